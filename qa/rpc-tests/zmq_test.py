@@ -11,6 +11,8 @@ from test_framework.test_framework import BitcoinTestFramework
 from test_framework.util import *
 import zmq
 import binascii
+import hashlib
+import struct
 
 try:
     import http.client as httplib
@@ -21,6 +23,36 @@ try:
 except ImportError:
     import urlparse
 
+def read_compact_size(data, pos):
+    n = ord(data[pos:pos+1])
+    if n < 253:
+        return n, pos + 1
+    if n == 253:
+        return struct.unpack("<H", data[pos+1:pos+3])[0], pos + 3
+    if n == 254:
+        return struct.unpack("<I", data[pos+1:pos+5])[0], pos + 5
+    return struct.unpack("<Q", data[pos+1:pos+9])[0], pos + 9
+
+# Length of the serialized transaction starting at pos
+def tx_size(data, pos):
+    start = pos
+    pos += 4 # version
+    nIn, pos = read_compact_size(data, pos)
+    for i in range(nIn):
+        pos += 36 # prevout
+        nScript, pos = read_compact_size(data, pos)
+        pos += nScript + 4 # scriptSig, sequence
+    nOut, pos = read_compact_size(data, pos)
+    for i in range(nOut):
+        pos += 8 # value
+        nScript, pos = read_compact_size(data, pos)
+        pos += nScript
+    pos += 4 # locktime
+    return pos - start
+
+def txid(raw):
+    return binascii.hexlify(hashlib.sha256(hashlib.sha256(raw).digest()).digest()[::-1]).decode("ascii")
+
 class ZMQTest (BitcoinTestFramework):
 
     port = 28332
@@ -31,13 +63,56 @@ class ZMQTest (BitcoinTestFramework):
         self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashblock")
         self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashtx")
         self.zmqSubSocket.connect("tcp://127.0.0.1:%i" % self.port)
+        # rawtxbatch on a socket of its own, so the hash topics arrive as before
+        self.zmqBatchSocket = self.zmqContext.socket(zmq.SUB)
+        self.zmqBatchSocket.setsockopt(zmq.SUBSCRIBE, b"rawtxbatch")
+        self.zmqBatchSocket.connect("tcp://127.0.0.1:%i" % self.port)
+        self.sequence = {}
+        self.hashtxs = []
         return start_nodes(4, self.options.tmpdir, extra_args=[
-            ['-zmqpubhashtx=tcp://127.0.0.1:'+str(self.port), '-zmqpubhashblock=tcp://127.0.0.1:'+str(self.port)],
+            ['-zmqpubhashtx=tcp://127.0.0.1:'+str(self.port), '-zmqpubhashblock=tcp://127.0.0.1:'+str(self.port),
+             '-zmqpubrawtxbatch=tcp://127.0.0.1:'+str(self.port)],
             [],
             [],
             []
             ])
 
+    # Receive a hash notification, checking that its topic's sequence numbers count up without gaps
+    def recv_hash(self):
+        msg = self.zmqSubSocket.recv_multipart()
+        topic = msg[0]
+        body = msg[1]
+        seq = struct.unpack("<I", msg[-1])[0]
+        assert_equal(seq, self.sequence.get(topic, 0))
+        self.sequence[topic] = seq + 1
+        if topic == b"hashtx":
+            self.hashtxs.append(binascii.hexlify(body).decode("ascii"))
+        return topic, body
+
+    # Receive rawtxbatch messages until they hold n transactions
+    def recv_batches(self, n):
+        txids = []
+        nextSeq = 0
+        poller = zmq.Poller()
+        poller.register(self.zmqBatchSocket, zmq.POLLIN)
+        while len(txids) < n:
+            assert(poller.poll(60000)) # a missing transaction shows up as a timeout
+            msg = self.zmqBatchSocket.recv_multipart()
+            assert_equal(msg[0], b"rawtxbatch")
+            body = msg[1]
+            # A batch carries its first transaction's number, the others take the ones after it
+            seq = struct.unpack("<I", msg[-1])[0]
+            assert_equal(seq, nextSeq)
+            count, pos = read_compact_size(body, 0)
+            assert(count >= 1)
+            for i in range(count):
+                size = tx_size(body, pos)
+                txids.append(txid(body[pos:pos+size]))
+                pos += size
+            assert_equal(pos, len(body))
+            nextSeq = seq + count
+        return txids
+
     def run_test(self):
         self.sync_all()
 
@@ -45,13 +120,9 @@ class ZMQTest (BitcoinTestFramework):
         self.sync_all()
 
         print "listen..."
-        msg = self.zmqSubSocket.recv_multipart()
-        topic = msg[0]
-        body = msg[1]
+        topic, body = self.recv_hash()
 
-        msg = self.zmqSubSocket.recv_multipart()
-        topic = msg[0]
-        body = msg[1]
+        topic, body = self.recv_hash()
         blkhash = bytes_to_hex_str(body)
 
         assert_equal(genhashes[0], blkhash) #blockhash from generate must be equal to the hash received over zmq
@@ -62,9 +133,7 @@ class ZMQTest (BitcoinTestFramework):
 
         zmqHashes = []
         for x in range(0,n*2):
-            msg = self.zmqSubSocket.recv_multipart()
-            topic = msg[0]
-            body = msg[1]
+            topic, body = self.recv_hash()
             if topic == b"hashblock":
                 zmqHashes.append(bytes_to_hex_str(body))
 
@@ -76,15 +145,26 @@ class ZMQTest (BitcoinTestFramework):
         self.sync_all()
 
         # now we should receive a zmq msg because the tx was broadcast
-        msg = self.zmqSubSocket.recv_multipart()
-        topic = msg[0]
-        body = msg[1]
+        topic, body = self.recv_hash()
         hashZMQ = ""
         if topic == b"hashtx":
             hashZMQ = bytes_to_hex_str(body)
 
         assert_equal(hashRPC, hashZMQ) #blockhash from generate must be equal to the hash received over zmq
 
+        # a burst of transactions, so that several queue up for one rawtxbatch message
+        hashesRPC = []
+        for x in range(0,10):
+            hashesRPC.append(self.nodes[1].sendtoaddress(self.nodes[0].getnewaddress(), 0.1))
+        self.sync_all()
+        for x in range(0,10):
+            topic, body = self.recv_hash()
+            assert_equal(topic, b"hashtx")
+        assert_equal(sorted(self.hashtxs[-10:]), sorted(hashesRPC)) # relayed, so not necessarily in send order
+
+        # rawtxbatch carries the same transactions as hashtx, in the same order
+        assert_equal(self.recv_batches(len(self.hashtxs)), self.hashtxs)
+
 
 if __name__ == '__main__':
     ZMQTest ().main ()
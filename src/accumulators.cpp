@@ -439,7 +439,7 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
         return error("%s failed to read tx", __func__);
 
     int nHeightTest;
-    if (!IsTransactionInChain(txid, nHeightTest))
+    if (!IsZerocoinTxInChain(txid, nHeightTest))
         return error("%s: mint tx %s is not in chain", __func__, txid.GetHex());
 
     int nHeightMintAdded = mapBlockIndex[hashBlock]->nHeight;
@@ -0,0 +1,311 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_ADDRESSINDEX_H
+#define BITCOIN_ADDRESSINDEX_H
+
+#include "amount.h"
+#include "crypto/common.h"
+#include "script/script.h"
+#include "serialize.h"
+#include "uint256.h"
+
+/**
+ * Optional explorer indexes kept in the block tree database:
+ *   'a' address index   every output paid to and every input spent from an address (-addressindex)
+ *   'u' unspent index   the unspent outputs of an address (-addressindex)
+ *   'p' spent index     the input that spent an output (-spentindex)
+ *   's' timestamp index block hashes by block time (-timestampindex)
+ * Heights, positions and times are stored big-endian so that LevelDB keeps the
+ * records of one address in chain order.
+ */
+
+/** Kinds of address the indexes know about. Zerocoin mints, data carriers and bare multisig outputs have none */
+enum AddressIndexType {
+    ADDRESS_INDEX_NONE = 0,
+    ADDRESS_INDEX_PUBKEYHASH = 1,
+    ADDRESS_INDEX_SCRIPTHASH = 2,
+};
+
+/** Wrapper that serializes a 32-bit integer big-endian, use with the BIGENDIAN32 macro */
+template <typename I>
+class CBigEndian32
+{
+protected:
+    I& n;
+
+public:
+    CBigEndian32(I& nIn) : n(nIn) {}
+
+    unsigned int GetSerializeSize(int, int) const
+    {
+        return 4;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int, int) const
+    {
+        unsigned char buf[4];
+        WriteBE32(buf, (uint32_t)n);
+        s.write((const char*)buf, 4);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int, int)
+    {
+        unsigned char buf[4];
+        s.read((char*)buf, 4);
+        n = (I)ReadBE32(buf);
+    }
+};
+
+template <typename I>
+CBigEndian32<I> WrapBigEndian32(I& n)
+{
+    return CBigEndian32<I>(n);
+}
+
+#define BIGENDIAN32(obj) REF(WrapBigEndian32(REF(obj)))
+
+struct CAddressIndexKey {
+    unsigned char nAddressType;
+    uint160 hashBytes;
+    int nHeight;
+    unsigned int nTxIndex;
+    uint256 txhash;
+    unsigned int nIndex;
+    bool fSpending;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nAddressType);
+        READWRITE(hashBytes);
+        READWRITE(BIGENDIAN32(nHeight));
+        READWRITE(BIGENDIAN32(nTxIndex));
+        READWRITE(txhash);
+        READWRITE(BIGENDIAN32(nIndex));
+        READWRITE(fSpending);
+    }
+
+    CAddressIndexKey(unsigned char nAddressTypeIn, const uint160& hashBytesIn, int nHeightIn, unsigned int nTxIndexIn,
+                     const uint256& txhashIn, unsigned int nIndexIn, bool fSpendingIn)
+        : nAddressType(nAddressTypeIn), hashBytes(hashBytesIn), nHeight(nHeightIn), nTxIndex(nTxIndexIn),
+          txhash(txhashIn), nIndex(nIndexIn), fSpending(fSpendingIn) {}
+
+    CAddressIndexKey()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        nAddressType = ADDRESS_INDEX_NONE;
+        hashBytes = 0;
+        nHeight = 0;
+        nTxIndex = 0;
+        txhash = 0;
+        nIndex = 0;
+        fSpending = false;
+    }
+};
+
+/** Leading part of a CAddressIndexKey, to seek to the first record of an address at or above nHeight */
+struct CAddressIndexIteratorKey {
+    unsigned char nAddressType;
+    uint160 hashBytes;
+    int nHeight;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nAddressType);
+        READWRITE(hashBytes);
+        READWRITE(BIGENDIAN32(nHeight));
+    }
+
+    CAddressIndexIteratorKey(unsigned char nAddressTypeIn, const uint160& hashBytesIn, int nHeightIn = 0)
+        : nAddressType(nAddressTypeIn), hashBytes(hashBytesIn), nHeight(nHeightIn) {}
+};
+
+struct CAddressUnspentKey {
+    unsigned char nAddressType;
+    uint160 hashBytes;
+    uint256 txhash;
+    unsigned int nIndex;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nAddressType);
+        READWRITE(hashBytes);
+        READWRITE(txhash);
+        READWRITE(BIGENDIAN32(nIndex));
+    }
+
+    CAddressUnspentKey(unsigned char nAddressTypeIn, const uint160& hashBytesIn, const uint256& txhashIn, unsigned int nIndexIn)
+        : nAddressType(nAddressTypeIn), hashBytes(hashBytesIn), txhash(txhashIn), nIndex(nIndexIn) {}
+
+    CAddressUnspentKey()
+    {
+        nAddressType = ADDRESS_INDEX_NONE;
+        hashBytes = 0;
+        txhash = 0;
+        nIndex = 0;
+    }
+};
+
+/** Leading part of a CAddressUnspentKey, to seek to the first unspent output of an address */
+struct CAddressUnspentIteratorKey {
+    unsigned char nAddressType;
+    uint160 hashBytes;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nAddressType);
+        READWRITE(hashBytes);
+    }
+
+    CAddressUnspentIteratorKey(unsigned char nAddressTypeIn, const uint160& hashBytesIn) : nAddressType(nAddressTypeIn), hashBytes(hashBytesIn) {}
+};
+
+/** A null value in an update erases the record */
+struct CAddressUnspentValue {
+    CAmount nSatoshis;
+    CScript script;
+    int nHeight;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nSatoshis);
+        READWRITE(script);
+        READWRITE(nHeight);
+    }
+
+    CAddressUnspentValue(CAmount nSatoshisIn, const CScript& scriptIn, int nHeightIn)
+        : nSatoshis(nSatoshisIn), script(scriptIn), nHeight(nHeightIn) {}
+
+    CAddressUnspentValue()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        nSatoshis = -1;
+        script.clear();
+        nHeight = 0;
+    }
+
+    bool IsNull() const
+    {
+        return nSatoshis == -1;
+    }
+};
+
+struct CSpentIndexKey {
+    uint256 txid;
+    unsigned int nOutputIndex;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(txid);
+        READWRITE(nOutputIndex);
+    }
+
+    CSpentIndexKey(const uint256& txidIn, unsigned int nOutputIndexIn) : txid(txidIn), nOutputIndex(nOutputIndexIn) {}
+
+    CSpentIndexKey()
+    {
+        txid = 0;
+        nOutputIndex = 0;
+    }
+};
+
+/** The input that spent an output. A null value in an update erases the record */
+struct CSpentIndexValue {
+    uint256 txid;
+    unsigned int nInputIndex;
+    int nHeight;
+    CAmount nSatoshis;
+    unsigned char nAddressType;
+    uint160 addressHash;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(txid);
+        READWRITE(nInputIndex);
+        READWRITE(nHeight);
+        READWRITE(nSatoshis);
+        READWRITE(nAddressType);
+        READWRITE(addressHash);
+    }
+
+    CSpentIndexValue(const uint256& txidIn, unsigned int nInputIndexIn, int nHeightIn, CAmount nSatoshisIn,
+                     unsigned char nAddressTypeIn, const uint160& addressHashIn)
+        : txid(txidIn), nInputIndex(nInputIndexIn), nHeight(nHeightIn), nSatoshis(nSatoshisIn),
+          nAddressType(nAddressTypeIn), addressHash(addressHashIn) {}
+
+    CSpentIndexValue()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        txid = 0;
+        nInputIndex = 0;
+        nHeight = -1;
+        nSatoshis = 0;
+        nAddressType = ADDRESS_INDEX_NONE;
+        addressHash = 0;
+    }
+
+    bool IsNull() const
+    {
+        return txid == 0;
+    }
+};
+
+struct CTimestampIndexKey {
+    unsigned int nTimestamp;
+    uint256 blockHash;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(BIGENDIAN32(nTimestamp));
+        READWRITE(blockHash);
+    }
+
+    CTimestampIndexKey(unsigned int nTimestampIn, const uint256& blockHashIn) : nTimestamp(nTimestampIn), blockHash(blockHashIn) {}
+
+    CTimestampIndexKey()
+    {
+        nTimestamp = 0;
+        blockHash = 0;
+    }
+};
+
+#endif // BITCOIN_ADDRESSINDEX_H
@@ -0,0 +1,194 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "chainparams.h"
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "main.h"
+#include "primitives/block.h"
+#include "primitives/zerocoin.h"
+#include "script/script.h"
+#include "zuserxchain.h"
+
+#include <algorithm>
+#include <ios>
+
+#include <boost/foreach.hpp>
+
+namespace {
+
+/** Writes bits most significant first */
+class CBitWriter
+{
+private:
+    std::vector<unsigned char>& vch;
+    int nBit;
+
+public:
+    explicit CBitWriter(std::vector<unsigned char>& vchIn) : vch(vchIn), nBit(0) {}
+
+    void WriteBit(bool fBit)
+    {
+        if (nBit == 0)
+            vch.push_back(0);
+        if (fBit)
+            vch.back() |= 0x80 >> nBit;
+        nBit = (nBit + 1) & 7;
+    }
+
+    void Write(uint64_t nValue, int nBits)
+    {
+        for (int i = nBits - 1; i >= 0; i--)
+            WriteBit((nValue >> i) & 1);
+    }
+};
+
+class CBitReader
+{
+private:
+    const std::vector<unsigned char>& vch;
+    uint64_t nPos;
+
+public:
+    explicit CBitReader(const std::vector<unsigned char>& vchIn) : vch(vchIn), nPos(0) {}
+
+    bool ReadBit()
+    {
+        if (nPos >= (uint64_t)vch.size() * 8)
+            throw std::ios_base::failure("CBitReader::ReadBit() : end of data");
+        bool fBit = (vch[nPos >> 3] >> (7 - (nPos & 7))) & 1;
+        nPos++;
+        return fBit;
+    }
+
+    uint64_t Read(int nBits)
+    {
+        uint64_t nValue = 0;
+        for (int i = 0; i < nBits; i++)
+            nValue = (nValue << 1) | ReadBit();
+        return nValue;
+    }
+};
+
+void GolombRiceEncode(CBitWriter& writer, uint64_t nValue)
+{
+    for (uint64_t q = nValue >> BLOCK_FILTER_P; q > 0; q--)
+        writer.WriteBit(true);
+    writer.WriteBit(false);
+    writer.Write(nValue, BLOCK_FILTER_P);
+}
+
+uint64_t GolombRiceDecode(CBitReader& reader)
+{
+    uint64_t q = 0;
+    while (reader.ReadBit())
+        q++;
+    return (q << BLOCK_FILTER_P) + reader.Read(BLOCK_FILTER_P);
+}
+
+/** Map a 64-bit hash uniformly onto [0, nRange). Monotonic in nHash. */
+uint64_t MapToRange(uint64_t nHash, uint64_t nRange)
+{
+#ifdef __SIZEOF_INT128__
+    return (uint64_t)(((unsigned __int128)nHash * nRange) >> 64);
+#else
+    uint64_t a = nHash >> 32, b = nHash & 0xffffffff;
+    uint64_t c = nRange >> 32, d = nRange & 0xffffffff;
+    uint64_t ad = a * d, bc = b * c;
+    uint64_t nMid = ((b * d) >> 32) + (ad & 0xffffffff) + (bc & 0xffffffff);
+    return a * c + (ad >> 32) + (bc >> 32) + (nMid >> 32);
+#endif
+}
+
+void AddScript(std::vector<uint64_t>& vHashes, const CScript& script)
+{
+    if (script.empty() || script[0] == OP_RETURN)
+        return;
+    vHashes.push_back(CBlockFilter::HashElement(script.data(), script.data() + script.size()));
+}
+
+} // anon namespace
+
+CBlockFilter::CBlockFilter(const CBlock& block, const CBlockUndo& blockundo) : nElements(0)
+{
+    std::vector<uint64_t> vHashes;
+    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+        if (tx.IsZerocoinSpend())
+            vHashes.push_back(GetZerocoinSpendElement());
+        BOOST_FOREACH (const CTxOut& txout, tx.vout) {
+            if (!txout.scriptPubKey.IsZerocoinMint()) {
+                AddScript(vHashes, txout.scriptPubKey);
+                continue;
+            }
+            libzerocoin::PublicCoin pubcoin(Params().Zerocoin_Params(false));
+            CValidationState state;
+            if (TxOutToPublicCoin(txout, pubcoin, state)) {
+                uint256 hashPubcoin = GetPubCoinHash(pubcoin.getValue());
+                vHashes.push_back(HashElement(hashPubcoin.begin(), hashPubcoin.end()));
+            }
+        }
+    }
+    BOOST_FOREACH (const CTxUndo& txundo, blockundo.vtxundo) {
+        BOOST_FOREACH (const CTxInUndo& txinundo, txundo.vprevout)
+            AddScript(vHashes, txinundo.txout.scriptPubKey);
+    }
+
+    std::sort(vHashes.begin(), vHashes.end());
+    vHashes.erase(std::unique(vHashes.begin(), vHashes.end()), vHashes.end());
+    nElements = vHashes.size();
+
+    // Mapping preserves order, so the mapped values are already sorted
+    const uint64_t nRange = (uint64_t)nElements * BLOCK_FILTER_M;
+    CBitWriter writer(vchEncoded);
+    uint64_t nLast = 0;
+    BOOST_FOREACH (uint64_t nHash, vHashes) {
+        uint64_t nValue = MapToRange(nHash, nRange);
+        GolombRiceEncode(writer, nValue - nLast);
+        nLast = nValue;
+    }
+}
+
+uint64_t CBlockFilter::HashElement(const unsigned char* pbegin, const unsigned char* pend)
+{
+    const uint256& hashKey = Params().HashGenesisBlock();
+    unsigned char vchHash[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(hashKey.begin(), hashKey.size()).Write(pbegin, pend - pbegin).Finalize(vchHash);
+    return ReadLE64(vchHash);
+}
+
+uint64_t CBlockFilter::GetZerocoinSpendElement()
+{
+    static const std::string strMarker = "zerocoinspend";
+    return HashElement((const unsigned char*)strMarker.data(), (const unsigned char*)strMarker.data() + strMarker.size());
+}
+
+bool CBlockFilter::MatchAny(const std::vector<uint64_t>& vHashesSorted) const
+{
+    if (nElements == 0 || vHashesSorted.empty())
+        return false;
+
+    // Walk the set once; for each value, binary search the query hashes by
+    // their mapped value, which is monotonic in the hash.
+    const uint64_t nRange = (uint64_t)nElements * BLOCK_FILTER_M;
+    std::vector<uint64_t>::const_iterator it = vHashesSorted.begin();
+    try {
+        CBitReader reader(vchEncoded);
+        uint64_t nValue = 0;
+        for (uint32_t i = 0; i < nElements; i++) {
+            nValue += GolombRiceDecode(reader);
+            it = std::lower_bound(it, vHashesSorted.end(), nValue, [nRange](uint64_t nHash, uint64_t nTarget) {
+                return MapToRange(nHash, nRange) < nTarget;
+            });
+            if (it == vHashesSorted.end())
+                return false;
+            if (MapToRange(*it, nRange) == nValue)
+                return true;
+        }
+    } catch (const std::ios_base::failure&) {
+        return true;
+    }
+    return false;
+}
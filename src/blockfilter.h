@@ -0,0 +1,64 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef USERX_BLOCKFILTER_H
+#define USERX_BLOCKFILTER_H
+
+#include "serialize.h"
+
+#include <stdint.h>
+#include <vector>
+
+class CBlock;
+class CBlockUndo;
+
+/** Golomb-Rice parameter: number of low bits stored verbatim per delta */
+static const int BLOCK_FILTER_P = 19;
+/** Inverse false positive rate of a filter lookup */
+static const uint64_t BLOCK_FILTER_M = 784931;
+/** Version of the element set; stored filters of another version are rebuilt */
+static const int BLOCK_FILTER_VERSION = 2;
+
+/**
+ * Golomb-coded set over the output scripts of a block, the scripts its
+ * inputs spent and the pubcoin hashes of its zerocoin mints (BIP 158 style).
+ * Blocks with a zerocoin spend also hold a fixed spend marker, as a spend
+ * carries no script or pubcoin of the wallet that minted the coin.
+ *
+ * Elements are hashed with a chain-wide key instead of a per-block one, so
+ * a wallet hashes its own scripts once and tests them against every block.
+ * The filters are a local index and are never relayed.
+ */
+class CBlockFilter
+{
+private:
+    uint32_t nElements;
+    std::vector<unsigned char> vchEncoded;
+
+public:
+    CBlockFilter() : nElements(0) {}
+    CBlockFilter(const CBlock& block, const CBlockUndo& blockundo);
+
+    static uint64_t HashElement(const unsigned char* pbegin, const unsigned char* pend);
+    static uint64_t GetZerocoinSpendElement();
+
+    /**
+     * Whether any of the given element hashes may be in the set. The hashes
+     * must be sorted. Corrupt filters match everything.
+     */
+    bool MatchAny(const std::vector<uint64_t>& vHashesSorted) const;
+
+    uint32_t GetElementCount() const { return nElements; }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(VARINT(nElements));
+        READWRITE(vchEncoded);
+    }
+};
+
+#endif // USERX_BLOCKFILTER_H
@@ -69,8 +69,8 @@ bool CheckBlockSignature(const CBlock& block)
     CPubKey pubkey;
     bool fzUSERXStake = block.vtx[1].IsZerocoinSpend();
     if (fzUSERXStake) {
-        libzerocoin::CoinSpend spend = TxInToZerocoinSpend(block.vtx[1].vin[0]);
-        pubkey = spend.getPubKey();
+        CoinSpendRef spend = TxInToZerocoinSpendRef(block.vtx[1], 0);
+        pubkey = spend->getPubKey();
     } else {
         txnouttype whichType;
         std::vector<valtype> vSolutions;
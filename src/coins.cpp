@@ -6,6 +6,8 @@
 #include "coins.h"
 
 #include "random.h"
+#include "streams.h"
+#include "version.h"
 
 #include <assert.h>
 
@@ -279,3 +281,12 @@ CCoinsModifier::~CCoinsModifier()
         cache.cacheCoins.erase(it);
     }
 }
+
+std::vector<unsigned char> UTXOSetHashElement(const COutPoint& outpoint, const CTxOut& out)
+{
+    // Only what the undo data can give back when the output is spent: the
+    // height and coinbase flag are kept with the last output of a transaction only
+    CDataStream ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << outpoint << out;
+    return std::vector<unsigned char>(ss.begin(), ss.end());
+}
@@ -327,10 +327,14 @@ struct CCoinsStats {
     uint64_t nSerializedSize;
     uint256 hashSerialized;
     CAmount nTotalAmount;
+    uint256 hashMuHash;
 
-    CCoinsStats() : nHeight(0), hashBlock(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), hashSerialized(0), nTotalAmount(0) {}
+    CCoinsStats() : nHeight(0), hashBlock(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), hashSerialized(0), nTotalAmount(0), hashMuHash(0) {}
 };
 
+/** Serialized form of an unspent output as it goes into the MuHash of the UTXO set */
+std::vector<unsigned char> UTXOSetHashElement(const COutPoint& outpoint, const CTxOut& out);
+
 
 /** Abstract view on the open txout dataset. */
 class CCoinsView
@@ -270,7 +270,8 @@ bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
             uint256 seed = key.GetPrivKey_256();
             LogPrintf("%s: first run of zuserx wallet detected, new seed generated. Seedhash=%s\n", __func__, Hash(seed.begin(), seed.end()).GetHex());
             pwalletMain->zwalletMain->SetMasterSeed(seed, true);
-            pwalletMain->zwalletMain->GenerateMintPool();
+            if (!pwalletMain->zwalletMain->GenerateMintPool())
+                LogPrintf("%s: failed to save the first mint pool\n", __func__);
         }
     }
 
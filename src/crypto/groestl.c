@@ -2734,6 +2734,243 @@ static const sph_u32 T3dn[] = {
 
 #endif
 
+/*
+ * AES-NI implementation of the big (1024-bit) permutations, selected at
+ * runtime. The state is held as eight 128-bit rows; AESENCLAST with a
+ * zero key applies the AES S-box (Groestl's SubBytes) together with AES
+ * ShiftRows, which a PSHUFB then replaces with Groestl's ShiftBytes.
+ */
+#if SPH_GROESTL_64 && USE_LE && !defined SPH_NO_GROESTL_AESNI \
+	&& (defined __x86_64__ || defined __i386__) \
+	&& (defined __clang__ || (defined __GNUC__ \
+	&& (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define SPH_GROESTL_AESNI   1
+#endif
+
+#if SPH_GROESTL_AESNI
+
+#include <cpuid.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+
+#define AESNI_FUNC   __attribute__((target("aes,ssse3")))
+
+/* AES ShiftRows undone and row i rotated left by the Groestl shift */
+static const unsigned char SHUF_P[8][16] __attribute__((aligned(16))) = {
+	{ 0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3 },
+	{ 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0 },
+	{ 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13 },
+	{ 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13, 10 },
+	{ 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7 },
+	{ 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7, 4 },
+	{ 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7, 4, 1 },
+	{ 15, 12, 9, 6, 3, 0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2 }
+};
+
+static const unsigned char SHUF_Q[8][16] __attribute__((aligned(16))) = {
+	{ 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0 },
+	{ 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13, 10 },
+	{ 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7, 4 },
+	{ 15, 12, 9, 6, 3, 0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2 },
+	{ 0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3 },
+	{ 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13 },
+	{ 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7 },
+	{ 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7, 4, 1 }
+};
+
+static int groestl_aesni = -1;
+
+static int
+groestl_aesni_supported(void)
+{
+	if (groestl_aesni < 0) {
+		unsigned a, b, c, d;
+		groestl_aesni = __get_cpuid(1, &a, &b, &c, &d)
+			&& (c & bit_AES) && (c & bit_SSSE3);
+	}
+	return groestl_aesni;
+}
+
+/* Transpose an 8x8 matrix of 16-bit words */
+AESNI_FUNC static void
+aesni_transpose(__m128i *y, const __m128i *x)
+{
+	__m128i b[8], c[8];
+	int i;
+
+	for (i = 0; i < 4; i ++) {
+		b[2 * i] = _mm_unpacklo_epi16(x[2 * i], x[2 * i + 1]);
+		b[2 * i + 1] = _mm_unpackhi_epi16(x[2 * i], x[2 * i + 1]);
+	}
+	c[0] = _mm_unpacklo_epi32(b[0], b[2]);
+	c[1] = _mm_unpackhi_epi32(b[0], b[2]);
+	c[2] = _mm_unpacklo_epi32(b[1], b[3]);
+	c[3] = _mm_unpackhi_epi32(b[1], b[3]);
+	c[4] = _mm_unpacklo_epi32(b[4], b[6]);
+	c[5] = _mm_unpackhi_epi32(b[4], b[6]);
+	c[6] = _mm_unpacklo_epi32(b[5], b[7]);
+	c[7] = _mm_unpackhi_epi32(b[5], b[7]);
+	for (i = 0; i < 4; i ++) {
+		y[2 * i] = _mm_unpacklo_epi64(c[i], c[i + 4]);
+		y[2 * i + 1] = _mm_unpackhi_epi64(c[i], c[i + 4]);
+	}
+}
+
+/* 128 bytes in column order to eight rows */
+AESNI_FUNC static void
+aesni_to_rows(__m128i *rows, const void *cols)
+{
+	const __m128i pair = _mm_setr_epi8(
+		0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15);
+	__m128i x[8];
+	int i;
+
+	for (i = 0; i < 8; i ++)
+		x[i] = _mm_shuffle_epi8(_mm_loadu_si128(
+			(const __m128i *)cols + i), pair);
+	aesni_transpose(rows, x);
+}
+
+AESNI_FUNC static void
+aesni_from_rows(void *cols, const __m128i *rows)
+{
+	const __m128i unpair = _mm_setr_epi8(
+		0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+	__m128i x[8];
+	int i;
+
+	aesni_transpose(x, rows);
+	for (i = 0; i < 8; i ++)
+		_mm_storeu_si128((__m128i *)cols + i,
+			_mm_shuffle_epi8(x[i], unpair));
+}
+
+/* Multiplication by 2 in GF(2^8) */
+AESNI_FUNC static inline __m128i
+aesni_xtime(__m128i x)
+{
+	__m128i hi = _mm_cmplt_epi8(x, _mm_setzero_si128());
+	return _mm_xor_si128(_mm_add_epi8(x, x),
+		_mm_and_si128(hi, _mm_set1_epi8(0x1B)));
+}
+
+/*
+ * SubBytes, ShiftBytes and MixBytes. Row i of the result is
+ * sum(b[d] * x[i + d]) with b = (2, 2, 3, 4, 5, 3, 5, 7), computed as
+ * s1 + 2 * (s2 + 2 * s4), where s1, s2 and s4 sum the rows whose
+ * coefficient contains 1, 2 and 4 respectively.
+ */
+#define AESNI_SUB(i) \
+	y ## i = _mm_shuffle_epi8(_mm_aesenclast_si128(x[i], z), \
+		_mm_load_si128((const __m128i *)shuf[i]))
+
+#define AESNI_MIX(i, a0, a1, a2, a3, a4, a5, a6, a7)   do { \
+		__m128i s1, s2, s4; \
+		s1 = _mm_xor_si128(_mm_xor_si128(a2, a4), \
+			_mm_xor_si128(_mm_xor_si128(a5, a6), a7)); \
+		s2 = _mm_xor_si128(_mm_xor_si128(a0, a1), \
+			_mm_xor_si128(_mm_xor_si128(a2, a5), a7)); \
+		s4 = _mm_xor_si128(_mm_xor_si128(a3, a4), \
+			_mm_xor_si128(a6, a7)); \
+		x[i] = _mm_xor_si128(s1, \
+			aesni_xtime(_mm_xor_si128(s2, aesni_xtime(s4)))); \
+	} while (0)
+
+AESNI_FUNC static inline void
+aesni_round(__m128i *x, const unsigned char (*shuf)[16])
+{
+	const __m128i z = _mm_setzero_si128();
+	__m128i y0, y1, y2, y3, y4, y5, y6, y7;
+
+	AESNI_SUB(0);
+	AESNI_SUB(1);
+	AESNI_SUB(2);
+	AESNI_SUB(3);
+	AESNI_SUB(4);
+	AESNI_SUB(5);
+	AESNI_SUB(6);
+	AESNI_SUB(7);
+	AESNI_MIX(0, y0, y1, y2, y3, y4, y5, y6, y7);
+	AESNI_MIX(1, y1, y2, y3, y4, y5, y6, y7, y0);
+	AESNI_MIX(2, y2, y3, y4, y5, y6, y7, y0, y1);
+	AESNI_MIX(3, y3, y4, y5, y6, y7, y0, y1, y2);
+	AESNI_MIX(4, y4, y5, y6, y7, y0, y1, y2, y3);
+	AESNI_MIX(5, y5, y6, y7, y0, y1, y2, y3, y4);
+	AESNI_MIX(6, y6, y7, y0, y1, y2, y3, y4, y5);
+	AESNI_MIX(7, y7, y0, y1, y2, y3, y4, y5, y6);
+}
+
+AESNI_FUNC static void
+aesni_perm_p(__m128i *x)
+{
+	const __m128i cst = _mm_setr_epi8(
+		0x00, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70,
+		(char)0x80, (char)0x90, (char)0xA0, (char)0xB0,
+		(char)0xC0, (char)0xD0, (char)0xE0, (char)0xF0);
+	int r;
+
+	for (r = 0; r < 14; r ++) {
+		x[0] = _mm_xor_si128(x[0],
+			_mm_xor_si128(cst, _mm_set1_epi8((char)r)));
+		aesni_round(x, SHUF_P);
+	}
+}
+
+AESNI_FUNC static void
+aesni_perm_q(__m128i *x)
+{
+	const __m128i ones = _mm_set1_epi8((char)0xFF);
+	const __m128i cst = _mm_setr_epi8(
+		(char)0xFF, (char)0xEF, (char)0xDF, (char)0xCF,
+		(char)0xBF, (char)0xAF, (char)0x9F, (char)0x8F,
+		0x7F, 0x6F, 0x5F, 0x4F, 0x3F, 0x2F, 0x1F, 0x0F);
+	int i, r;
+
+	for (r = 0; r < 14; r ++) {
+		for (i = 0; i < 7; i ++)
+			x[i] = _mm_xor_si128(x[i], ones);
+		x[7] = _mm_xor_si128(x[7],
+			_mm_xor_si128(cst, _mm_set1_epi8((char)r)));
+		aesni_round(x, SHUF_Q);
+	}
+}
+
+/* Same as COMPRESS_BIG */
+AESNI_FUNC static void
+groestl_big_compress_aesni(sph_u64 *H, const unsigned char *buf)
+{
+	__m128i h[8], g[8], m[8];
+	int i;
+
+	aesni_to_rows(h, H);
+	aesni_to_rows(m, buf);
+	for (i = 0; i < 8; i ++)
+		g[i] = _mm_xor_si128(h[i], m[i]);
+	aesni_perm_p(g);
+	aesni_perm_q(m);
+	for (i = 0; i < 8; i ++)
+		h[i] = _mm_xor_si128(h[i], _mm_xor_si128(g[i], m[i]));
+	aesni_from_rows(H, h);
+}
+
+/* Same as FINAL_BIG */
+AESNI_FUNC static void
+groestl_big_final_aesni(sph_u64 *H)
+{
+	__m128i h[8], x[8];
+	int i;
+
+	aesni_to_rows(h, H);
+	for (i = 0; i < 8; i ++)
+		x[i] = h[i];
+	aesni_perm_p(x);
+	for (i = 0; i < 8; i ++)
+		h[i] = _mm_xor_si128(h[i], x[i]);
+	aesni_from_rows(H, h);
+}
+
+#endif
+
 static void
 groestl_small_init(sph_groestl_small_context *sc, unsigned out_size)
 {
@@ -2932,6 +3169,11 @@ groestl_big_core(sph_groestl_big_context *sc, const void *data, size_t len)
 		data = (const unsigned char *)data + clen;
 		len -= clen;
 		if (ptr == sizeof sc->buf) {
+#if SPH_GROESTL_AESNI
+			if (groestl_aesni_supported())
+				groestl_big_compress_aesni(H, buf);
+			else
+#endif
 			COMPRESS_BIG;
 #if SPH_64
 			sc->count ++;
@@ -2995,6 +3237,11 @@ groestl_big_close(sph_groestl_big_context *sc,
 #endif
 	groestl_big_core(sc, pad, pad_len);
 	READ_STATE_BIG(sc);
+#if SPH_GROESTL_AESNI
+	if (groestl_aesni_supported())
+		groestl_big_final_aesni(H);
+	else
+#endif
 	FINAL_BIG;
 #if SPH_GROESTL_64
 	for (u = 0; u < 8; u ++)
@@ -717,6 +717,109 @@ static const sph_u32 IV512[] = {
 
 #endif
 
+/*
+ * On x86 with SSE2, the "hi" and "lo" halves of each 64-bit bitslice
+ * word pair are processed together in one 128-bit register. The
+ * bitwise operators in Sb() and Lb() work on vector types as is; only
+ * the loads, stores and the W* permutations need intrinsics. The
+ * little-endian word order of H.wide and C matches the register lanes.
+ */
+#if SPH_JH_64 && SPH_LITTLE_ENDIAN && defined __SSE2__ && !defined SPH_NO_JH_SSE2
+#define SPH_JH_SSE2   1
+#endif
+
+#if SPH_JH_SSE2
+
+#include <emmintrin.h>
+
+#undef DECL_STATE
+#undef READ_STATE
+#undef WRITE_STATE
+#undef INPUT_BUF1
+#undef INPUT_BUF2
+#undef S
+#undef L
+#undef W0
+#undef W1
+#undef W2
+#undef W3
+#undef W4
+#undef W5
+#undef W6
+#undef Wz
+
+#define DECL_STATE \
+	__m128i h0, h1, h2, h3, h4, h5, h6, h7; \
+	__m128i tmp;
+
+#define READ_STATE(state)   do { \
+		const __m128i *hp = (const __m128i *)(state)->H.wide; \
+		h0 = _mm_loadu_si128(hp + 0); \
+		h1 = _mm_loadu_si128(hp + 1); \
+		h2 = _mm_loadu_si128(hp + 2); \
+		h3 = _mm_loadu_si128(hp + 3); \
+		h4 = _mm_loadu_si128(hp + 4); \
+		h5 = _mm_loadu_si128(hp + 5); \
+		h6 = _mm_loadu_si128(hp + 6); \
+		h7 = _mm_loadu_si128(hp + 7); \
+	} while (0)
+
+#define WRITE_STATE(state)   do { \
+		__m128i *hp = (__m128i *)(state)->H.wide; \
+		_mm_storeu_si128(hp + 0, h0); \
+		_mm_storeu_si128(hp + 1, h1); \
+		_mm_storeu_si128(hp + 2, h2); \
+		_mm_storeu_si128(hp + 3, h3); \
+		_mm_storeu_si128(hp + 4, h4); \
+		_mm_storeu_si128(hp + 5, h5); \
+		_mm_storeu_si128(hp + 6, h6); \
+		_mm_storeu_si128(hp + 7, h7); \
+	} while (0)
+
+#define INPUT_BUF1 \
+	__m128i m0 = _mm_loadu_si128((const __m128i *)(buf +  0)); \
+	__m128i m1 = _mm_loadu_si128((const __m128i *)(buf + 16)); \
+	__m128i m2 = _mm_loadu_si128((const __m128i *)(buf + 32)); \
+	__m128i m3 = _mm_loadu_si128((const __m128i *)(buf + 48)); \
+	h0 ^= m0; \
+	h1 ^= m1; \
+	h2 ^= m2; \
+	h3 ^= m3;
+
+#define INPUT_BUF2 \
+	h4 ^= m0; \
+	h5 ^= m1; \
+	h6 ^= m2; \
+	h7 ^= m3;
+
+#define Ceven_v(r)   _mm_loadu_si128((const __m128i *)&C[((r) << 2) + 0])
+#define Codd_v(r)    _mm_loadu_si128((const __m128i *)&C[((r) << 2) + 2])
+
+#define S(x0, x1, x2, x3, cb, r)   do { \
+		__m128i cv = cb ## v(r); \
+		Sb(x0, x1, x2, x3, cv); \
+	} while (0)
+
+#define L(x0, x1, x2, x3, x4, x5, x6, x7) \
+	Lb(x0, x1, x2, x3, x4, x5, x6, x7)
+
+#define Wz(x, c, n)   do { \
+		__m128i cm = _mm_set1_epi64x((long long)(c)); \
+		__m128i t = _mm_slli_epi64(x & cm, n); \
+		x = (_mm_srli_epi64(x, n) & cm) | t; \
+	} while (0)
+
+#define W0(x)   Wz(x, SPH_C64(0x5555555555555555),  1)
+#define W1(x)   Wz(x, SPH_C64(0x3333333333333333),  2)
+#define W2(x)   Wz(x, SPH_C64(0x0F0F0F0F0F0F0F0F),  4)
+#define W3(x)   Wz(x, SPH_C64(0x00FF00FF00FF00FF),  8)
+#define W4(x)   Wz(x, SPH_C64(0x0000FFFF0000FFFF), 16)
+#define W5(x)   Wz(x, SPH_C64(0x00000000FFFFFFFF), 32)
+#define W6(x)   (x = _mm_shuffle_epi32(x, 0x4E))
+
+#endif
+
+
 #define SL(ro)   SLu(r + ro, ro)
 
 #define SLu(r, ro)   do { \
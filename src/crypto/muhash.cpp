@@ -0,0 +1,264 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/muhash.h"
+
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "crypto/sha512.h"
+
+#include <string.h>
+
+namespace
+{
+typedef unsigned __int128 uint128_t;
+
+/** The prime is 2^3072 - MAX_PRIME_DIFF */
+const uint64_t MAX_PRIME_DIFF = 1103717;
+const int LIMBS = Num3072::LIMBS;
+
+/** Whether a >= the prime */
+bool IsOverflow(const Num3072& a)
+{
+    if (a.limbs[0] <= ~(uint64_t)0 - MAX_PRIME_DIFF)
+        return false;
+    for (int i = 1; i < LIMBS; i++) {
+        if (~a.limbs[i])
+            return false;
+    }
+    return true;
+}
+
+/** Subtract the prime, that is add MAX_PRIME_DIFF modulo 2^3072 */
+void FullReduce(Num3072& a)
+{
+    uint64_t c = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS && c; i++) {
+        a.limbs[i] += c;
+        c = a.limbs[i] < c;
+    }
+}
+
+bool IsOne(const Num3072& a)
+{
+    if (a.limbs[0] != 1)
+        return false;
+    for (int i = 1; i < LIMBS; i++) {
+        if (a.limbs[i])
+            return false;
+    }
+    return true;
+}
+
+bool IsZero(const Num3072& a)
+{
+    for (int i = 0; i < LIMBS; i++) {
+        if (a.limbs[i])
+            return false;
+    }
+    return true;
+}
+
+int Compare(const Num3072& a, const Num3072& b)
+{
+    for (int i = LIMBS - 1; i >= 0; i--) {
+        if (a.limbs[i] != b.limbs[i])
+            return a.limbs[i] < b.limbs[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+/** a -= b modulo 2^3072, returns the borrow */
+uint64_t Sub(Num3072& a, const Num3072& b)
+{
+    uint64_t borrow = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        uint128_t d = (uint128_t)a.limbs[i] - b.limbs[i] - borrow;
+        a.limbs[i] = (uint64_t)d;
+        borrow = (uint64_t)(d >> 64) & 1;
+    }
+    return borrow;
+}
+
+/** a += b modulo 2^3072, returns the carry */
+uint64_t Add(Num3072& a, const Num3072& b)
+{
+    uint64_t carry = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        uint128_t s = (uint128_t)a.limbs[i] + b.limbs[i] + carry;
+        a.limbs[i] = (uint64_t)s;
+        carry = (uint64_t)(s >> 64);
+    }
+    return carry;
+}
+
+/** a = (a + top * 2^3072) / 2 */
+void ShiftRight(Num3072& a, uint64_t top)
+{
+    for (int i = 0; i < LIMBS - 1; i++)
+        a.limbs[i] = (a.limbs[i] >> 1) | (a.limbs[i + 1] << 63);
+    a.limbs[LIMBS - 1] = (a.limbs[LIMBS - 1] >> 1) | (top << 63);
+}
+
+Num3072 GetPrime()
+{
+    Num3072 p;
+    for (int i = 0; i < LIMBS; i++)
+        p.limbs[i] = ~(uint64_t)0;
+    p.limbs[0] -= MAX_PRIME_DIFF - 1;
+    return p;
+}
+
+/** x = x / 2 modulo the prime */
+void HalveModPrime(Num3072& x, const Num3072& p)
+{
+    uint64_t carry = 0;
+    if (x.limbs[0] & 1)
+        carry = Add(x, p);
+    ShiftRight(x, carry);
+}
+
+/** a = a - b modulo the prime, for a and b below it */
+void SubModPrime(Num3072& a, const Num3072& b, const Num3072& p)
+{
+    if (Sub(a, b))
+        Add(a, p);
+}
+
+/** Expand an element to a number below the prime: SHA-512 of its SHA-256 in counter mode */
+Num3072 ToNum3072(const unsigned char* data, size_t len)
+{
+    unsigned char seed[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(seed);
+    unsigned char expanded[Num3072::BYTE_SIZE];
+    for (unsigned int i = 0; i < Num3072::BYTE_SIZE / CSHA512::OUTPUT_SIZE; i++) {
+        unsigned char counter[4];
+        WriteLE32(counter, i);
+        CSHA512().Write(seed, sizeof(seed)).Write(counter, sizeof(counter)).Finalize(expanded + i * CSHA512::OUTPUT_SIZE);
+    }
+    return Num3072(expanded);
+}
+
+} // anon namespace
+
+Num3072::Num3072(const unsigned char (&data)[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; i++)
+        limbs[i] = ReadLE64(data + 8 * i);
+    if (IsOverflow(*this))
+        FullReduce(*this);
+}
+
+void Num3072::SetToOne()
+{
+    limbs[0] = 1;
+    memset(limbs + 1, 0, sizeof(limbs) - sizeof(limbs[0]));
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    // Schoolbook product into 6144 bits
+    uint64_t t[2 * LIMBS] = {};
+    for (int i = 0; i < LIMBS; i++) {
+        uint64_t carry = 0;
+        for (int j = 0; j < LIMBS; j++) {
+            uint128_t cur = (uint128_t)limbs[i] * a.limbs[j] + t[i + j] + carry;
+            t[i + j] = (uint64_t)cur;
+            carry = (uint64_t)(cur >> 64);
+        }
+        t[i + LIMBS] = carry;
+    }
+
+    // 2^3072 is MAX_PRIME_DIFF modulo the prime, so fold the high half down
+    uint64_t carry = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        uint128_t cur = (uint128_t)t[i + LIMBS] * MAX_PRIME_DIFF + t[i] + carry;
+        limbs[i] = (uint64_t)cur;
+        carry = (uint64_t)(cur >> 64);
+    }
+
+    // And the few bits that spilled over once more
+    uint128_t cur = (uint128_t)carry * MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS; i++) {
+        cur += limbs[i];
+        limbs[i] = (uint64_t)cur;
+        cur >>= 64;
+    }
+    if (cur)
+        FullReduce(*this);
+    if (IsOverflow(*this))
+        FullReduce(*this);
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // Binary extended Euclid. Set hashes are public, so this need not run in constant time
+    if (IsZero(*this))
+        return *this;
+    const Num3072 p = GetPrime();
+    Num3072 u = *this, v = p, x1, x2;
+    memset(x2.limbs, 0, sizeof(x2.limbs));
+    // Invariants: x1 * this == u and x2 * this == v modulo the prime
+    while (!IsOne(u) && !IsOne(v)) {
+        while (!(u.limbs[0] & 1)) {
+            ShiftRight(u, 0);
+            HalveModPrime(x1, p);
+        }
+        while (!(v.limbs[0] & 1)) {
+            ShiftRight(v, 0);
+            HalveModPrime(x2, p);
+        }
+        if (Compare(u, v) >= 0) {
+            Sub(u, v);
+            SubModPrime(x1, x2, p);
+        } else {
+            Sub(v, u);
+            SubModPrime(x2, x1, p);
+        }
+    }
+    return IsOne(u) ? x1 : x2;
+}
+
+void Num3072::ToBytes(unsigned char (&out)[BYTE_SIZE]) const
+{
+    for (int i = 0; i < LIMBS; i++)
+        WriteLE64(out + 8 * i, limbs[i]);
+}
+
+MuHash3072& MuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    numerator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    denominator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul)
+{
+    numerator.Multiply(mul.numerator);
+    denominator.Multiply(mul.denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& div)
+{
+    numerator.Multiply(div.denominator);
+    denominator.Multiply(div.numerator);
+    return *this;
+}
+
+void MuHash3072::Finalize(unsigned char hash[OUTPUT_SIZE])
+{
+    if (!IsOne(denominator)) {
+        numerator.Multiply(denominator.GetInverse());
+        denominator.SetToOne();
+    }
+    unsigned char data[Num3072::BYTE_SIZE];
+    numerator.ToBytes(data);
+    CSHA256().Write(data, sizeof(data)).Finalize(hash);
+}
@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string>
 
 /** A hasher class for SHA-256. */
 class CSHA256
@@ -25,4 +26,20 @@ public:
     CSHA256& Reset();
 };
 
+/**
+ * Select the fastest SHA-256 implementation the CPU supports and return a
+ * description of it. Call once at startup, before any other threads hash.
+ */
+std::string SHA256AutoDetect();
+
+/**
+ * Compute n double-SHA256 hashes of equal-length messages stored back to
+ * back at in, writing the 32-byte results back to back at out. Several
+ * messages are hashed in parallel when a multi-lane implementation is active.
+ */
+void SHA256DMany(unsigned char* out, const unsigned char* in, size_t len, size_t n);
+
+/** Double-SHA256 of each of blocks 64-byte inputs, e.g. merkle node pairs */
+void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
@@ -0,0 +1,110 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// 8-way SHA-256 transform using AVX2: each 32-bit lane of a vector belongs
+// to a different message.
+
+#include "crypto/sha256_x86.h"
+
+#ifdef ENABLE_SHA256_X86
+
+#include "crypto/common.h"
+
+#include <immintrin.h>
+
+namespace sha256_avx2
+{
+namespace
+{
+#define AVX2_FUNC __attribute__((target("avx2")))
+
+AVX2_FUNC inline __m256i K(uint32_t x) { return _mm256_set1_epi32(x); }
+AVX2_FUNC inline __m256i Add(__m256i x, __m256i y) { return _mm256_add_epi32(x, y); }
+AVX2_FUNC inline __m256i Add(__m256i x, __m256i y, __m256i z) { return Add(Add(x, y), z); }
+AVX2_FUNC inline __m256i Add(__m256i x, __m256i y, __m256i z, __m256i w) { return Add(Add(x, y), Add(z, w)); }
+AVX2_FUNC inline __m256i Add(__m256i x, __m256i y, __m256i z, __m256i w, __m256i v) { return Add(Add(x, y, z), Add(w, v)); }
+AVX2_FUNC inline __m256i Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+AVX2_FUNC inline __m256i Xor(__m256i x, __m256i y, __m256i z) { return Xor(Xor(x, y), z); }
+AVX2_FUNC inline __m256i Or(__m256i x, __m256i y) { return _mm256_or_si256(x, y); }
+AVX2_FUNC inline __m256i And(__m256i x, __m256i y) { return _mm256_and_si256(x, y); }
+AVX2_FUNC inline __m256i ShR(__m256i x, int n) { return _mm256_srli_epi32(x, n); }
+AVX2_FUNC inline __m256i ShL(__m256i x, int n) { return _mm256_slli_epi32(x, n); }
+AVX2_FUNC inline __m256i Rot(__m256i x, int n) { return Or(ShR(x, n), ShL(x, 32 - n)); }
+
+AVX2_FUNC inline __m256i Ch(__m256i x, __m256i y, __m256i z) { return Xor(z, And(x, Xor(y, z))); }
+AVX2_FUNC inline __m256i Maj(__m256i x, __m256i y, __m256i z) { return Or(And(x, y), And(z, Or(x, y))); }
+AVX2_FUNC inline __m256i Sigma0(__m256i x) { return Xor(Rot(x, 2), Rot(x, 13), Rot(x, 22)); }
+AVX2_FUNC inline __m256i Sigma1(__m256i x) { return Xor(Rot(x, 6), Rot(x, 11), Rot(x, 25)); }
+AVX2_FUNC inline __m256i sigma0(__m256i x) { return Xor(Rot(x, 7), Rot(x, 18), ShR(x, 3)); }
+AVX2_FUNC inline __m256i sigma1(__m256i x) { return Xor(Rot(x, 17), Rot(x, 19), ShR(x, 10)); }
+
+/** Gather word i of each lane's chunk */
+AVX2_FUNC inline __m256i Read(const unsigned char* const* chunks, int i)
+{
+    return _mm256_set_epi32(ReadBE32(chunks[7] + 4 * i), ReadBE32(chunks[6] + 4 * i), ReadBE32(chunks[5] + 4 * i), ReadBE32(chunks[4] + 4 * i),
+                            ReadBE32(chunks[3] + 4 * i), ReadBE32(chunks[2] + 4 * i), ReadBE32(chunks[1] + 4 * i), ReadBE32(chunks[0] + 4 * i));
+}
+
+AVX2_FUNC inline __m256i Load(const uint32_t* s, int i)
+{
+    return _mm256_set_epi32(s[56 + i], s[48 + i], s[40 + i], s[32 + i], s[24 + i], s[16 + i], s[8 + i], s[i]);
+}
+
+AVX2_FUNC inline void Store(uint32_t* s, int i, __m256i x)
+{
+    uint32_t v[8];
+    _mm256_storeu_si256((__m256i*)v, x);
+    for (int j = 0; j < 8; j++)
+        s[8 * j + i] = v[j];
+}
+
+const uint32_t k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+} // anon namespace
+
+AVX2_FUNC void Transform_8way(uint32_t* s, const unsigned char* const* chunks)
+{
+    __m256i a = Load(s, 0), b = Load(s, 1), c = Load(s, 2), d = Load(s, 3);
+    __m256i e = Load(s, 4), f = Load(s, 5), g = Load(s, 6), h = Load(s, 7);
+    __m256i w[16];
+
+    for (int i = 0; i < 64; i++) {
+        if (i < 16)
+            w[i] = Read(chunks, i);
+        else
+            w[i & 15] = Add(sigma1(w[(i - 2) & 15]), w[(i - 7) & 15], sigma0(w[(i - 15) & 15]), w[i & 15]);
+
+        __m256i t1 = Add(h, Sigma1(e), Ch(e, f, g), K(k[i]), w[i & 15]);
+        __m256i t2 = Add(Sigma0(a), Maj(a, b, c));
+        h = g;
+        g = f;
+        f = e;
+        e = Add(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = Add(t1, t2);
+    }
+
+    Store(s, 0, Add(a, Load(s, 0)));
+    Store(s, 1, Add(b, Load(s, 1)));
+    Store(s, 2, Add(c, Load(s, 2)));
+    Store(s, 3, Add(d, Load(s, 3)));
+    Store(s, 4, Add(e, Load(s, 4)));
+    Store(s, 5, Add(f, Load(s, 5)));
+    Store(s, 6, Add(g, Load(s, 6)));
+    Store(s, 7, Add(h, Load(s, 7)));
+}
+
+} // namespace sha256_avx2
+
+#endif
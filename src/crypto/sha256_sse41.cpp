@@ -0,0 +1,109 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// 4-way SHA-256 transform using SSE4.1: each 32-bit lane of a vector belongs
+// to a different message.
+
+#include "crypto/sha256_x86.h"
+
+#ifdef ENABLE_SHA256_X86
+
+#include "crypto/common.h"
+
+#include <immintrin.h>
+
+namespace sha256_sse41
+{
+namespace
+{
+#define SSE41_FUNC __attribute__((target("sse4.1")))
+
+SSE41_FUNC inline __m128i K(uint32_t x) { return _mm_set1_epi32(x); }
+SSE41_FUNC inline __m128i Add(__m128i x, __m128i y) { return _mm_add_epi32(x, y); }
+SSE41_FUNC inline __m128i Add(__m128i x, __m128i y, __m128i z) { return Add(Add(x, y), z); }
+SSE41_FUNC inline __m128i Add(__m128i x, __m128i y, __m128i z, __m128i w) { return Add(Add(x, y), Add(z, w)); }
+SSE41_FUNC inline __m128i Add(__m128i x, __m128i y, __m128i z, __m128i w, __m128i v) { return Add(Add(x, y, z), Add(w, v)); }
+SSE41_FUNC inline __m128i Xor(__m128i x, __m128i y) { return _mm_xor_si128(x, y); }
+SSE41_FUNC inline __m128i Xor(__m128i x, __m128i y, __m128i z) { return Xor(Xor(x, y), z); }
+SSE41_FUNC inline __m128i Or(__m128i x, __m128i y) { return _mm_or_si128(x, y); }
+SSE41_FUNC inline __m128i And(__m128i x, __m128i y) { return _mm_and_si128(x, y); }
+SSE41_FUNC inline __m128i ShR(__m128i x, int n) { return _mm_srli_epi32(x, n); }
+SSE41_FUNC inline __m128i ShL(__m128i x, int n) { return _mm_slli_epi32(x, n); }
+SSE41_FUNC inline __m128i Rot(__m128i x, int n) { return Or(ShR(x, n), ShL(x, 32 - n)); }
+
+SSE41_FUNC inline __m128i Ch(__m128i x, __m128i y, __m128i z) { return Xor(z, And(x, Xor(y, z))); }
+SSE41_FUNC inline __m128i Maj(__m128i x, __m128i y, __m128i z) { return Or(And(x, y), And(z, Or(x, y))); }
+SSE41_FUNC inline __m128i Sigma0(__m128i x) { return Xor(Rot(x, 2), Rot(x, 13), Rot(x, 22)); }
+SSE41_FUNC inline __m128i Sigma1(__m128i x) { return Xor(Rot(x, 6), Rot(x, 11), Rot(x, 25)); }
+SSE41_FUNC inline __m128i sigma0(__m128i x) { return Xor(Rot(x, 7), Rot(x, 18), ShR(x, 3)); }
+SSE41_FUNC inline __m128i sigma1(__m128i x) { return Xor(Rot(x, 17), Rot(x, 19), ShR(x, 10)); }
+
+/** Gather word i of each lane's chunk */
+SSE41_FUNC inline __m128i Read(const unsigned char* const* chunks, int i)
+{
+    return _mm_set_epi32(ReadBE32(chunks[3] + 4 * i), ReadBE32(chunks[2] + 4 * i), ReadBE32(chunks[1] + 4 * i), ReadBE32(chunks[0] + 4 * i));
+}
+
+SSE41_FUNC inline __m128i Load(const uint32_t* s, int i)
+{
+    return _mm_set_epi32(s[24 + i], s[16 + i], s[8 + i], s[i]);
+}
+
+SSE41_FUNC inline void Store(uint32_t* s, int i, __m128i x)
+{
+    s[i] = _mm_extract_epi32(x, 0);
+    s[8 + i] = _mm_extract_epi32(x, 1);
+    s[16 + i] = _mm_extract_epi32(x, 2);
+    s[24 + i] = _mm_extract_epi32(x, 3);
+}
+
+const uint32_t k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+} // anon namespace
+
+SSE41_FUNC void Transform_4way(uint32_t* s, const unsigned char* const* chunks)
+{
+    __m128i a = Load(s, 0), b = Load(s, 1), c = Load(s, 2), d = Load(s, 3);
+    __m128i e = Load(s, 4), f = Load(s, 5), g = Load(s, 6), h = Load(s, 7);
+    __m128i w[16];
+
+    for (int i = 0; i < 64; i++) {
+        if (i < 16)
+            w[i] = Read(chunks, i);
+        else
+            w[i & 15] = Add(sigma1(w[(i - 2) & 15]), w[(i - 7) & 15], sigma0(w[(i - 15) & 15]), w[i & 15]);
+
+        __m128i t1 = Add(h, Sigma1(e), Ch(e, f, g), K(k[i]), w[i & 15]);
+        __m128i t2 = Add(Sigma0(a), Maj(a, b, c));
+        h = g;
+        g = f;
+        f = e;
+        e = Add(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = Add(t1, t2);
+    }
+
+    Store(s, 0, Add(a, Load(s, 0)));
+    Store(s, 1, Add(b, Load(s, 1)));
+    Store(s, 2, Add(c, Load(s, 2)));
+    Store(s, 3, Add(d, Load(s, 3)));
+    Store(s, 4, Add(e, Load(s, 4)));
+    Store(s, 5, Add(f, Load(s, 5)));
+    Store(s, 6, Add(g, Load(s, 6)));
+    Store(s, 7, Add(h, Load(s, 7)));
+}
+
+} // namespace sha256_sse41
+
+#endif
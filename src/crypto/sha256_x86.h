@@ -0,0 +1,42 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_SHA256_X86_H
+#define BITCOIN_CRYPTO_SHA256_X86_H
+
+#include <stdint.h>
+
+/**
+ * Internal x86 SHA-256 backends, selected at runtime by SHA256AutoDetect().
+ * They are compiled with per-function target attributes, so no special
+ * compiler flags are needed and the rest of the binary stays baseline x86.
+ */
+#if (defined(__x86_64__) || defined(__amd64__) || defined(__i386__)) && \
+    (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define ENABLE_SHA256_X86 1
+
+/** SHA-NI: one 64-byte chunk, same interface as the scalar transform */
+namespace sha256_shani
+{
+void Transform(uint32_t* s, const unsigned char* chunk);
+}
+
+/**
+ * Multi-lane transforms: process one 64-byte chunk for each of 4 (SSE4.1) or
+ * 8 (AVX2) independent states. s holds the states one after another, 8 words
+ * per lane; chunks holds one chunk pointer per lane.
+ */
+namespace sha256_sse41
+{
+void Transform_4way(uint32_t* s, const unsigned char* const* chunks);
+}
+
+namespace sha256_avx2
+{
+void Transform_8way(uint32_t* s, const unsigned char* const* chunks);
+}
+
+#endif
+
+#endif // BITCOIN_CRYPTO_SHA256_X86_H
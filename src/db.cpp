@@ -7,10 +7,13 @@
 
 #include "addrman.h"
 #include "hash.h"
+#include "main.h"
 #include "protocol.h"
+#include "ui_interface.h"
 #include "util.h"
 #include "utilstrencodings.h"
 
+#include <limits>
 #include <stdint.h>
 
 #ifndef WIN32
@@ -19,6 +22,7 @@
 
 #include <boost/filesystem.hpp>
 #include <boost/thread.hpp>
+#include <boost/thread/tss.hpp>
 #include <boost/version.hpp>
 
 #include <openssl/rand.h>
@@ -27,7 +31,7 @@ using namespace std;
 using namespace boost;
 
 
-unsigned int nWalletDBUpdated;
+std::atomic<unsigned int> nWalletDBUpdated(0);
 
 
 //
@@ -53,10 +57,14 @@ CDBEnv::CDBEnv() : dbenv(DB_CXX_NO_EXCEPTIONS)
 {
     fDbEnvInit = false;
     fMockDb = false;
+    fUseLog = false;
 }
 
 CDBEnv::~CDBEnv()
 {
+    for (map<string, CLogDB*>::iterator it = mapLogDb.begin(); it != mapLogDb.end(); ++it)
+        delete it->second;
+    mapLogDb.clear();
     EnvShutdown();
 }
 
@@ -107,6 +115,8 @@ bool CDBEnv::Open(const boost::filesystem::path& pathIn)
 
     fDbEnvInit = true;
     fMockDb = false;
+    // The environment stays open to import BerkeleyDB files into their logs
+    fUseLog = GetBoolArg("-walletlog", false);
     return true;
 }
 
@@ -142,16 +152,44 @@ void CDBEnv::MakeMock()
     fMockDb = true;
 }
 
+void CDBEnv::MakeMockLog(const std::string& strPathIn)
+{
+    LOCK(cs_db);
+    if (!fMockDb)
+        throw runtime_error("CDBEnv::MakeMockLog : Not a mock environment");
+
+    for (map<string, CLogDB*>::iterator it = mapLogDb.begin(); it != mapLogDb.end(); ++it) {
+        assert(mapFileUseCount[it->first] == 0);
+        mapFileUseCount.erase(it->first);
+        delete it->second;
+    }
+    mapLogDb.clear();
+    strPath = strPathIn;
+    fUseLog = !strPath.empty();
+}
+
 CDBEnv::VerifyResult CDBEnv::Verify(std::string strFile, bool (*recoverFunc)(CDBEnv& dbenv, std::string strFile))
 {
     LOCK(cs_db);
     assert(mapFileUseCount.count(strFile) == 0);
 
-    Db db(&dbenv, 0);
-    int result = db.verify(strFile.c_str(), NULL, NULL, 0);
-    if (result == 0)
-        return VERIFY_OK;
-    else if (recoverFunc == NULL)
+    boost::filesystem::path pathLog = boost::filesystem::path(strPath) / (strFile + ".log");
+    if (fUseLog && (mapLogDb.count(strFile) || boost::filesystem::exists(pathLog))) {
+        // A log is sound if it opens: that replays it, and fails on damage
+        if (mapLogDb.count(strFile))
+            return VERIFY_OK;
+        CLogDB logdb;
+        if (logdb.Open(pathLog, false)) {
+            logdb.Close();
+            return VERIFY_OK;
+        }
+    } else {
+        Db db(&dbenv, 0);
+        int result = db.verify(strFile.c_str(), NULL, NULL, 0);
+        if (result == 0)
+            return VERIFY_OK;
+    }
+    if (recoverFunc == NULL)
         return RECOVER_FAIL;
 
     // Try to recover:
@@ -218,7 +256,380 @@ void CDBEnv::CheckpointLSN(const std::string& strFile)
 }
 
 
-CDB::CDB(const std::string& strFilename, const char* pszMode) : pdb(NULL), activeTxn(NULL)
+//
+// Cursors
+//
+
+/** A cursor over a BerkeleyDB file */
+class CBDBCursor : public CDBCursor
+{
+private:
+    Dbc* pcursor;
+
+public:
+    explicit CBDBCursor(Dbc* pcursorIn) : pcursor(pcursorIn) {}
+    ~CBDBCursor() { pcursor->close(); }
+
+    int Read(CDataStream& ssKey, CDataStream& ssValue, unsigned int fFlags)
+    {
+        // Read at cursor
+        Dbt datKey;
+        if (fFlags == DB_SET || fFlags == DB_SET_RANGE || fFlags == DB_GET_BOTH || fFlags == DB_GET_BOTH_RANGE) {
+            datKey.set_data(&ssKey[0]);
+            datKey.set_size(ssKey.size());
+        }
+        Dbt datValue;
+        if (fFlags == DB_GET_BOTH || fFlags == DB_GET_BOTH_RANGE) {
+            datValue.set_data(&ssValue[0]);
+            datValue.set_size(ssValue.size());
+        }
+        datKey.set_flags(DB_DBT_MALLOC);
+        datValue.set_flags(DB_DBT_MALLOC);
+        int ret = pcursor->get(&datKey, &datValue, fFlags);
+        if (ret != 0)
+            return ret;
+        else if (datKey.get_data() == NULL || datValue.get_data() == NULL)
+            return 99999;
+
+        // Convert to streams
+        ssKey.SetType(SER_DISK);
+        ssKey.clear();
+        ssKey.write((char*)datKey.get_data(), datKey.get_size());
+        ssValue.SetType(SER_DISK);
+        ssValue.clear();
+        ssValue.write((char*)datValue.get_data(), datValue.get_size());
+
+        // Clear and free memory
+        memset(datKey.get_data(), 0, datKey.get_size());
+        memset(datValue.get_data(), 0, datValue.get_size());
+        free(datKey.get_data());
+        free(datValue.get_data());
+        return 0;
+    }
+};
+
+/**
+ * A cursor over a log, in key order or in the order of the log. It reads the
+ * pending writes of the CDB it came from over those of the log
+ */
+class CLogDBCursor : public CDBCursor
+{
+private:
+    CDB& db;
+    CLogDB* plogdb;
+    bool fStarted;
+    std::string strKey;             // the last key read
+    std::vector<std::string> vKeys; // in file order, the keys still to read
+    size_t nNext;
+
+    /** Read strKey as the CDB sees it */
+    bool ReadKey(CSerializeData& value)
+    {
+        bool fErased;
+        if (db.FindPendingLog(strKey, fErased, value))
+            return !fErased;
+        return plogdb->Read(strKey, value);
+    }
+
+    /** Move strKey to the first live key after it, or at it if fInclusive */
+    bool NextKey(CSerializeData& value, bool fInclusive)
+    {
+        while (true) {
+            std::string strLog = strKey;
+            std::string strPending = strKey;
+            CSerializeData valueLog;
+            bool fLog = plogdb->Next(strLog, valueLog, fInclusive);
+            bool fPending = db.NextPendingLog(strPending, fInclusive);
+            if (!fLog && !fPending)
+                return false;
+            strKey = fLog && (!fPending || strLog < strPending) ? strLog : strPending;
+            bool fErased;
+            if (!db.FindPendingLog(strKey, fErased, value)) {
+                value.swap(valueLog);
+                return true;
+            }
+            if (!fErased)
+                return true;
+            fInclusive = false;
+        }
+    }
+
+public:
+    CLogDBCursor(CDB& dbIn, bool fFileOrder) : db(dbIn), plogdb(dbIn.plogdb), fStarted(false), nNext(0)
+    {
+        if (!fFileOrder) {
+            nNext = std::numeric_limits<size_t>::max();
+            return;
+        }
+        // The pending writes would be appended to the log, so they come last
+        std::set<std::string> setPending;
+        db.GetPendingLogKeys(setPending);
+        std::vector<std::string> vLogKeys;
+        plogdb->GetKeysInLogOrder(vLogKeys);
+        vKeys.reserve(vLogKeys.size() + setPending.size());
+        for (unsigned int i = 0; i < vLogKeys.size(); i++)
+            if (!setPending.count(vLogKeys[i]))
+                vKeys.push_back(vLogKeys[i]);
+        vKeys.insert(vKeys.end(), setPending.begin(), setPending.end());
+    }
+
+    int Read(CDataStream& ssKey, CDataStream& ssValue, unsigned int fFlags)
+    {
+        CSerializeData value;
+        bool fFound = false;
+        if (nNext != std::numeric_limits<size_t>::max()) {
+            if (fFlags != DB_NEXT)
+                return EINVAL;
+            // Skip the keys erased since the cursor was made
+            while (!fFound && nNext < vKeys.size()) {
+                strKey = vKeys[nNext++];
+                fFound = ReadKey(value);
+            }
+        } else if (fFlags == DB_SET_RANGE) {
+            strKey.assign(ssKey.begin(), ssKey.end());
+            fFound = NextKey(value, true);
+        } else if (fFlags == DB_NEXT) {
+            fFound = NextKey(value, !fStarted);
+        } else {
+            return EINVAL;
+        }
+        fStarted = true;
+        if (!fFound)
+            return DB_NOTFOUND;
+
+        ssKey.SetType(SER_DISK);
+        ssKey.clear();
+        ssKey.write(strKey.data(), strKey.size());
+        ssValue.SetType(SER_DISK);
+        ssValue.clear();
+        if (!value.empty())
+            ssValue.write(&value[0], value.size());
+        return 0;
+    }
+};
+
+
+//
+// Logs
+//
+
+CLogDB* CDBEnv::GetLog(const std::string& strFile, bool fCreate)
+{
+    AssertLockHeld(cs_db);
+    map<string, CLogDB*>::iterator it = mapLogDb.find(strFile);
+    if (it != mapLogDb.end())
+        return it->second;
+
+    boost::filesystem::path pathLog = boost::filesystem::path(strPath) / (strFile + ".log");
+    boost::filesystem::path pathFile = boost::filesystem::path(strPath) / strFile;
+    if (!boost::filesystem::exists(pathLog) && boost::filesystem::exists(pathFile)) {
+        if (CLogDB::IsLog(pathFile)) {
+            // A backup made with -walletlog, restored under the wallet's own name
+            LogPrintf("CDBEnv::GetLog : %s is a log, moving it to %s\n", strFile, pathLog.string());
+            if (!RenameOver(pathFile, pathLog)) {
+                error("CDBEnv::GetLog : Can't move %s to %s", strFile, pathLog.string());
+                return NULL;
+            }
+        } else if (!ImportLog(strFile, pathLog))
+            return NULL;
+    }
+    CLogDB* plogdb = new CLogDB();
+    if (!plogdb->Open(pathLog, fCreate)) {
+        delete plogdb;
+        return NULL;
+    }
+    mapLogDb[strFile] = plogdb;
+    return plogdb;
+}
+
+bool CDBEnv::ImportLog(const std::string& strFile, const boost::filesystem::path& pathLog)
+{
+    LogPrintf("CDBEnv::ImportLog : Importing %s into %s...\n", strFile, pathLog.string());
+    int64_t nStart = GetTimeMillis();
+    boost::filesystem::path pathImport = pathLog.string() + ".import";
+    boost::filesystem::remove(pathImport);
+
+    // A mock environment has no home directory to find strFile in
+    boost::filesystem::path pathFile = boost::filesystem::path(strPath) / strFile;
+    Db db(&dbenv, 0);
+    int ret = db.open(NULL, fMockDb ? pathFile.string().c_str() : strFile.c_str(), "main", DB_BTREE, DB_RDONLY, 0);
+    if (ret != 0)
+        return error("CDBEnv::ImportLog : Error %d, can't open database %s", ret, strFile);
+    Dbc* pdbc = NULL;
+    if (db.cursor(NULL, &pdbc, 0) != 0 || !pdbc) {
+        db.close(0);
+        return error("CDBEnv::ImportLog : Error getting cursor on %s", strFile);
+    }
+
+    CLogDB logdb;
+    bool fSuccess = logdb.Open(pathImport, true);
+    unsigned int nRecords = 0;
+    {
+        CBDBCursor cursor(pdbc);
+        CLogDBTxn txn;
+        size_t nTxnSize = 0;
+        while (fSuccess) {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            ret = cursor.Read(ssKey, ssValue, DB_NEXT);
+            if (ret == DB_NOTFOUND)
+                break;
+            if (ret != 0) {
+                fSuccess = false;
+                break;
+            }
+            txn.Write(std::string(ssKey.begin(), ssKey.end()), CSerializeData(ssValue.begin(), ssValue.end()));
+            nTxnSize += ssKey.size() + ssValue.size();
+            nRecords++;
+            if (nTxnSize >= (1 << 20)) {
+                fSuccess = logdb.Commit(txn);
+                txn = CLogDBTxn();
+                nTxnSize = 0;
+            }
+        }
+        if (fSuccess)
+            fSuccess = logdb.Commit(txn);
+    }
+    db.close(0);
+    logdb.Close();
+
+    // The index was written for the imported log, and still fits it once renamed
+    if (fSuccess)
+        fSuccess = RenameOver(pathImport.string() + ".idx", pathLog.string() + ".idx") && RenameOver(pathImport, pathLog);
+    if (!fSuccess) {
+        boost::filesystem::remove(pathImport);
+        return error("CDBEnv::ImportLog : Failed to import %s", strFile);
+    }
+    LogPrintf("CDBEnv::ImportLog : Imported %u records from %s in %dms\n", nRecords, strFile, GetTimeMillis() - nStart);
+
+    // Keep the file, but out of the way of BerkeleyDB mode and of another import
+    boost::filesystem::path pathImported = pathFile.string() + strprintf(".imported-%d", GetTime());
+    if (RenameOver(pathFile, pathImported))
+        LogPrintf("CDBEnv::ImportLog : Renamed %s to %s\n", strFile, pathImported.filename().string());
+    else
+        LogPrintf("CDBEnv::ImportLog : Failed to rename %s to %s\n", strFile, pathImported.filename().string());
+    return true;
+}
+
+bool CDBEnv::SalvageLog(const std::string& strFile, const std::string& strBackup, std::vector<CDBEnv::KeyValPair>& vResult)
+{
+    LOCK(cs_db);
+    assert(mapLogDb.count(strFile) == 0);
+    boost::filesystem::path pathLog = boost::filesystem::path(strPath) / (strFile + ".log");
+    boost::filesystem::path pathBackup = boost::filesystem::path(strPath) / strBackup;
+    if (!RenameOver(pathLog, pathBackup))
+        return error("CDBEnv::SalvageLog : Failed to rename %s to %s", pathLog.string(), strBackup);
+    LogPrintf("Renamed %s to %s\n", pathLog.filename().string(), strBackup);
+    boost::filesystem::remove(pathLog.string() + ".idx");
+
+    std::vector<std::pair<std::string, CSerializeData> > vRecords;
+    if (!CLogDB::Salvage(pathBackup, vRecords))
+        return false;
+    for (unsigned int i = 0; i < vRecords.size(); i++)
+        vResult.push_back(make_pair(std::vector<unsigned char>(vRecords[i].first.begin(), vRecords[i].first.end()),
+            std::vector<unsigned char>(vRecords[i].second.begin(), vRecords[i].second.end())));
+
+    // An empty log in its place, so that opening it doesn't import strFile
+    CLogDB logdb;
+    if (!logdb.Open(pathLog, true))
+        return false;
+    logdb.Close();
+    return true;
+}
+
+
+//
+// CDBBatch
+//
+
+//! The batches the current thread has open, by file
+static boost::thread_specific_ptr<std::map<std::string, CDBBatch*> > batchesThread;
+
+CDBBatch::CDBBatch(const std::string& strFileIn) : strFile(strFileIn), fOutermost(false), ptxn(NULL), ptxnCurrent(NULL), plogdb(NULL), plogtxn(NULL)
+{
+    if (strFile.empty() || Get(strFile))
+        return;
+    if (!batchesThread.get())
+        batchesThread.reset(new std::map<std::string, CDBBatch*>());
+    (*batchesThread)[strFile] = this;
+    fOutermost = true;
+}
+
+CDBBatch::~CDBBatch()
+{
+    // Losing the writes silently would leave the wallet out of step with what
+    // it has told the user and the network, so stop instead
+    if (fOutermost && !Commit())
+        AbortNode(strprintf("Error: failed to commit a batch of writes to %s", strFile),
+            _("Error: Failed to write to the wallet. See debug.log for details"));
+}
+
+bool CDBBatch::Commit()
+{
+    if (!fOutermost)
+        return true;
+    fOutermost = false;
+    batchesThread->erase(strFile);
+    bool fSuccess = true;
+    if (plogtxn) {
+        fSuccess = plogdb->Commit(*plogtxn);
+        if (!fSuccess)
+            LogPrintf("CDBBatch : Error committing to the log of %s\n", strFile);
+        delete plogtxn;
+        plogtxn = NULL;
+    } else if (ptxn) {
+        int ret = ptxn->commit(0);
+        fSuccess = (ret == 0);
+        if (!fSuccess)
+            LogPrintf("CDBBatch : Error %d committing to %s: %s\n", ret, strFile, DbEnv::strerror(ret));
+        ptxn = ptxnCurrent = NULL;
+    } else {
+        return true;
+    }
+    {
+        LOCK(bitdb.cs_db);
+        --bitdb.mapFileUseCount[strFile];
+    }
+    return fSuccess;
+}
+
+CDBBatch* CDBBatch::Get(const std::string& strFile)
+{
+    std::map<std::string, CDBBatch*>* pbatches = batchesThread.get();
+    if (!pbatches)
+        return NULL;
+    std::map<std::string, CDBBatch*>::iterator it = pbatches->find(strFile);
+    return it != pbatches->end() ? it->second : NULL;
+}
+
+DbTxn* CDBBatch::GetTxn()
+{
+    if (!ptxn) {
+        // Only a CDB asks, so the environment is open. Count the batch as a
+        // user of the file, so that it isn't closed under the transaction
+        LOCK(bitdb.cs_db);
+        ptxn = bitdb.TxnBegin();
+        if (!ptxn)
+            return NULL;
+        ++bitdb.mapFileUseCount[strFile];
+        ptxnCurrent = ptxn;
+    }
+    return ptxnCurrent;
+}
+
+CLogDBTxn* CDBBatch::GetLogTxn(CLogDB* plogdbIn)
+{
+    if (!plogtxn) {
+        LOCK(bitdb.cs_db);
+        plogdb = plogdbIn;
+        plogtxn = new CLogDBTxn();
+        ++bitdb.mapFileUseCount[strFile];
+    }
+    return plogtxn;
+}
+
+
+CDB::CDB(const std::string& strFilename, const char* pszMode) : pdb(NULL), plogdb(NULL), activeTxn(NULL), parentTxn(NULL), activeLogTxn(NULL)
 {
     int ret;
     fReadOnly = (!strchr(pszMode, '+') && !strchr(pszMode, 'w'));
@@ -236,6 +647,22 @@ CDB::CDB(const std::string& strFilename, const char* pszMode) : pdb(NULL), activ
             throw runtime_error("CDB : Failed to open database environment.");
 
         strFile = strFilename;
+        if (bitdb.UsesLog()) {
+            plogdb = bitdb.GetLog(strFile, fCreate);
+            if (!plogdb) {
+                strFile = "";
+                throw runtime_error(strprintf("CDB : Can't open log of database %s", strFilename));
+            }
+            ++bitdb.mapFileUseCount[strFile];
+            if (fCreate && !Exists(string("version"))) {
+                bool fTmp = fReadOnly;
+                fReadOnly = false;
+                WriteVersion(CLIENT_VERSION);
+                fReadOnly = fTmp;
+            }
+            return;
+        }
+
         ++bitdb.mapFileUseCount[strFile];
         pdb = bitdb.mapDb[strFile];
         if (pdb == NULL) {
@@ -276,9 +703,199 @@ CDB::CDB(const std::string& strFilename, const char* pszMode) : pdb(NULL), activ
     }
 }
 
-void CDB::Flush()
+DbTxn* CDB::GetTxn()
 {
     if (activeTxn)
+        return activeTxn;
+    CDBBatch* pbatch = CDBBatch::Get(strFile);
+    return pbatch ? pbatch->GetTxn() : NULL;
+}
+
+CLogDBTxn* CDB::GetLogTxn()
+{
+    if (activeLogTxn)
+        return activeLogTxn;
+    CDBBatch* pbatch = CDBBatch::Get(strFile);
+    return pbatch ? pbatch->GetLogTxn(plogdb) : NULL;
+}
+
+bool CDB::TxnBegin()
+{
+    if (plogdb) {
+        if (activeLogTxn)
+            return false;
+        activeLogTxn = new CLogDBTxn();
+        return true;
+    }
+    if (!pdb || activeTxn)
+        return false;
+    // Inside a batch, nest in its transaction, so that this one can still
+    // be aborted on its own
+    CDBBatch* pbatch = CDBBatch::Get(strFile);
+    DbTxn* ptxnBatch = pbatch ? pbatch->GetTxn() : NULL;
+    DbTxn* ptxn = bitdb.TxnBegin(DB_TXN_WRITE_NOSYNC, ptxnBatch);
+    if (!ptxn)
+        return false;
+    activeTxn = ptxn;
+    if (ptxnBatch) {
+        parentTxn = ptxnBatch;
+        pbatch->ptxnCurrent = ptxn;
+    }
+    return true;
+}
+
+bool CDB::TxnCommit()
+{
+    if (plogdb) {
+        if (!activeLogTxn)
+            return false;
+        // Inside a batch, the writes go to the log with the batch's
+        bool fSuccess = true;
+        CDBBatch* pbatch = CDBBatch::Get(strFile);
+        if (pbatch)
+            pbatch->GetLogTxn(plogdb)->Merge(*activeLogTxn);
+        else
+            fSuccess = plogdb->Commit(*activeLogTxn);
+        delete activeLogTxn;
+        activeLogTxn = NULL;
+        return fSuccess;
+    }
+    if (!pdb || !activeTxn)
+        return false;
+    int ret = activeTxn->commit(0);
+    EndTxn();
+    return (ret == 0);
+}
+
+bool CDB::TxnAbort()
+{
+    if (plogdb) {
+        if (!activeLogTxn)
+            return false;
+        delete activeLogTxn;
+        activeLogTxn = NULL;
+        return true;
+    }
+    if (!pdb || !activeTxn)
+        return false;
+    int ret = activeTxn->abort();
+    EndTxn();
+    return (ret == 0);
+}
+
+void CDB::EndTxn()
+{
+    activeTxn = NULL;
+    if (parentTxn) {
+        // Other handles of the thread go back to the batch's transaction
+        CDBBatch* pbatch = CDBBatch::Get(strFile);
+        if (pbatch)
+            pbatch->ptxnCurrent = parentTxn;
+        parentTxn = NULL;
+    }
+}
+
+bool CDB::FindPendingLog(const std::string& strKey, bool& fErased, CSerializeData& value)
+{
+    if (activeLogTxn && activeLogTxn->Find(strKey, fErased, value))
+        return true;
+    CDBBatch* pbatch = CDBBatch::Get(strFile);
+    return pbatch && pbatch->plogtxn && pbatch->plogtxn->Find(strKey, fErased, value);
+}
+
+bool CDB::NextPendingLog(std::string& strKey, bool fInclusive)
+{
+    std::string strActive = strKey;
+    std::string strBatch = strKey;
+    bool fActive = activeLogTxn && activeLogTxn->Next(strActive, fInclusive);
+    CDBBatch* pbatch = CDBBatch::Get(strFile);
+    bool fBatch = pbatch && pbatch->plogtxn && pbatch->plogtxn->Next(strBatch, fInclusive);
+    if (!fActive && !fBatch)
+        return false;
+    strKey = fActive && (!fBatch || strActive < strBatch) ? strActive : strBatch;
+    return true;
+}
+
+void CDB::GetPendingLogKeys(std::set<std::string>& setKeys)
+{
+    if (activeLogTxn)
+        activeLogTxn->GetKeys(setKeys);
+    CDBBatch* pbatch = CDBBatch::Get(strFile);
+    if (pbatch && pbatch->plogtxn)
+        pbatch->plogtxn->GetKeys(setKeys);
+}
+
+bool CDB::ReadLog(const CDataStream& ssKey, CDataStream& ssValue)
+{
+    std::string strKey(ssKey.begin(), ssKey.end());
+    CSerializeData value;
+    bool fErased;
+    if (FindPendingLog(strKey, fErased, value)) {
+        if (fErased)
+            return false;
+    } else if (!plogdb->Read(strKey, value)) {
+        return false;
+    }
+    if (!value.empty())
+        ssValue.write(&value[0], value.size());
+    return true;
+}
+
+bool CDB::WriteLog(const CDataStream& ssKey, const CDataStream& ssValue, bool fOverwrite)
+{
+    if (!fOverwrite && ExistsLog(ssKey))
+        return false;
+    std::string strKey(ssKey.begin(), ssKey.end());
+    CSerializeData value(ssValue.begin(), ssValue.end());
+    CLogDBTxn* ptxn = GetLogTxn();
+    if (ptxn) {
+        ptxn->Write(strKey, value);
+        return true;
+    }
+    return plogdb->Write(strKey, value);
+}
+
+bool CDB::EraseLog(const CDataStream& ssKey)
+{
+    std::string strKey(ssKey.begin(), ssKey.end());
+    CLogDBTxn* ptxn = GetLogTxn();
+    if (ptxn) {
+        ptxn->Erase(strKey);
+        return true;
+    }
+    return plogdb->Erase(strKey);
+}
+
+bool CDB::ExistsLog(const CDataStream& ssKey)
+{
+    std::string strKey(ssKey.begin(), ssKey.end());
+    CSerializeData value;
+    bool fErased;
+    if (FindPendingLog(strKey, fErased, value))
+        return !fErased;
+    return plogdb->Exists(strKey);
+}
+
+CDBCursor* CDB::GetCursor(bool fFileOrder)
+{
+    if (plogdb)
+        return new CLogDBCursor(*this, fFileOrder);
+    if (!pdb)
+        return NULL;
+    Dbc* pcursor = NULL;
+    int ret = pdb->cursor(GetTxn(), &pcursor, 0);
+    if (ret != 0)
+        return NULL;
+    return new CBDBCursor(pcursor);
+}
+
+void CDB::Flush()
+{
+    // Logs are written through by ThreadFlushWalletDB
+    if (activeTxn || plogdb)
+        return;
+    // A batch commits later, and ThreadFlushWalletDB writes it through
+    if (CDBBatch::Get(strFile))
         return;
 
     // Flush database activity from memory pool to disk log
@@ -291,11 +908,18 @@ void CDB::Flush()
 
 void CDB::Close()
 {
+    if (plogdb) {
+        if (activeLogTxn)
+            TxnAbort();
+        plogdb = NULL;
+        LOCK(bitdb.cs_db);
+        --bitdb.mapFileUseCount[strFile];
+        return;
+    }
     if (!pdb)
         return;
     if (activeTxn)
-        activeTxn->abort();
-    activeTxn = NULL;
+        TxnAbort();
     pdb = NULL;
 
     Flush();
@@ -331,10 +955,19 @@ bool CDBEnv::RemoveDb(const string& strFile)
 
 bool CDB::Rewrite(const string& strFile, const char* pszSkip)
 {
+    CLogDB* plogdb = NULL;
     while (true) {
         {
             LOCK(bitdb.cs_db);
             if (!bitdb.mapFileUseCount.count(strFile) || bitdb.mapFileUseCount[strFile] == 0) {
+                // A log is compacted below, once cs_db is released. Count
+                // it as in use till then, so that Flush doesn't close it
+                if (bitdb.UsesLog()) {
+                    plogdb = bitdb.GetLog(strFile, true);
+                    ++bitdb.mapFileUseCount[strFile];
+                    break;
+                }
+
                 // Flush log data to the dat file
                 bitdb.CloseDb(strFile);
                 bitdb.CheckpointLSN(strFile);
@@ -358,17 +991,17 @@ bool CDB::Rewrite(const string& strFile, const char* pszSkip)
                         fSuccess = false;
                     }
 
-                    Dbc* pcursor = db.GetCursor();
+                    CDBCursor* pcursor = db.GetCursor();
                     if (pcursor)
                         while (fSuccess) {
                             CDataStream ssKey(SER_DISK, CLIENT_VERSION);
                             CDataStream ssValue(SER_DISK, CLIENT_VERSION);
                             int ret = db.ReadAtCursor(pcursor, ssKey, ssValue, DB_NEXT);
                             if (ret == DB_NOTFOUND) {
-                                pcursor->close();
+                                delete pcursor;
                                 break;
                             } else if (ret != 0) {
-                                pcursor->close();
+                                delete pcursor;
                                 fSuccess = false;
                                 break;
                             }
@@ -409,7 +1042,23 @@ bool CDB::Rewrite(const string& strFile, const char* pszSkip)
         }
         MilliSleep(100);
     }
-    return false;
+
+    // Compacting writes a new log of the live records. It reads the whole log,
+    // so it runs without cs_db, relying on the log's own locks
+    LogPrintf("CDB::Rewrite : Compacting %s...\n", strFile);
+    bool fSuccess;
+    {
+        CDB db(strFile);
+        fSuccess = db.WriteVersion(CLIENT_VERSION);
+    }
+    fSuccess = fSuccess && plogdb && plogdb->Compact(pszSkip ? pszSkip : "");
+    {
+        LOCK(bitdb.cs_db);
+        --bitdb.mapFileUseCount[strFile];
+    }
+    if (!fSuccess)
+        LogPrintf("CDB::Rewrite : Failed to compact %s\n", strFile);
+    return fSuccess;
 }
 
 
@@ -427,7 +1076,12 @@ void CDBEnv::Flush(bool fShutdown)
             string strFile = (*mi).first;
             int nRefCount = (*mi).second;
             LogPrint("db", "CDBEnv::Flush : Flushing %s (refcount = %d)...\n", strFile, nRefCount);
-            if (nRefCount == 0) {
+            map<string, CLogDB*>::iterator itLog = mapLogDb.find(strFile);
+            if (nRefCount == 0 && itLog != mapLogDb.end()) {
+                itLog->second->Flush();
+                LogPrint("db", "CDBEnv::Flush : %s log flushed\n", strFile);
+                mapFileUseCount.erase(mi++);
+            } else if (nRefCount == 0) {
                 // Move log data to the dat file
                 CloseDb(strFile);
                 LogPrint("db", "CDBEnv::Flush : %s checkpoint\n", strFile);
@@ -442,6 +1096,16 @@ void CDBEnv::Flush(bool fShutdown)
         }
         LogPrint("db", "CDBEnv::Flush : Flush(%s)%s took %15dms\n", fShutdown ? "true" : "false", fDbEnvInit ? "" : " database not started", GetTimeMillis() - nStart);
         if (fShutdown) {
+            // Close the logs nobody has open; Flush(false) may have let go of them already
+            map<string, CLogDB*>::iterator itLog = mapLogDb.begin();
+            while (itLog != mapLogDb.end()) {
+                if (mapFileUseCount.count(itLog->first)) {
+                    itLog++;
+                    continue;
+                }
+                delete itLog->second;
+                mapLogDb.erase(itLog++);
+            }
             char** listp;
             if (mapFileUseCount.empty()) {
                 dbenv.log_archive(&listp, DB_ARCH_REMOVE);
@@ -7,11 +7,13 @@
 #define BITCOIN_DB_H
 
 #include "clientversion.h"
+#include "logdb.h"
 #include "serialize.h"
 #include "streams.h"
 #include "sync.h"
 #include "version.h"
 
+#include <atomic>
 #include <map>
 #include <string>
 #include <vector>
@@ -25,9 +27,9 @@ class COutPoint;
 
 struct CBlockLocator;
 
-extern unsigned int nWalletDBUpdated;
+extern std::atomic<unsigned int> nWalletDBUpdated;
 
-void ThreadFlushWalletDB(const std::string& strWalletFile);
+void ThreadFlushWalletDB();
 
 
 class CDBEnv
@@ -35,22 +37,33 @@ class CDBEnv
 private:
     bool fDbEnvInit;
     bool fMockDb;
+    bool fUseLog;
     // Don't change into boost::filesystem::path, as that can result in
     // shutdown problems/crashes caused by a static initialized internal pointer.
     std::string strPath;
 
     void EnvShutdown();
+    bool ImportLog(const std::string& strFile, const boost::filesystem::path& pathLog);
 
 public:
     mutable CCriticalSection cs_db;
     DbEnv dbenv;
     std::map<std::string, int> mapFileUseCount;
     std::map<std::string, Db*> mapDb;
+    std::map<std::string, CLogDB*> mapLogDb;
 
     CDBEnv();
     ~CDBEnv();
     void MakeMock();
+    /**
+     * Keep the files of a mock environment as logs in strPathIn, for the tests
+     * of -walletlog, or in memory again if it is empty. Closes the logs opened
+     * so far, which nobody may be using.
+     */
+    void MakeMockLog(const std::string& strPathIn);
     bool IsMock() { return fMockDb; }
+    /** Whether files are kept as append-only logs (-walletlog) rather than in BerkeleyDB */
+    bool UsesLog() { return fUseLog; }
 
     /**
      * Verify that database file strFile is OK. If it is not,
@@ -71,6 +84,11 @@ public:
      */
     typedef std::pair<std::vector<unsigned char>, std::vector<unsigned char> > KeyValPair;
     bool Salvage(std::string strFile, bool fAggressive, std::vector<KeyValPair>& vResult);
+    /**
+     * The same for the log of strFile: it is renamed to strBackup, the records
+     * still readable in it appended to vResult, and an empty log left in its place.
+     */
+    bool SalvageLog(const std::string& strFile, const std::string& strBackup, std::vector<KeyValPair>& vResult);
 
     bool Open(const boost::filesystem::path& path);
     void Close();
@@ -79,11 +97,17 @@ public:
 
     void CloseDb(const std::string& strFile);
     bool RemoveDb(const std::string& strFile);
+    /**
+     * The log that holds strFile, opened if need be. The first time, a
+     * BerkeleyDB file of that name is imported into it, then renamed to
+     * <strFile>.imported-<time>. Call with cs_db held
+     */
+    CLogDB* GetLog(const std::string& strFile, bool fCreate);
 
-    DbTxn* TxnBegin(int flags = DB_TXN_WRITE_NOSYNC)
+    DbTxn* TxnBegin(int flags = DB_TXN_WRITE_NOSYNC, DbTxn* ptxnParent = NULL)
     {
         DbTxn* ptxn = NULL;
-        int ret = dbenv.txn_begin(NULL, &ptxn, flags);
+        int ret = dbenv.txn_begin(ptxnParent, &ptxn, flags);
         if (!ptxn || ret != 0)
             return NULL;
         return ptxn;
@@ -93,18 +117,97 @@ public:
 extern CDBEnv bitdb;
 
 
-/** RAII class that provides access to a Berkeley database */
+/**
+ * Groups the reads and writes one thread makes to a database file into one
+ * transaction, so that the many small writes of a logical operation reach the
+ * log with a single commit. While a batch is in scope, every CDB on the file
+ * in the same thread uses its transaction, whether it was opened before or
+ * after the batch, and CDB::TxnBegin nests in it. The transaction begins on
+ * first use and commits when the outermost batch on the file ends.
+ *
+ * Handles closed inside a batch skip the checkpoint they would otherwise do:
+ * ThreadFlushWalletDB writes the changes through once the wallet is idle.
+ * Other threads wait on the pages a batch has written until it commits, so
+ * keep batches short, hold the lock that orders the writers (cs_wallet for
+ * the wallet) for their whole scope, and don't back up or rewrite the file
+ * inside one.
+ *
+ * On a log (-walletlog) the batch gathers the writes in one CLogDBTxn, which
+ * reaches the log as a single frame when the outermost batch ends; a CDB
+ * transaction inside the batch merges into it when it commits.
+ *
+ * Callers that can report a failure should end the batch with Commit(). A
+ * batch that commits from its destructor and fails aborts the node, as the
+ * writes it held are lost.
+ */
+class CDBBatch
+{
+private:
+    std::string strFile;
+    bool fOutermost;
+    DbTxn* ptxn;        // the batch's transaction, once begun
+    DbTxn* ptxnCurrent; // the innermost transaction nested in it, or ptxn
+    CLogDB* plogdb;     // on a log, where plogtxn commits to
+    CLogDBTxn* plogtxn; // on a log, the batch's writes, once begun
+
+    CDBBatch(const CDBBatch&);
+    void operator=(const CDBBatch&);
+
+    /** The batch the current thread has open on strFile, if any */
+    static CDBBatch* Get(const std::string& strFile);
+    /** The transaction to use, begun if need be. NULL if it can't be begun */
+    DbTxn* GetTxn();
+    /** The same for a log */
+    CLogDBTxn* GetLogTxn(CLogDB* plogdbIn);
+
+    friend class CDB;
+
+public:
+    explicit CDBBatch(const std::string& strFileIn);
+    ~CDBBatch();
+
+    /**
+     * Commit the batch now and end it, so that later writes in its scope
+     * commit on their own. Call it outside any CDB transaction. A nested
+     * batch leaves the commit to the outermost one and returns true.
+     */
+    bool Commit();
+};
+
+
+/** A position in a database file, to read its records one after another */
+class CDBCursor
+{
+public:
+    virtual ~CDBCursor() {}
+    /**
+     * Read the record after the last one read (DB_NEXT), or the first at or
+     * after ssKey (DB_SET_RANGE), into ssKey and ssValue. Returns 0,
+     * DB_NOTFOUND past the last record, or another error.
+     */
+    virtual int Read(CDataStream& ssKey, CDataStream& ssValue, unsigned int fFlags) = 0;
+};
+
+
+/** RAII class that provides access to a Berkeley database, or to a log that holds the same records */
 class CDB
 {
 protected:
     Db* pdb;
+    CLogDB* plogdb;
     std::string strFile;
     DbTxn* activeTxn;
+    DbTxn* parentTxn; // the batch transaction activeTxn is nested in, if any
+    CLogDBTxn* activeLogTxn;
     bool fReadOnly;
 
     explicit CDB(const std::string& strFilename, const char* pszMode = "r+");
     ~CDB() { Close(); }
 
+    /** The transaction to read and write in: our own, else the thread's batch on the file */
+    DbTxn* GetTxn();
+    CLogDBTxn* GetLogTxn();
+
 public:
     void Flush();
     void Close();
@@ -113,23 +216,50 @@ private:
     CDB(const CDB&);
     void operator=(const CDB&);
 
+    void EndTxn();
+
 protected:
+    //! Read and write the records of a log, seeing the writes of activeLogTxn and of the thread's batch
+    bool ReadLog(const CDataStream& ssKey, CDataStream& ssValue);
+    bool WriteLog(const CDataStream& ssKey, const CDataStream& ssValue, bool fOverwrite);
+    bool EraseLog(const CDataStream& ssKey);
+    bool ExistsLog(const CDataStream& ssKey);
+    //! Whether activeLogTxn or the batch writes strKey; if so, fErased or value say how
+    bool FindPendingLog(const std::string& strKey, bool& fErased, CSerializeData& value);
+    //! The same as CLogDBTxn::Next and CLogDBTxn::GetKeys, over activeLogTxn and the batch
+    bool NextPendingLog(std::string& strKey, bool fInclusive);
+    void GetPendingLogKeys(std::set<std::string>& setKeys);
+
+    friend class CLogDBCursor;
+
     template <typename K, typename T>
     bool Read(const K& key, T& value)
     {
-        if (!pdb)
+        if (!pdb && !plogdb)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+
+        if (plogdb) {
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            if (!ReadLog(ssKey, ssValue))
+                return false;
+            try {
+                ssValue >> value;
+            } catch (const std::exception&) {
+                return false;
+            }
+            return true;
+        }
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Read
         Dbt datValue;
         datValue.set_flags(DB_DBT_MALLOC);
-        int ret = pdb->get(activeTxn, &datKey, &datValue, 0);
+        int ret = pdb->get(GetTxn(), &datKey, &datValue, 0);
         memset(datKey.get_data(), 0, datKey.get_size());
         if (datValue.get_data() == NULL)
             return false;
@@ -151,7 +281,7 @@ protected:
     template <typename K, typename T>
     bool Write(const K& key, const T& value, bool fOverwrite = true)
     {
-        if (!pdb)
+        if (!pdb && !plogdb)
             return false;
         if (fReadOnly)
             assert(!"Write called on database in read-only mode");
@@ -160,16 +290,18 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
-        Dbt datKey(&ssKey[0], ssKey.size());
 
         // Value
         CDataStream ssValue(SER_DISK, CLIENT_VERSION);
         ssValue.reserve(10000);
         ssValue << value;
+        if (plogdb)
+            return WriteLog(ssKey, ssValue, fOverwrite);
+        Dbt datKey(&ssKey[0], ssKey.size());
         Dbt datValue(&ssValue[0], ssValue.size());
 
         // Write
-        int ret = pdb->put(activeTxn, &datKey, &datValue, (fOverwrite ? 0 : DB_NOOVERWRITE));
+        int ret = pdb->put(GetTxn(), &datKey, &datValue, (fOverwrite ? 0 : DB_NOOVERWRITE));
 
         // Clear memory in case it was a private key
         memset(datKey.get_data(), 0, datKey.get_size());
@@ -180,7 +312,7 @@ protected:
     template <typename K>
     bool Erase(const K& key)
     {
-        if (!pdb)
+        if (!pdb && !plogdb)
             return false;
         if (fReadOnly)
             assert(!"Erase called on database in read-only mode");
@@ -189,10 +321,12 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+        if (plogdb)
+            return EraseLog(ssKey);
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Erase
-        int ret = pdb->del(activeTxn, &datKey, 0);
+        int ret = pdb->del(GetTxn(), &datKey, 0);
 
         // Clear memory
         memset(datKey.get_data(), 0, datKey.get_size());
@@ -202,100 +336,44 @@ protected:
     template <typename K>
     bool Exists(const K& key)
     {
-        if (!pdb)
+        if (!pdb && !plogdb)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+        if (plogdb)
+            return ExistsLog(ssKey);
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Exists
-        int ret = pdb->exists(activeTxn, &datKey, 0);
+        int ret = pdb->exists(GetTxn(), &datKey, 0);
 
         // Clear memory
         memset(datKey.get_data(), 0, datKey.get_size());
         return (ret == 0);
     }
 
-    Dbc* GetCursor()
-    {
-        if (!pdb)
-            return NULL;
-        Dbc* pcursor = NULL;
-        int ret = pdb->cursor(NULL, &pcursor, 0);
-        if (ret != 0)
-            return NULL;
-        return pcursor;
-    }
+    /**
+     * A cursor over the records of the file, in key order, or NULL. The
+     * caller deletes it before the CDB. With fFileOrder a log is read in the
+     * order its records sit on disk instead, in one sequential pass; such a
+     * cursor only reads with DB_NEXT, and the records written in the pending
+     * transaction come last. Either way the cursor sees the writes of the
+     * transaction and the batch in progress, as a BerkeleyDB cursor does.
+     */
+    CDBCursor* GetCursor(bool fFileOrder = false);
 
-    int ReadAtCursor(Dbc* pcursor, CDataStream& ssKey, CDataStream& ssValue, unsigned int fFlags = DB_NEXT)
+    int ReadAtCursor(CDBCursor* pcursor, CDataStream& ssKey, CDataStream& ssValue, unsigned int fFlags = DB_NEXT)
     {
-        // Read at cursor
-        Dbt datKey;
-        if (fFlags == DB_SET || fFlags == DB_SET_RANGE || fFlags == DB_GET_BOTH || fFlags == DB_GET_BOTH_RANGE) {
-            datKey.set_data(&ssKey[0]);
-            datKey.set_size(ssKey.size());
-        }
-        Dbt datValue;
-        if (fFlags == DB_GET_BOTH || fFlags == DB_GET_BOTH_RANGE) {
-            datValue.set_data(&ssValue[0]);
-            datValue.set_size(ssValue.size());
-        }
-        datKey.set_flags(DB_DBT_MALLOC);
-        datValue.set_flags(DB_DBT_MALLOC);
-        int ret = pcursor->get(&datKey, &datValue, fFlags);
-        if (ret != 0)
-            return ret;
-        else if (datKey.get_data() == NULL || datValue.get_data() == NULL)
-            return 99999;
-
-        // Convert to streams
-        ssKey.SetType(SER_DISK);
-        ssKey.clear();
-        ssKey.write((char*)datKey.get_data(), datKey.get_size());
-        ssValue.SetType(SER_DISK);
-        ssValue.clear();
-        ssValue.write((char*)datValue.get_data(), datValue.get_size());
-
-        // Clear and free memory
-        memset(datKey.get_data(), 0, datKey.get_size());
-        memset(datValue.get_data(), 0, datValue.get_size());
-        free(datKey.get_data());
-        free(datValue.get_data());
-        return 0;
+        return pcursor->Read(ssKey, ssValue, fFlags);
     }
 
 public:
-    bool TxnBegin()
-    {
-        if (!pdb || activeTxn)
-            return false;
-        DbTxn* ptxn = bitdb.TxnBegin();
-        if (!ptxn)
-            return false;
-        activeTxn = ptxn;
-        return true;
-    }
-
-    bool TxnCommit()
-    {
-        if (!pdb || !activeTxn)
-            return false;
-        int ret = activeTxn->commit(0);
-        activeTxn = NULL;
-        return (ret == 0);
-    }
-
-    bool TxnAbort()
-    {
-        if (!pdb || !activeTxn)
-            return false;
-        int ret = activeTxn->abort();
-        activeTxn = NULL;
-        return (ret == 0);
-    }
+    bool TxnBegin();
+    bool TxnCommit();
+    bool TxnAbort();
 
     bool ReadVersion(int& nVersion)
     {
@@ -8,6 +8,7 @@
 #include "base58.h"
 #include "chainparams.h"
 #include "httpserver.h"
+#include "jsonstream.h"
 #include "rpcprotocol.h"
 #include "rpcserver.h"
 #include "random.h"
@@ -17,6 +18,7 @@
 #include "ui_interface.h"
 
 #include <boost/algorithm/string.hpp> // boost::trim
+#include <boost/bind.hpp>
 
 /** Simple one-shot callback timer to be used by the RPC mechanism to e.g.
  * re-lock the wellet.
@@ -89,6 +91,31 @@ static bool RPCAuthorized(const std::string& strAuth)
     return TimingResistantEqual(strUserPass, strRPCUserColonPass);
 }
 
+static void WriteJSONChunk(HTTPRequest* req, const std::string& strChunk)
+{
+    if (!req->IsChunkedReplyStarted())
+        req->WriteHeader("Content-Type", "application/json");
+    req->WriteReplyChunk(strChunk);
+}
+
+/**
+ * Answer a single call whose method can stream its result, sending the reply
+ * in chunks while it is being produced. Errors raised before the first chunk
+ * has gone out still get a normal error reply.
+ * @returns false if the method has no streaming form.
+ */
+static bool HTTPReq_JSONRPCStream(HTTPRequest* req, const JSONRequest& jreq)
+{
+    CJSONStreamWriter writer(boost::bind(&WriteJSONChunk, req, _1));
+    writer.BeginObject().Key("result");
+    if (!tableRPC.executeStream(jreq.strMethod, jreq.params, writer))
+        return false;
+    writer.Pair("error", NullUniValue).Pair("id", jreq.id).EndObject();
+    writer.Finish();
+    req->EndChunkedReply();
+    return true;
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -127,6 +154,9 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
+            if (HTTPReq_JSONRPCStream(req, jreq))
+                return true;
+
             UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
 
             // Send reply
@@ -134,17 +164,25 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 
         // array of requests
         } else if (valRequest.isArray())
-            strReply = JSONRPCExecBatch(valRequest.get_array());
+            strReply = JSONRPCExecBatch(valRequest.get_array(), &QueueHTTPWork, GetArg("-rpcthreads", DEFAULT_HTTP_THREADS) - 1);
         else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
 
         req->WriteHeader("Content-Type", "application/json");
         req->WriteReply(HTTP_OK, strReply);
     } catch (const UniValue& objError) {
-        JSONErrorReply(req, objError, jreq.id);
+        if (req->IsChunkedReplyStarted()) {
+            LogPrintf("JSON-RPC stream for %s cut short: %s\n", jreq.strMethod, find_value(objError, "message").getValStr());
+            req->EndChunkedReply();
+        } else
+            JSONErrorReply(req, objError, jreq.id);
         return false;
     } catch (const std::exception& e) {
-        JSONErrorReply(req, JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
+        if (req->IsChunkedReplyStarted()) {
+            LogPrintf("JSON-RPC stream for %s cut short: %s\n", jreq.strMethod, e.what());
+            req->EndChunkedReply();
+        } else
+            JSONErrorReply(req, JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
         return false;
     }
     return true;
@@ -62,6 +62,22 @@ private:
     HTTPRequestHandler func;
 };
 
+/** Work item that runs a function, see QueueHTTPWork */
+class HTTPFunctionItem : public HTTPClosure
+{
+public:
+    HTTPFunctionItem(const boost::function<void(void)>& func): func(func)
+    {
+    }
+    void operator()()
+    {
+        func();
+    }
+
+private:
+    boost::function<void(void)> func;
+};
+
 /** Simple work queue for distributing work over multiple threads.
  * Work items are simply callable objects.
  */
@@ -112,11 +128,11 @@ public:
             queue.pop_front();
         }
     }
-    /** Enqueue a work item */
-    bool Enqueue(WorkItem* item)
+    /** Enqueue a work item, leaving at least nKeepFree slots for others */
+    bool Enqueue(WorkItem* item, size_t nKeepFree = 0)
     {
         boost::unique_lock<boost::mutex> lock(cs);
-        if (queue.size() >= maxDepth) {
+        if (queue.size() + nKeepFree >= maxDepth) {
             return false;
         }
         queue.push_back(item);
@@ -149,6 +165,11 @@ public:
         running = false;
         cond.notify_all();
     }
+    /** Number of items the queue holds at most */
+    size_t MaxDepth() const
+    {
+        return maxDepth;
+    }
     /** Wait for worker threads to exit */
     void WaitExit()
     {
@@ -506,6 +527,18 @@ void StopHTTPServer()
     LogPrint("http", "Stopped HTTP server\n");
 }
 
+bool QueueHTTPWork(const boost::function<void(void)>& func)
+{
+    if (!workQueue)
+        return false;
+    HTTPFunctionItem* item = new HTTPFunctionItem(func);
+    if (!workQueue->Enqueue(item, (workQueue->MaxDepth() + 1) / 2)) {
+        delete item;
+        return false;
+    }
+    return true;
+}
+
 struct event_base* EventBase()
 {
     return eventBase;
@@ -538,12 +571,17 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* req) : req(req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       chunkedStarted(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (chunkedStarted && !replySent) {
+        // Too late for an error status; cut the reply short
+        LogPrintf("%s: Unfinished chunked reply\n", __func__);
+        EndChunkedReply();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -608,6 +646,42 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = 0; // transferred back to main thread
 }
 
+/** Send one chunk on the main http thread; the buffer was filled by a worker */
+static void http_send_reply_chunk(struct evhttp_request* req, struct evbuffer* evb)
+{
+    evhttp_send_reply_chunk(req, evb);
+    evbuffer_free(evb);
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(!replySent && req);
+    // Events are run in the order they are triggered, so the chunks go out in order
+    if (!chunkedStarted) {
+        HTTPEvent* ev = new HTTPEvent(eventBase, true,
+            boost::bind(evhttp_send_reply_start, req, (int)HTTP_OK, (const char*)NULL));
+        ev->trigger(0);
+        chunkedStarted = true;
+    }
+    // An empty chunk would mark the end of the body
+    if (strChunk.empty())
+        return;
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(http_send_reply_chunk, req, evb));
+    ev->trigger(0);
+}
+
+void HTTPRequest::EndChunkedReply()
+{
+    assert(chunkedStarted && !replySent && req);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(evhttp_send_reply_end, req));
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
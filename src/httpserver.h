@@ -44,6 +44,12 @@ void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPR
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
+/** Run a function on one of the HTTP worker threads.
+ * Returns false if the work queue is not running or already half full:
+ * the other half is kept free for incoming requests.
+ */
+bool QueueHTTPWork(const boost::function<void(void)>& func);
+
 /** Return evhttp event base. This can be used by submodules to
  * queue timers or custom events.
  */
@@ -57,6 +63,7 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool chunkedStarted;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -112,6 +119,25 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Send part of a 200 reply with chunked transfer encoding.
+     * The first call sends the status line and the headers, so until then
+     * the request can still be answered with WriteReply instead.
+     *
+     * @note Finish with EndChunkedReply.
+     */
+    void WriteReplyChunk(const std::string& strChunk);
+
+    /**
+     * End a reply started with WriteReplyChunk.
+     *
+     * @note As with WriteReply, do not call any other HTTPRequest methods after calling this.
+     */
+    void EndChunkedReply();
+
+    /** Whether WriteReplyChunk has started sending the reply */
+    bool IsChunkedReplyStarted() const { return chunkedStarted; }
 };
 
 /** Event handler closure.
@@ -0,0 +1,106 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "jsonstream.h"
+
+#include <assert.h>
+
+CJSONStreamWriter::CJSONStreamWriter(const Sink& sinkIn, size_t nFlushSizeIn) : sink(sinkIn), nFlushSize(nFlushSizeIn), fAfterKey(false)
+{
+    strBuffer.reserve(nFlushSize + 1024);
+}
+
+void CJSONStreamWriter::BeforeValue()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (!vHasElements.empty()) {
+        if (vHasElements.back())
+            strBuffer += ',';
+        vHasElements.back() = true;
+    }
+}
+
+void CJSONStreamWriter::Append(const std::string& str)
+{
+    strBuffer += str;
+    if (strBuffer.size() >= nFlushSize)
+        Flush();
+}
+
+CJSONStreamWriter& CJSONStreamWriter::BeginObject()
+{
+    BeforeValue();
+    strBuffer += '{';
+    vHasElements.push_back(false);
+    return *this;
+}
+
+CJSONStreamWriter& CJSONStreamWriter::EndObject()
+{
+    assert(!vHasElements.empty() && !fAfterKey);
+    vHasElements.pop_back();
+    Append("}");
+    return *this;
+}
+
+CJSONStreamWriter& CJSONStreamWriter::BeginArray()
+{
+    BeforeValue();
+    strBuffer += '[';
+    vHasElements.push_back(false);
+    return *this;
+}
+
+CJSONStreamWriter& CJSONStreamWriter::EndArray()
+{
+    assert(!vHasElements.empty() && !fAfterKey);
+    vHasElements.pop_back();
+    Append("]");
+    return *this;
+}
+
+CJSONStreamWriter& CJSONStreamWriter::Key(const std::string& key)
+{
+    assert(!vHasElements.empty() && !fAfterKey);
+    BeforeValue();
+    // A string value writes as the escaped, quoted key
+    strBuffer += UniValue(key).write();
+    strBuffer += ':';
+    fAfterKey = true;
+    return *this;
+}
+
+CJSONStreamWriter& CJSONStreamWriter::Value(const UniValue& value)
+{
+    BeforeValue();
+    Append(value.write());
+    return *this;
+}
+
+CJSONStreamWriter& CJSONStreamWriter::Fields(const UniValue& obj)
+{
+    const std::vector<std::string>& vKeys = obj.getKeys();
+    const std::vector<UniValue>& vValues = obj.getValues();
+    for (unsigned int i = 0; i < vKeys.size(); i++)
+        Key(vKeys[i]).Value(vValues[i]);
+    return *this;
+}
+
+void CJSONStreamWriter::Finish()
+{
+    assert(vHasElements.empty());
+    strBuffer += '\n';
+    Flush();
+}
+
+void CJSONStreamWriter::Flush()
+{
+    if (strBuffer.empty())
+        return;
+    sink(strBuffer);
+    strBuffer.clear();
+}
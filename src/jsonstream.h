@@ -0,0 +1,64 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_JSONSTREAM_H
+#define BITCOIN_JSONSTREAM_H
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include <univalue.h>
+
+/**
+ * Writes a JSON document piece by piece and hands the text to a sink each
+ * time the buffer passes the flush size, so that a large reply never exists
+ * as one UniValue tree or one string. Small parts can still be built as
+ * UniValue and written whole with Value() or Fields(). The output matches
+ * UniValue::write() without indentation.
+ */
+class CJSONStreamWriter
+{
+public:
+    typedef boost::function<void(const std::string&)> Sink;
+
+    static const size_t DEFAULT_FLUSH_SIZE = 64 * 1024;
+
+    explicit CJSONStreamWriter(const Sink& sinkIn, size_t nFlushSizeIn = DEFAULT_FLUSH_SIZE);
+
+    CJSONStreamWriter& BeginObject();
+    CJSONStreamWriter& EndObject();
+    CJSONStreamWriter& BeginArray();
+    CJSONStreamWriter& EndArray();
+
+    /** The key of the next value in the current object */
+    CJSONStreamWriter& Key(const std::string& key);
+    /** A complete value, as an array element or after Key() */
+    CJSONStreamWriter& Value(const UniValue& value);
+    CJSONStreamWriter& Pair(const std::string& key, const UniValue& value)
+    {
+        return Key(key).Value(value);
+    }
+    /** Every key and value of obj, into the current object */
+    CJSONStreamWriter& Fields(const UniValue& obj);
+
+    /** End the document with a newline and hand everything left to the sink */
+    void Finish();
+    /** Hand what has been written so far to the sink */
+    void Flush();
+
+private:
+    Sink sink;
+    size_t nFlushSize;
+    std::string strBuffer;
+    //! For each open object or array, whether it has an element yet
+    std::vector<bool> vHasElements;
+    bool fAfterKey;
+
+    void BeforeValue();
+    void Append(const std::string& str);
+};
+
+#endif // BITCOIN_JSONSTREAM_H
@@ -6,6 +6,8 @@
 #include <boost/assign/list_of.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include "crypto/common.h"
+#include "crypto/sha256.h"
 #include "db.h"
 #include "kernel.h"
 #include "script/interpreter.h"
@@ -318,17 +320,32 @@ bool Stake(CStakeInput* stakeInput, unsigned int nBits, unsigned int nTimeBlockF
     int nHashDrift = 30;
     CDataStream ssUniqueID = stakeInput->GetUniqueness();
     CAmount nValueIn = stakeInput->GetValue();
-    for (int i = 0; i < nHashDrift; i++) //iterate the hashing
+
+    // Every candidate kernel shares the same prefix and only differs in the
+    // trailing time, so lay them out back to back and hash them in one batch.
+    CDataStream ssPrefix(SER_GETHASH, 0);
+    ssPrefix << nStakeModifier << nTimeBlockFrom << ssUniqueID;
+    const size_t nKernelSize = ssPrefix.size() + sizeof(nTryTime);
+    std::vector<unsigned char> vKernels(nKernelSize * nHashDrift);
+    for (int i = 0; i < nHashDrift; i++) {
+        unsigned char* pKernel = &vKernels[nKernelSize * i];
+        std::copy(ssPrefix.begin(), ssPrefix.end(), pKernel);
+        WriteLE32(pKernel + ssPrefix.size(), nTimeTx + nHashDrift - i);
+    }
+    std::vector<uint256> vHashes(nHashDrift);
+    SHA256DMany(vHashes[0].begin(), &vKernels[0], nKernelSize, nHashDrift);
+
+    for (int i = 0; i < nHashDrift; i++) //check the hashes in the original order
     {
         //new block came in, move on
         if (chainActive.Height() != nHeightStart)
             break;
 
-        //hash this iteration
         nTryTime = nTimeTx + nHashDrift - i;
+        hashProofOfStake = vHashes[i];
 
         // if stake hash does not meet the target then continue to next iteration
-        if (!CheckStake(ssUniqueID, nValueIn, nStakeModifier, bnTargetPerCoinDay, nTimeBlockFrom, nTryTime, hashProofOfStake))
+        if (!stakeTargetHit(hashProofOfStake, nValueIn, bnTargetPerCoinDay))
             continue;
 
         fSuccess = true; // if we make it this far then we have successfully created a stake hash
@@ -354,11 +371,11 @@ bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, std::uniqu
 
     //Construct the stakeinput object
     if (tx.IsZerocoinSpend()) {
-        libzerocoin::CoinSpend spend = TxInToZerocoinSpend(txin);
-        if (spend.getSpendType() != libzerocoin::SpendType::STAKE)
-            return error("%s: spend is using the wrong SpendType (%d)", __func__, (int)spend.getSpendType());
+        CoinSpendRef spend = TxInToZerocoinSpendRef(tx, 0);
+        if (spend->getSpendType() != libzerocoin::SpendType::STAKE)
+            return error("%s: spend is using the wrong SpendType (%d)", __func__, (int)spend->getSpendType());
 
-        stake = std::unique_ptr<CStakeInput>(new CZUserxStake(spend));
+        stake = std::unique_ptr<CStakeInput>(new CZUserxStake(*spend));
     } else {
         // First try finding the previous transaction in database
         uint256 hashBlock;
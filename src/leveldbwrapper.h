@@ -85,12 +85,10 @@ private:
     //! the database itself
     leveldb::DB* pdb;
 
-public:
-    CLevelDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
-    ~CLevelDBWrapper();
+    friend class CLevelDBSnapshot;
 
     template <typename K, typename V>
-    bool Read(const K& key, V& value) const throw(leveldb_error)
+    bool Read(const leveldb::ReadOptions& options, const K& key, V& value) const throw(leveldb_error)
     {
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(ssKey.GetSerializeSize(key));
@@ -98,7 +96,7 @@ public:
         leveldb::Slice slKey(&ssKey[0], ssKey.size());
 
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        leveldb::Status status = pdb->Get(options, slKey, &strValue);
         if (!status.ok()) {
             if (status.IsNotFound())
                 return false;
@@ -114,6 +112,16 @@ public:
         return true;
     }
 
+public:
+    CLevelDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    ~CLevelDBWrapper();
+
+    template <typename K, typename V>
+    bool Read(const K& key, V& value) const throw(leveldb_error)
+    {
+        return Read(readoptions, key, value);
+    }
+
     template <typename K, typename V>
     bool Write(const K& key, const V& value, bool fSync = false) throw(leveldb_error)
     {
@@ -170,4 +178,46 @@ public:
     }
 };
 
+/**
+ * A consistent read-only view of a database as it was when the snapshot was
+ * taken. Writes made afterwards are not seen, so long scans need no lock
+ * against concurrent writers.
+ */
+class CLevelDBSnapshot
+{
+private:
+    const CLevelDBWrapper& db;
+    const leveldb::Snapshot* psnapshot;
+    leveldb::ReadOptions readoptions;
+    leveldb::ReadOptions iteroptions;
+
+    CLevelDBSnapshot(const CLevelDBSnapshot&);
+    void operator=(const CLevelDBSnapshot&);
+
+public:
+    explicit CLevelDBSnapshot(const CLevelDBWrapper& dbIn) : db(dbIn), psnapshot(dbIn.pdb->GetSnapshot())
+    {
+        readoptions = db.readoptions;
+        readoptions.snapshot = psnapshot;
+        iteroptions = db.iteroptions;
+        iteroptions.snapshot = psnapshot;
+    }
+
+    ~CLevelDBSnapshot()
+    {
+        db.pdb->ReleaseSnapshot(psnapshot);
+    }
+
+    template <typename K, typename V>
+    bool Read(const K& key, V& value) const throw(leveldb_error)
+    {
+        return db.Read(readoptions, key, value);
+    }
+
+    leveldb::Iterator* NewIterator() const
+    {
+        return db.pdb->NewIterator(iteroptions);
+    }
+};
+
 #endif // BITCOIN_LEVELDBWRAPPER_H
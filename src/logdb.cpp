@@ -0,0 +1,801 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "logdb.h"
+
+#include "clientversion.h"
+#include "crypto/common.h"
+#include "hash.h"
+#include "random.h"
+#include "streams.h"
+#include "util.h"
+
+#include <algorithm>
+#include <limits>
+
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <boost/filesystem.hpp>
+
+namespace
+{
+const unsigned char LOG_MAGIC[8] = {'u', 's', 'e', 'r', 'x', 'l', 'o', 'g'};
+const unsigned char INDEX_MAGIC[8] = {'u', 's', 'e', 'r', 'x', 'i', 'd', 'x'};
+const uint32_t LOG_VERSION = 1;
+//! Magic, version and log id
+const uint64_t LOG_HEADER_SIZE = 20;
+//! Payload size and checksum
+const uint64_t FRAME_HEADER_SIZE = 8;
+//! Compaction writes the live records in frames of about this size
+const size_t COMPACT_FRAME_SIZE = 1 << 20;
+
+enum LogRecordType {
+    LOG_PUT = 1,
+    LOG_ERASE = 2,
+};
+
+int SeekLog(FILE* file, uint64_t nPos)
+{
+#ifdef WIN32
+    return _fseeki64(file, nPos, SEEK_SET);
+#else
+    return fseeko(file, nPos, SEEK_SET);
+#endif
+}
+
+bool TruncateLog(FILE* file, uint64_t nSize)
+{
+#ifdef WIN32
+    return _chsize_s(_fileno(file), nSize) == 0;
+#else
+    return ftruncate(fileno(file), nSize) == 0;
+#endif
+}
+
+uint32_t FrameChecksum(const CDataStream& ss)
+{
+    uint256 hash = Hash(ss.begin(), ss.end());
+    return ReadLE32(hash.begin());
+}
+
+uint32_t FrameChecksum(const char* pbegin, const char* pend)
+{
+    uint256 hash = Hash(pbegin, pend);
+    return ReadLE32(hash.begin());
+}
+
+void WriteLogHeader(unsigned char (&header)[LOG_HEADER_SIZE], uint64_t nLogId)
+{
+    memcpy(header, LOG_MAGIC, sizeof(LOG_MAGIC));
+    WriteLE32(header + 8, LOG_VERSION);
+    WriteLE64(header + 12, nLogId);
+}
+
+bool ReadLogValue(FILE* file, uint64_t nPos, uint32_t nSize, CSerializeData& value)
+{
+    value.resize(nSize);
+    if (SeekLog(file, nPos) != 0)
+        return false;
+    return nSize == 0 || fread(&value[0], 1, nSize, file) == nSize;
+}
+
+/** Read the records of a frame's payload into txn; false if they don't parse */
+bool ParseFrame(const char* pbegin, const char* pend, CLogDBTxn& txn)
+{
+    CDataStream ss(pbegin, pend, SER_DISK, CLIENT_VERSION);
+    try {
+        while (!ss.empty()) {
+            unsigned char nType;
+            std::string key;
+            ss >> nType >> key;
+            if (nType == LOG_PUT) {
+                uint64_t nValueSize = ReadCompactSize(ss);
+                if (nValueSize > ss.size())
+                    return false;
+                CSerializeData value(nValueSize);
+                if (nValueSize)
+                    ss.read(&value[0], nValueSize);
+                txn.Write(key, value);
+            } else if (nType == LOG_ERASE) {
+                txn.Erase(key);
+            } else {
+                return false;
+            }
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+/** Copy the bytes of src from nPos up to nEnd to the end of dest */
+bool CopyLogRange(FILE* src, FILE* dest, uint64_t nPos, uint64_t nEnd)
+{
+    std::vector<char> vBuf(1 << 16);
+    if (SeekLog(src, nPos) != 0)
+        return false;
+    while (nPos < nEnd) {
+        size_t nChunk = (size_t)std::min<uint64_t>(vBuf.size(), nEnd - nPos);
+        if (fread(&vBuf[0], 1, nChunk, src) != nChunk || fwrite(&vBuf[0], 1, nChunk, dest) != nChunk)
+            return false;
+        nPos += nChunk;
+    }
+    return true;
+}
+} // anon namespace
+
+void CLogDBTxn::Write(const std::string& key, const CSerializeData& value)
+{
+    std::pair<bool, CSerializeData>& entry = mapWrites[key];
+    entry.first = false;
+    entry.second = value;
+}
+
+void CLogDBTxn::Erase(const std::string& key)
+{
+    std::pair<bool, CSerializeData>& entry = mapWrites[key];
+    entry.first = true;
+    entry.second.clear();
+}
+
+bool CLogDBTxn::Find(const std::string& key, bool& fErased, CSerializeData& value) const
+{
+    std::map<std::string, std::pair<bool, CSerializeData> >::const_iterator it = mapWrites.find(key);
+    if (it == mapWrites.end())
+        return false;
+    fErased = it->second.first;
+    value = it->second.second;
+    return true;
+}
+
+bool CLogDBTxn::Next(std::string& key, bool fInclusive) const
+{
+    std::map<std::string, std::pair<bool, CSerializeData> >::const_iterator it = fInclusive ? mapWrites.lower_bound(key) : mapWrites.upper_bound(key);
+    if (it == mapWrites.end())
+        return false;
+    key = it->first;
+    return true;
+}
+
+void CLogDBTxn::GetKeys(std::set<std::string>& setKeys) const
+{
+    for (std::map<std::string, std::pair<bool, CSerializeData> >::const_iterator it = mapWrites.begin(); it != mapWrites.end(); ++it)
+        setKeys.insert(it->first);
+}
+
+void CLogDBTxn::Merge(const CLogDBTxn& txn)
+{
+    for (std::map<std::string, std::pair<bool, CSerializeData> >::const_iterator it = txn.mapWrites.begin(); it != txn.mapWrites.end(); ++it)
+        mapWrites[it->first] = it->second;
+}
+
+CLogDB::CLogDB() : file(NULL), nLogId(0), nFileSize(0), nLiveSize(0), nSynced(0), nIndexed(0)
+{
+}
+
+CLogDB::~CLogDB()
+{
+    Close();
+}
+
+bool CLogDB::Open(const boost::filesystem::path& pathIn, bool fCreate)
+{
+    LOCK(cs);
+    if (file)
+        return true;
+
+    path = pathIn;
+    mapIndex.clear();
+    nLiveSize = 0;
+    nIndexed = 0;
+    file = fopen(path.string().c_str(), "r+b");
+    if (!file) {
+        if (!fCreate)
+            return error("CLogDB::Open : can't open %s", path.string());
+        file = fopen(path.string().c_str(), "w+b");
+        if (!file)
+            return error("CLogDB::Open : can't create %s", path.string());
+        nLogId = GetRand(std::numeric_limits<uint64_t>::max());
+        unsigned char header[LOG_HEADER_SIZE];
+        WriteLogHeader(header, nLogId);
+        if (fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+            fclose(file);
+            file = NULL;
+            return error("CLogDB::Open : can't write to %s", path.string());
+        }
+        FileCommit(file);
+        nFileSize = nSynced = LOG_HEADER_SIZE;
+        return true;
+    }
+
+    unsigned char header[LOG_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 || ReadLE32(header + 8) != LOG_VERSION) {
+        fclose(file);
+        file = NULL;
+        return error("CLogDB::Open : %s is not a wallet log", path.string());
+    }
+    nLogId = ReadLE64(header + 12);
+
+    // Start from the saved index if it matches the log, else read the whole log
+    int64_t nStart = GetTimeMillis();
+    if (!ReadIndex()) {
+        mapIndex.clear();
+        nLiveSize = 0;
+        nIndexed = LOG_HEADER_SIZE;
+    }
+    if (!Replay(nIndexed)) {
+        fclose(file);
+        file = NULL;
+        return false;
+    }
+    nSynced = nFileSize;
+    LogPrint("db", "CLogDB::Open : %s, %u records, replayed %d bytes in %dms\n", path.string(), mapIndex.size(), nFileSize - nIndexed, GetTimeMillis() - nStart);
+    return true;
+}
+
+void CLogDB::Close()
+{
+    LOCK(cs);
+    if (!file)
+        return;
+    FileCommit(file);
+    nSynced = nFileSize;
+    if (nIndexed != nFileSize)
+        WriteIndex();
+    fclose(file);
+    file = NULL;
+    mapIndex.clear();
+}
+
+bool CLogDB::Replay(uint64_t nPos)
+{
+    AssertLockHeld(cs);
+    uint64_t nEnd = boost::filesystem::file_size(path);
+    if (SeekLog(file, nPos) != 0)
+        return error("CLogDB::Replay : can't seek in %s", path.string());
+
+    // Apply every whole frame from nPos on
+    while (nPos + FRAME_HEADER_SIZE <= nEnd) {
+        unsigned char header[FRAME_HEADER_SIZE];
+        if (fread(header, 1, sizeof(header), file) != sizeof(header))
+            break;
+        uint32_t nSize = ReadLE32(header);
+        if (nPos + FRAME_HEADER_SIZE + nSize > nEnd)
+            break;
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss.resize(nSize);
+        if (nSize && fread(&ss[0], 1, nSize, file) != nSize)
+            break;
+        if (FrameChecksum(ss) != ReadLE32(header + 4))
+            break;
+
+        uint64_t nPayload = nPos + FRAME_HEADER_SIZE;
+        try {
+            while (!ss.empty()) {
+                unsigned char nType;
+                std::string key;
+                ss >> nType >> key;
+                if (nType == LOG_PUT) {
+                    uint64_t nValueSize = ReadCompactSize(ss);
+                    if (nValueSize > ss.size())
+                        throw std::ios_base::failure("value past the end of the frame");
+                    IndexPut(key, CValuePos(nPayload + nSize - ss.size(), nValueSize));
+                    ss.ignore(nValueSize);
+                } else if (nType == LOG_ERASE) {
+                    IndexErase(key);
+                } else {
+                    throw std::ios_base::failure("unknown record type");
+                }
+            }
+        } catch (const std::exception& e) {
+            // The checksum matched, so this was written that way
+            return error("CLogDB::Replay : bad frame at %d in %s: %s", nPos, path.string(), e.what());
+        }
+        nPos = nPayload + nSize;
+    }
+
+    // Anything after the last whole frame was cut short by a crash, unless
+    // whole frames follow it: then the log is damaged in the middle, and
+    // truncating it would throw those away
+    if (nEnd > nPos && FrameFollows(nPos, nEnd))
+        return error("CLogDB::Replay : %s is corrupt at %d, with valid frames after it; leaving it as it is", path.string(), nPos);
+    nFileSize = nPos;
+    if (nEnd > nFileSize) {
+        LogPrintf("CLogDB::Replay : dropping %d bytes of an unfinished frame at the end of %s\n", nEnd - nFileSize, path.string());
+        if (!TruncateLog(file, nFileSize))
+            return error("CLogDB::Replay : can't truncate %s", path.string());
+    }
+    return true;
+}
+
+bool CLogDB::FrameFollows(uint64_t nPos, uint64_t nEnd)
+{
+    AssertLockHeld(cs);
+    // Frames aren't aligned, so try every offset after the bad one
+    std::vector<char> vBuf((size_t)(nEnd - nPos));
+    if (SeekLog(file, nPos) != 0 || fread(&vBuf[0], 1, vBuf.size(), file) != vBuf.size())
+        return false;
+    for (size_t i = 1; i + FRAME_HEADER_SIZE < vBuf.size(); i++) {
+        uint32_t nSize = ReadLE32((const unsigned char*)&vBuf[i]);
+        // AppendFrame never writes an empty frame
+        if (nSize == 0 || nSize > vBuf.size() - i - FRAME_HEADER_SIZE)
+            continue;
+        const char* pPayload = &vBuf[i + FRAME_HEADER_SIZE];
+        if (FrameChecksum(pPayload, pPayload + nSize) == ReadLE32((const unsigned char*)&vBuf[i + 4]))
+            return true;
+    }
+    return false;
+}
+
+bool CLogDB::IsLog(const boost::filesystem::path& path)
+{
+    FILE* file = fopen(path.string().c_str(), "rb");
+    if (!file)
+        return false;
+    unsigned char header[LOG_HEADER_SIZE];
+    bool fLog = fread(header, 1, sizeof(header), file) == sizeof(header) && memcmp(header, LOG_MAGIC, sizeof(LOG_MAGIC)) == 0;
+    fclose(file);
+    return fLog;
+}
+
+bool CLogDB::Salvage(const boost::filesystem::path& pathIn, std::vector<std::pair<std::string, CSerializeData> >& vResult)
+{
+    FILE* fileIn = fopen(pathIn.string().c_str(), "rb");
+    if (!fileIn)
+        return error("CLogDB::Salvage : can't open %s", pathIn.string());
+    std::vector<char> vBuf((size_t)boost::filesystem::file_size(pathIn));
+    bool fRead = vBuf.empty() || fread(&vBuf[0], 1, vBuf.size(), fileIn) == vBuf.size();
+    fclose(fileIn);
+    if (!fRead || vBuf.size() < LOG_HEADER_SIZE || memcmp(&vBuf[0], LOG_MAGIC, sizeof(LOG_MAGIC)) != 0)
+        return error("CLogDB::Salvage : %s is not a wallet log", pathIn.string());
+
+    // Apply each whole frame in turn; past damage, try every offset for the next one
+    CLogDBTxn txnAll;
+    unsigned int nFrames = 0;
+    size_t nPos = LOG_HEADER_SIZE;
+    size_t nSkipped = 0;
+    while (nPos < vBuf.size()) {
+        CLogDBTxn txnFrame;
+        bool fFrame = false;
+        uint32_t nSize = 0;
+        if (nPos + FRAME_HEADER_SIZE < vBuf.size()) {
+            nSize = ReadLE32((const unsigned char*)&vBuf[nPos]);
+            // AppendFrame never writes an empty frame
+            if (nSize != 0 && nSize <= vBuf.size() - nPos - FRAME_HEADER_SIZE) {
+                const char* pPayload = &vBuf[nPos + FRAME_HEADER_SIZE];
+                fFrame = FrameChecksum(pPayload, pPayload + nSize) == ReadLE32((const unsigned char*)&vBuf[nPos + 4]) &&
+                         ParseFrame(pPayload, pPayload + nSize, txnFrame);
+            }
+        }
+        if (!fFrame) {
+            nSkipped++;
+            nPos++;
+            continue;
+        }
+        if (nSkipped) {
+            LogPrintf("CLogDB::Salvage : skipped %u damaged bytes before %u in %s\n", nSkipped, nPos, pathIn.string());
+            nSkipped = 0;
+        }
+        txnAll.Merge(txnFrame);
+        nFrames++;
+        nPos += FRAME_HEADER_SIZE + nSize;
+    }
+    if (nSkipped)
+        LogPrintf("CLogDB::Salvage : skipped %u damaged bytes at the end of %s\n", nSkipped, pathIn.string());
+
+    for (std::map<std::string, std::pair<bool, CSerializeData> >::const_iterator it = txnAll.mapWrites.begin(); it != txnAll.mapWrites.end(); ++it) {
+        if (!it->second.first)
+            vResult.push_back(std::make_pair(it->first, it->second.second));
+    }
+    LogPrintf("CLogDB::Salvage : read %u records from %u frames of %s\n", vResult.size(), nFrames, pathIn.string());
+    return true;
+}
+
+bool CLogDB::ReadIndex()
+{
+    AssertLockHeld(cs);
+    boost::filesystem::path pathIndex = path.string() + ".idx";
+    FILE* fileIndex = fopen(pathIndex.string().c_str(), "rb");
+    if (!fileIndex)
+        return false;
+    CAutoFile filein(fileIndex, SER_DISK, CLIENT_VERSION);
+
+    // One read for the whole index, then check it
+    uint64_t nSize = boost::filesystem::file_size(pathIndex);
+    if (nSize < sizeof(INDEX_MAGIC) + 32)
+        return false;
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss.resize(nSize - 32);
+    uint256 hashChecksum;
+    try {
+        filein.read(&ss[0], ss.size());
+        filein >> hashChecksum;
+    } catch (const std::exception&) {
+        return false;
+    }
+    if (Hash(ss.begin(), ss.end()) != hashChecksum || memcmp(&ss[0], INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0)
+        return error("CLogDB::ReadIndex : %s is damaged, reading the whole log", pathIndex.string());
+
+    try {
+        ss.ignore(sizeof(INDEX_MAGIC));
+        uint64_t nIndexLogId;
+        ss >> nIndexLogId >> nIndexed;
+        if (nIndexLogId != nLogId || nIndexed < LOG_HEADER_SIZE || nIndexed > boost::filesystem::file_size(path))
+            return false;
+        ss >> mapIndex;
+    } catch (const std::exception&) {
+        return false;
+    }
+    nLiveSize = 0;
+    for (IndexMap::const_iterator it = mapIndex.begin(); it != mapIndex.end(); ++it)
+        nLiveSize += it->first.size() + it->second.nSize;
+    return true;
+}
+
+bool CLogDB::WriteIndex()
+{
+    AssertLockHeld(cs);
+    // Only what is on disk may be covered
+    assert(nSynced == nFileSize);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss.write((const char*)INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    ss << nLogId << nFileSize << mapIndex;
+    uint256 hashChecksum = Hash(ss.begin(), ss.end());
+
+    // Write a new file and move it over the old one
+    boost::filesystem::path pathIndex = path.string() + ".idx";
+    boost::filesystem::path pathTmp = path.string() + ".idx.new";
+    FILE* fileIndex = fopen(pathTmp.string().c_str(), "wb");
+    if (!fileIndex)
+        return error("CLogDB::WriteIndex : can't create %s", pathTmp.string());
+    CAutoFile fileout(fileIndex, SER_DISK, CLIENT_VERSION);
+    try {
+        fileout.write(&ss[0], ss.size());
+        fileout << hashChecksum;
+    } catch (const std::exception& e) {
+        return error("CLogDB::WriteIndex : %s", e.what());
+    }
+    FileCommit(fileout.Get());
+    fileout.fclose();
+    if (!RenameOver(pathTmp, pathIndex))
+        return error("CLogDB::WriteIndex : can't rename %s", pathTmp.string());
+    nIndexed = nFileSize;
+    return true;
+}
+
+void CLogDB::IndexPut(const std::string& key, const CValuePos& pos)
+{
+    std::pair<IndexMap::iterator, bool> ret = mapIndex.insert(std::make_pair(key, pos));
+    if (!ret.second) {
+        nLiveSize -= key.size() + ret.first->second.nSize;
+        ret.first->second = pos;
+    }
+    nLiveSize += key.size() + pos.nSize;
+}
+
+void CLogDB::IndexErase(const std::string& key)
+{
+    IndexMap::iterator it = mapIndex.find(key);
+    if (it == mapIndex.end())
+        return;
+    nLiveSize -= key.size() + it->second.nSize;
+    mapIndex.erase(it);
+}
+
+bool CLogDB::AppendFrame(const std::map<std::string, std::pair<bool, CSerializeData> >& mapWrites)
+{
+    AssertLockHeld(cs);
+    if (!file)
+        return false;
+    if (mapWrites.empty())
+        return true;
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    std::vector<size_t> vValueOffsets;
+    for (std::map<std::string, std::pair<bool, CSerializeData> >::const_iterator it = mapWrites.begin(); it != mapWrites.end(); ++it) {
+        const CSerializeData& value = it->second.second;
+        if (it->second.first) {
+            ss << (unsigned char)LOG_ERASE << it->first;
+            continue;
+        }
+        ss << (unsigned char)LOG_PUT << it->first;
+        WriteCompactSize(ss, value.size());
+        vValueOffsets.push_back(ss.size());
+        if (!value.empty())
+            ss.write(&value[0], value.size());
+    }
+    if (ss.size() > std::numeric_limits<uint32_t>::max())
+        return error("CLogDB::AppendFrame : %u bytes are too many for one frame", ss.size());
+
+    unsigned char header[FRAME_HEADER_SIZE];
+    WriteLE32(header, ss.size());
+    WriteLE32(header + 4, FrameChecksum(ss));
+    if (SeekLog(file, nFileSize) != 0 ||
+        fwrite(header, 1, sizeof(header), file) != sizeof(header) ||
+        fwrite(&ss[0], 1, ss.size(), file) != ss.size() ||
+        fflush(file) != 0) {
+        TruncateLog(file, nFileSize);
+        return error("CLogDB::AppendFrame : can't write to %s", path.string());
+    }
+
+    uint64_t nPayload = nFileSize + FRAME_HEADER_SIZE;
+    nFileSize = nPayload + ss.size();
+    std::vector<size_t>::const_iterator itOffset = vValueOffsets.begin();
+    for (std::map<std::string, std::pair<bool, CSerializeData> >::const_iterator it = mapWrites.begin(); it != mapWrites.end(); ++it) {
+        if (it->second.first)
+            IndexErase(it->first);
+        else
+            IndexPut(it->first, CValuePos(nPayload + *itOffset++, it->second.second.size()));
+    }
+    return true;
+}
+
+bool CLogDB::ReadValue(const CValuePos& pos, CSerializeData& value)
+{
+    AssertLockHeld(cs);
+    return ReadLogValue(file, pos.nPos, pos.nSize, value);
+}
+
+bool CLogDB::Read(const std::string& key, CSerializeData& value)
+{
+    LOCK(cs);
+    IndexMap::const_iterator it = mapIndex.find(key);
+    if (it == mapIndex.end() || !file)
+        return false;
+    return ReadValue(it->second, value);
+}
+
+bool CLogDB::Exists(const std::string& key)
+{
+    LOCK(cs);
+    return mapIndex.count(key) != 0;
+}
+
+bool CLogDB::Write(const std::string& key, const CSerializeData& value)
+{
+    CLogDBTxn txn;
+    txn.Write(key, value);
+    return Commit(txn);
+}
+
+bool CLogDB::Erase(const std::string& key)
+{
+    LOCK(cs);
+    if (!mapIndex.count(key))
+        return true;
+    CLogDBTxn txn;
+    txn.Erase(key);
+    return AppendFrame(txn.mapWrites);
+}
+
+bool CLogDB::Commit(const CLogDBTxn& txn)
+{
+    LOCK(cs);
+    return AppendFrame(txn.mapWrites);
+}
+
+bool CLogDB::Next(std::string& key, CSerializeData& value, bool fInclusive)
+{
+    LOCK(cs);
+    IndexMap::const_iterator it = fInclusive ? mapIndex.lower_bound(key) : mapIndex.upper_bound(key);
+    if (it == mapIndex.end() || !file)
+        return false;
+    key = it->first;
+    return ReadValue(it->second, value);
+}
+
+void CLogDB::GetKeysInLogOrder(std::vector<std::string>& vKeys)
+{
+    LOCK(cs);
+    std::vector<std::pair<uint64_t, const std::string*> > vByPos;
+    vByPos.reserve(mapIndex.size());
+    for (IndexMap::const_iterator it = mapIndex.begin(); it != mapIndex.end(); ++it)
+        vByPos.push_back(std::make_pair(it->second.nPos, &it->first));
+    std::sort(vByPos.begin(), vByPos.end());
+
+    vKeys.clear();
+    vKeys.reserve(vByPos.size());
+    for (unsigned int i = 0; i < vByPos.size(); i++)
+        vKeys.push_back(*vByPos[i].second);
+}
+
+bool CLogDB::IsCompactionDue()
+{
+    AssertLockHeld(cs);
+    return nFileSize >= LOGDB_MIN_COMPACT_SIZE && nFileSize - LOG_HEADER_SIZE > 2 * nLiveSize;
+}
+
+bool CLogDB::Flush()
+{
+    {
+        LOCK(cs);
+        if (!file)
+            return false;
+        if (nSynced != nFileSize) {
+            FileCommit(file);
+            nSynced = nFileSize;
+        }
+        if (!IsCompactionDue()) {
+            if (nIndexed != nFileSize)
+                return WriteIndex();
+            return true;
+        }
+    }
+    // Compacting reads the whole log, so it runs without holding up writers
+    return CompactSnapshot("", true);
+}
+
+bool CLogDB::Compact(const std::string& strSkip)
+{
+    return CompactSnapshot(strSkip, false);
+}
+
+bool CLogDB::CompactSnapshot(const std::string& strSkip, bool fIfDue)
+{
+    LOCK(csCompact);
+    int64_t nStart = GetTimeMillis();
+    boost::filesystem::path pathTmp = path.string() + ".compact";
+
+    // Take the live records as of now
+    IndexMap mapSnapshot;
+    uint64_t nSnapshotLogId;
+    uint64_t nSnapshotSize;
+    {
+        LOCK(cs);
+        if (!file)
+            return false;
+        if (fIfDue && !IsCompactionDue())
+            return true;
+        if (fflush(file) != 0)
+            return error("CLogDB::Compact : can't write to %s", path.string());
+        for (IndexMap::const_iterator it = mapIndex.begin(); it != mapIndex.end(); ++it)
+            if (strSkip.empty() || it->first.compare(0, strSkip.size(), strSkip) != 0)
+                mapSnapshot.insert(mapSnapshot.end(), *it);
+        nSnapshotLogId = nLogId;
+        nSnapshotSize = nFileSize;
+    }
+
+    // Write them, in key order, to a log with a new id. The values are read
+    // through a handle of our own, as writers keep appending to the log
+    FILE* fileOld = fopen(path.string().c_str(), "rb");
+    if (!fileOld)
+        return error("CLogDB::Compact : can't open %s", path.string());
+    FILE* fileNew = fopen(pathTmp.string().c_str(), "w+b");
+    if (!fileNew) {
+        fclose(fileOld);
+        return error("CLogDB::Compact : can't create %s", pathTmp.string());
+    }
+    CLogDB logNew;
+    LOCK(logNew.cs);
+    logNew.path = pathTmp;
+    logNew.file = fileNew;
+    logNew.nLogId = GetRand(std::numeric_limits<uint64_t>::max());
+    unsigned char header[LOG_HEADER_SIZE];
+    WriteLogHeader(header, logNew.nLogId);
+    bool fSuccess = fwrite(header, 1, sizeof(header), fileNew) == sizeof(header);
+    logNew.nFileSize = LOG_HEADER_SIZE;
+
+    CLogDBTxn txn;
+    size_t nTxnSize = 0;
+    for (IndexMap::const_iterator it = mapSnapshot.begin(); fSuccess && it != mapSnapshot.end(); ++it) {
+        CSerializeData value;
+        if (!ReadLogValue(fileOld, it->second.nPos, it->second.nSize, value)) {
+            fSuccess = error("CLogDB::Compact : can't read from %s", path.string());
+            break;
+        }
+        txn.Write(it->first, value);
+        nTxnSize += it->first.size() + value.size();
+        if (nTxnSize >= COMPACT_FRAME_SIZE) {
+            fSuccess = logNew.AppendFrame(txn.mapWrites);
+            txn.mapWrites.clear();
+            nTxnSize = 0;
+        }
+    }
+    if (fSuccess)
+        fSuccess = logNew.AppendFrame(txn.mapWrites);
+    fclose(fileOld);
+
+    // Bring over the frames written meanwhile and swap the new log in
+    LOCK(cs);
+    if (fSuccess && (!file || nLogId != nSnapshotLogId))
+        fSuccess = error("CLogDB::Compact : %s changed under the compaction", path.string());
+    if (fSuccess && nFileSize > nSnapshotSize) {
+        uint64_t nTail = logNew.nFileSize;
+        fSuccess = fflush(file) == 0 && SeekLog(fileNew, nTail) == 0 &&
+                   CopyLogRange(file, fileNew, nSnapshotSize, nFileSize) &&
+                   fflush(fileNew) == 0 && logNew.Replay(nTail);
+    }
+    if (fSuccess)
+        FileCommit(fileNew);
+    fclose(fileNew);
+    logNew.file = NULL;
+    if (!fSuccess) {
+        boost::filesystem::remove(pathTmp);
+        return error("CLogDB::Compact : failed to write %s", pathTmp.string());
+    }
+
+    // The old index no longer matches, as the log id changed
+    uint64_t nOldSize = nFileSize;
+    fclose(file);
+    file = NULL;
+    if (!RenameOver(pathTmp, path)) {
+        file = fopen(path.string().c_str(), "r+b");
+        return error("CLogDB::Compact : can't rename %s", pathTmp.string());
+    }
+    file = fopen(path.string().c_str(), "r+b");
+    if (!file)
+        return error("CLogDB::Compact : can't reopen %s", path.string());
+    mapIndex.swap(logNew.mapIndex);
+    nLogId = logNew.nLogId;
+    nLiveSize = logNew.nLiveSize;
+    nFileSize = nSynced = logNew.nFileSize;
+    WriteIndex();
+    LogPrintf("CLogDB::Compact : %s from %d to %d bytes in %dms, %d bytes of them written meanwhile\n", path.string(), nOldSize, nFileSize, GetTimeMillis() - nStart, nOldSize - nSnapshotSize);
+    return true;
+}
+
+bool CLogDB::Backup(const boost::filesystem::path& pathDest)
+{
+    LOCK(cs);
+    if (!file)
+        return false;
+    if (fflush(file) != 0)
+        return false;
+
+    // An older copy of this log has the same id and all its bytes match
+    // ours. Check the header and the last few bytes, then append the rest
+    uint64_t nDestSize = 0;
+    FILE* fileDest = fopen(pathDest.string().c_str(), "r+b");
+    if (fileDest) {
+        uint64_t nSize = boost::filesystem::file_size(pathDest);
+        unsigned char headerOurs[LOG_HEADER_SIZE];
+        unsigned char headerDest[LOG_HEADER_SIZE];
+        WriteLogHeader(headerOurs, nLogId);
+        if (nSize >= LOG_HEADER_SIZE && nSize <= nFileSize &&
+            fread(headerDest, 1, sizeof(headerDest), fileDest) == sizeof(headerDest) &&
+            memcmp(headerOurs, headerDest, sizeof(headerOurs)) == 0) {
+            size_t nTail = (size_t)std::min<uint64_t>(4096, nSize - LOG_HEADER_SIZE);
+            std::vector<char> vOurs(nTail), vDest(nTail);
+            if (nTail == 0 ||
+                (SeekLog(fileDest, nSize - nTail) == 0 && fread(&vDest[0], 1, nTail, fileDest) == nTail &&
+                 SeekLog(file, nSize - nTail) == 0 && fread(&vOurs[0], 1, nTail, file) == nTail &&
+                 vOurs == vDest))
+                nDestSize = nSize;
+        }
+        if (nDestSize == 0) {
+            fclose(fileDest);
+            fileDest = NULL;
+        }
+    }
+    if (!fileDest)
+        fileDest = fopen(pathDest.string().c_str(), "wb");
+    if (!fileDest)
+        return error("CLogDB::Backup : can't write %s", pathDest.string());
+
+    bool fSuccess = SeekLog(fileDest, nDestSize) == 0 && CopyLogRange(file, fileDest, nDestSize, nFileSize);
+    if (fSuccess)
+        FileCommit(fileDest);
+    fclose(fileDest);
+    if (!fSuccess)
+        return error("CLogDB::Backup : failed to copy %s to %s", path.string(), pathDest.string());
+    LogPrint("db", "CLogDB::Backup : %s %s, %d bytes\n", nDestSize ? "appended to" : "wrote", pathDest.string(), nFileSize - nDestSize);
+    return true;
+}
+
+size_t CLogDB::GetCount()
+{
+    LOCK(cs);
+    return mapIndex.size();
+}
+
+uint64_t CLogDB::GetFileSize()
+{
+    LOCK(cs);
+    return nFileSize;
+}
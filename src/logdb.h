@@ -0,0 +1,156 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_LOGDB_H
+#define BITCOIN_LOGDB_H
+
+#include "allocators.h"
+#include "serialize.h"
+#include "sync.h"
+
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+//! Don't compact logs smaller than this, however much of them is dead
+static const uint64_t LOGDB_MIN_COMPACT_SIZE = 1 << 20;
+
+/** Puts and erases made through a CLogDB together, which reach the log as one frame */
+class CLogDBTxn
+{
+public:
+    void Write(const std::string& key, const CSerializeData& value);
+    void Erase(const std::string& key);
+    /** Whether the transaction writes key; if so, fErased or value say how */
+    bool Find(const std::string& key, bool& fErased, CSerializeData& value) const;
+    /** Move key to the first key the transaction writes after it, or at it if fInclusive */
+    bool Next(std::string& key, bool fInclusive) const;
+    /** Add the keys the transaction writes to setKeys */
+    void GetKeys(std::set<std::string>& setKeys) const;
+    /** Take over the writes of txn, as if they were made after ours */
+    void Merge(const CLogDBTxn& txn);
+    bool IsEmpty() const { return mapWrites.empty(); }
+
+private:
+    //! The last write of each key: whether it erases it, else its value
+    std::map<std::string, std::pair<bool, CSerializeData> > mapWrites;
+
+    friend class CLogDB;
+};
+
+/**
+ * A key-value store kept as an append-only log of checksummed frames, each a
+ * group of puts and erases that commits as a whole. An index in memory maps
+ * every live key to where its value sits in the log, so values are only read
+ * when asked for and a wallet loads with one sequential pass. Flush() saves
+ * the index next to the log, so that opening only replays the frames written
+ * after it, and compacts the log once most of it is dead. Since the log only
+ * grows between compactions, Backup() brings an older copy up to date by
+ * appending what it lacks.
+ *
+ * Opening drops a frame that a crash left unfinished at the end of the log.
+ * A bad frame with whole frames after it is damage instead, and fails the open
+ * without touching the file.
+ *
+ * Keys order as unsigned bytes, like BerkeleyDB's btree. Thread safe.
+ */
+class CLogDB
+{
+public:
+    CLogDB();
+    ~CLogDB();
+
+    /** Open the log at pathIn, creating it if fCreate, and load its index */
+    bool Open(const boost::filesystem::path& pathIn, bool fCreate);
+    /** Write everything through and save the index */
+    void Close();
+
+    bool Read(const std::string& key, CSerializeData& value);
+    bool Exists(const std::string& key);
+    bool Write(const std::string& key, const CSerializeData& value);
+    bool Erase(const std::string& key);
+    bool Commit(const CLogDBTxn& txn);
+
+    /**
+     * Find the first key after key, or at it if fInclusive, and read its
+     * value. Returns false past the last key.
+     */
+    bool Next(std::string& key, CSerializeData& value, bool fInclusive);
+    /** The live keys in the order of their values in the log, to read a whole file in one pass */
+    void GetKeysInLogOrder(std::vector<std::string>& vKeys);
+
+    /** Write the log through to disk and save the index; compact if most of it is dead */
+    bool Flush();
+    /**
+     * Rewrite the log with only its live records, dropping keys that start with
+     * strSkip. Reads and writes carry on meanwhile: the records are copied from a
+     * snapshot of the index, and cs is only held to take it and to swap the logs.
+     */
+    bool Compact(const std::string& strSkip = "");
+    /** Make pathDest a copy of the log, appending only what it lacks if it is an older copy */
+    bool Backup(const boost::filesystem::path& pathDest);
+    /**
+     * Read the live records of a damaged log at pathIn into vResult, skipping
+     * the bytes between its whole frames. Returns false if it isn't a log.
+     * NOTE: reads the entire log into memory.
+     */
+    static bool Salvage(const boost::filesystem::path& pathIn, std::vector<std::pair<std::string, CSerializeData> >& vResult);
+    /** Whether the file at path starts like a log, e.g. a backup of one */
+    static bool IsLog(const boost::filesystem::path& path);
+
+    size_t GetCount();
+    uint64_t GetFileSize();
+
+private:
+    /** Where a live value sits in the log */
+    struct CValuePos {
+        uint64_t nPos;
+        uint32_t nSize;
+
+        CValuePos() : nPos(0), nSize(0) {}
+        CValuePos(uint64_t nPosIn, uint32_t nSizeIn) : nPos(nPosIn), nSize(nSizeIn) {}
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+        {
+            READWRITE(nPos);
+            READWRITE(nSize);
+        }
+    };
+    typedef std::map<std::string, CValuePos> IndexMap;
+
+    CCriticalSection cs;
+    //! Held for a whole compaction, before cs, so only one runs at a time
+    CCriticalSection csCompact;
+    boost::filesystem::path path;
+    FILE* file;
+    uint64_t nLogId;    // random, and new after each compaction, to tell copies of this log apart
+    uint64_t nFileSize; // the end of the last whole frame
+    uint64_t nLiveSize; // the bytes of keys and values still in the index
+    uint64_t nSynced;   // how much of the log has been written through
+    uint64_t nIndexed;  // how much of the log the saved index covers
+    IndexMap mapIndex;
+
+    bool AppendFrame(const std::map<std::string, std::pair<bool, CSerializeData> >& mapWrites);
+    bool Replay(uint64_t nPos);
+    /** Whether a whole, valid frame starts somewhere after the bad one at nPos */
+    bool FrameFollows(uint64_t nPos, uint64_t nEnd);
+    bool ReadValue(const CValuePos& pos, CSerializeData& value);
+    bool ReadIndex();
+    bool WriteIndex();
+    void IndexPut(const std::string& key, const CValuePos& pos);
+    void IndexErase(const std::string& key);
+    bool IsCompactionDue();
+    bool CompactSnapshot(const std::string& strSkip, bool fIfDue);
+};
+
+#endif // BITCOIN_LOGDB_H
@@ -10,8 +10,10 @@
 
 #include "accumulators.h"
 #include "accumulatormap.h"
+#include "addressindex.h"
 #include "addrman.h"
 #include "alert.h"
+#include "blockfilter.h"
 #include "blocksignature.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -35,17 +37,20 @@
 #include "utilmoneystr.h"
 #include "validationinterface.h"
 #include "zuserxchain.h"
+#include "zuserxspendcache.h"
 
 #include "primitives/zerocoin.h"
 #include "libzerocoin/Denominations.h"
 #include "invalid.h"
 
+#include <atomic>
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/thread.hpp>
 
 using namespace boost;
@@ -75,6 +80,9 @@ int nScriptCheckThreads = 0;
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = true;
+bool fAddressIndex = DEFAULT_ADDRESSINDEX;
+bool fSpentIndex = DEFAULT_SPENTINDEX;
+bool fTimestampIndex = DEFAULT_TIMESTAMPINDEX;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
 bool fVerifyingBlocks = false;
@@ -531,10 +539,19 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
     return chain.Genesis();
 }
 
+CBlockIndex* LookupBlockIndex(const uint256& hash)
+{
+    LOCK(cs_main);
+    BlockMap::iterator mi = mapBlockIndex.find(hash);
+    return mi == mapBlockIndex.end() ? NULL : mi->second;
+}
+
 CCoinsViewCache* pcoinsTip = NULL;
 CBlockTreeDB* pblocktree = NULL;
 CZerocoinDB* zerocoinDB = NULL;
 CSporkDB* pSporkDB = NULL;
+CBlockFilterDB* pblockfilterdb = NULL;
+CUTXOStatsDB* putxostatsdb = NULL;
 
 //////////////////////////////////////////////////////////////////////////////
 //
@@ -940,7 +957,7 @@ bool ContextualCheckZerocoinMint(const CTransaction& tx, const PublicCoin& coin,
         //See if this coin has already been added to the blockchain
         uint256 txid;
         int nHeight;
-        if (zerocoinDB->ReadCoinMint(coin.getValue(), txid) && IsTransactionInChain(txid, nHeight))
+        if (zerocoinDB->ReadCoinMint(coin.getValue(), txid) && IsZerocoinTxInChain(txid, nHeight))
             return error("%s: pubcoin %s was already accumulated in tx %s", __func__,
                          coin.getValue().GetHex().substr(0, 10),
                          txid.GetHex());
@@ -981,7 +998,7 @@ bool ContextualCheckZerocoinSpend(const CTransaction& tx, const CoinSpend& spend
     return true;
 }
 
-bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state)
+bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state, bool fCacheStore)
 {
     //max needed non-mint outputs should be 2 - one for redemption address and a possible 2nd for change
     if (tx.vout.size() > 2) {
@@ -1004,16 +1021,16 @@ bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidati
 
     bool fValidated = false;
     set<CBigNum> serials;
-    list<CoinSpend> vSpends;
     CAmount nTotalRedeemed = 0;
-    for (const CTxIn& txin : tx.vin) {
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        const CTxIn& txin = tx.vin[i];
 
         //only check txin that is a zcspend
         if (!txin.scriptSig.IsZerocoinSpend())
             continue;
 
-        CoinSpend newSpend = TxInToZerocoinSpend(txin);
-        vSpends.push_back(newSpend);
+        CoinSpendRef spendRef = TxInToZerocoinSpendRef(tx, i);
+        const CoinSpend& newSpend = *spendRef;
 
         //check that the denomination is valid
         if (newSpend.getDenomination() == ZQ_ERROR)
@@ -1029,19 +1046,26 @@ bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidati
 
         // Skip signature verification during initial block download
         if (fVerifySignature) {
-            //see if we have record of the accumulator used in the spend tx
-            CBigNum bnAccumulatorValue = 0;
-            if (!zerocoinDB->ReadAccumulatorValue(newSpend.getAccumulatorChecksum(), bnAccumulatorValue)) {
-                uint32_t nChecksum = newSpend.getAccumulatorChecksum();
-                return state.DoS(100, error("%s: Zerocoinspend could not find accumulator associated with checksum %s", __func__, HexStr(BEGIN(nChecksum), END(nChecksum))));
-            }
+            bool fUseV1Params = chainActive.Height() < Params().Zerocoin_Block_V2_Start();
+            uint32_t nChecksum = newSpend.getAccumulatorChecksum();
+
+            // Spends already proven when accepted to the mempool do not need to be proven again
+            // when checked as part of a block, so they are only kept until the next cache insert
+            if (!IsZerocoinSpendVerified(txin, nChecksum, hashTxOut, fUseV1Params, !fCacheStore)) {
+                //see if we have record of the accumulator used in the spend tx
+                CBigNum bnAccumulatorValue = 0;
+                if (!zerocoinDB->ReadAccumulatorValue(nChecksum, bnAccumulatorValue))
+                    return state.DoS(100, error("%s: Zerocoinspend could not find accumulator associated with checksum %s", __func__, HexStr(BEGIN(nChecksum), END(nChecksum))));
 
-            Accumulator accumulator(Params().Zerocoin_Params(chainActive.Height() < Params().Zerocoin_Block_V2_Start()),
-                                    newSpend.getDenomination(), bnAccumulatorValue);
+                Accumulator accumulator(Params().Zerocoin_Params(fUseV1Params), newSpend.getDenomination(), bnAccumulatorValue);
 
-            //Check that the coin has been accumulated
-            if(!newSpend.Verify(accumulator))
-                    return state.DoS(100, error("CheckZerocoinSpend(): zerocoin spend did not verify"));
+                //Check that the coin has been accumulated
+                if(!newSpend.Verify(accumulator))
+                        return state.DoS(100, error("CheckZerocoinSpend(): zerocoin spend did not verify"));
+
+                if (fCacheStore)
+                    SetZerocoinSpendVerified(txin, nChecksum, hashTxOut, fUseV1Params);
+            }
         }
 
         if (serials.count(newSpend.getCoinSerialNumber()))
@@ -1061,7 +1085,7 @@ bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidati
     return fValidated;
 }
 
-bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state)
+bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state, bool fCacheStore)
 {
     // Basic checks that don't depend on any context
     if (tx.vin.empty())
@@ -1117,7 +1141,7 @@ bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fReject
 
             // Do not require signature verification if this is initial sync and a block over 24 hours old
             bool fVerifySignature = !IsInitialBlockDownload() && (GetTime() - chainActive.Tip()->GetBlockTime() < (60*60*24));
-            if (!CheckZerocoinSpend(tx, fVerifySignature, state))
+            if (!CheckZerocoinSpend(tx, fVerifySignature, state, fCacheStore))
                 return state.DoS(100, error("CheckTransaction() : invalid zerocoin spend"));
         }
     }
@@ -1221,7 +1245,7 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
     if (GetAdjustedTime() > GetSporkValue(SPORK_16_ZEROCOIN_MAINTENANCE_MODE) && tx.ContainsZerocoins())
         return state.DoS(10, error("AcceptToMemoryPool : Zerocoin transactions are temporarily disabled for maintenance"), REJECT_INVALID, "bad-tx");
 
-    if (!CheckTransaction(tx, chainActive.Height() >= Params().Zerocoin_StartHeight(), true, state))
+    if (!CheckTransaction(tx, chainActive.Height() >= Params().Zerocoin_StartHeight(), true, state, true))
         return state.DoS(100, error("AcceptToMemoryPool: : CheckTransaction failed"), REJECT_INVALID, "bad-tx");
 
     // Coinbase is only valid in a block, not as a loose transaction
@@ -1282,16 +1306,16 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 
             //Check that txid is not already in the chain
             int nHeightTx = 0;
-            if (IsTransactionInChain(tx.GetHash(), nHeightTx))
+            if (IsZerocoinTxInChain(tx.GetHash(), nHeightTx))
                 return state.Invalid(error("AcceptToMemoryPool : zUSERX spend tx %s already in block %d",
                                            tx.GetHash().GetHex(), nHeightTx), REJECT_DUPLICATE, "bad-txns-inputs-spent");
 
             //Check for double spending of serial #'s
-            for (const CTxIn& txIn : tx.vin) {
-                if (!txIn.scriptSig.IsZerocoinSpend())
+            for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                if (!tx.vin[i].scriptSig.IsZerocoinSpend())
                     continue;
-                CoinSpend spend = TxInToZerocoinSpend(txIn);
-                if (!ContextualCheckZerocoinSpend(tx, spend, chainActive.Tip(), 0))
+                CoinSpendRef spend = TxInToZerocoinSpendRef(tx, i);
+                if (!ContextualCheckZerocoinSpend(tx, *spend, chainActive.Tip(), 0))
                     return state.Invalid(error("%s: ContextualCheckZerocoinSpend failed for tx %s", __func__,
                                                tx.GetHash().GetHex()), REJECT_INVALID, "bad-txns-invalid-zuserx");
             }
@@ -1450,7 +1474,7 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
         pool.addUnchecked(hash, entry);
     }
 
-    SyncWithWallets(tx, NULL);
+    SyncWithWallets(tx);
 
     //Track zerocoinspends and ensure that they are given priority to make it into the blockchain
     if (tx.IsZerocoinSpend())
@@ -1466,7 +1490,7 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
         *pfMissingInputs = false;
 
 
-    if (!CheckTransaction(tx, chainActive.Height() >= Params().Zerocoin_StartHeight(), true, state))
+    if (!CheckTransaction(tx, chainActive.Height() >= Params().Zerocoin_StartHeight(), true, state, true))
         return error("AcceptableInputs: : CheckTransaction failed");
 
     // Coinbase is only valid in a block, not as a loose transaction
@@ -1662,49 +1686,46 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
 bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock, bool fAllowSlow)
 {
     CBlockIndex* pindexSlow = NULL;
-    {
-        LOCK(cs_main);
-        {
-            if (mempool.lookup(hash, txOut)) {
-                return true;
-            }
-        }
+    // The mempool and the block tree database lock themselves, and block files
+    // are only appended to, so cs_main is needed for the slow path only
+    if (mempool.lookup(hash, txOut))
+        return true;
 
-        if (fTxIndex) {
-            CDiskTxPos postx;
-            if (pblocktree->ReadTxIndex(hash, postx)) {
-                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-                if (file.IsNull())
-                    return error("%s: OpenBlockFile failed", __func__);
-                CBlockHeader header;
-                try {
-                    file >> header;
-                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                    file >> txOut;
-                } catch (std::exception& e) {
-                    return error("%s : Deserialize or I/O error - %s", __func__, e.what());
-                }
-                hashBlock = header.GetHash();
-                if (txOut.GetHash() != hash)
-                    return error("%s : txid mismatch", __func__);
-                return true;
+    if (fTxIndex) {
+        CDiskTxPos postx;
+        if (pblocktree->ReadTxIndex(hash, postx)) {
+            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+            if (file.IsNull())
+                return error("%s: OpenBlockFile failed", __func__);
+            CBlockHeader header;
+            try {
+                file >> header;
+                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+                file >> txOut;
+            } catch (std::exception& e) {
+                return error("%s : Deserialize or I/O error - %s", __func__, e.what());
             }
-
-            // transaction not found in the index, nothing more can be done
-            return false;
+            hashBlock = header.GetHash();
+            if (txOut.GetHash() != hash)
+                return error("%s : txid mismatch", __func__);
+            return true;
         }
 
-        if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
-            int nHeight = -1;
-            {
-                CCoinsViewCache& view = *pcoinsTip;
-                const CCoins* coins = view.AccessCoins(hash);
-                if (coins)
-                    nHeight = coins->nHeight;
-            }
-            if (nHeight > 0)
-                pindexSlow = chainActive[nHeight];
+        // transaction not found in the index, nothing more can be done
+        return false;
+    }
+
+    if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
+        LOCK(cs_main);
+        int nHeight = -1;
+        {
+            CCoinsViewCache& view = *pcoinsTip;
+            const CCoins* coins = view.AccessCoins(hash);
+            if (coins)
+                nHeight = coins->nHeight;
         }
+        if (nHeight > 0)
+            pindexSlow = chainActive[nHeight];
     }
 
     if (pindexSlow) {
@@ -1750,7 +1771,8 @@ bool WriteBlockToDisk(CBlock& block, CDiskBlockPos& pos)
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
+/** Read a block and check its header, handing back the hash it was checked with */
+static bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, uint256& hashBlock)
 {
     block.SetNull();
 
@@ -1767,20 +1789,28 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
     }
 
     // Check the header
+    hashBlock = block.GetHash();
     if (block.IsProofOfWork()) {
-        if (!CheckProofOfWork(block.GetHash(), block.nBits))
+        if (!CheckProofOfWork(hashBlock, block.nBits))
             return error("ReadBlockFromDisk : Errors in block header");
     }
 
     return true;
 }
 
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
+{
+    uint256 hashBlock;
+    return ReadBlockFromDisk(block, pos, hashBlock);
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex)
 {
-    if (!ReadBlockFromDisk(block, pindex->GetBlockPos()))
+    uint256 hashBlock;
+    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), hashBlock))
         return false;
-    if (block.GetHash() != pindex->GetBlockHash()) {
-        LogPrintf("%s : block=%s index=%s\n", __func__, block.GetHash().ToString().c_str(), pindex->GetBlockHash().ToString().c_str());
+    if (hashBlock != pindex->GetBlockHash()) {
+        LogPrintf("%s : block=%s index=%s\n", __func__, hashBlock.ToString().c_str(), pindex->GetBlockHash().ToString().c_str());
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*) : GetHash() doesn't match index");
     }
     return true;
@@ -2213,6 +2243,237 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
     return true;
 }
 
+bool GetIndexAddress(const CScript& script, unsigned char& nAddressType, uint160& hashBytes)
+{
+    if (script.IsZerocoinMint())
+        return false;
+
+    CTxDestination dest;
+    if (!ExtractDestination(script, dest))
+        return false;
+
+    if (const CKeyID* keyID = boost::get<CKeyID>(&dest)) {
+        nAddressType = ADDRESS_INDEX_PUBKEYHASH;
+        hashBytes = *keyID;
+    } else if (const CScriptID* scriptID = boost::get<CScriptID>(&dest)) {
+        nAddressType = ADDRESS_INDEX_SCRIPTHASH;
+        hashBytes = *scriptID;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool GetAddressIndex(unsigned char nAddressType, const uint160& hashBytes, std::vector<std::pair<CAddressIndexKey, CAmount> >& vAddressIndex, int nStart, int nEnd)
+{
+    return fAddressIndex && pblocktree->ReadAddressIndex(nAddressType, hashBytes, vAddressIndex, nStart, nEnd);
+}
+
+bool GetAddressUnspent(unsigned char nAddressType, const uint160& hashBytes, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vUnspentOutputs)
+{
+    return fAddressIndex && pblocktree->ReadAddressUnspentIndex(nAddressType, hashBytes, vUnspentOutputs);
+}
+
+bool GetSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value)
+{
+    return fSpentIndex && pblocktree->ReadSpentIndex(key, value);
+}
+
+bool GetTimestampIndex(unsigned int nHigh, unsigned int nLow, std::vector<uint256>& vHashes)
+{
+    return fTimestampIndex && pblocktree->ReadTimestampIndex(nHigh, nLow, vHashes);
+}
+
+namespace {
+
+/** Explorer index records of one block, see GetBlockExplorerIndexes */
+struct CBlockExplorerIndexes {
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vAddressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vAddressUnspentIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > vSpentIndex;
+};
+
+/**
+ * Collect the address and spent index records of a block from the block and its undo data, for the
+ * indexes that are enabled. When disconnecting, the unspent and spent updates undo those of connecting
+ * in reverse order, and view must already hold the restored inputs so that their heights are known.
+ * Zerocoin spends have no prevouts and zerocoin mints pay no address, so neither is indexed; the
+ * transparent inputs that fund a mint and the outputs of a spend are.
+ */
+void GetBlockExplorerIndexes(const CBlock& block, const CBlockUndo& blockundo, int nHeight, const CCoinsViewCache& view, bool fConnect, CBlockExplorerIndexes& indexes)
+{
+    for (unsigned int n = 0; n < block.vtx.size(); n++) {
+        const unsigned int i = fConnect ? n : block.vtx.size() - 1 - n;
+        const CTransaction& tx = block.vtx[i];
+        const uint256 txhash = tx.GetHash();
+
+        auto outputs = [&]() {
+            if (!fAddressIndex)
+                return;
+            for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                const CTxOut& out = tx.vout[k];
+                unsigned char nAddressType;
+                uint160 hashBytes;
+                if (!GetIndexAddress(out.scriptPubKey, nAddressType, hashBytes))
+                    continue;
+
+                indexes.vAddressIndex.push_back(make_pair(CAddressIndexKey(nAddressType, hashBytes, nHeight, i, txhash, k, false), out.nValue));
+                indexes.vAddressUnspentIndex.push_back(make_pair(CAddressUnspentKey(nAddressType, hashBytes, txhash, k),
+                    fConnect ? CAddressUnspentValue(out.nValue, out.scriptPubKey, nHeight) : CAddressUnspentValue()));
+            }
+        };
+
+        auto inputs = [&]() {
+            if (tx.IsCoinBase() || i == 0 || blockundo.vtxundo[i - 1].vprevout.size() != tx.vin.size())
+                return;
+            const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+            for (unsigned int k = 0; k < tx.vin.size(); k++) {
+                const COutPoint& prevout = tx.vin[k].prevout;
+                const CTxInUndo& undo = txundo.vprevout[k];
+                unsigned char nAddressType = ADDRESS_INDEX_NONE;
+                uint160 hashBytes = 0;
+                bool fAddress = GetIndexAddress(undo.txout.scriptPubKey, nAddressType, hashBytes);
+
+                if (fAddressIndex && fAddress) {
+                    indexes.vAddressIndex.push_back(make_pair(CAddressIndexKey(nAddressType, hashBytes, nHeight, i, txhash, k, true), -undo.txout.nValue));
+
+                    CAddressUnspentValue value;
+                    if (!fConnect) {
+                        // The undo data only records the height when the last output of a transaction is spent
+                        int nPrevHeight = undo.nHeight;
+                        const CCoins* coins = nPrevHeight == 0 ? view.AccessCoins(prevout.hash) : NULL;
+                        if (coins)
+                            nPrevHeight = coins->nHeight;
+                        value = CAddressUnspentValue(undo.txout.nValue, undo.txout.scriptPubKey, nPrevHeight);
+                    }
+                    indexes.vAddressUnspentIndex.push_back(make_pair(CAddressUnspentKey(nAddressType, hashBytes, prevout.hash, prevout.n), value));
+                }
+
+                if (fSpentIndex) {
+                    indexes.vSpentIndex.push_back(make_pair(CSpentIndexKey(prevout.hash, prevout.n),
+                        fConnect ? CSpentIndexValue(txhash, k, nHeight, undo.txout.nValue, nAddressType, hashBytes) : CSpentIndexValue()));
+                }
+            }
+        };
+
+        if (fConnect) {
+            inputs();
+            outputs();
+        } else {
+            outputs();
+            inputs();
+        }
+    }
+}
+
+} // anon namespace
+
+bool UpdateBlockExplorerIndexes(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, const CCoinsViewCache& view, bool fConnect)
+{
+    if (fAddressIndex || fSpentIndex) {
+        CBlockExplorerIndexes indexes;
+        GetBlockExplorerIndexes(block, blockundo, pindex->nHeight, view, fConnect, indexes);
+        if (fAddressIndex) {
+            bool fWritten = fConnect ? pblocktree->WriteAddressIndex(indexes.vAddressIndex) : pblocktree->EraseAddressIndex(indexes.vAddressIndex);
+            if (!fWritten || !pblocktree->UpdateAddressUnspentIndex(indexes.vAddressUnspentIndex))
+                return error("%s : failed to update address index", __func__);
+        }
+        if (fSpentIndex && !pblocktree->UpdateSpentIndex(indexes.vSpentIndex))
+            return error("%s : failed to update spent index", __func__);
+    }
+    if (fTimestampIndex) {
+        CTimestampIndexKey key(pindex->nTime, pindex->GetBlockHash());
+        if (!(fConnect ? pblocktree->WriteTimestampIndex(key) : pblocktree->EraseTimestampIndex(key)))
+            return error("%s : failed to update timestamp index", __func__);
+    }
+    return true;
+}
+
+/** Where the UTXO stats index is; an index that was never written starts from the empty set at genesis */
+static CUTXOStatsState GetUTXOStatsState()
+{
+    CUTXOStatsState state;
+    if (!putxostatsdb->ReadState(state))
+        state.hashBlock = Params().HashGenesisBlock();
+    return state;
+}
+
+/**
+ * Move the UTXO stats index across pindex, forwards or backwards. Nothing is
+ * done unless the index is at pindex's parent (connect) or at pindex
+ * (disconnect); ThreadUTXOStatsIndex catches up with the rest.
+ */
+static bool UpdateUTXOStatsIndex(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, bool fConnect)
+{
+    AssertLockHeld(cs_main);
+    CUTXOStatsState state = GetUTXOStatsState();
+    if (state.hashBlock != (fConnect ? pindex->pprev->GetBlockHash() : pindex->GetBlockHash()))
+        return true;
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s : block and undo data inconsistent", __func__);
+
+    MuHash3072 added, removed;
+    int64_t nOutputsDelta = 0;
+    CAmount nAmountDelta = 0;
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = block.vtx[i];
+        const uint256& txid = tx.GetHash();
+        for (unsigned int j = 0; j < tx.vout.size(); j++) {
+            const CTxOut& out = tx.vout[j];
+            if (out.scriptPubKey.IsUnspendable())
+                continue;
+            std::vector<unsigned char> vElement = UTXOSetHashElement(COutPoint(txid, j), out);
+            added.Insert(&vElement[0], vElement.size());
+            nOutputsDelta++;
+            nAmountDelta += out.nValue;
+        }
+        if (tx.IsCoinBase() || tx.IsZerocoinSpend())
+            continue;
+        const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+        if (txundo.vprevout.size() != tx.vin.size())
+            return error("%s : transaction and undo data inconsistent", __func__);
+        for (unsigned int j = 0; j < tx.vin.size(); j++) {
+            const CTxOut& out = txundo.vprevout[j].txout;
+            std::vector<unsigned char> vElement = UTXOSetHashElement(tx.vin[j].prevout, out);
+            removed.Insert(&vElement[0], vElement.size());
+            nOutputsDelta--;
+            nAmountDelta -= out.nValue;
+        }
+    }
+
+    if (fConnect) {
+        state.muhash *= added;
+        state.muhash /= removed;
+        state.hashBlock = pindex->GetBlockHash();
+        state.stats.nHeight = pindex->nHeight;
+    } else {
+        state.muhash *= removed;
+        state.muhash /= added;
+        nOutputsDelta = -nOutputsDelta;
+        nAmountDelta = -nAmountDelta;
+        state.hashBlock = pindex->pprev->GetBlockHash();
+        state.stats.nHeight = pindex->pprev->nHeight;
+    }
+    state.stats.nTransactionOutputs += nOutputsDelta;
+    state.stats.nTotalAmount += nAmountDelta;
+    state.muhash.Finalize(state.stats.hashMuHash.begin());
+    return putxostatsdb->WriteState(state);
+}
+
+/**
+ * Write pindex's block filter. The index's best block moves along with it
+ * only if it is at pindex's parent; ThreadBlockFilterIndex catches up with
+ * the rest.
+ */
+static bool WriteBlockFilter(const CBlockFilter& filter, const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    uint256 hashParent = pindex->pprev ? pindex->pprev->GetBlockHash() : uint256(0);
+    return pblockfilterdb->WriteFilter(pindex->GetBlockHash(), filter, pblockfilterdb->ReadBestBlock() == hashParent);
+}
+
+static bool EraseTxLocations(const CBlock& block, const CBlockIndex* pindex);
+
 bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean)
 {
     if (pindex->GetBlockHash() != view.GetBestBlock())
@@ -2251,12 +2512,17 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
                         if (!zerocoinDB->EraseCoinSpend(spend.getCoinSerialNumber()))
                             return error("failed to erase spent zerocoin in block");
 
-                        //if this was our spend, then mark it unspent now
+                        //if this was our spend, then mark it unspent now. This queues behind the
+                        //notifications of the connect that spent it, which would mark it spent again
                         if (pwalletMain) {
-                            if (pwalletMain->IsMyZerocoinSpend(spend.getCoinSerialNumber())) {
-                                if (!pwalletMain->SetMintUnspent(spend.getCoinSerialNumber()))
-                                    LogPrintf("%s: failed to automatically reset mint", __func__);
-                            }
+                            CBigNum bnSerial = spend.getCoinSerialNumber();
+                            CallFunctionInValidationInterfaceQueue([bnSerial]() {
+                                LOCK2(cs_main, pwalletMain->cs_wallet);
+                                if (pwalletMain->IsMyZerocoinSpend(bnSerial)) {
+                                    if (!pwalletMain->SetMintUnspent(bnSerial))
+                                        LogPrintf("DisconnectBlock: failed to automatically reset mint");
+                                }
+                            });
                         }
                     }
 
@@ -2343,6 +2609,17 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
             if(!EraseAccumulatorValues(nCheckpoint, pindex->pprev->nAccumulatorCheckpoint))
                 return error("DisconnectBlock(): failed to erase checkpoint");
         }
+
+        if (!EraseTxLocations(block, pindex))
+            return error("DisconnectBlock(): failed to erase transaction locations");
+        if (!UpdateBlockExplorerIndexes(block, blockUndo, pindex, view, false))
+            return error("DisconnectBlock(): failed to update explorer indexes");
+        if (putxostatsdb && !UpdateUTXOStatsIndex(block, blockUndo, pindex, false))
+            return error("DisconnectBlock(): failed to update UTXO stats index");
+        // Filters are kept by block hash, only the best block steps back
+        if (pblockfilterdb && pblockfilterdb->ReadBestBlock() == pindex->GetBlockHash() &&
+            !pblockfilterdb->WriteBestBlock(pindex->pprev->GetBlockHash()))
+            return error("DisconnectBlock(): failed to update block filter index");
     }
 
     if (pfClean) {
@@ -2386,66 +2663,284 @@ void ThreadScriptCheck()
     scriptcheckqueue.Thread();
 }
 
-void RecalculateZUSERXMinted()
+void ThreadBlockFilterIndex()
 {
-    CBlockIndex *pindex = chainActive[Params().Zerocoin_StartHeight()];
-    int nHeightEnd = chainActive.Height();
-    while (true) {
-        if (pindex->nHeight % 1000 == 0)
-            LogPrintf("%s : block %d...\n", __func__, pindex->nHeight);
+    RenameThread("userx-blkfilter");
 
-        //overwrite possibly wrong vMintsInBlock data
-        CBlock block;
-        assert(ReadBlockFromDisk(block, pindex));
+    // Resume after the index's best block, or where its chain left the active one
+    int nHeight = 0;
+    {
+        LOCK(cs_main);
+        uint256 hashBest = pblockfilterdb->ReadBestBlock();
+        BlockMap::iterator mi = mapBlockIndex.find(hashBest);
+        if (hashBest != 0 && mi != mapBlockIndex.end()) {
+            const CBlockIndex* pfork = chainActive.FindFork(mi->second);
+            if (pfork && pfork != mi->second && !pblockfilterdb->WriteBestBlock(pfork->GetBlockHash())) {
+                LogPrintf("%s : failed to write the best block, stopping\n", __func__);
+                return;
+            }
+            if (pfork)
+                nHeight = pfork->nHeight + 1;
+        }
+    }
 
-        std::list<CZerocoinMint> listMints;
-        BlockToZerocoinMintList(block, listMints, true);
+    // Once the index reaches the tip, ConnectBlock keeps it there
+    int nBuilt = 0;
+    for (; ; nHeight++) {
+        boost::this_thread::interruption_point();
 
-        vector<libzerocoin::CoinDenomination> vDenomsBefore = pindex->vMintDenominationsInBlock;
-        pindex->vMintDenominationsInBlock.clear();
-        for (auto mint : listMints)
-            pindex->vMintDenominationsInBlock.emplace_back(mint.GetDenomination());
+        CBlockIndex* pindex;
+        CDiskBlockPos posUndo;
+        uint256 hashPrev;
+        {
+            LOCK(cs_main);
+            pindex = chainActive[nHeight];
+            if (!pindex)
+                break;
+            if (pblockfilterdb->HaveFilter(pindex->GetBlockHash())) {
+                // Connected since the thread started, or before a reorg
+                if (pblockfilterdb->ReadBestBlock() == (pindex->pprev ? pindex->pprev->GetBlockHash() : uint256(0)) &&
+                    !pblockfilterdb->WriteBestBlock(pindex->GetBlockHash())) {
+                    LogPrintf("%s : failed to write the best block, stopping\n", __func__);
+                    break;
+                }
+                continue;
+            }
+            posUndo = pindex->GetUndoPos();
+            if (pindex->pprev)
+                hashPrev = pindex->pprev->GetBlockHash();
+        }
 
-        if (pindex->nHeight < nHeightEnd)
-            pindex = chainActive.Next(pindex);
-        else
+        CBlock block;
+        CBlockUndo blockundo;
+        if (!ReadBlockFromDisk(block, pindex) || (pindex->pprev && !blockundo.ReadFromDisk(posUndo, hashPrev))) {
+            LogPrintf("%s : failed to read block %s, stopping\n", __func__, pindex->GetBlockHash().ToString());
             break;
+        }
+        CBlockFilter filter(block, blockundo);
+        {
+            LOCK(cs_main);
+            if (!chainActive.Contains(pindex)) {
+                // Disconnected meanwhile, look at this height again
+                nHeight--;
+                continue;
+            }
+            if (!WriteBlockFilter(filter, pindex)) {
+                LogPrintf("%s : failed to write filter for block %s, stopping\n", __func__, pindex->GetBlockHash().ToString());
+                break;
+            }
+        }
+        if (++nBuilt % 10000 == 0)
+            LogPrintf("%s : built %d filters, at height %d\n", __func__, nBuilt, nHeight);
     }
+    LogPrintf("%s : built %d block filters\n", __func__, nBuilt);
 }
 
-void RecalculateZUSERXSpent()
+void ThreadUTXOStatsIndex()
 {
-    CBlockIndex* pindex = chainActive[Params().Zerocoin_StartHeight()];
+    RenameThread("userx-utxostats");
+
+    // Once the index reaches the tip, ConnectBlock and DisconnectBlock keep it there
+    int nApplied = 0;
     while (true) {
-        if (pindex->nHeight % 1000 == 0)
-            LogPrintf("%s : block %d...\n", __func__, pindex->nHeight);
+        boost::this_thread::interruption_point();
+
+        CBlockIndex* pindex;
+        bool fConnect;
+        {
+            LOCK(cs_main);
+            CUTXOStatsState state = GetUTXOStatsState();
+            BlockMap::iterator mi = mapBlockIndex.find(state.hashBlock);
+            if (mi == mapBlockIndex.end()) {
+                LogPrintf("%s : index is at unknown block %s, stopping\n", __func__, state.hashBlock.ToString());
+                break;
+            }
+            if (chainActive.Contains(mi->second)) {
+                // Forwards along the active chain
+                pindex = chainActive.Next(mi->second);
+                if (!pindex)
+                    break;
+                fConnect = true;
+            } else {
+                // Back off a branch that is no longer active
+                pindex = mi->second;
+                fConnect = false;
+            }
+        }
 
-        //Rewrite zUSERX supply
         CBlock block;
-        assert(ReadBlockFromDisk(block, pindex));
+        CBlockUndo blockundo;
+        if (!ReadBlockFromDisk(block, pindex) || !blockundo.ReadFromDisk(pindex->GetUndoPos(), pindex->pprev->GetBlockHash())) {
+            LogPrintf("%s : failed to read block %s, stopping\n", __func__, pindex->GetBlockHash().ToString());
+            break;
+        }
+        {
+            LOCK(cs_main);
+            if (!UpdateUTXOStatsIndex(block, blockundo, pindex, fConnect)) {
+                LogPrintf("%s : failed to update the index at block %s, stopping\n", __func__, pindex->GetBlockHash().ToString());
+                break;
+            }
+        }
+        if (++nApplied % 10000 == 0)
+            LogPrintf("%s : applied %d blocks, at height %d\n", __func__, nApplied, pindex->nHeight);
+    }
+    LogPrintf("%s : applied %d blocks\n", __func__, nApplied);
+}
+
+namespace {
+
+/** Heights handed to a recovery worker at a time; neighbouring heights sit next to each other in the blk/rev files */
+const size_t RECOVERY_CHUNK_BLOCKS = 256;
+/** Heights the recovery workers read ahead before the calling thread folds them in */
+const size_t RECOVERY_WINDOW_BLOCKS = 16 * 1024;
+
+/** The next window of the active chain starting at pindex, which is advanced past it */
+std::vector<CBlockIndex*> NextRecoveryWindow(CBlockIndex*& pindex)
+{
+    std::vector<CBlockIndex*> vWindow;
+    for (; pindex && vWindow.size() < RECOVERY_WINDOW_BLOCKS; pindex = chainActive.Next(pindex))
+        vWindow.push_back(pindex);
+    return vWindow;
+}
+
+/** What one block adds to and removes from the money supply */
+struct CBlockSupplyDelta {
+    bool fRead;
+    CAmount nValueIn;
+    CAmount nValueOut;
+    //! Spent outputs the undo data did not cover, looked up by the calling thread
+    std::vector<COutPoint> vMissing;
+
+    CBlockSupplyDelta() : fRead(false), nValueIn(0), nValueOut(0) {}
+};
+
+void ReadBlockSupplyDelta(const CBlockIndex* pindex, CBlockSupplyDelta& delta)
+{
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex))
+        return;
 
-        list<libzerocoin::CoinDenomination> listDenomsSpent = ZerocoinSpendListFromBlock(block, true);
+    // The undo record of vtx[t] is vtxundo[t - 1] and holds every output it spent
+    CBlockUndo blockundo;
+    bool fUndo = pindex->pprev && (pindex->nStatus & BLOCK_HAVE_UNDO) &&
+                 blockundo.ReadFromDisk(pindex->GetUndoPos(), pindex->pprev->GetBlockHash()) &&
+                 blockundo.vtxundo.size() + 1 == block.vtx.size();
 
-        //Reset the supply to previous block
-        pindex->mapZerocoinSupply = pindex->pprev->mapZerocoinSupply;
+    for (unsigned int t = 0; t < block.vtx.size(); t++) {
+        const CTransaction& tx = block.vtx[t];
+        if (!tx.IsCoinBase()) {
+            const CTxUndo* ptxundo = (fUndo && t > 0) ? &blockundo.vtxundo[t - 1] : NULL;
+            if (ptxundo && ptxundo->vprevout.size() != tx.vin.size())
+                ptxundo = NULL;
 
-        //Add mints to zUSERX supply
-        for (auto denom : libzerocoin::zerocoinDenomList) {
-            long nDenomAdded = count(pindex->vMintDenominationsInBlock.begin(), pindex->vMintDenominationsInBlock.end(), denom);
-            pindex->mapZerocoinSupply.at(denom) += nDenomAdded;
+            for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                if (tx.vin[i].scriptSig.IsZerocoinSpend())
+                    delta.nValueIn += tx.vin[i].nSequence * COIN;
+                else if (ptxundo)
+                    delta.nValueIn += ptxundo->vprevout[i].txout.nValue;
+                else
+                    delta.vMissing.push_back(tx.vin[i].prevout);
+            }
         }
 
-        //Remove spends from zUSERX supply
-        for (auto denom : listDenomsSpent)
-            pindex->mapZerocoinSupply.at(denom)--;
+        for (unsigned int i = 0; i < tx.vout.size(); i++) {
+            if (i == 0 && tx.IsCoinStake())
+                continue;
 
-        //Rewrite money supply
-        assert(pblocktree->WriteBlockIndex(CDiskBlockIndex(pindex)));
+            delta.nValueOut += tx.vout[i].nValue;
+        }
+    }
+    delta.fRead = true;
+}
 
-        if (pindex->nHeight < chainActive.Height())
-            pindex = chainActive.Next(pindex);
-        else
-            break;
+} // anon namespace
+
+void ParallelForBlocks(size_t nCount, const std::function<void(size_t)>& fn)
+{
+    // Zerocoin_Params() initializes its statics lazily, so touch it before any worker does
+    Params().Zerocoin_Params(false);
+    Params().Zerocoin_Params(true);
+
+    std::atomic<size_t> nNext(0);
+    auto work = [&]() {
+        while (true) {
+            size_t nBegin = nNext.fetch_add(RECOVERY_CHUNK_BLOCKS);
+            if (nBegin >= nCount)
+                return;
+            size_t nEnd = std::min(nCount, nBegin + RECOVERY_CHUNK_BLOCKS);
+            for (size_t i = nBegin; i < nEnd; i++)
+                fn(i);
+        }
+    };
+    int nChunks = (nCount + RECOVERY_CHUNK_BLOCKS - 1) / RECOVERY_CHUNK_BLOCKS;
+    int nThreads = std::max(1, std::min(nChunks, (int)boost::thread::hardware_concurrency()));
+    boost::thread_group threadGroup;
+    for (int i = 1; i < nThreads; i++)
+        threadGroup.create_thread(work);
+    work();
+    threadGroup.join_all();
+}
+
+void RecalculateZUSERXMinted()
+{
+    CBlockIndex* pindexWindow = chainActive[Params().Zerocoin_StartHeight()];
+    while (pindexWindow) {
+        std::vector<CBlockIndex*> vWindow = NextRecoveryWindow(pindexWindow);
+        LogPrintf("%s : blocks %d to %d...\n", __func__, vWindow.front()->nHeight, vWindow.back()->nHeight);
+
+        // Every block is independent, and each worker only touches the index entries it was handed
+        ParallelForBlocks(vWindow.size(), [&](size_t i) {
+            CBlockIndex* pindex = vWindow[i];
+
+            //overwrite possibly wrong vMintsInBlock data
+            CBlock block;
+            assert(ReadBlockFromDisk(block, pindex));
+
+            std::list<CZerocoinMint> listMints;
+            BlockToZerocoinMintList(block, listMints, true);
+
+            pindex->vMintDenominationsInBlock.clear();
+            for (auto mint : listMints)
+                pindex->vMintDenominationsInBlock.emplace_back(mint.GetDenomination());
+        });
+    }
+}
+
+void RecalculateZUSERXSpent()
+{
+    CBlockIndex* pindexWindow = chainActive[Params().Zerocoin_StartHeight()];
+    while (pindexWindow) {
+        std::vector<CBlockIndex*> vWindow = NextRecoveryWindow(pindexWindow);
+
+        // Parse the spends on the worker pool, then carry the supply forward in chain order
+        std::vector<list<libzerocoin::CoinDenomination> > vDenomsSpent(vWindow.size());
+        ParallelForBlocks(vWindow.size(), [&](size_t i) {
+            CBlock block;
+            assert(ReadBlockFromDisk(block, vWindow[i]));
+            vDenomsSpent[i] = ZerocoinSpendListFromBlock(block, true);
+        });
+
+        for (unsigned int j = 0; j < vWindow.size(); j++) {
+            CBlockIndex* pindex = vWindow[j];
+            if (pindex->nHeight % 1000 == 0)
+                LogPrintf("%s : block %d...\n", __func__, pindex->nHeight);
+
+            //Reset the supply to previous block
+            pindex->mapZerocoinSupply = pindex->pprev->mapZerocoinSupply;
+
+            //Add mints to zUSERX supply
+            for (auto denom : libzerocoin::zerocoinDenomList) {
+                long nDenomAdded = count(pindex->vMintDenominationsInBlock.begin(), pindex->vMintDenominationsInBlock.end(), denom);
+                pindex->mapZerocoinSupply.at(denom) += nDenomAdded;
+            }
+
+            //Remove spends from zUSERX supply
+            for (auto denom : vDenomsSpent[j])
+                pindex->mapZerocoinSupply.at(denom)--;
+
+            //Rewrite money supply
+            assert(pblocktree->WriteBlockIndex(CDiskBlockIndex(pindex)));
+        }
     }
 }
 
@@ -2454,67 +2949,51 @@ bool RecalculateUSERXSupply(int nHeightStart)
     if (nHeightStart > chainActive.Height())
         return false;
 
-    CBlockIndex* pindex = chainActive[nHeightStart];
-    CAmount nSupplyPrev = pindex->pprev->nMoneySupply;
+    CBlockIndex* pindexWindow = chainActive[nHeightStart];
+    CAmount nSupplyPrev = pindexWindow->pprev->nMoneySupply;
     if (nHeightStart == Params().Zerocoin_StartHeight())
         nSupplyPrev = CAmount(5449796547496199);
 
-    while (true) {
-        if (pindex->nHeight % 1000 == 0)
-            LogPrintf("%s : block %d...\n", __func__, pindex->nHeight);
-
-        CBlock block;
-        assert(ReadBlockFromDisk(block, pindex));
+    while (pindexWindow) {
+        std::vector<CBlockIndex*> vWindow = NextRecoveryWindow(pindexWindow);
 
-        CAmount nValueIn = 0;
-        CAmount nValueOut = 0;
-        for (const CTransaction tx : block.vtx) {
-            for (unsigned int i = 0; i < tx.vin.size(); i++) {
-                if (tx.IsCoinBase())
-                    break;
+        // Spent values come from the undo files on the worker pool, which must not take cs_main since
+        // ConnectBlock calls this with it held; whatever the undo data lacks is looked up below
+        std::vector<CBlockSupplyDelta> vDelta(vWindow.size());
+        ParallelForBlocks(vWindow.size(), [&](size_t i) { ReadBlockSupplyDelta(vWindow[i], vDelta[i]); });
 
-                if (tx.vin[i].scriptSig.IsZerocoinSpend()) {
-                    nValueIn += tx.vin[i].nSequence * COIN;
-                    continue;
-                }
+        for (unsigned int j = 0; j < vWindow.size(); j++) {
+            CBlockIndex* pindex = vWindow[j];
+            if (pindex->nHeight % 1000 == 0)
+                LogPrintf("%s : block %d...\n", __func__, pindex->nHeight);
 
-                COutPoint prevout = tx.vin[i].prevout;
+            assert(vDelta[j].fRead);
+            CAmount nValueIn = vDelta[j].nValueIn;
+            for (const COutPoint& prevout : vDelta[j].vMissing) {
                 CTransaction txPrev;
                 uint256 hashBlock;
                 assert(GetTransaction(prevout.hash, txPrev, hashBlock, true));
                 nValueIn += txPrev.vout[prevout.n].nValue;
             }
 
-            for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                if (i == 0 && tx.IsCoinStake())
-                    continue;
+            // Rewrite money supply
+            pindex->nMoneySupply = nSupplyPrev + vDelta[j].nValueOut - nValueIn;
+            nSupplyPrev = pindex->nMoneySupply;
 
-                nValueOut += tx.vout[i].nValue;
-            }
-        }
+            // Add fraudulent funds to the supply and remove any recovered funds.
+            if (pindex->nHeight == Params().Zerocoin_Block_RecalculateAccumulators()) {
+                LogPrintf("%s : Original money supply=%s\n", __func__, FormatMoney(pindex->nMoneySupply));
 
-        // Rewrite money supply
-        pindex->nMoneySupply = nSupplyPrev + nValueOut - nValueIn;
-        nSupplyPrev = pindex->nMoneySupply;
+                pindex->nMoneySupply += Params().InvalidAmountFiltered();
+                LogPrintf("%s : Adding filtered funds to supply + %s : supply=%s\n", __func__, FormatMoney(Params().InvalidAmountFiltered()), FormatMoney(pindex->nMoneySupply));
 
-        // Add fraudulent funds to the supply and remove any recovered funds.
-        if (pindex->nHeight == Params().Zerocoin_Block_RecalculateAccumulators()) {
-            LogPrintf("%s : Original money supply=%s\n", __func__, FormatMoney(pindex->nMoneySupply));
-
-            pindex->nMoneySupply += Params().InvalidAmountFiltered();
-            LogPrintf("%s : Adding filtered funds to supply + %s : supply=%s\n", __func__, FormatMoney(Params().InvalidAmountFiltered()), FormatMoney(pindex->nMoneySupply));
+                CAmount nLocked = GetInvalidUTXOValue();
+                pindex->nMoneySupply -= nLocked;
+                LogPrintf("%s : Removing locked from supply - %s : supply=%s\n", __func__, FormatMoney(nLocked), FormatMoney(pindex->nMoneySupply));
+            }
 
-            CAmount nLocked = GetInvalidUTXOValue();
-            pindex->nMoneySupply -= nLocked;
-            LogPrintf("%s : Removing locked from supply - %s : supply=%s\n", __func__, FormatMoney(nLocked), FormatMoney(pindex->nMoneySupply));
+            assert(pblocktree->WriteBlockIndex(CDiskBlockIndex(pindex)));
         }
-
-        assert(pblocktree->WriteBlockIndex(CDiskBlockIndex(pindex)));
-
-        if (pindex->nHeight < chainActive.Height())
-            pindex = chainActive.Next(pindex);
-        else
-            break;
     }
     return true;
 }
@@ -2637,6 +3116,47 @@ static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 
+/**
+ * Location index of transactions containing zerocoins. Entries are written when a block is
+ * connected and erased when it is disconnected, except for the temporary disconnects done by
+ * CVerifyDB. An entry still only counts while the block at its height in the active chain is
+ * stored at the same position.
+ */
+namespace {
+CCriticalSection cs_txlocations;
+boost::unordered_map<uint256, CTxLocation, BlockHasher> mapTxLocations;
+bool fTxLocationsLoaded = false;
+}
+
+static bool WriteTxLocations(const std::vector<std::pair<uint256, CTxLocation> >& vLocations)
+{
+    if (!pblocktree->WriteTxLocations(vLocations))
+        return false;
+
+    LOCK(cs_txlocations);
+    for (const std::pair<uint256, CTxLocation>& location : vLocations)
+        mapTxLocations[location.first] = location.second;
+    return true;
+}
+
+static bool EraseTxLocations(const CBlock& block, const CBlockIndex* pindex)
+{
+    std::vector<uint256> vErase;
+    {
+        LOCK(cs_txlocations);
+        for (const CTransaction& tx : block.vtx) {
+            if (!tx.ContainsZerocoins())
+                continue;
+            boost::unordered_map<uint256, CTxLocation, BlockHasher>::iterator it = mapTxLocations.find(tx.GetHash());
+            if (it != mapTxLocations.end() && (CDiskBlockPos)it->second.pos == pindex->GetBlockPos()) {
+                vErase.push_back(it->first);
+                mapTxLocations.erase(it);
+            }
+        }
+    }
+    return vErase.empty() || pblocktree->EraseTxLocations(vErase);
+}
+
 bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool fJustCheck, bool fAlreadyChecked)
 {
     AssertLockHeld(cs_main);
@@ -2650,9 +3170,11 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         LogPrintf("%s: hashPrev=%s view=%s\n", __func__, hashPrevBlock.ToString().c_str(), view.GetBestBlock().ToString().c_str());
     assert(hashPrevBlock == view.GetBestBlock());
 
+    const uint256 hashBlock = block.GetHash();
+
     // Special case for the genesis block, skipping connection of its transactions
     // (its coinbase is unspendable)
-    if (block.GetHash() == Params().HashGenesisBlock()) {
+    if (hashBlock == Params().HashGenesisBlock()) {
         view.SetBestBlock(pindex->GetBlockHash());
         return true;
     }
@@ -2699,6 +3221,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     unsigned int nSigOps = 0;
     CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
     std::vector<std::pair<uint256, CDiskTxPos> > vPos;
+    std::vector<std::pair<uint256, CTxLocation> > vLocations;
     std::vector<std::pair<CoinSpend, uint256> > vSpends;
     std::vector<std::pair<PublicCoin, uint256> > vMints;
     vPos.reserve(block.vtx.size());
@@ -2708,7 +3231,6 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     CAmount nValueIn = 0;
     unsigned int nMaxBlockSigOps = MAX_BLOCK_SIGOPS_CURRENT;
     vector<uint256> vSpendsInBlock;
-    uint256 hashBlock = block.GetHash();
     for (unsigned int i = 0; i < block.vtx.size(); i++) {
         const CTransaction& tx = block.vtx[i];
 
@@ -2726,7 +3248,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             int nHeightTx = 0;
             uint256 txid = tx.GetHash();
             vSpendsInBlock.emplace_back(txid);
-            if (IsTransactionInChain(txid, nHeightTx)) {
+            if (IsZerocoinTxInChain(txid, nHeightTx)) {
                 //when verifying blocks on init, the blocks are scanned without being disconnected - prevent that from causing an error
                 if (!fVerifyingBlocks || (fVerifyingBlocks && pindex->nHeight > nHeightTx))
                     return state.DoS(100, error("%s : txid %s already exists in block %d , trying to include it again in block %d", __func__,
@@ -2736,15 +3258,15 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
             //Check for double spending of serial #'s
             set<CBigNum> setSerials;
-            for (const CTxIn& txIn : tx.vin) {
-                if (!txIn.scriptSig.IsZerocoinSpend())
+            for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                if (!tx.vin[i].scriptSig.IsZerocoinSpend())
                     continue;
-                CoinSpend spend = TxInToZerocoinSpend(txIn);
-                nValueIn += spend.getDenomination() * COIN;
+                CoinSpendRef spend = TxInToZerocoinSpendRef(tx, i);
+                nValueIn += spend->getDenomination() * COIN;
 
                 //queue for db write after the 'justcheck' section has concluded
-                vSpends.emplace_back(make_pair(spend, tx.GetHash()));
-                if (!ContextualCheckZerocoinSpend(tx, spend, pindex, hashBlock))
+                vSpends.emplace_back(make_pair(*spend, tx.GetHash()));
+                if (!ContextualCheckZerocoinSpend(tx, *spend, pindex, hashBlock))
                     return state.DoS(100, error("%s: failed to add block %s with invalid zerocoinspend", __func__, tx.GetHash().GetHex()), REJECT_INVALID);
             }
 
@@ -2820,6 +3342,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         UpdateCoins(tx, state, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
 
         vPos.push_back(std::make_pair(tx.GetHash(), pos));
+        if (tx.ContainsZerocoins())
+            vLocations.push_back(std::make_pair(tx.GetHash(), CTxLocation(pindex->nHeight, pos)));
         pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
     }
 
@@ -2833,7 +3357,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     //Track zUSERX money supply in the block index
     if (!UpdateZUSERXSupply(block, pindex))
         return state.DoS(100, error("%s: Failed to calculate new zUSERX supply for block=%s height=%d", __func__,
-                                    block.GetHash().GetHex(), pindex->nHeight), REJECT_INVALID);
+                                    hashBlock.GetHex(), pindex->nHeight), REJECT_INVALID);
 
     // track money supply and mint amount info
     CAmount nMoneySupplyPrev = pindex->pprev ? pindex->pprev->nMoneySupply : 0;
@@ -2864,7 +3388,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     AccumulatorMap mapAccumulators(Params().Zerocoin_Params(pindex->nHeight < Params().Zerocoin_Block_V2_Start()));
     if (!ValidateAccumulatorCheckpoint(block, pindex, mapAccumulators))
         return state.DoS(100, error("%s: Failed to validate accumulator checkpoint for block=%s height=%d", __func__,
-                                    block.GetHash().GetHex(), pindex->nHeight), REJECT_INVALID, "bad-acc-checkpoint");
+                                    hashBlock.GetHex(), pindex->nHeight), REJECT_INVALID, "bad-acc-checkpoint");
 
     if (!control.Wait())
         return state.DoS(100, false);
@@ -2894,35 +3418,57 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         setDirtyBlockIndex.insert(pindex);
     }
 
-    //Record zUSERX serials
-    set<uint256> setAddedTx;
-    for (pair<CoinSpend, uint256> pSpend : vSpends) {
-        // Send signal to wallet if this is ours
-        if (pwalletMain) {
-            if (pwalletMain->IsMyZerocoinSpend(pSpend.first.getCoinSerialNumber())) {
-                LogPrintf("%s: %s detected zerocoinspend in transaction %s \n", __func__, pSpend.first.getCoinSerialNumber().GetHex(), pSpend.second.GetHex());
-                pwalletMain->NotifyZerocoinChanged(pwalletMain, pSpend.first.getCoinSerialNumber().GetHex(), "Used", CT_UPDATED);
+    if (pblockfilterdb && !WriteBlockFilter(CBlockFilter(block, blockundo), pindex))
+        return state.Abort("Failed to write block filter");
+    if (putxostatsdb && !fVerifyingBlocks && !UpdateUTXOStatsIndex(block, blockundo, pindex, true))
+        return state.Abort("Failed to write UTXO stats index");
 
-                //Don't add the same tx multiple times
-                if (setAddedTx.count(pSpend.second))
-                    continue;
+    //Record zUSERX serials. The wallet hears about them in order with the other
+    //notifications, so the spending transactions are made into wtxs here and
+    //handed over
+    if (pwalletMain && !vSpends.empty()) {
+        std::map<uint256, CWalletTx> mapSpendTx;
+        for (pair<CoinSpend, uint256> pSpend : vSpends) {
+            if (mapSpendTx.count(pSpend.second))
+                continue;
+
+            //Search block for matching tx, turn into wtx, set merkle branch
+            for (const CTransaction& tx : block.vtx) {
+                if (tx.GetHash() == pSpend.second) {
+                    CWalletTx wtx(pwalletMain, tx);
+                    wtx.nTimeReceived = pindex->GetBlockTime();
+                    wtx.SetMerkleBranch(block);
+                    mapSpendTx.insert(make_pair(pSpend.second, wtx));
+                    break;
+                }
+            }
+        }
+
+        CallFunctionInValidationInterfaceQueue([vSpends, mapSpendTx]() {
+            LOCK2(cs_main, pwalletMain->cs_wallet);
+            set<uint256> setAddedTx;
+            for (pair<CoinSpend, uint256> pSpend : vSpends) {
+                // Send signal to wallet if this is ours
+                if (pwalletMain->IsMyZerocoinSpend(pSpend.first.getCoinSerialNumber())) {
+                    LogPrintf("ConnectBlock: %s detected zerocoinspend in transaction %s \n", pSpend.first.getCoinSerialNumber().GetHex(), pSpend.second.GetHex());
+                    pwalletMain->NotifyZerocoinChanged(pwalletMain, pSpend.first.getCoinSerialNumber().GetHex(), "Used", CT_UPDATED);
 
-                //Search block for matching tx, turn into wtx, set merkle branch, add to wallet
-                for (CTransaction tx : block.vtx) {
-                    if (tx.GetHash() == pSpend.second) {
-                        CWalletTx wtx(pwalletMain, tx);
-                        wtx.nTimeReceived = pindex->GetBlockTime();
-                        wtx.SetMerkleBranch(block);
-                        pwalletMain->AddToWallet(wtx);
+                    //Don't add the same tx multiple times
+                    if (setAddedTx.count(pSpend.second))
+                        continue;
+
+                    std::map<uint256, CWalletTx>::const_iterator it = mapSpendTx.find(pSpend.second);
+                    if (it != mapSpendTx.end()) {
+                        pwalletMain->AddToWallet(it->second);
                         setAddedTx.insert(pSpend.second);
                     }
                 }
             }
-        }
+        });
     }
 
     // Flush spend/mint info to disk
-    if (!zerocoinDB->WriteCoinSpendBatch(vSpends)) return state.Abort(("Failed to record coin serials to database"));
+    if (!zerocoinDB->WriteCoinSpendBatch(vSpends, pindex)) return state.Abort(("Failed to record coin serials to database"));
     if (!zerocoinDB->WriteCoinMintBatch(vMints)) return state.Abort(("Failed to record new mints to database"));
 
     //Record accumulator checksums
@@ -2932,6 +3478,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->WriteTxIndex(vPos))
             return state.Abort("Failed to write transaction index");
 
+    if (!UpdateBlockExplorerIndexes(block, blockundo, pindex, view, true))
+        return state.Abort("Failed to write explorer indexes");
+
+    if (!vLocations.empty() && !WriteTxLocations(vLocations))
+        return state.Abort("Failed to write transaction location index");
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -3035,9 +3587,14 @@ void static UpdateTip(CBlockIndex* pindexNew)
 {
     chainActive.SetTip(pindexNew);
 
-    // If turned on AutoZeromint will automatically convert USERX to zUSERX
-    if (pwalletMain->isZeromintEnabled ())
-        pwalletMain->AutoZeromint ();
+    // If turned on AutoZeromint will automatically convert USERX to zUSERX. It
+    // spends from the wallet's view of the chain, so it queues behind the
+    // notifications of the blocks connected so far
+    if (pwalletMain && pwalletMain->isZeromintEnabled())
+        CallFunctionInValidationInterfaceQueue([]() {
+            LOCK(cs_main);
+            pwalletMain->AutoZeromint();
+        });
 
     // New best block
     nTimeBestReceived = GetTime();
@@ -3078,7 +3635,8 @@ bool static DisconnectTip(CValidationState& state)
     assert(pindexDelete);
     mempool.check(pcoinsTip);
     // Read block from disk.
-    CBlock block;
+    boost::shared_ptr<CBlock> pblock = boost::make_shared<CBlock>();
+    CBlock& block = *pblock;
     if (!ReadBlockFromDisk(block, pindexDelete))
         return state.Abort("Failed to read block");
     // Apply the block atomically to the chain state.
@@ -3107,9 +3665,7 @@ bool static DisconnectTip(CValidationState& state)
     UpdateTip(pindexDelete->pprev);
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
-    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
-        SyncWithWallets(tx, NULL);
-    }
+    GetMainSignals().SyncDisconnectedBlock(pblock);
     return true;
 }
 
@@ -3120,25 +3676,25 @@ static int64_t nTimeChainState = 0;
 static int64_t nTimePostConnect = 0;
 
 /**
- * Connect a new block to chainActive. pblock is either NULL or a pointer to a CBlock
+ * Connect a new block to chainActive. pblockIn is either NULL or a pointer to a CBlock
  * corresponding to pindexNew, to bypass loading it again from disk.
  */
-bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock* pblock, bool fAlreadyChecked)
+bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, const boost::shared_ptr<CBlock>& pblockIn, bool fAlreadyChecked)
 {
     assert(pindexNew->pprev == chainActive.Tip());
     mempool.check(pcoinsTip);
     CCoinsViewCache view(pcoinsTip);
 
-    if (pblock == NULL)
+    if (!pblockIn)
         fAlreadyChecked = false;
 
     // Read block from disk.
     int64_t nTime1 = GetTimeMicros();
-    CBlock block;
+    boost::shared_ptr<CBlock> pblock = pblockIn;
     if (!pblock) {
-        if (!ReadBlockFromDisk(block, pindexNew))
+        pblock = boost::make_shared<CBlock>();
+        if (!ReadBlockFromDisk(*pblock, pindexNew))
             return state.Abort("Failed to read block");
-        pblock = &block;
     }
     // Apply the block atomically to the chain state.
     int64_t nTime2 = GetTimeMicros();
@@ -3183,12 +3739,10 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
     // Tell wallet about transactions that went from mempool
     // to conflicted:
     BOOST_FOREACH (const CTransaction& tx, txConflicted) {
-        SyncWithWallets(tx, NULL);
+        SyncWithWallets(tx);
     }
     // ... and about transactions that got confirmed:
-    BOOST_FOREACH (const CTransaction& tx, pblock->vtx) {
-        SyncWithWallets(tx, pblock);
-    }
+    GetMainSignals().SyncBlock(pblock);
 
     int64_t nTime6 = GetTimeMicros();
     nTimePostConnect += nTime6 - nTime5;
@@ -3358,10 +3912,10 @@ static void PruneBlockIndexCandidates()
  * Try to make some progress towards making pindexMostWork the active block.
  * pblock is either NULL or a pointer to a CBlock corresponding to pindexMostWork.
  */
-static bool ActivateBestChainStep(CValidationState& state, CBlockIndex* pindexMostWork, CBlock* pblock, bool fAlreadyChecked)
+static bool ActivateBestChainStep(CValidationState& state, CBlockIndex* pindexMostWork, const boost::shared_ptr<CBlock>& pblock, bool fAlreadyChecked)
 {
     AssertLockHeld(cs_main);
-    if (pblock == NULL)
+    if (!pblock)
         fAlreadyChecked = false;
     bool fInvalidFound = false;
     const CBlockIndex* pindexOldTip = chainActive.Tip();
@@ -3392,7 +3946,7 @@ static bool ActivateBestChainStep(CValidationState& state, CBlockIndex* pindexMo
 
         // Connect new blocks.
         BOOST_REVERSE_FOREACH (CBlockIndex* pindexConnect, vpindexToConnect) {
-            if (!ConnectTip(state, pindexConnect, pindexConnect == pindexMostWork ? pblock : NULL, fAlreadyChecked)) {
+            if (!ConnectTip(state, pindexConnect, pindexConnect == pindexMostWork ? pblock : boost::shared_ptr<CBlock>(), fAlreadyChecked)) {
                 if (state.IsInvalid()) {
                     // The block violates a consensus rule.
                     if (!state.CorruptionPossible())
@@ -3429,14 +3983,21 @@ static bool ActivateBestChainStep(CValidationState& state, CBlockIndex* pindexMo
  * Make the best chain active, in multiple steps. The result is either failure
  * or an activated best chain. pblock is either NULL or a pointer to a block
  * that is already loaded (to avoid loading it again from disk).
+ * With fLimitQueue, each step first waits for the validation queue to shrink,
+ * so connecting a long chain does not queue notifications without bound; the
+ * caller must not hold cs_main then.
  */
-bool ActivateBestChain(CValidationState& state, CBlock* pblock, bool fAlreadyChecked)
+static bool ActivateBestChainInternal(CValidationState& state, const boost::shared_ptr<CBlock>& pblock, bool fAlreadyChecked, bool fLimitQueue)
 {
     CBlockIndex* pindexNewTip = NULL;
     CBlockIndex* pindexMostWork = NULL;
+    const uint256 hashBlock = pblock ? pblock->GetHash() : uint256();
     do {
         boost::this_thread::interruption_point();
 
+        if (fLimitQueue)
+            LimitValidationInterfaceQueue();
+
         bool fInitialDownload;
         while (true) {
             TRY_LOCK(cs_main, lockMain);
@@ -3451,7 +4012,7 @@ bool ActivateBestChain(CValidationState& state, CBlock* pblock, bool fAlreadyChe
             if (pindexMostWork == NULL || pindexMostWork == chainActive.Tip())
                 return true;
 
-            if (!ActivateBestChainStep(state, pindexMostWork, pblock && pblock->GetHash() == pindexMostWork->GetBlockHash() ? pblock : NULL, fAlreadyChecked))
+            if (!ActivateBestChainStep(state, pindexMostWork, pblock && hashBlock == pindexMostWork->GetBlockHash() ? pblock : boost::shared_ptr<CBlock>(), fAlreadyChecked))
                 return false;
 
             pindexNewTip = chainActive.Tip();
@@ -3495,6 +4056,11 @@ bool ActivateBestChain(CValidationState& state, CBlock* pblock, bool fAlreadyChe
     return true;
 }
 
+bool ActivateBestChain(CValidationState& state, const boost::shared_ptr<CBlock>& pblock, bool fAlreadyChecked)
+{
+    return ActivateBestChainInternal(state, pblock, fAlreadyChecked, true);
+}
+
 bool InvalidateBlock(CValidationState& state, CBlockIndex* pindex)
 {
     AssertLockHeld(cs_main);
@@ -3758,10 +4324,11 @@ bool FindUndoPos(CValidationState& state, int nFile, CDiskBlockPos& pos, unsigne
     return true;
 }
 
-bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW)
+/** CheckBlockHeader for a header the caller has already hashed */
+static bool CheckBlockHeader(const CBlockHeader& block, const uint256& hashBlock, CValidationState& state, bool fCheckPOW)
 {
     // Check proof of work matches claimed amount
-    if (fCheckPOW && !CheckProofOfWork(block.GetHash(), block.nBits))
+    if (fCheckPOW && !CheckProofOfWork(hashBlock, block.nBits))
         return state.DoS(50, error("CheckBlockHeader() : proof of work failed"),
             REJECT_INVALID, "high-hash");
 
@@ -3779,20 +4346,26 @@ bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool f
     return true;
 }
 
+bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW)
+{
+    return CheckBlockHeader(block, fCheckPOW ? block.GetHash() : uint256(), state, fCheckPOW);
+}
+
 // #define STAKE_MIN_CONF 100
 
 bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSig)
 {
     // These are checks that are independent of context.
+    const uint256 hashBlock = block.GetHash();
 
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, block.IsProofOfWork()))
+    if (!CheckBlockHeader(block, hashBlock, state, block.IsProofOfWork()))
         return state.DoS(100, error("CheckBlock() : CheckBlockHeader failed"),
             REJECT_INVALID, "bad-header", true);
 
     // Check timestamp
-    LogPrint("debug", "%s: block=%s  is proof of stake=%d\n", __func__, block.GetHash().ToString().c_str(), block.IsProofOfStake());
+    LogPrint("debug", "%s: block=%s  is proof of stake=%d\n", __func__, hashBlock.ToString().c_str(), block.IsProofOfStake());
     if (block.GetBlockTime() > GetAdjustedTime() + (block.IsProofOfStake() ? 180 : 7200)) // 3 minute future drift for PoS
         return state.Invalid(error("CheckBlock() : block timestamp too far in the future"),
             REJECT_INVALID, "time-too-new");
@@ -3847,18 +4420,27 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
         //additional check against false PoS attack
         
 		// Check for coin age.
-		// First try finding the previous transaction in database.
-		CTransaction txPrev;
-		uint256 hashBlockPrev;
-		if (!GetTransaction(block.vtx[1].vin[0].prevout.hash, txPrev, hashBlockPrev, true))
-			return state.DoS(100, error("CheckBlock() : stake failed to find vin transaction"));
-		// Find block in map.
+		// The staked output is normally unspent in the coins view, which records the height of its block.
 		CBlockIndex* pindex = NULL;
-		BlockMap::iterator it = mapBlockIndex.find(hashBlockPrev);
-		if (it != mapBlockIndex.end())
-			pindex = it->second;
-		else
-			return state.DoS(100, error("CheckBlock() :  stake failed to find block index"));
+		{
+			LOCK(cs_main);
+			const CCoins* coins = pcoinsTip->AccessCoins(block.vtx[1].vin[0].prevout.hash);
+			if (coins && coins->nHeight > 0 && coins->nHeight <= chainActive.Height())
+				pindex = chainActive[coins->nHeight];
+		}
+		if (!pindex) {
+			// Otherwise try finding the previous transaction in database.
+			CTransaction txPrev;
+			uint256 hashBlockPrev;
+			if (!GetTransaction(block.vtx[1].vin[0].prevout.hash, txPrev, hashBlockPrev, true))
+				return state.DoS(100, error("CheckBlock() : stake failed to find vin transaction"));
+			// Find block in map.
+			BlockMap::iterator it = mapBlockIndex.find(hashBlockPrev);
+			if (it != mapBlockIndex.end())
+				pindex = it->second;
+			else
+				return state.DoS(100, error("CheckBlock() :  stake failed to find block index"));
+		}
 		// Check block time vs stake age requirement.
 		if (pindex->GetBlockHeader().nTime + nStakeMinAge > GetAdjustedTime())
 			return state.DoS(100, error("CheckBlock() : stake under min. stake age"));
@@ -3878,7 +4460,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
                 BOOST_FOREACH (const CTxIn& in, tx.vin) {
                     if (mapLockedInputs.count(in.prevout)) {
                         if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                            mapRejectedBlocks.insert(make_pair(block.GetHash(), GetTime()));
+                            mapRejectedBlocks.insert(make_pair(hashBlock, GetTime()));
                             LogPrintf("CheckBlock() : found conflicting transaction with transaction lock %s %s\n", mapLockedInputs[in.prevout].ToString(), tx.GetHash().ToString());
                             return state.DoS(0, error("CheckBlock() : found conflicting transaction with transaction lock"),
                                 REJECT_INVALID, "conflicting-tx-ix");
@@ -3911,7 +4493,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
         // that this block is invalid, so don't issue an outright ban.
         if (nHeight != 0 && !IsInitialBlockDownload()) {
             if (!IsBlockPayeeValid(block, nHeight)) {
-                mapRejectedBlocks.insert(make_pair(block.GetHash(), GetTime()));
+                mapRejectedBlocks.insert(make_pair(hashBlock, GetTime()));
                 return state.DoS(0, error("CheckBlock() : Couldn't find masternode/budget payment"),
                         REJECT_INVALID, "bad-cb-payee");
             }
@@ -3923,20 +4505,19 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
 
     // Check transactions
     bool fZerocoinActive = block.GetBlockTime() > Params().Zerocoin_StartTime();
-    vector<CBigNum> vBlockSerials;
+    std::set<uint256> setBlockSerials;
     for (const CTransaction& tx : block.vtx) {
         if (!CheckTransaction(tx, fZerocoinActive, chainActive.Height() + 1 >= Params().Zerocoin_Block_EnforceSerialRange(), state))
             return error("CheckBlock() : CheckTransaction failed");
 
         // double check that there are no double spent zUSERX spends in this block
         if (tx.IsZerocoinSpend()) {
-            for (const CTxIn txIn : tx.vin) {
-                if (txIn.scriptSig.IsZerocoinSpend()) {
-                    libzerocoin::CoinSpend spend = TxInToZerocoinSpend(txIn);
-                    if (count(vBlockSerials.begin(), vBlockSerials.end(), spend.getCoinSerialNumber()))
+            for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                if (tx.vin[i].scriptSig.IsZerocoinSpend()) {
+                    CoinSpendRef spend = TxInToZerocoinSpendRef(tx, i);
+                    if (!setBlockSerials.insert(GetSerialHash(spend->getCoinSerialNumber())).second)
                         return state.DoS(100, error("%s : Double spending of zUSERX serial %s in block\n Block: %s",
-                                                    __func__, spend.getCoinSerialNumber().GetHex(), block.ToString()));
-                    vBlockSerials.emplace_back(spend.getCoinSerialNumber());
+                                                    __func__, spend->getCoinSerialNumber().GetHex(), block.ToString()));
                 }
             }
         }
@@ -4035,8 +4616,110 @@ bool IsBlockHashInChain(const uint256& hashBlock)
     return chainActive.Contains(mapBlockIndex[hashBlock]);
 }
 
+bool LoadTxLocations()
+{
+    LOCK(cs_main);
+
+    std::vector<std::pair<uint256, CTxLocation> > vLocations;
+    if (!pblocktree->LoadTxLocations(vLocations))
+        return false;
+    {
+        LOCK(cs_txlocations);
+        mapTxLocations.clear();
+        for (const std::pair<uint256, CTxLocation>& location : vLocations)
+            mapTxLocations[location.first] = location.second;
+    }
+    LogPrintf("%s: loaded %u transaction locations\n", __func__, vLocations.size());
+
+    // Build the index once from the block files of chains connected before it existed
+    bool fBuilt = false;
+    pblocktree->ReadFlag("txlocations", fBuilt);
+    if (!fBuilt && chainActive.Height() >= Params().Zerocoin_StartHeight()) {
+        LogPrintf("%s: building transaction location index\n", __func__);
+        uiInterface.ShowProgress(_("Building transaction location index..."), 0);
+        int nHeightStart = Params().Zerocoin_StartHeight();
+        vLocations.clear();
+        for (CBlockIndex* pindex = chainActive[nHeightStart]; pindex; pindex = chainActive.Next(pindex)) {
+            boost::this_thread::interruption_point();
+            if (pindex->nHeight % 1000 == 0)
+                uiInterface.ShowProgress(_("Building transaction location index..."), std::max(1, std::min(99, (int)((double)(pindex->nHeight - nHeightStart) / (double)(chainActive.Height() - nHeightStart + 1) * 100))));
+
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pindex))
+                return error("%s: failed to read block %s", __func__, pindex->GetBlockHash().GetHex());
+
+            CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
+            for (const CTransaction& tx : block.vtx) {
+                if (tx.ContainsZerocoins())
+                    vLocations.push_back(std::make_pair(tx.GetHash(), CTxLocation(pindex->nHeight, pos)));
+                pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
+            }
+
+            if (vLocations.size() >= 1000 || pindex == chainActive.Tip()) {
+                if (!WriteTxLocations(vLocations))
+                    return error("%s: failed to write transaction location index", __func__);
+                vLocations.clear();
+            }
+        }
+        uiInterface.ShowProgress("", 100);
+    }
+    pblocktree->WriteFlag("txlocations", true);
+
+    fTxLocationsLoaded = true;
+    return true;
+}
+
+bool GetTxLocation(const uint256& txid, CTxLocation& location)
+{
+    LOCK(cs_main);
+    {
+        LOCK(cs_txlocations);
+        boost::unordered_map<uint256, CTxLocation, BlockHasher>::const_iterator it = mapTxLocations.find(txid);
+        if (it == mapTxLocations.end())
+            return false;
+        location = it->second;
+    }
+
+    CBlockIndex* pindex = chainActive[location.nHeight];
+    return pindex && pindex->GetBlockPos() == (CDiskBlockPos)location.pos;
+}
+
+bool IsZerocoinTxInChain(const uint256& txid, int& nHeightTx)
+{
+    if (!fTxLocationsLoaded)
+        return IsTransactionInChain(txid, nHeightTx);
+
+    CTxLocation location;
+    if (!GetTxLocation(txid, location))
+        return false;
+
+    nHeightTx = location.nHeight;
+    return true;
+}
+
 bool IsTransactionInChain(const uint256& txId, int& nHeightTx, CTransaction& tx)
 {
+    // Indexed transactions are read straight from their position in the block file
+    CTxLocation location;
+    if (GetTxLocation(txId, location)) {
+        CAutoFile file(OpenBlockFile(location.pos, true), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull())
+            return error("%s: OpenBlockFile failed", __func__);
+        try {
+            CBlockHeader header;
+            file >> header;
+            fseek(file.Get(), location.pos.nTxOffset, SEEK_CUR);
+            file >> tx;
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+        if (tx.GetHash() != txId)
+            return error("%s : txid mismatch", __func__);
+
+        nHeightTx = location.nHeight;
+        return true;
+    }
+
     uint256 hashBlock;
     if (!GetTransaction(txId, tx, hashBlock, true))
         return false;
@@ -4049,6 +4732,12 @@ bool IsTransactionInChain(const uint256& txId, int& nHeightTx, CTransaction& tx)
 
 bool IsTransactionInChain(const uint256& txId, int& nHeightTx)
 {
+    CTxLocation location;
+    if (GetTxLocation(txId, location)) {
+        nHeightTx = location.nHeight;
+        return true;
+    }
+
     CTransaction tx;
     return IsTransactionInChain(txId, nHeightTx, tx);
 }
@@ -4115,7 +4804,8 @@ bool AcceptBlockHeader(const CBlock& block, CValidationState& state, CBlockIndex
                 CValidationState statePrev;
                 ReconsiderBlock(statePrev, pindexPrev);
                 if (statePrev.IsValid()) {
-                    ActivateBestChain(statePrev);
+                    // cs_main is held here, so the queue can't be waited for
+                    ActivateBestChainInternal(statePrev, boost::shared_ptr<CBlock>(), false, false);
                     return true;
                 }
             }
@@ -4168,10 +4858,11 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
     AssertLockHeld(cs_main);
 
     CBlockIndex*& pindex = *ppindex;
+    const uint256 hash = block.GetHash();
 
     // Get prev block index
     CBlockIndex* pindexPrev = NULL;
-    if (block.GetHash() != Params().HashGenesisBlock()) {
+    if (hash != Params().HashGenesisBlock()) {
         BlockMap::iterator mi = mapBlockIndex.find(block.hashPrevBlock);
         if (mi == mapBlockIndex.end())
             return state.DoS(0, error("%s : prev block %s not found", __func__, block.hashPrevBlock.ToString().c_str()), 0, "bad-prevblk");
@@ -4183,16 +4874,17 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
                 CValidationState statePrev;
                 ReconsiderBlock(statePrev, pindexPrev);
                 if (statePrev.IsValid()) {
-                    ActivateBestChain(statePrev);
+                    // cs_main is held here, so the queue can't be waited for
+                    ActivateBestChainInternal(statePrev, boost::shared_ptr<CBlock>(), false, false);
                     return true;
                 }
             }
-            return state.DoS(100, error("%s : prev block %s is invalid, unable to add block %s", __func__, block.hashPrevBlock.GetHex(), block.GetHash().GetHex()),
+            return state.DoS(100, error("%s : prev block %s is invalid, unable to add block %s", __func__, block.hashPrevBlock.GetHex(), hash.GetHex()),
                              REJECT_INVALID, "bad-prevblk");
         }
     }
 
-    if (block.GetHash() != Params().HashGenesisBlock() && !CheckWork(block, pindexPrev))
+    if (hash != Params().HashGenesisBlock() && !CheckWork(block, pindexPrev))
         return false;
 
     if (block.IsProofOfStake()) {
@@ -4208,7 +4900,6 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
         if (stake->IsZUSERX() && !ContextualCheckZerocoinStake(pindexPrev->nHeight, stake.get()))
             return state.DoS(100, error("%s: staked zUSERX fails context checks", __func__));
 
-        uint256 hash = block.GetHash();
         if(!mapProofOfStake.count(hash)) // add to mapProofOfStake
             mapProofOfStake.insert(make_pair(hash, hashProofOfStake));
     }
@@ -4313,10 +5004,14 @@ void CBlockIndex::BuildSkip()
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
 }
 
-bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDiskBlockPos* dbp)
+bool ProcessNewBlock(CValidationState& state, CNode* pfrom, const boost::shared_ptr<CBlock>& pblock, CDiskBlockPos* dbp)
 {
+    // Don't let the wallet and other listeners fall ever further behind
+    LimitValidationInterfaceQueue();
+
     // Preliminary checks
     int64_t nStartTime = GetTimeMillis();
+    const uint256 hashBlock = pblock->GetHash();
     bool checked = CheckBlock(*pblock, state);
 
     int nMints = 0;
@@ -4339,7 +5034,7 @@ bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDis
     if (!CheckBlockSignature(*pblock))
         return error("ProcessNewBlock() : bad proof-of-stake block signature");
 
-    if (pblock->GetHash() != Params().HashGenesisBlock() && pfrom != NULL) {
+    if (hashBlock != Params().HashGenesisBlock() && pfrom != NULL) {
         //if we get this far, check if the prev block is our prev block, if not then request sync and return false
         BlockMap::iterator mi = mapBlockIndex.find(pblock->hashPrevBlock);
         if (mi == mapBlockIndex.end()) {
@@ -4351,9 +5046,9 @@ bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDis
     {
         LOCK(cs_main);   // Replaces the former TRY_LOCK loop because busy waiting wastes too much resources
 
-        MarkBlockAsReceived (pblock->GetHash ());
+        MarkBlockAsReceived (hashBlock);
         if (!checked) {
-            return error ("%s : CheckBlock FAILED for block %s", __func__, pblock->GetHash().GetHex());
+            return error ("%s : CheckBlock FAILED for block %s", __func__, hashBlock.GetHex());
         }
 
         // Store to disk
@@ -4379,6 +5074,11 @@ bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDis
     }
 
     if (pwalletMain) {
+        // The wallet features below spend from the wallet's view of the chain, so let
+        // it catch up with the blocks just connected first
+        if (pwalletMain->isMultiSendEnabled() || pwalletMain->fCombineDust)
+            SyncWithValidationInterfaceQueue();
+
         // If turned on MultiSend will send a transaction (or more) on the after maturity of a stake
         if (pwalletMain->isMultiSendEnabled())
             pwalletMain->MultiSend();
@@ -4591,6 +5291,14 @@ bool static LoadBlockIndexDB(string& strError)
     pblocktree->ReadFlag("txindex", fTxIndex);
     LogPrintf("LoadBlockIndexDB(): transaction index %s\n", fTxIndex ? "enabled" : "disabled");
 
+    // Check whether we have the explorer indexes
+    pblocktree->ReadFlag("addressindex", fAddressIndex);
+    LogPrintf("LoadBlockIndexDB(): address index %s\n", fAddressIndex ? "enabled" : "disabled");
+    pblocktree->ReadFlag("spentindex", fSpentIndex);
+    LogPrintf("LoadBlockIndexDB(): spent index %s\n", fSpentIndex ? "enabled" : "disabled");
+    pblocktree->ReadFlag("timestampindex", fTimestampIndex);
+    LogPrintf("LoadBlockIndexDB(): timestamp index %s\n", fTimestampIndex ? "enabled" : "disabled");
+
     // If this is written true before the next client init, then we know the shutdown process failed
     pblocktree->WriteFlag("shutdown", false);
 
@@ -4724,6 +5432,12 @@ bool InitBlockIndex()
     // Use the provided setting for -txindex in the new database
     fTxIndex = GetBoolArg("-txindex", true);
     pblocktree->WriteFlag("txindex", fTxIndex);
+    fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+    pblocktree->WriteFlag("addressindex", fAddressIndex);
+    fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+    pblocktree->WriteFlag("spentindex", fSpentIndex);
+    fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+    pblocktree->WriteFlag("timestampindex", fTimestampIndex);
     LogPrintf("Initializing databases...\n");
 
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
@@ -4741,7 +5455,7 @@ bool InitBlockIndex()
             CBlockIndex* pindex = AddToBlockIndex(block);
             if (!ReceivedBlockTransactions(block, state, pindex, blockPos))
                 return error("LoadBlockIndex() : genesis block not accepted");
-            if (!ActivateBestChain(state, &block))
+            if (!ActivateBestChainInternal(state, boost::make_shared<CBlock>(block), false, false))
                 return error("LoadBlockIndex() : genesis block cannot be activated");
             // Force a chainstate write so that when we VerifyDB in a moment, it doesnt check stale data
             return FlushStateToDisk(state, FLUSH_STATE_ALWAYS);
@@ -4795,7 +5509,8 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
                     dbp->nPos = nBlockPos;
                 blkdat.SetLimit(nBlockPos + nSize);
                 blkdat.SetPos(nBlockPos);
-                CBlock block;
+                boost::shared_ptr<CBlock> pblock = boost::make_shared<CBlock>();
+                CBlock& block = *pblock;
                 blkdat >> block;
                 nRewind = blkdat.GetPos();
 
@@ -4812,7 +5527,7 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
                 // process in case the block isn't known yet
                 if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
                     CValidationState state;
-                    if (ProcessNewBlock(state, NULL, &block, dbp))
+                    if (ProcessNewBlock(state, NULL, pblock, dbp))
                         nLoaded++;
                     if (state.IsError())
                         break;
@@ -4829,13 +5544,15 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
                     std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
                     while (range.first != range.second) {
                         std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        if (ReadBlockFromDisk(block, it->second)) {
-                            LogPrintf("%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
+                        // A fresh block each time, as listeners may still hold the last one
+                        boost::shared_ptr<CBlock> pblockChild = boost::make_shared<CBlock>();
+                        if (ReadBlockFromDisk(*pblockChild, it->second)) {
+                            LogPrintf("%s: Processing out of order child %s of %s\n", __func__, pblockChild->GetHash().ToString(),
                                 head.ToString());
                             CValidationState dummy;
-                            if (ProcessNewBlock(dummy, NULL, &block, &it->second)) {
+                            if (ProcessNewBlock(dummy, NULL, pblockChild, &it->second)) {
                                 nLoaded++;
-                                queue.push_back(block.GetHash());
+                                queue.push_back(pblockChild->GetHash());
                             }
                         }
                         range.first++;
@@ -5921,7 +6638,8 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
     else if (strCommand == "block" && !fImporting && !fReindex) // Ignore blocks received while importing
     {
-        CBlock block;
+        boost::shared_ptr<CBlock> pblock = boost::make_shared<CBlock>();
+        CBlock& block = *pblock;
         vRecv >> block;
         uint256 hashBlock = block.GetHash();
         CInv inv(MSG_BLOCK, hashBlock);
@@ -5943,7 +6661,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
             CValidationState state;
             if (!mapBlockIndex.count(block.GetHash())) {
-                ProcessNewBlock(state, pfrom, &block);
+                ProcessNewBlock(state, pfrom, pblock);
                 int nDoS;
                 if(state.IsInvalid(nDoS)) {
                     pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
@@ -32,6 +32,7 @@
 
 #include <algorithm>
 #include <exception>
+#include <functional>
 #include <map>
 #include <set>
 #include <stdint.h>
@@ -41,9 +42,18 @@
 
 #include "libzerocoin/CoinSpend.h"
 
+#include <boost/shared_ptr.hpp>
 #include <boost/unordered_map.hpp>
 
 class CBlockIndex;
+class CBlockUndo;
+class CBlockFilterDB;
+class CUTXOStatsDB;
+struct CAddressIndexKey;
+struct CAddressUnspentKey;
+struct CAddressUnspentValue;
+struct CSpentIndexKey;
+struct CSpentIndexValue;
 class CBlockTreeDB;
 class CZerocoinDB;
 class CSporkDB;
@@ -56,19 +66,17 @@ class CValidationState;
 struct CBlockTemplate;
 struct CNodeStateStats;
 
+/** Masternode collateral tiers in whole coins, and the heights from which GetMNCollateral() requires them */
+static const int64_t MN_COLLATERAL_TIERS[] = {2000, 4000, 6000, 10000, 25000};
+static const int MN_COLLATERAL_TIER_HEIGHTS[] = {0, 60000, 100000, 150000, 200000};
+static const int MN_COLLATERAL_TIER_COUNT = sizeof(MN_COLLATERAL_TIERS) / sizeof(MN_COLLATERAL_TIERS[0]);
+
 inline int64_t GetMNCollateral(int nHeight) {
 
-	if (nHeight < 60000) {
-		return 2000;
-	} else if (nHeight >= 60000 && nHeight < 100000) {
-		return 4000;
-	} else if (nHeight >= 100000 && nHeight < 150000) {
-		return 6000;
-	} else if (nHeight >= 150000 && nHeight < 200000) {
-		return 10000;
-	} else if (nHeight >= 200000) {
-		return 25000;
-	}
+	int nTier = 0;
+	while (nTier + 1 < MN_COLLATERAL_TIER_COUNT && nHeight >= MN_COLLATERAL_TIER_HEIGHTS[nTier + 1])
+		nTier++;
+	return MN_COLLATERAL_TIERS[nTier];
 }
 
 inline int64_t GetMNCollateralOld(int nHeight) {
@@ -140,6 +148,17 @@ static const unsigned int MAX_REJECT_MESSAGE_LENGTH = 111;
 /** Enable bloom filter */
  static const bool DEFAULT_PEERBLOOMFILTERS = true;
 
+/** Maintain compact block filters for wallet rescans (-blockfilterindex) */
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+
+/** Maintain UTXO set totals and a rolling MuHash for every block (-utxostatsindex) */
+static const bool DEFAULT_UTXOSTATSINDEX = false;
+
+/** Explorer indexes, see addressindex.h (-addressindex, -spentindex, -timestampindex) */
+static const bool DEFAULT_ADDRESSINDEX = false;
+static const bool DEFAULT_SPENTINDEX = false;
+static const bool DEFAULT_TIMESTAMPINDEX = false;
+
 /** "reject" message codes */
 static const unsigned char REJECT_MALFORMED = 0x01;
 static const unsigned char REJECT_INVALID = 0x10;
@@ -169,6 +188,9 @@ extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+extern bool fAddressIndex;
+extern bool fSpentIndex;
+extern bool fTimestampIndex;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
 extern unsigned int nCoinCacheSize;
@@ -202,7 +224,7 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
 void UnregisterAllValidationInterfaces();
 /** Push an updated transaction to all registered wallets */
-void SyncWithWallets(const CTransaction& tx, const CBlock* pblock = NULL);
+void SyncWithWallets(const CTransaction& tx, const boost::shared_ptr<const CBlock>& pblock = boost::shared_ptr<const CBlock>());
 
 /** Register with a network node to receive its signals */
 void RegisterNodeSignals(CNodeSignals& nodeSignals);
@@ -216,11 +238,11 @@ void UnregisterNodeSignals(CNodeSignals& nodeSignals);
  *
  * @param[out]  state   This may be set to an Error state if any error occurred processing it, including during validation/connection/etc of otherwise unrelated blocks during reorganisation; or it may be set to an Invalid state if pblock is itself invalid (but this is not guaranteed even when the block is checked). If you want to *possibly* get feedback on whether pblock is valid, you must also install a CValidationInterface - this will have its BlockChecked method called whenever *any* block completes validation.
  * @param[in]   pfrom   The node which we are receiving the block from; it is added to mapBlockSource and may be penalised if the block is invalid.
- * @param[in]   pblock  The block we want to process.
+ * @param[in]   pblock  The block we want to process. Listeners share it once it connects, so it must not be changed afterwards.
  * @param[out]  dbp     If pblock is stored to disk (or already there), this will be set to its location.
  * @return True if state.IsValid()
  */
-bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDiskBlockPos* dbp = NULL);
+bool ProcessNewBlock(CValidationState& state, CNode* pfrom, const boost::shared_ptr<CBlock>& pblock, CDiskBlockPos* dbp = NULL);
 /** Check whether enough disk space is available for an incoming block */
 bool CheckDiskSpace(uint64_t nAdditionalBytes = 0);
 /** Open a block file (blk?????.dat) */
@@ -250,6 +272,10 @@ bool ProcessMessages(CNode* pfrom);
 bool SendMessages(CNode* pto, bool fSendTrickle);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Build the block filters missing for the active chain, then exit */
+void ThreadBlockFilterIndex();
+/** Bring the UTXO stats index up to the active chain, then exit */
+void ThreadUTXOStatsIndex();
 
 // ***TODO*** probably not the right place for these 2
 /** Check whether a block hash satisfies the proof-of-work requirement specified by nBits */
@@ -270,7 +296,8 @@ double ConvertBitsToDouble(unsigned int nBits);
 int64_t GetMasternodePayment(int nHeight, int64_t blockValue, int nMasternodeCount, bool isZUSERXStake);
 unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader* pblock, bool fProofOfStake);
 
-bool ActivateBestChain(CValidationState& state, CBlock* pblock = NULL, bool fAlreadyChecked = false);
+/** Must not be called with cs_main held, as it waits for the validation queue to shrink */
+bool ActivateBestChain(CValidationState& state, const boost::shared_ptr<CBlock>& pblock = boost::shared_ptr<CBlock>(), bool fAlreadyChecked = false);
 CAmount GetBlockValue(int nHeight);
 
 /** Create a new block index entry for a given block hash */
@@ -330,6 +357,29 @@ struct CDiskTxPos : public CDiskBlockPos {
     }
 };
 
+/** Height and disk position of a transaction tracked by the consensus transaction location index */
+struct CTxLocation {
+    int nHeight;
+    CDiskTxPos pos;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(VARINT(nHeight));
+        READWRITE(pos);
+    }
+
+    CTxLocation(int nHeightIn, const CDiskTxPos& posIn) : nHeight(nHeightIn), pos(posIn) {}
+
+    CTxLocation()
+    {
+        nHeight = -1;
+        pos.SetNull();
+    }
+};
+
 
 CAmount GetMinRelayFee(const CTransaction& tx, unsigned int nBytes, bool fAllowFree);
 bool MoneyRange(CAmount nValueOut);
@@ -381,14 +431,34 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
 void UpdateCoins(const CTransaction& tx, CValidationState& state, CCoinsViewCache& inputs, CTxUndo& txundo, int nHeight);
 
 /** Context-independent validity checks */
-bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state);
+bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state, bool fCacheStore = false);
 bool CheckZerocoinMint(const uint256& txHash, const CTxOut& txout, CValidationState& state, bool fCheckOnly = false);
-bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state);
+bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state, bool fCacheStore);
 bool ContextualCheckZerocoinSpend(const CTransaction& tx, const libzerocoin::CoinSpend& spend, CBlockIndex* pindex);
 bool IsTransactionInChain(const uint256& txId, int& nHeightTx, CTransaction& tx);
 bool IsTransactionInChain(const uint256& txId, int& nHeightTx);
+/** Load the location index of zerocoin transactions, building it from the block files the first time */
+bool LoadTxLocations();
+/** Find a zerocoin transaction in the active chain using the in-memory location index */
+bool GetTxLocation(const uint256& txid, CTxLocation& location);
+/** Whether a transaction containing zerocoins is in the active chain, without reading block files */
+bool IsZerocoinTxInChain(const uint256& txid, int& nHeightTx);
 bool IsBlockHashInChain(const uint256& hashBlock);
 bool ValidOutPoint(const COutPoint out, int nHeight);
+/** Index type and hash of the address an output pays, false if it has none */
+bool GetIndexAddress(const CScript& script, unsigned char& nAddressType, uint160& hashBytes);
+/** Explorer index lookups; these read the block tree database and do not need cs_main */
+bool GetAddressIndex(unsigned char nAddressType, const uint160& hashBytes, std::vector<std::pair<CAddressIndexKey, CAmount> >& vAddressIndex, int nStart = 0, int nEnd = 0);
+bool GetAddressUnspent(unsigned char nAddressType, const uint160& hashBytes, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vUnspentOutputs);
+bool GetSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value);
+bool GetTimestampIndex(unsigned int nHigh, unsigned int nLow, std::vector<uint256>& vHashes);
+/**
+ * Write (fConnect) or remove the enabled explorer index records of a block, as ConnectBlock and
+ * DisconnectBlock do. When disconnecting, view must already hold the restored inputs
+ */
+bool UpdateBlockExplorerIndexes(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, const CCoinsViewCache& view, bool fConnect);
+/** Run fn(i) for every i in [0, nCount) on a worker pool, handing each thread runs of neighbouring blocks */
+void ParallelForBlocks(size_t nCount, const std::function<void(size_t)>& fn);
 void RecalculateZUSERXSpent();
 void RecalculateZUSERXMinted();
 bool RecalculateUSERXSupply(int nHeightStart);
@@ -645,6 +715,9 @@ public:
 /** Find the last common block between the parameter chain and a locator. */
 CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& locator);
 
+/** Find a block index entry by hash, NULL if unknown. Takes cs_main for the lookup only; entries live until shutdown */
+CBlockIndex* LookupBlockIndex(const uint256& hash);
+
 /** Mark a block as invalid. */
 bool InvalidateBlock(CValidationState& state, CBlockIndex* pindex);
 
@@ -666,6 +739,12 @@ extern CZerocoinDB* zerocoinDB;
 /** Global variable that points to the spork database (protected by cs_main) */
 extern CSporkDB* pSporkDB;
 
+/** Global variable that points to the block filter index, NULL if -blockfilterindex=0 */
+extern CBlockFilterDB* pblockfilterdb;
+
+/** Global variable that points to the UTXO stats index, NULL if -utxostatsindex=0 */
+extern CUTXOStatsDB* putxostatsdb;
+
 struct CBlockTemplate {
     CBlock block;
     std::vector<CAmount> vTxFees;
@@ -519,7 +519,12 @@ bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerI
         }
     }
 
-    mapMasternodeBlocks[winnerIn.nBlockHeight].AddPayee(winnerIn.payee, 1);
+    CMasternodeBlockPayees& blockPayees = mapMasternodeBlocks[winnerIn.nBlockHeight];
+    CScript payeeBefore, payeeAfter;
+    bool fHadPayee = blockPayees.GetPayee(payeeBefore);
+    blockPayees.AddPayee(winnerIn.payee, 1);
+    if (blockPayees.GetPayee(payeeAfter) && (!fHadPayee || payeeAfter != payeeBefore))
+        GetMainSignals().UpdatedMasternodeWinner(winnerIn.nBlockHeight, payeeAfter);
 
     return true;
 }
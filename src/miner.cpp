@@ -30,6 +30,7 @@
 #include "zuserxchain.h"
 
 
+#include <boost/make_shared.hpp>
 #include <boost/thread.hpp>
 #include <boost/tuple/tuple.hpp>
 
@@ -303,8 +304,8 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
         TxPriorityCompare comparer(fSortedByFee);
         std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
 
-        vector<CBigNum> vBlockSerials;
-        vector<CBigNum> vTxSerials;
+        std::set<uint256> setBlockSerials;
+        std::set<uint256> setTxSerials;
         while (!vecPriority.empty()) {
             // Take highest priority transaction off the priority queue:
             double dPriority = vecPriority.front().get<0>();
@@ -348,23 +349,24 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
             // double check that there are no double spent zUSERX spends in this block or tx
             if (tx.IsZerocoinSpend()) {
                 int nHeightTx = 0;
-                if (IsTransactionInChain(tx.GetHash(), nHeightTx))
+                if (IsZerocoinTxInChain(tx.GetHash(), nHeightTx))
                     continue;
 
                 bool fDoubleSerial = false;
-                for (const CTxIn txIn : tx.vin) {
-                    if (txIn.scriptSig.IsZerocoinSpend()) {
-                        libzerocoin::CoinSpend spend = TxInToZerocoinSpend(txIn);
-                        bool fUseV1Params = libzerocoin::ExtractVersionFromSerial(spend.getCoinSerialNumber()) < libzerocoin::PrivateCoin::PUBKEY_VERSION;
-                        if (!spend.HasValidSerial(Params().Zerocoin_Params(fUseV1Params)))
+                for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                    if (tx.vin[i].scriptSig.IsZerocoinSpend()) {
+                        CoinSpendRef spend = TxInToZerocoinSpendRef(tx, i);
+                        bool fUseV1Params = libzerocoin::ExtractVersionFromSerial(spend->getCoinSerialNumber()) < libzerocoin::PrivateCoin::PUBKEY_VERSION;
+                        if (!spend->HasValidSerial(Params().Zerocoin_Params(fUseV1Params)))
                             fDoubleSerial = true;
-                        if (count(vBlockSerials.begin(), vBlockSerials.end(), spend.getCoinSerialNumber()))
+                        uint256 hashSerial = GetSerialHash(spend->getCoinSerialNumber());
+                        if (setBlockSerials.count(hashSerial))
                             fDoubleSerial = true;
-                        if (count(vTxSerials.begin(), vTxSerials.end(), spend.getCoinSerialNumber()))
+                        if (setTxSerials.count(hashSerial))
                             fDoubleSerial = true;
                         if (fDoubleSerial)
                             break;
-                        vTxSerials.emplace_back(spend.getCoinSerialNumber());
+                        setTxSerials.insert(hashSerial);
                     }
                 }
                 //This zUSERX serial has already been included in the block, do not add this tx.
@@ -397,8 +399,7 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
             nBlockSigOps += nTxSigOps;
             nFees += nTxFees;
 
-            for (const CBigNum bnSerial : vTxSerials)
-                vBlockSerials.emplace_back(bnSerial);
+            setBlockSerials.insert(setTxSerials.begin(), setTxSerials.end());
 
             if (fPrintPriority) {
                 LogPrintf("priority %.1f fee %s txid %s\n",
@@ -555,9 +556,10 @@ bool ProcessBlockFound(CBlock* pblock, CWallet& wallet, CReserveKey& reservekey)
     // Inform about the new block
     GetMainSignals().BlockFound(pblock->GetHash());
 
-    // Process this block the same as if we had received it from another node
+    // Process this block the same as if we had received it from another node.
+    // Listeners keep the block it is given, so hand over a copy of the template's
     CValidationState state;
-    if (!ProcessNewBlock(state, NULL, pblock)) {
+    if (!ProcessNewBlock(state, NULL, boost::make_shared<CBlock>(*pblock))) {
         if (pblock->IsZerocoinStake())
             pwalletMain->zuserxTracker->RemovePending(pblock->vtx[1].GetHash());
         return error("UserXMiner : ProcessNewBlock, block not accepted");
@@ -624,6 +626,9 @@ void BitcoinMiner(CWallet* pwallet, bool fProofOfStake)
             }
         }
 
+        // Build on a wallet that has seen every block and transaction validated so far
+        SyncWithValidationInterfaceQueue();
+
         //
         // Create new block
         //
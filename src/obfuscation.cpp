@@ -13,6 +13,7 @@
 #include "swifttx.h"
 #include "ui_interface.h"
 #include "util.h"
+#include "validationinterface.h"
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
@@ -2295,6 +2296,10 @@ void ThreadCheckObfuScationPool()
         MilliSleep(1000);
         //LogPrintf("ThreadCheckObfuScationPool::check timeout\n");
 
+        // Masternode activation and denominating pick wallet coins, so let the
+        // wallet catch up with what was validated first
+        SyncWithValidationInterfaceQueue();
+
         // try to sync from all available nodes, one step at a time
         masternodeSync.Process();
 
@@ -389,6 +389,25 @@ void TransactionRecord::updateStatus(const CWalletTx& wtx)
             status.status = TransactionStatus::Confirmed;
         }
     }
+
+    // Once confirmed past the recommended depth (and so past any IX depth bonus) the
+    // status stays Confirmed for as long as the block stays in the active chain
+    status.pindexSettled = NULL;
+    if (status.status == TransactionStatus::Confirmed && pindex && chainActive.Contains(pindex) &&
+        chainActive.Height() - pindex->nHeight + 1 >= RecommendedNumConfirmations)
+        status.pindexSettled = pindex;
+}
+
+bool TransactionRecord::updateDepth()
+{
+    AssertLockHeld(cs_main);
+    if (!status.pindexSettled || !chainActive.Contains(status.pindexSettled))
+        return false;
+
+    status.depth = chainActive.Height() - status.pindexSettled->nHeight + 1;
+    status.cur_num_blocks = chainActive.Height();
+    status.cur_num_ix_locks = nCompleteTXLocks;
+    return true;
 }
 
 bool TransactionRecord::statusUpdateNeeded()
@@ -13,6 +13,7 @@
 #include <QList>
 #include <QString>
 
+class CBlockIndex;
 class CWallet;
 class CWalletTx;
 
@@ -22,7 +23,8 @@ class TransactionStatus
 {
 public:
     TransactionStatus() : countsForBalance(false), sortKey(""),
-                          matures_in(0), status(Offline), depth(0), open_for(0), cur_num_blocks(-1)
+                          matures_in(0), status(Offline), depth(0), open_for(0), cur_num_blocks(-1),
+                          pindexSettled(NULL)
     {
     }
 
@@ -65,6 +67,10 @@ public:
 
     //** Know when to update transaction for ix locks **/
     int cur_num_ix_locks;
+
+    /** Block of a fully confirmed transaction. While it stays in the active chain only the
+        depth changes, so new blocks need no full status update */
+    const CBlockIndex* pindexSettled;
 };
 
 /** UI model for a transaction. A core transaction can be represented by multiple UI transactions if it has
@@ -148,6 +154,11 @@ public:
      */
     void updateStatus(const CWalletTx& wtx);
 
+    /** Update only the depth of a settled transaction, without the wallet tx.
+        Returns false if the status needs a full update.
+     */
+    bool updateDepth();
+
     /** Return whether a status update is needed.
      */
     bool statusUpdateNeeded();
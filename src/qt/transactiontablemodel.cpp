@@ -26,6 +26,12 @@
 #include <QIcon>
 #include <QList>
 
+#include <atomic>
+#include <list>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 // Amount column is right-aligned it contains numbers
 static int column_alignments[] = {
     Qt::AlignLeft | Qt::AlignVCenter, /* status */
@@ -52,13 +58,32 @@ struct TxLessThan {
     }
 };
 
+// Number of wallet transactions decomposed per page by the background loader
+static const int LOAD_PAGE_SIZE = 1000;
+
+// A page of decomposed records, covering the wallet transactions with hashes below hashEnd
+struct TransactionPage {
+    QList<TransactionRecord> records;
+    uint256 hashEnd;
+    bool fLast;
+};
+
 // Private implementation
 class TransactionTablePriv
 {
 public:
     TransactionTablePriv(CWallet* wallet, TransactionTableModel* parent) : wallet(wallet),
-                                                                           parent(parent)
+                                                                           parent(parent),
+                                                                           fLoaded(false),
+                                                                           fStopLoading(false)
+    {
+    }
+
+    ~TransactionTablePriv()
     {
+        fStopLoading = true;
+        if (loadThread.joinable())
+            loadThread.join();
     }
 
     CWallet* wallet;
@@ -70,21 +95,79 @@ public:
      */
     QList<TransactionRecord> cachedWallet;
 
-    /* Query entire wallet anew from core.
+    /* Loading progress. Transactions with hashes from hashLoaded on have not been
+     * loaded yet; the loader picks up their current state when it gets there.
+     */
+    uint256 hashLoaded;
+    bool fLoaded;
+
+    boost::thread loadThread;
+    std::atomic<bool> fStopLoading;
+    CCriticalSection cs_pages;
+    std::list<TransactionPage> listPages;
+
+    /* Query entire wallet anew from core. Records are decomposed a page at a time
+     * on a background thread and handed to the GUI thread through loadPage().
      */
     void refreshWallet()
     {
         qDebug() << "TransactionTablePriv::refreshWallet";
         cachedWallet.clear();
-        {
+        hashLoaded = 0;
+        fLoaded = false;
+        loadThread = boost::thread(boost::bind(&TransactionTablePriv::loadWorker, this));
+    }
+
+    void loadWorker()
+    {
+        uint256 hashNext = 0;
+        while (!fStopLoading) {
             LOCK2(cs_main, wallet->cs_wallet);
-            for (std::map<uint256, CWalletTx>::iterator it = wallet->mapWallet.begin(); it != wallet->mapWallet.end(); ++it) {
+            TransactionPage page;
+            std::map<uint256, CWalletTx>::iterator it = wallet->mapWallet.lower_bound(hashNext);
+            for (int n = 0; it != wallet->mapWallet.end() && n < LOAD_PAGE_SIZE; ++it, ++n) {
                 if (TransactionRecord::showTransaction(it->second))
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wallet, it->second));
+                    page.records.append(TransactionRecord::decomposeTransaction(wallet, it->second));
             }
+            page.fLast = (it == wallet->mapWallet.end());
+            if (!page.fLast)
+                hashNext = page.hashEnd = it->first;
+
+            // Queue the page while still holding cs_wallet, so wallet notifications about
+            // these transactions are delivered after it
+            {
+                LOCK(cs_pages);
+                listPages.push_back(page);
+            }
+            QMetaObject::invokeMethod(parent, "loadPage", Qt::QueuedConnection);
+            if (page.fLast)
+                return;
         }
     }
 
+    /* Append the next loaded page to the model (GUI thread).
+     */
+    void loadPage()
+    {
+        TransactionPage page;
+        {
+            LOCK(cs_pages);
+            if (listPages.empty())
+                return;
+            page = listPages.front();
+            listPages.pop_front();
+        }
+
+        // Pages arrive in hash order and beyond anything already in the model
+        if (!page.records.isEmpty()) {
+            parent->beginInsertRows(QModelIndex(), cachedWallet.size(), cachedWallet.size() + page.records.size() - 1);
+            cachedWallet.append(page.records);
+            parent->endInsertRows();
+        }
+        hashLoaded = page.hashEnd;
+        fLoaded = page.fLast;
+    }
+
     /* Update our model of the wallet incrementally, to synchronize our model of the wallet
        with that of the core.
 
@@ -94,6 +177,11 @@ public:
     {
         qDebug() << "TransactionTablePriv::updateWallet : " + QString::fromStdString(hash.ToString()) + " " + QString::number(status);
 
+        if (!fLoaded && !(hash < hashLoaded)) {
+            qDebug() << "    not loaded yet";
+            return;
+        }
+
         // Find bounds of this transaction in model
         QList<TransactionRecord>::iterator lower = qLowerBound(
             cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
@@ -179,6 +267,10 @@ public:
             // simply re-use the cached status.
             TRY_LOCK(cs_main, lockMain);
             if (lockMain) {
+                // Settled transactions only need their depth updated
+                if (rec->statusUpdateNeeded() && rec->updateDepth())
+                    return rec;
+
                 TRY_LOCK(wallet->cs_wallet, lockWallet);
                 if (lockWallet && rec->statusUpdateNeeded()) {
                     std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(rec->hash);
@@ -241,6 +333,15 @@ void TransactionTableModel::updateTransaction(const QString& hash, int status, b
     priv->updateWallet(updated, status, showTransaction);
 }
 
+void TransactionTableModel::loadPage()
+{
+    // Loaded transactions are not new, keep them from raising notifications
+    bool fProcessing = fProcessingQueuedTransactions;
+    fProcessingQueuedTransactions = true;
+    priv->loadPage();
+    fProcessingQueuedTransactions = fProcessing;
+}
+
 void TransactionTableModel::updateConfirmations()
 {
     // Blocks came in since last poll.
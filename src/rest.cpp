@@ -9,6 +9,7 @@
 #include "primitives/transaction.h"
 #include "main.h"
 #include "httpserver.h"
+#include "jsonstream.h"
 #include "rpcserver.h"
 #include "streams.h"
 #include "sync.h"
@@ -17,6 +18,7 @@
 #include "version.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/dynamic_bitset.hpp>
 
 #include <univalue.h>
@@ -64,6 +66,11 @@ extern UniValue mempoolInfoToJSON();
 extern UniValue mempoolToJSON(bool fVerbose = false);
 extern void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
 extern UniValue blockheaderToJSON(const CBlockIndex* blockindex);
+extern void blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails, CJSONStreamWriter& writer);
+extern void mempoolToJSON(bool fVerbose, CJSONStreamWriter& writer);
+extern std::vector<const CBlockIndex*> GetBlockRange(int nStart, int nCount);
+extern bool WriteBlockRangeEntry(const CBlockIndex* pindex, CDataStream& ss);
+extern void blockRangeToJSON(const std::vector<const CBlockIndex*>& vIndex, CJSONStreamWriter& writer);
 
 static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, string message)
 {
@@ -72,6 +79,13 @@ static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, string message
     return false;
 }
 
+static void WriteJSONChunk(HTTPRequest* req, const std::string& chunk)
+{
+    if (!req->IsChunkedReplyStarted())
+        req->WriteHeader("Content-Type", "application/json");
+    req->WriteReplyChunk(chunk);
+}
+
 static enum RetFormat ParseDataFormat(vector<string>& params, const string& strReq)
 {
     boost::split(params, strReq, boost::is_any_of("."));
@@ -215,11 +229,11 @@ static bool rest_block(HTTPRequest* req,
         pblockindex = mapBlockIndex[hash];
         if (!(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
-
-        if (!ReadBlockFromDisk(block, pblockindex))
-            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
     }
 
+    if (!ReadBlockFromDisk(block, pblockindex))
+        return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+
     CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
     ssBlock << block;
 
@@ -239,10 +253,10 @@ static bool rest_block(HTTPRequest* req,
     }
 
     case RF_JSON: {
-        UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
-        string strJSON = objBlock.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        CJSONStreamWriter writer(boost::bind(&WriteJSONChunk, req, _1));
+        blockToJSON(block, pblockindex, showTxDetails, writer);
+        writer.Finish();
+        req->EndChunkedReply();
         return true;
     }
 
@@ -265,6 +279,90 @@ static bool rest_block_notxdetails(HTTPRequest* req, const std::string& strURIPa
     return rest_block(req, strURIPart, false);
 }
 
+/** Fail a streamed reply: cut it short if it has started, or send an error */
+static bool RESTStreamError(HTTPRequest* req, const std::string& message)
+{
+    if (!req->IsChunkedReplyStarted())
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, message);
+    LogPrintf("REST stream aborted: %s\n", message);
+    req->EndChunkedReply();
+    return false;
+}
+
+static void WriteRangeChunk(HTTPRequest* req, const std::string& contentType, const std::string& chunk)
+{
+    if (!req->IsChunkedReplyStarted())
+        req->WriteHeader("Content-Type", contentType);
+    req->WriteReplyChunk(chunk);
+}
+
+static bool rest_blockrange(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+
+    // /rest/blockrange/<start>/<count>
+    vector<string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+    int32_t nStart, nCount;
+    if (path.size() != 2 || !ParseInt32(path[0], &nStart) || !ParseInt32(path[1], &nCount))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Parse error, expected <start>/<count>: " + params[0]);
+
+    std::vector<const CBlockIndex*> vIndex;
+    try {
+        vIndex = GetBlockRange(nStart, nCount);
+    } catch (const UniValue& objError) {
+        // A bad start or count is the client's; data missing from disk is not found
+        const UniValue& code = find_value(objError, "code");
+        HTTPStatusCode status = (code.isNum() && code.get_int() == RPC_INVALID_PARAMETER) ? HTTP_BAD_REQUEST : HTTP_NOT_FOUND;
+        return RESTERR(req, status, find_value(objError, "message").get_str());
+    }
+
+    switch (rf) {
+    case RF_BINARY:
+    case RF_HEX: {
+        // Each block is followed by its undo data, serialized as in blk*.dat and rev*.dat
+        const std::string contentType = rf == RF_BINARY ? "application/octet-stream" : "text/plain";
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        BOOST_FOREACH (const CBlockIndex* pindex, vIndex) {
+            if (!WriteBlockRangeEntry(pindex, ss))
+                return RESTStreamError(req, strprintf("Can't read block at height %d from disk", pindex->nHeight));
+            if (ss.size() >= CJSONStreamWriter::DEFAULT_FLUSH_SIZE) {
+                WriteRangeChunk(req, contentType, rf == RF_BINARY ? ss.str() : HexStr(ss.begin(), ss.end()));
+                ss.clear();
+            }
+        }
+        if (rf == RF_HEX)
+            WriteRangeChunk(req, contentType, HexStr(ss.begin(), ss.end()) + "\n");
+        else if (!ss.empty())
+            WriteRangeChunk(req, contentType, ss.str());
+        req->EndChunkedReply();
+        return true;
+    }
+
+    case RF_JSON: {
+        CJSONStreamWriter writer(boost::bind(&WriteJSONChunk, req, _1));
+        try {
+            blockRangeToJSON(vIndex, writer);
+        } catch (const UniValue& objError) {
+            return RESTStreamError(req, find_value(objError, "message").get_str());
+        }
+        writer.Finish();
+        req->EndChunkedReply();
+        return true;
+    }
+
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
 static bool rest_chaininfo(HTTPRequest* req, const std::string& strURIPart)
 {
     if (!CheckWarmup(req))
@@ -324,11 +422,10 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RF_JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
-
-        string strJSON = mempoolObject.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        CJSONStreamWriter writer(boost::bind(&WriteJSONChunk, req, _1));
+        mempoolToJSON(true, writer);
+        writer.Finish();
+        req->EndChunkedReply();
         return true;
     }
     default: {
@@ -589,6 +686,80 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+/** Reply with the result of an explorer index RPC, turning its errors into HTTP statuses */
+static bool rest_index_reply(HTTPRequest* req, RetFormat rf, rpcfn_type fn, const UniValue& rpcParams)
+{
+    if (rf != RF_JSON)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+
+    UniValue result;
+    try {
+        result = fn(rpcParams, false);
+    } catch (const UniValue& objError) {
+        const UniValue& code = find_value(objError, "code");
+        HTTPStatusCode status = (code.isNum() && code.get_int() == RPC_MISC_ERROR) ? HTTP_SERVICE_UNAVAILABLE :
+                                (code.isNum() && code.get_int() == RPC_INVALID_PARAMETER) ? HTTP_BAD_REQUEST : HTTP_NOT_FOUND;
+        return RESTERR(req, status, find_value(objError, "message").get_str());
+    } catch (const std::exception& e) {
+        return RESTERR(req, HTTP_BAD_REQUEST, e.what());
+    }
+
+    string strJSON = result.write() + "\n";
+    req->WriteHeader("Content-Type", "application/json");
+    req->WriteReply(HTTP_OK, strJSON);
+    return true;
+}
+
+static bool rest_address(HTTPRequest* req, const std::string& strURIPart, rpcfn_type fn)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+
+    UniValue rpcParams(UniValue::VARR);
+    rpcParams.push_back(params[0]);
+    return rest_index_reply(req, rf, fn, rpcParams);
+}
+
+static bool rest_address_balance(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_address(req, strURIPart, getaddressbalance);
+}
+
+static bool rest_address_utxos(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_address(req, strURIPart, getaddressutxos);
+}
+
+static bool rest_address_txids(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_address(req, strURIPart, getaddresstxids);
+}
+
+static bool rest_spentinfo(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+
+    // /rest/spentinfo/<txid>-<n>
+    vector<string> vOutPoint;
+    boost::split(vOutPoint, params[0], boost::is_any_of("-"));
+    uint256 txid;
+    int32_t nOutput;
+    if (vOutPoint.size() != 2 || !ParseHashStr(vOutPoint[0], txid) || !ParseInt32(vOutPoint[1], &nOutput) || nOutput < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Parse error, expected <txid>-<n>: " + params[0]);
+
+    UniValue outpoint(UniValue::VOBJ);
+    outpoint.push_back(Pair("txid", txid.GetHex()));
+    outpoint.push_back(Pair("index", nOutput));
+    UniValue rpcParams(UniValue::VARR);
+    rpcParams.push_back(outpoint);
+    return rest_index_reply(req, rf, getspentinfo, rpcParams);
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -596,11 +767,16 @@ static const struct {
       {"/rest/tx/", rest_tx},
       {"/rest/block/notxdetails/", rest_block_notxdetails},
       {"/rest/block/", rest_block_extended},
+      {"/rest/blockrange/", rest_blockrange},
       {"/rest/chaininfo", rest_chaininfo},
       {"/rest/mempool/info", rest_mempool_info},
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/address/balance/", rest_address_balance},
+      {"/rest/address/utxos/", rest_address_utxos},
+      {"/rest/address/txids/", rest_address_txids},
+      {"/rest/spentinfo/", rest_spentinfo},
 };
 
 bool StartREST()
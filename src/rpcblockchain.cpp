@@ -8,7 +8,9 @@
 #include "base58.h"
 #include "checkpoints.h"
 #include "clientversion.h"
+#include "jsonstream.h"
 #include "main.h"
+#include "primitives/zerocoin.h"
 #include "rpcserver.h"
 #include "sync.h"
 #include "txdb.h"
@@ -16,6 +18,7 @@
 #include "utilmoneystr.h"
 #include "accumulatormap.h"
 #include "accumulators.h"
+#include "zuserxchain.h"
 
 #include <stdint.h>
 #include <univalue.h>
@@ -53,14 +56,33 @@ double GetDifficulty(const CBlockIndex* blockindex)
     return dDiff;
 }
 
+/**
+ * Where a block sits in the active chain. Only this needs cs_main, and only
+ * briefly: the rest of a block index entry does not change once the block is
+ * connected, so the JSON can be built without holding the lock.
+ */
+static void GetChainPosition(const CBlockIndex* blockindex, int& confirmations, uint256& hashNext)
+{
+    LOCK(cs_main);
+    confirmations = -1;
+    hashNext = 0;
+    // Only report confirmations if the block is on the main chain
+    if (chainActive.Contains(blockindex)) {
+        confirmations = chainActive.Height() - blockindex->nHeight + 1;
+        CBlockIndex* pnext = chainActive.Next(blockindex);
+        if (pnext)
+            hashNext = pnext->GetBlockHash();
+    }
+}
+
 UniValue blockheaderToJSON(const CBlockIndex* blockindex)
 {
+    int confirmations;
+    uint256 hashNext;
+    GetChainPosition(blockindex, confirmations, hashNext);
+
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
-    int confirmations = -1;
-    // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
     result.push_back(Pair("confirmations", confirmations));
     result.push_back(Pair("height", blockindex->nHeight));
     result.push_back(Pair("version", blockindex->nVersion));
@@ -74,60 +96,81 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
 
     if (blockindex->pprev)
         result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex *pnext = chainActive.Next(blockindex);
-    if (pnext)
-        result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
+    if (hashNext != 0)
+        result.push_back(Pair("nextblockhash", hashNext.GetHex()));
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+/** The fields of a block's JSON that come before and after its "tx" array */
+static void blockFieldsToJSON(const CBlock& block, const CBlockIndex* blockindex, UniValue& before, UniValue& after)
 {
-    UniValue result(UniValue::VOBJ);
-    result.push_back(Pair("hash", block.GetHash().GetHex()));
-    int confirmations = -1;
-    // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.push_back(Pair("confirmations", confirmations));
-    result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
-    result.push_back(Pair("height", blockindex->nHeight));
-    result.push_back(Pair("version", block.nVersion));
-    result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-    result.push_back(Pair("acc_checkpoint", block.nAccumulatorCheckpoint.GetHex()));
-    UniValue txs(UniValue::VARR);
-    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
-        if (txDetails) {
-            UniValue objTx(UniValue::VOBJ);
-            TxToJSON(tx, uint256(0), objTx);
-            txs.push_back(objTx);
-        } else
-            txs.push_back(tx.GetHash().GetHex());
-    }
-    result.push_back(Pair("tx", txs));
-    result.push_back(Pair("time", block.GetBlockTime()));
-    result.push_back(Pair("nonce", (uint64_t)block.nNonce));
-    result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-    result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
-    result.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
+    int confirmations;
+    uint256 hashNext;
+    GetChainPosition(blockindex, confirmations, hashNext);
+
+    before.push_back(Pair("hash", block.GetHash().GetHex()));
+    before.push_back(Pair("confirmations", confirmations));
+    before.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
+    before.push_back(Pair("height", blockindex->nHeight));
+    before.push_back(Pair("version", block.nVersion));
+    before.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
+    before.push_back(Pair("acc_checkpoint", block.nAccumulatorCheckpoint.GetHex()));
+
+    after.push_back(Pair("time", block.GetBlockTime()));
+    after.push_back(Pair("nonce", (uint64_t)block.nNonce));
+    after.push_back(Pair("bits", strprintf("%08x", block.nBits)));
+    after.push_back(Pair("difficulty", GetDifficulty(blockindex)));
+    after.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
 
     if (blockindex->pprev)
-        result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex* pnext = chainActive.Next(blockindex);
-    if (pnext)
-        result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
+        after.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
+    if (hashNext != 0)
+        after.push_back(Pair("nextblockhash", hashNext.GetHex()));
 
-    result.push_back(Pair("moneysupply",ValueFromAmount(blockindex->nMoneySupply)));
+    after.push_back(Pair("moneysupply",ValueFromAmount(blockindex->nMoneySupply)));
 
     /* UniValue zuserxObj(UniValue::VOBJ);
     for (auto denom : libzerocoin::zerocoinDenomList) {
         zuserxObj.push_back(Pair(to_string(denom), ValueFromAmount(blockindex->mapZerocoinSupply.at(denom) * (denom*COIN))));
     }
     zuserxObj.push_back(Pair("total", ValueFromAmount(blockindex->GetZerocoinSupply())));
-    result.push_back(Pair("zUSERXsupply", zuserxObj)); */
+    after.push_back(Pair("zUSERXsupply", zuserxObj)); */
+}
+
+static UniValue blockTxToJSON(const CTransaction& tx, bool txDetails)
+{
+    if (!txDetails)
+        return tx.GetHash().GetHex();
+    UniValue objTx(UniValue::VOBJ);
+    TxToJSON(tx, uint256(0), objTx);
+    return objTx;
+}
 
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+{
+    UniValue result(UniValue::VOBJ);
+    UniValue after(UniValue::VOBJ);
+    blockFieldsToJSON(block, blockindex, result, after);
+    UniValue txs(UniValue::VARR);
+    BOOST_FOREACH (const CTransaction& tx, block.vtx)
+        txs.push_back(blockTxToJSON(tx, txDetails));
+    result.push_back(Pair("tx", txs));
+    result.pushKVs(after);
     return result;
 }
 
+/** blockToJSON one transaction at a time, so that only one of them is held as UniValue */
+void blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails, CJSONStreamWriter& writer)
+{
+    UniValue before(UniValue::VOBJ);
+    UniValue after(UniValue::VOBJ);
+    blockFieldsToJSON(block, blockindex, before, after);
+    writer.BeginObject().Fields(before).Key("tx").BeginArray();
+    BOOST_FOREACH (const CTransaction& tx, block.vtx)
+        writer.Value(blockTxToJSON(tx, txDetails));
+    writer.EndArray().Fields(after).EndObject();
+}
+
 UniValue getblockcount(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
@@ -180,36 +223,46 @@ UniValue getdifficulty(const UniValue& params, bool fHelp)
 }
 
 
+/** Requires mempool.cs */
+static UniValue mempoolEntryToJSON(const CTxMemPoolEntry& e, int nTipHeight)
+{
+    UniValue info(UniValue::VOBJ);
+    info.push_back(Pair("size", (int)e.GetTxSize()));
+    info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
+    info.push_back(Pair("time", e.GetTime()));
+    info.push_back(Pair("height", (int)e.GetHeight()));
+    info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
+    info.push_back(Pair("currentpriority", e.GetPriority(nTipHeight)));
+    const CTransaction& tx = e.GetTx();
+    set<string> setDepends;
+    BOOST_FOREACH (const CTxIn& txin, tx.vin) {
+        if (mempool.exists(txin.prevout.hash))
+            setDepends.insert(txin.prevout.hash.ToString());
+    }
+
+    UniValue depends(UniValue::VARR);
+    BOOST_FOREACH(const string& dep, setDepends) {
+        depends.push_back(dep);
+    }
+
+    info.push_back(Pair("depends", depends));
+    return info;
+}
+
+static int GetTipHeight()
+{
+    LOCK(cs_main);
+    return chainActive.Height();
+}
+
 UniValue mempoolToJSON(bool fVerbose = false)
 {
     if (fVerbose) {
+        int nTipHeight = GetTipHeight();
         LOCK(mempool.cs);
         UniValue o(UniValue::VOBJ);
-        BOOST_FOREACH (const PAIRTYPE(uint256, CTxMemPoolEntry) & entry, mempool.mapTx) {
-            const uint256& hash = entry.first;
-            const CTxMemPoolEntry& e = entry.second;
-            UniValue info(UniValue::VOBJ);
-            info.push_back(Pair("size", (int)e.GetTxSize()));
-            info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
-            info.push_back(Pair("time", e.GetTime()));
-            info.push_back(Pair("height", (int)e.GetHeight()));
-            info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
-            info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
-            const CTransaction& tx = e.GetTx();
-            set<string> setDepends;
-            BOOST_FOREACH (const CTxIn& txin, tx.vin) {
-                if (mempool.exists(txin.prevout.hash))
-                    setDepends.insert(txin.prevout.hash.ToString());
-            }
-
-            UniValue depends(UniValue::VARR);
-            BOOST_FOREACH(const string& dep, setDepends) {
-                depends.push_back(dep);
-            }
-
-            info.push_back(Pair("depends", depends));
-            o.push_back(Pair(hash.ToString(), info));
-        }
+        BOOST_FOREACH (const PAIRTYPE(uint256, CTxMemPoolEntry) & entry, mempool.mapTx)
+            o.push_back(Pair(entry.first.ToString(), mempoolEntryToJSON(entry.second, nTipHeight)));
         return o;
     } else {
         vector<uint256> vtxid;
@@ -223,6 +276,26 @@ UniValue mempoolToJSON(bool fVerbose = false)
     }
 }
 
+void mempoolToJSON(bool fVerbose, CJSONStreamWriter& writer)
+{
+    if (fVerbose) {
+        int nTipHeight = GetTipHeight();
+        LOCK(mempool.cs);
+        writer.BeginObject();
+        BOOST_FOREACH (const PAIRTYPE(uint256, CTxMemPoolEntry) & entry, mempool.mapTx)
+            writer.Pair(entry.first.ToString(), mempoolEntryToJSON(entry.second, nTipHeight));
+        writer.EndObject();
+    } else {
+        vector<uint256> vtxid;
+        mempool.queryHashes(vtxid);
+
+        writer.BeginArray();
+        BOOST_FOREACH (const uint256& hash, vtxid)
+            writer.Value(hash.ToString());
+        writer.EndArray();
+    }
+}
+
 UniValue getrawmempool(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() > 1)
@@ -257,8 +330,6 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
             "\nExamples\n" +
             HelpExampleCli("getrawmempool", "true") + HelpExampleRpc("getrawmempool", "true"));
 
-    LOCK(cs_main);
-
     bool fVerbose = false;
     if (params.size() > 0)
         fVerbose = params[0].get_bool();
@@ -266,6 +337,18 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
     return mempoolToJSON(fVerbose);
 }
 
+void getrawmempool_stream(const UniValue& params, CJSONStreamWriter& writer)
+{
+    if (params.size() > 1)
+        getrawmempool(params, true); // throws the usage
+
+    bool fVerbose = false;
+    if (params.size() > 0)
+        fVerbose = params[0].get_bool();
+
+    mempoolToJSON(fVerbose, writer);
+}
+
 UniValue getblockhash(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -292,6 +375,71 @@ UniValue getblockhash(const UniValue& params, bool fHelp)
     return pblockindex->GetBlockHash().GetHex();
 }
 
+UniValue getblockhashes(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 2)
+        throw runtime_error(
+            "getblockhashes high low\n"
+            "\nReturns the hashes of the blocks with low <= block time < high, in time order (requires -timestampindex).\n"
+
+            "\nArguments:\n"
+            "1. high         (numeric, required) The newer block timestamp, exclusive\n"
+            "2. low          (numeric, required) The older block timestamp\n"
+
+            "\nResult:\n"
+            "[\n"
+            "  \"hash\"         (string) The block hash\n"
+            "  ,...\n"
+            "]\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getblockhashes", "1531000000 1530000000") + HelpExampleRpc("getblockhashes", "1531000000, 1530000000"));
+
+    if (!fTimestampIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Timestamp index not enabled, restart with -timestampindex -reindex");
+
+    int64_t nHigh = params[0].get_int64();
+    int64_t nLow = params[1].get_int64();
+    if (nLow < 0 || nHigh < nLow || nHigh > std::numeric_limits<unsigned int>::max())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid timestamp range");
+
+    std::vector<uint256> vHashes;
+    if (!GetTimestampIndex((unsigned int)nHigh, (unsigned int)nLow, vHashes))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for block hashes");
+
+    UniValue result(UniValue::VARR);
+    for (const uint256& hash : vHashes)
+        result.push_back(hash.GetHex());
+    return result;
+}
+
+static std::string EncodeHexBlock(const CBlock& block)
+{
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    ssBlock << block;
+    return HexStr(ssBlock.begin(), ssBlock.end());
+}
+
+/** The block a getblock call asks for, read from disk, and whether it wants JSON */
+static CBlockIndex* ReadBlockForRPC(const UniValue& params, CBlock& block, bool& fVerbose)
+{
+    std::string strHash = params[0].get_str();
+    uint256 hash(strHash);
+
+    fVerbose = true;
+    if (params.size() > 1)
+        fVerbose = params[1].get_bool();
+
+    CBlockIndex* pblockindex = LookupBlockIndex(hash);
+    if (!pblockindex)
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+
+    // Block files are only appended to, so the block is read and converted without cs_main
+    if (!ReadBlockFromDisk(block, pblockindex))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    return pblockindex;
+}
+
 UniValue getblock(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
@@ -332,32 +480,242 @@ UniValue getblock(const UniValue& params, bool fHelp)
             HelpExampleCli("getblock", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\"") +
             HelpExampleRpc("getblock", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\""));
 
-    LOCK(cs_main);
+    CBlock block;
+    bool fVerbose;
+    CBlockIndex* pblockindex = ReadBlockForRPC(params, block, fVerbose);
+    if (!fVerbose)
+        return EncodeHexBlock(block);
 
-    std::string strHash = params[0].get_str();
-    uint256 hash(strHash);
+    return blockToJSON(block, pblockindex);
+}
 
-    bool fVerbose = true;
-    if (params.size() > 1)
-        fVerbose = params[1].get_bool();
+void getblock_stream(const UniValue& params, CJSONStreamWriter& writer)
+{
+    if (params.size() < 1 || params.size() > 2)
+        getblock(params, true); // throws the usage
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    CBlock block;
+    bool fVerbose;
+    CBlockIndex* pblockindex = ReadBlockForRPC(params, block, fVerbose);
+    if (!fVerbose)
+        writer.Value(EncodeHexBlock(block));
+    else
+        blockToJSON(block, pblockindex, false, writer);
+}
+
+/**
+ * The active chain blocks from height nStart, up to nCount of them. Only this
+ * takes cs_main; the blocks and their undo data are read afterwards.
+ */
+std::vector<const CBlockIndex*> GetBlockRange(int nStart, int nCount)
+{
+    if (nCount < 1 || nCount > MAX_BLOCKRANGE_COUNT)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Block count must be between 1 and %d", MAX_BLOCKRANGE_COUNT));
+
+    std::vector<const CBlockIndex*> vIndex;
+    LOCK(cs_main);
+    if (nStart < 0 || nStart > chainActive.Height())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+    int nEnd = std::min(nStart + nCount - 1, chainActive.Height());
+    vIndex.reserve(nEnd - nStart + 1);
+    for (int nHeight = nStart; nHeight <= nEnd; nHeight++) {
+        const CBlockIndex* pindex = chainActive[nHeight];
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA) || (pindex->pprev && !(pindex->nStatus & BLOCK_HAVE_UNDO)))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("Block data at height %d not available", nHeight));
+        vIndex.push_back(pindex);
+    }
+    return vIndex;
+}
+
+/** A block and the prevouts it spends. The genesis block has no undo data */
+bool ReadBlockAndUndo(const CBlockIndex* pindex, CBlock& block, CBlockUndo& blockundo)
+{
+    blockundo.vtxundo.clear();
+    if (!ReadBlockFromDisk(block, pindex))
+        return false;
+    if (!pindex->pprev)
+        return true;
+    return blockundo.ReadFromDisk(pindex->GetUndoPos(), pindex->pprev->GetBlockHash()) &&
+           blockundo.vtxundo.size() + 1 == block.vtx.size();
+}
 
+/** Append a block and its undo data to ss, as binary and hex block ranges carry them */
+bool WriteBlockRangeEntry(const CBlockIndex* pindex, CDataStream& ss)
+{
     CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+    CBlockUndo blockundo;
+    if (!ReadBlockAndUndo(pindex, block, blockundo))
+        return false;
+    ss << block << blockundo;
+    return true;
+}
 
-    if (!ReadBlockFromDisk(block, pblockindex))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+static UniValue zerocoinSpendToJSON(const CTxIn& txin)
+{
+    UniValue spendObj(UniValue::VOBJ);
+    try {
+        libzerocoin::CoinSpend spend = TxInToZerocoinSpend(txin);
+        spendObj.push_back(Pair("serial", spend.getCoinSerialNumber().GetHex()));
+        spendObj.push_back(Pair("serialhash", GetSerialHash(spend.getCoinSerialNumber()).GetHex()));
+        spendObj.push_back(Pair("denomination", libzerocoin::ZerocoinDenominationToInt(spend.getDenomination())));
+        spendObj.push_back(Pair("version", (int)spend.getVersion()));
+    } catch (const std::exception& e) {
+        spendObj.push_back(Pair("error", e.what()));
+    }
+    return spendObj;
+}
 
-    if (!fVerbose) {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
+static UniValue zerocoinMintToJSON(const CTxOut& txout)
+{
+    UniValue mintObj(UniValue::VOBJ);
+    libzerocoin::PublicCoin pubCoin(Params().Zerocoin_Params(false));
+    CValidationState state;
+    try {
+        if (!TxOutToPublicCoin(txout, pubCoin, state)) {
+            mintObj.push_back(Pair("error", "invalid denomination"));
+            return mintObj;
+        }
+        mintObj.push_back(Pair("pubcoinhash", GetPubCoinHash(pubCoin.getValue()).GetHex()));
+        mintObj.push_back(Pair("denomination", libzerocoin::ZerocoinDenominationToInt(pubCoin.getDenomination())));
+    } catch (const std::exception& e) {
+        mintObj.push_back(Pair("error", e.what()));
     }
+    return mintObj;
+}
 
-    return blockToJSON(block, pblockindex);
+/**
+ * One block of a block range in compact form: scripts as hex, and every
+ * input with the value and script of the output it spends, from undo data.
+ */
+static UniValue blockRangeEntryToJSON(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("hash", pindex->GetBlockHash().GetHex()));
+    result.push_back(Pair("height", pindex->nHeight));
+    if (pindex->pprev)
+        result.push_back(Pair("previousblockhash", pindex->pprev->GetBlockHash().GetHex()));
+    result.push_back(Pair("time", block.GetBlockTime()));
+    result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
+
+    UniValue txs(UniValue::VARR);
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = block.vtx[i];
+        // Zerocoin spends have no undo entries for their inputs
+        const CTxUndo* ptxundo = NULL;
+        if (i > 0 && blockundo.vtxundo[i - 1].vprevout.size() == tx.vin.size())
+            ptxundo = &blockundo.vtxundo[i - 1];
+
+        UniValue vin(UniValue::VARR);
+        for (unsigned int j = 0; j < tx.vin.size(); j++) {
+            const CTxIn& txin = tx.vin[j];
+            UniValue in(UniValue::VOBJ);
+            if (tx.IsCoinBase()) {
+                in.push_back(Pair("coinbase", HexStr(txin.scriptSig.begin(), txin.scriptSig.end())));
+            } else if (txin.scriptSig.IsZerocoinSpend()) {
+                in.push_back(Pair("zerocoinspend", zerocoinSpendToJSON(txin)));
+            } else {
+                in.push_back(Pair("txid", txin.prevout.hash.GetHex()));
+                in.push_back(Pair("vout", (int64_t)txin.prevout.n));
+                if (ptxundo) {
+                    const CTxOut& prevout = ptxundo->vprevout[j].txout;
+                    in.push_back(Pair("value", ValueFromAmount(prevout.nValue)));
+                    in.push_back(Pair("scriptPubKey", HexStr(prevout.scriptPubKey.begin(), prevout.scriptPubKey.end())));
+                }
+            }
+            vin.push_back(in);
+        }
+
+        UniValue vout(UniValue::VARR);
+        BOOST_FOREACH (const CTxOut& txout, tx.vout) {
+            UniValue out(UniValue::VOBJ);
+            out.push_back(Pair("value", ValueFromAmount(txout.nValue)));
+            out.push_back(Pair("scriptPubKey", HexStr(txout.scriptPubKey.begin(), txout.scriptPubKey.end())));
+            if (txout.IsZerocoinMint())
+                out.push_back(Pair("zerocoinmint", zerocoinMintToJSON(txout)));
+            vout.push_back(out);
+        }
+
+        UniValue txObj(UniValue::VOBJ);
+        txObj.push_back(Pair("txid", tx.GetHash().GetHex()));
+        txObj.push_back(Pair("vin", vin));
+        txObj.push_back(Pair("vout", vout));
+        txs.push_back(txObj);
+    }
+    result.push_back(Pair("tx", txs));
+    return result;
+}
+
+static UniValue readBlockRangeEntry(const CBlockIndex* pindex)
+{
+    CBlock block;
+    CBlockUndo blockundo;
+    if (!ReadBlockAndUndo(pindex, block, blockundo))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("Can't read block at height %d from disk", pindex->nHeight));
+    return blockRangeEntryToJSON(block, blockundo, pindex);
+}
+
+void blockRangeToJSON(const std::vector<const CBlockIndex*>& vIndex, CJSONStreamWriter& writer)
+{
+    writer.BeginArray();
+    BOOST_FOREACH (const CBlockIndex* pindex, vIndex)
+        writer.Value(readBlockRangeEntry(pindex));
+    writer.EndArray();
+}
+
+UniValue getblockrange(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 2)
+        throw runtime_error(
+            "getblockrange start count\n"
+            "\nReturns up to count consecutive active chain blocks from height start, with the\n"
+            "value and script of every output they spend and decoded zerocoin mints and spends.\n"
+            "Blocks are read from disk one at a time and the reply is streamed.\n"
+
+            "\nArguments:\n"
+            "1. start          (numeric, required) The height of the first block\n"
+            "2. count          (numeric, required) The number of blocks, at most " + std::to_string(MAX_BLOCKRANGE_COUNT) + "\n"
+
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"hash\" : \"hash\",        (string) The block hash\n"
+            "    \"height\" : n,           (numeric) The block height\n"
+            "    \"previousblockhash\" : \"hash\", (string) The hash of the previous block\n"
+            "    \"time\" : ttt,           (numeric) The block time in seconds since epoch (Jan 1 1970 GMT)\n"
+            "    \"size\" : n,             (numeric) The block size\n"
+            "    \"tx\" : [\n"
+            "      {\n"
+            "        \"txid\" : \"id\",      (string) The transaction id\n"
+            "        \"vin\" : [            (array) The inputs, each one of\n"
+            "          { \"coinbase\" : \"hex\" }\n"
+            "          { \"zerocoinspend\" : { \"serial\" : \"hex\", \"serialhash\" : \"hash\", \"denomination\" : n, \"version\" : n } }\n"
+            "          { \"txid\" : \"id\", \"vout\" : n, \"value\" : x.xxx, \"scriptPubKey\" : \"hex\" }\n"
+            "        ],\n"
+            "        \"vout\" : [           (array) The outputs\n"
+            "          { \"value\" : x.xxx, \"scriptPubKey\" : \"hex\", \"zerocoinmint\" : { \"pubcoinhash\" : \"hash\", \"denomination\" : n } }\n"
+            "        ]\n"
+            "      }, ...\n"
+            "    ]\n"
+            "  }, ...\n"
+            "]\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getblockrange", "1000 100") +
+            HelpExampleRpc("getblockrange", "1000, 100"));
+
+    std::vector<const CBlockIndex*> vIndex = GetBlockRange(params[0].get_int(), params[1].get_int());
+    UniValue result(UniValue::VARR);
+    BOOST_FOREACH (const CBlockIndex* pindex, vIndex)
+        result.push_back(readBlockRangeEntry(pindex));
+    return result;
+}
+
+void getblockrange_stream(const UniValue& params, CJSONStreamWriter& writer)
+{
+    if (params.size() != 2)
+        getblockrange(params, true); // throws the usage
+
+    blockRangeToJSON(GetBlockRange(params[0].get_int(), params[1].get_int()), writer);
 }
 
 UniValue getblockheader(const UniValue& params, bool fHelp)
@@ -396,11 +754,10 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
     if (params.size() > 1)
         fVerbose = params[1].get_bool();
 
-    if (mapBlockIndex.count(hash) == 0)
+    CBlockIndex* pblockindex = LookupBlockIndex(hash);
+    if (!pblockindex)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
-
     if (!fVerbose) {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
         ssBlock << pblockindex->GetBlockHeader();
@@ -413,30 +770,74 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
 
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.size() > 1)
         throw runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( hash_or_height )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "Without an argument the set is scanned at the current tip, which may take some time but does not block the node.\n"
+            "With a block hash or height the totals after that block are returned at once; this needs -utxostatsindex.\n"
+
+            "\nArguments:\n"
+            "1. hash_or_height   (string or numeric, optional) The block to return the totals after\n"
 
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
-            "  \"transactions\": n,      (numeric) The number of transactions\n"
+            "  \"transactions\": n,      (numeric) The number of transactions, not given for a block\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
-            "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
-            "  \"total_amount\": x.xxx          (numeric) The total amount\n"
+            "  \"bytes_serialized\": n,  (numeric) The serialized size, not given for a block\n"
+            "  \"hash_serialized\": \"hash\",   (string) The serialized hash, not given for a block\n"
+            "  \"muhash\": \"hash\",     (string) The MuHash3072 of the unspent outputs, which does not depend on their order\n"
+            "  \"total_amount\": x.xxx,         (numeric) The total amount\n"
+            "  \"money_supply\": x.xxx          (numeric) The money supply recorded for the block, only given for a block\n"
             "}\n"
 
             "\nExamples:\n" +
-            HelpExampleCli("gettxoutsetinfo", "") + HelpExampleRpc("gettxoutsetinfo", ""));
-
-    LOCK(cs_main);
+            HelpExampleCli("gettxoutsetinfo", "") + HelpExampleCli("gettxoutsetinfo", "1000") + HelpExampleRpc("gettxoutsetinfo", ""));
 
     UniValue ret(UniValue::VOBJ);
 
+    if (params.size() > 0) {
+        if (!putxostatsdb)
+            throw JSONRPCError(RPC_MISC_ERROR, "UTXO stats index not enabled, restart with -utxostatsindex");
+
+        uint256 hashBlock;
+        CAmount nMoneySupply;
+        {
+            LOCK(cs_main);
+            CBlockIndex* pindex = NULL;
+            int32_t nHeight;
+            if (params[0].isNum() || ParseInt32(params[0].get_str(), &nHeight)) {
+                if (params[0].isNum())
+                    nHeight = params[0].get_int();
+                if (nHeight < 0 || nHeight > chainActive.Height())
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+                pindex = chainActive[nHeight];
+            } else {
+                BlockMap::iterator mi = mapBlockIndex.find(ParseHashV(params[0], "hash_or_height"));
+                if (mi == mapBlockIndex.end())
+                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+                pindex = mi->second;
+            }
+            hashBlock = pindex->GetBlockHash();
+            nMoneySupply = pindex->nMoneySupply;
+        }
+
+        CUTXOSetStats stats;
+        if (!putxostatsdb->ReadStats(hashBlock, stats))
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not in the UTXO stats index yet");
+        ret.push_back(Pair("height", (int64_t)stats.nHeight));
+        ret.push_back(Pair("bestblock", hashBlock.GetHex()));
+        ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
+        ret.push_back(Pair("muhash", stats.hashMuHash.GetHex()));
+        ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+        ret.push_back(Pair("money_supply", ValueFromAmount(nMoneySupply)));
+        return ret;
+    }
+
+    // The scan works on a database snapshot and takes cs_main only to flush
+    // and to look up the height, so blocks keep connecting while it runs
     CCoinsStats stats;
     FlushStateToDisk();
     if (pcoinsTip->GetStats(stats)) {
@@ -446,6 +847,7 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
         ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
         ret.push_back(Pair("bytes_serialized", (int64_t)stats.nSerializedSize));
         ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
+        ret.push_back(Pair("muhash", stats.hashMuHash.GetHex()));
         ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
     }
     return ret;
@@ -49,6 +49,12 @@ static const CRPCConvertParam vRPCConvertParams[] =
         {"getbalance", 1},
         {"getbalance", 2},
         {"getblockhash", 0},
+        {"getblockhashes", 0},
+        {"getblockhashes", 1},
+        {"getspentinfo", 0},
+        {"getaddressbalance", 0},
+        {"getaddressutxos", 0},
+        {"getaddresstxids", 0},
         {"move", 2},
         {"move", 3},
         {"sendfrom", 2},
@@ -56,6 +62,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
         {"listtransactions", 1},
         {"listtransactions", 2},
         {"listtransactions", 3},
+        {"listtransactions", 4},
         {"listaccounts", 0},
         {"listaccounts", 1},
         {"walletpassphrase", 1},
@@ -73,8 +80,12 @@ static const CRPCConvertParam vRPCConvertParams[] =
         {"listunspent", 1},
         {"listunspent", 2},
         {"listunspent", 3},
+        {"listunspent", 4},
+        {"listunspent", 5},
         {"getblock", 1},
         {"getblockheader", 1},
+        {"getblockrange", 0},
+        {"getblockrange", 1},
         {"gettransaction", 1},
         {"getrawtransaction", 1},
         {"createrawtransaction", 0},
@@ -5,6 +5,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "addressindex.h"
 #include "base58.h"
 #include "clientversion.h"
 #include "init.h"
@@ -550,6 +551,251 @@ UniValue setmocktime(const UniValue& params, bool fHelp)
     return NullUniValue;
 }
 
+/** The addresses named by a getaddress* argument, either one address or {"addresses": [...]} */
+static void ParseIndexAddresses(const UniValue& param, std::vector<std::pair<unsigned char, uint160> >& vAddresses)
+{
+    std::vector<std::string> vStrings;
+    if (param.isStr()) {
+        vStrings.push_back(param.get_str());
+    } else if (param.isObject()) {
+        const UniValue& addresses = find_value(param.get_obj(), "addresses");
+        if (!addresses.isArray())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Addresses is expected to be an array");
+        for (unsigned int i = 0; i < addresses.size(); i++)
+            vStrings.push_back(addresses[i].get_str());
+    } else {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected an address or an object with an addresses array");
+    }
+
+    for (const std::string& strAddress : vStrings) {
+        CBitcoinAddress address(strAddress);
+        CKeyID keyID;
+        if (address.GetKeyID(keyID))
+            vAddresses.push_back(make_pair((unsigned char)ADDRESS_INDEX_PUBKEYHASH, uint160(keyID)));
+        else if (address.IsScript())
+            vAddresses.push_back(make_pair((unsigned char)ADDRESS_INDEX_SCRIPTHASH, uint160(boost::get<CScriptID>(address.Get()))));
+        else
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address: " + strAddress);
+    }
+}
+
+static std::string IndexAddressToString(unsigned char nAddressType, const uint160& hashBytes)
+{
+    if (nAddressType == ADDRESS_INDEX_SCRIPTHASH)
+        return CBitcoinAddress(CScriptID(hashBytes)).ToString();
+    return CBitcoinAddress(CKeyID(hashBytes)).ToString();
+}
+
+static void EnsureAddressIndex()
+{
+    if (!fAddressIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled, restart with -addressindex -reindex");
+}
+
+UniValue getaddressbalance(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddressbalance \"userxaddress\"|{\"addresses\": [\"userxaddress\",...]}\n"
+            "\nReturns the balance of one or more addresses (requires -addressindex).\n"
+
+            "\nArguments:\n"
+            "1. \"userxaddress\"     (string) The address, or an object with an array of addresses\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"balance\" : x.xxx,     (numeric) The current balance in UserX\n"
+            "  \"received\" : x.xxx     (numeric) The total amount received in UserX, including change\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getaddressbalance", "'{\"addresses\": [\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\"]}'") +
+            HelpExampleRpc("getaddressbalance", "{\"addresses\": [\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\"]}"));
+
+    EnsureAddressIndex();
+    std::vector<std::pair<unsigned char, uint160> > vAddresses;
+    ParseIndexAddresses(params[0], vAddresses);
+
+    CAmount nBalance = 0;
+    CAmount nReceived = 0;
+    for (const auto& address : vAddresses) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vAddressIndex;
+        if (!GetAddressIndex(address.first, address.second, vAddressIndex))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+
+        for (const auto& entry : vAddressIndex) {
+            if (entry.second > 0)
+                nReceived += entry.second;
+            nBalance += entry.second;
+        }
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("balance", ValueFromAmount(nBalance)));
+    result.push_back(Pair("received", ValueFromAmount(nReceived)));
+    return result;
+}
+
+UniValue getaddressutxos(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddressutxos \"userxaddress\"|{\"addresses\": [\"userxaddress\",...]}\n"
+            "\nReturns the unspent outputs of one or more addresses (requires -addressindex).\n"
+
+            "\nArguments:\n"
+            "1. \"userxaddress\"     (string) The address, or an object with an array of addresses\n"
+
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"address\" : \"userxaddress\", (string) The address\n"
+            "    \"txid\" : \"hash\",            (string) The transaction id\n"
+            "    \"outputIndex\" : n,          (numeric) The output index\n"
+            "    \"script\" : \"hex\",           (string) The script hex\n"
+            "    \"amount\" : x.xxx,           (numeric) The output value in UserX\n"
+            "    \"height\" : n                (numeric) The height of the block containing the output\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\"]}'") +
+            HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\"]}"));
+
+    EnsureAddressIndex();
+    std::vector<std::pair<unsigned char, uint160> > vAddresses;
+    ParseIndexAddresses(params[0], vAddresses);
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspentOutputs;
+    for (const auto& address : vAddresses) {
+        if (!GetAddressUnspent(address.first, address.second, vUnspentOutputs))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    }
+
+    std::stable_sort(vUnspentOutputs.begin(), vUnspentOutputs.end(),
+        [](const std::pair<CAddressUnspentKey, CAddressUnspentValue>& a, const std::pair<CAddressUnspentKey, CAddressUnspentValue>& b) {
+            return a.second.nHeight < b.second.nHeight;
+        });
+
+    UniValue result(UniValue::VARR);
+    for (const auto& output : vUnspentOutputs) {
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("address", IndexAddressToString(output.first.nAddressType, output.first.hashBytes)));
+        entry.push_back(Pair("txid", output.first.txhash.GetHex()));
+        entry.push_back(Pair("outputIndex", (int)output.first.nIndex));
+        entry.push_back(Pair("script", HexStr(output.second.script.begin(), output.second.script.end())));
+        entry.push_back(Pair("amount", ValueFromAmount(output.second.nSatoshis)));
+        entry.push_back(Pair("height", output.second.nHeight));
+        result.push_back(entry);
+    }
+    return result;
+}
+
+UniValue getaddresstxids(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddresstxids \"userxaddress\"|{\"addresses\": [\"userxaddress\",...], \"start\": n, \"end\": n}\n"
+            "\nReturns the ids of the transactions that paid to or spent from one or more addresses,\n"
+            "in chain order (requires -addressindex).\n"
+
+            "\nArguments:\n"
+            "1. \"userxaddress\"     (string) The address, or an object with an array of addresses and\n"
+            "                        optionally the start and end heights (inclusive) to look at\n"
+
+            "\nResult:\n"
+            "[\n"
+            "  \"transactionid\"  (string) The transaction id\n"
+            "  ,...\n"
+            "]\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\"]}'") +
+            HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\"], \"start\": 1000, \"end\": 2000}"));
+
+    EnsureAddressIndex();
+    std::vector<std::pair<unsigned char, uint160> > vAddresses;
+    ParseIndexAddresses(params[0], vAddresses);
+
+    int nStart = 0;
+    int nEnd = 0;
+    if (params[0].isObject()) {
+        const UniValue& start = find_value(params[0].get_obj(), "start");
+        const UniValue& end = find_value(params[0].get_obj(), "end");
+        if (start.isNum() && end.isNum()) {
+            nStart = start.get_int();
+            nEnd = end.get_int();
+            if (nStart <= 0 || nEnd < nStart)
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Start and end must be positive heights with start <= end");
+        }
+    }
+
+    std::vector<std::pair<int, uint256> > vTxids;
+    for (const auto& address : vAddresses) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vAddressIndex;
+        if (!GetAddressIndex(address.first, address.second, vAddressIndex, nStart, nEnd))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+
+        for (const auto& entry : vAddressIndex)
+            vTxids.push_back(make_pair(entry.first.nHeight, entry.first.txhash));
+    }
+
+    // An address's records are already in chain order; several addresses have to be merged
+    std::sort(vTxids.begin(), vTxids.end());
+    std::set<uint256> setSeen;
+    UniValue result(UniValue::VARR);
+    for (const auto& txid : vTxids) {
+        if (setSeen.insert(txid.second).second)
+            result.push_back(txid.second.GetHex());
+    }
+    return result;
+}
+
+UniValue getspentinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1 || !params[0].isObject())
+        throw runtime_error(
+            "getspentinfo {\"txid\": \"hash\", \"index\": n}\n"
+            "\nReturns the transaction input that spent an output (requires -spentindex).\n"
+
+            "\nArguments:\n"
+            "1. {\n"
+            "     \"txid\" : \"hash\",  (string, required) The id of the transaction with the output\n"
+            "     \"index\" : n       (numeric, required) The output index\n"
+            "   }\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"txid\" : \"hash\",  (string) The id of the spending transaction\n"
+            "  \"index\" : n,      (numeric) The spending input index\n"
+            "  \"height\" : n      (numeric) The height of the block containing the spending transaction\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getspentinfo", "'{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}'") +
+            HelpExampleRpc("getspentinfo", "{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}"));
+
+    if (!fSpentIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Spent index not enabled, restart with -spentindex -reindex");
+
+    const UniValue& txid = find_value(params[0].get_obj(), "txid");
+    const UniValue& index = find_value(params[0].get_obj(), "index");
+    if (!txid.isStr() || !index.isNum())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid txid or index");
+
+    CSpentIndexKey key(ParseHashV(txid, "txid"), index.get_int());
+    CSpentIndexValue value;
+    if (!GetSpentIndex(key, value))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info");
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("txid", value.txid.GetHex()));
+    result.push_back(Pair("index", (int)value.nInputIndex));
+    result.push_back(Pair("height", value.nHeight));
+    return result;
+}
+
 #ifdef ENABLE_WALLET
 UniValue getstakingstatus(const UniValue& params, bool fHelp)
 {
@@ -96,6 +96,7 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
 
     if (hashBlock != 0) {
         entry.push_back(Pair("blockhash", hashBlock.GetHex()));
+        LOCK(cs_main);
         BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
         if (mi != mapBlockIndex.end() && (*mi).second) {
             CBlockIndex* pindex = (*mi).second;
@@ -172,8 +173,6 @@ UniValue getrawtransaction(const UniValue& params, bool fHelp)
             "\nExamples:\n" +
             HelpExampleCli("getrawtransaction", "\"mytxid\"") + HelpExampleCli("getrawtransaction", "\"mytxid\" 1") + HelpExampleRpc("getrawtransaction", "\"mytxid\", 1"));
 
-    LOCK(cs_main);
-
     uint256 hash = ParseHashV(params[0], "parameter 1");
 
     bool fVerbose = false;
@@ -199,9 +198,9 @@ UniValue getrawtransaction(const UniValue& params, bool fHelp)
 #ifdef ENABLE_WALLET
 UniValue listunspent(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() > 4)
+    if (fHelp || params.size() > 6)
         throw runtime_error(
-            "listunspent ( minconf maxconf  [\"address\",...] )\n"
+            "listunspent ( minconf maxconf  [\"address\",...] watchonlyconfig limit {\"txid\":\"id\",\"vout\":n} )\n"
             "\nReturns array of unspent transaction outputs\n"
             "with between minconf and maxconf (inclusive) confirmations.\n"
             "Optionally filter to only include txouts paid to specified addresses.\n"
@@ -217,6 +216,13 @@ UniValue listunspent(const UniValue& params, bool fHelp)
             "      ,...\n"
             "    ]\n"
             "4. watchonlyconfig  (numberic, optional, default=1) 1 = list regular unspent transactions, 2 = list only watchonly transactions,  3 = list all unspent transactions (including watchonly)\n"
+            "5. limit            (numeric, optional, default=0) Return at most this many outputs, 0 for all\n"
+            "6. after            (json object, optional) Return only outputs after this one, for paging with 'limit'\n"
+            "    {\n"
+            "      \"txid\":\"id\",  (string, required) The transaction id of the last output of the previous page\n"
+            "      \"vout\":n        (numeric, required) The output number\n"
+            "    }\n"
+            "Outputs are ordered by txid and vout.\n"
 
             "\nResult\n"
             "[                   (array of json object)\n"
@@ -235,7 +241,7 @@ UniValue listunspent(const UniValue& params, bool fHelp)
             "\nExamples\n" +
             HelpExampleCli("listunspent", "") + HelpExampleCli("listunspent", "6 9999999 \"[\\\"1PGFqEzfmQch1gKD3ra4k18PNj3tTUUSqg\\\",\\\"1LtvqCaApEdUGFkpKMM4MstjcaL4dKg8SP\\\"]\"") + HelpExampleRpc("listunspent", "6, 9999999 \"[\\\"1PGFqEzfmQch1gKD3ra4k18PNj3tTUUSqg\\\",\\\"1LtvqCaApEdUGFkpKMM4MstjcaL4dKg8SP\\\"]\""));
 
-    RPCTypeCheck(params, boost::assign::list_of(UniValue::VNUM)(UniValue::VNUM)(UniValue::VARR)(UniValue::VNUM));
+    RPCTypeCheck(params, boost::assign::list_of(UniValue::VNUM)(UniValue::VNUM)(UniValue::VARR)(UniValue::VNUM)(UniValue::VNUM)(UniValue::VOBJ));
 
     int nMinDepth = 1;
     if (params.size() > 0)
@@ -266,49 +272,79 @@ UniValue listunspent(const UniValue& params, bool fHelp)
             nWatchonlyConfig = 1;
     }
 
+    int nLimit = 0;
+    if (params.size() > 4) {
+        nLimit = params[4].get_int();
+        if (nLimit < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative limit");
+    }
+
+    COutPoint outpointAfter;
+    bool fAfter = false;
+    if (params.size() > 5) {
+        const UniValue& after = params[5].get_obj();
+        RPCTypeCheckObj(after, boost::assign::map_list_of("txid", UniValue::VSTR)("vout", UniValue::VNUM));
+        outpointAfter = COutPoint(ParseHashO(after, "txid"), find_value(after, "vout").get_int());
+        fAfter = true;
+    }
+
     UniValue results(UniValue::VARR);
     vector<COutput> vecOutputs;
     assert(pwalletMain != NULL);
     LOCK2(cs_main, pwalletMain->cs_wallet);
-    pwalletMain->AvailableCoins(vecOutputs, false, NULL, false, ALL_COINS, false, nWatchonlyConfig);
-    BOOST_FOREACH (const COutput& out, vecOutputs) {
-        if (out.nDepth < nMinDepth || out.nDepth > nMaxDepth)
-            continue;
 
-        if (setAddress.size()) {
-            CTxDestination address;
-            if (!ExtractDestination(out.tx->vout[out.i].scriptPubKey, address))
+    // Fetch candidates in pages, so a limited listing stops once it has enough
+    // outputs that pass the filters below.
+    const unsigned int nPageSize = nLimit ? std::max(nLimit, 100) : 0;
+    while (true) {
+        pwalletMain->AvailableCoins(vecOutputs, false, NULL, false, ALL_COINS, false, nWatchonlyConfig, fAfter ? &outpointAfter : NULL, nPageSize);
+        BOOST_FOREACH (const COutput& out, vecOutputs) {
+            if (nLimit && (int)results.size() >= nLimit)
+                break;
+            outpointAfter = COutPoint(out.tx->GetHash(), out.i);
+            fAfter = true;
+
+            if (out.nDepth < nMinDepth || out.nDepth > nMaxDepth)
                 continue;
 
-            if (!setAddress.count(address))
-                continue;
-        }
+            if (setAddress.size()) {
+                CTxDestination address;
+                if (!ExtractDestination(out.tx->vout[out.i].scriptPubKey, address))
+                    continue;
 
-        CAmount nValue = out.tx->vout[out.i].nValue;
-        const CScript& pk = out.tx->vout[out.i].scriptPubKey;
-        UniValue entry(UniValue::VOBJ);
-        entry.push_back(Pair("txid", out.tx->GetHash().GetHex()));
-        entry.push_back(Pair("vout", out.i));
-        CTxDestination address;
-        if (ExtractDestination(out.tx->vout[out.i].scriptPubKey, address)) {
-            entry.push_back(Pair("address", CBitcoinAddress(address).ToString()));
-            if (pwalletMain->mapAddressBook.count(address))
-                entry.push_back(Pair("account", pwalletMain->mapAddressBook[address].name));
-        }
-        entry.push_back(Pair("scriptPubKey", HexStr(pk.begin(), pk.end())));
-        if (pk.IsPayToScriptHash()) {
+                if (!setAddress.count(address))
+                    continue;
+            }
+
+            CAmount nValue = out.tx->vout[out.i].nValue;
+            const CScript& pk = out.tx->vout[out.i].scriptPubKey;
+            UniValue entry(UniValue::VOBJ);
+            entry.push_back(Pair("txid", out.tx->GetHash().GetHex()));
+            entry.push_back(Pair("vout", out.i));
             CTxDestination address;
-            if (ExtractDestination(pk, address)) {
-                const CScriptID& hash = boost::get<CScriptID>(address);
-                CScript redeemScript;
-                if (pwalletMain->GetCScript(hash, redeemScript))
-                    entry.push_back(Pair("redeemScript", HexStr(redeemScript.begin(), redeemScript.end())));
+            if (ExtractDestination(out.tx->vout[out.i].scriptPubKey, address)) {
+                entry.push_back(Pair("address", CBitcoinAddress(address).ToString()));
+                if (pwalletMain->mapAddressBook.count(address))
+                    entry.push_back(Pair("account", pwalletMain->mapAddressBook[address].name));
+            }
+            entry.push_back(Pair("scriptPubKey", HexStr(pk.begin(), pk.end())));
+            if (pk.IsPayToScriptHash()) {
+                CTxDestination address;
+                if (ExtractDestination(pk, address)) {
+                    const CScriptID& hash = boost::get<CScriptID>(address);
+                    CScript redeemScript;
+                    if (pwalletMain->GetCScript(hash, redeemScript))
+                        entry.push_back(Pair("redeemScript", HexStr(redeemScript.begin(), redeemScript.end())));
+                }
             }
+            entry.push_back(Pair("amount", ValueFromAmount(nValue)));
+            entry.push_back(Pair("confirmations", out.nDepth));
+            entry.push_back(Pair("spendable", out.fSpendable));
+            results.push_back(entry);
         }
-        entry.push_back(Pair("amount", ValueFromAmount(nValue)));
-        entry.push_back(Pair("confirmations", out.nDepth));
-        entry.push_back(Pair("spendable", out.fSpendable));
-        results.push_back(entry);
+
+        if (!nPageSize || vecOutputs.size() < nPageSize || (int)results.size() >= nLimit)
+            break;
     }
 
     return results;
@@ -346,7 +382,6 @@ UniValue createrawtransaction(const UniValue& params, bool fHelp)
             "\nExamples\n" +
             HelpExampleCli("createrawtransaction", "\"[{\\\"txid\\\":\\\"myid\\\",\\\"vout\\\":0}]\" \"{\\\"address\\\":0.01}\"") + HelpExampleRpc("createrawtransaction", "\"[{\\\"txid\\\":\\\"myid\\\",\\\"vout\\\":0}]\", \"{\\\"address\\\":0.01}\""));
 
-    LOCK(cs_main);
     RPCTypeCheck(params, boost::assign::list_of(UniValue::VARR)(UniValue::VOBJ));
 
     UniValue inputs = params[0].get_array();
@@ -441,7 +476,6 @@ UniValue decoderawtransaction(const UniValue& params, bool fHelp)
             "\nExamples:\n" +
             HelpExampleCli("decoderawtransaction", "\"hexstring\"") + HelpExampleRpc("decoderawtransaction", "\"hexstring\""));
 
-    LOCK(cs_main);
     RPCTypeCheck(params, boost::assign::list_of(UniValue::VSTR));
 
     CTransaction tx;
@@ -481,7 +515,6 @@ UniValue decodescript(const UniValue& params, bool fHelp)
             "\nExamples:\n" +
             HelpExampleCli("decodescript", "\"hexstring\"") + HelpExampleRpc("decodescript", "\"hexstring\""));
 
-    LOCK(cs_main);
     RPCTypeCheck(params, boost::assign::list_of(UniValue::VSTR));
 
     UniValue r(UniValue::VOBJ);
@@ -14,6 +14,7 @@
 #include "sync.h"
 #include "ui_interface.h"
 #include "util.h"
+#include "validationinterface.h"
 #include "utilstrencodings.h"
 
 #include <boost/bind.hpp>
@@ -26,6 +27,8 @@
 #include <boost/thread.hpp>
 #include <boost/algorithm/string/case_conv.hpp> // for to_upper()
 
+#include <atomic>
+
 #include <univalue.h>
 
 using namespace RPCServer;
@@ -276,181 +279,189 @@ UniValue stop(const UniValue& params, bool fHelp)
  */
 static const CRPCCommand vRPCCommands[] =
     {
-        //  category              name                      actor (function)         okSafeMode threadSafe reqWallet
-        //  --------------------- ------------------------  -----------------------  ---------- ---------- ---------
+        //  category              name                      actor (function)         okSafeMode threadSafe reqWallet readOnly streamActor
+        //  --------------------- ------------------------  -----------------------  ---------- ---------- --------- --------
         /* Overall control/query calls */
-        {"control", "getinfo", &getinfo, true, false, false}, /* uses wallet if enabled */
-        {"control", "help", &help, true, true, false},
-        {"control", "stop", &stop, true, true, false},
+        {"control", "getinfo", &getinfo, true, false, false, false, NULL}, /* uses wallet if enabled */
+        {"control", "help", &help, true, true, false, true, NULL},
+        {"control", "stop", &stop, true, true, false, false, NULL},
 
         /* P2P networking */
-        {"network", "getnetworkinfo", &getnetworkinfo, true, false, false},
-        {"network", "addnode", &addnode, true, true, false},
-        {"network", "disconnectnode", &disconnectnode, true, true, false},
-        {"network", "getaddednodeinfo", &getaddednodeinfo, true, true, false},
-        {"network", "getconnectioncount", &getconnectioncount, true, false, false},
-        {"network", "getnettotals", &getnettotals, true, true, false},
-        {"network", "getpeerinfo", &getpeerinfo, true, false, false},
-        {"network", "ping", &ping, true, false, false},
-        {"network", "setban", &setban, true, false, false},
-        {"network", "listbanned", &listbanned, true, false, false},
-        {"network", "clearbanned", &clearbanned, true, false, false},
+        {"network", "getnetworkinfo", &getnetworkinfo, true, false, false, true, NULL},
+        {"network", "addnode", &addnode, true, true, false, false, NULL},
+        {"network", "disconnectnode", &disconnectnode, true, true, false, false, NULL},
+        {"network", "getaddednodeinfo", &getaddednodeinfo, true, true, false, false, NULL},
+        {"network", "getconnectioncount", &getconnectioncount, true, false, false, true, NULL},
+        {"network", "getnettotals", &getnettotals, true, true, false, true, NULL},
+        {"network", "getpeerinfo", &getpeerinfo, true, false, false, true, NULL},
+        {"network", "ping", &ping, true, false, false, false, NULL},
+        {"network", "setban", &setban, true, false, false, false, NULL},
+        {"network", "listbanned", &listbanned, true, false, false, true, NULL},
+        {"network", "clearbanned", &clearbanned, true, false, false, false, NULL},
 
         /* Block chain and UTXO */
-        {"blockchain", "findserial", &findserial, true, false, false},
-        {"blockchain", "getaccumulatorvalues", &getaccumulatorvalues, true, false, false},
-        {"blockchain", "getblockchaininfo", &getblockchaininfo, true, false, false},
-        {"blockchain", "getbestblockhash", &getbestblockhash, true, false, false},
-        {"blockchain", "getblockcount", &getblockcount, true, false, false},
-        {"blockchain", "getblock", &getblock, true, false, false},
-        {"blockchain", "getblockhash", &getblockhash, true, false, false},
-        {"blockchain", "getblockheader", &getblockheader, false, false, false},
-        {"blockchain", "getchaintips", &getchaintips, true, false, false},
-        {"blockchain", "getdifficulty", &getdifficulty, true, false, false},
-        {"blockchain", "getfeeinfo", &getfeeinfo, true, false, false},
-        {"blockchain", "getmempoolinfo", &getmempoolinfo, true, true, false},
-        {"blockchain", "getrawmempool", &getrawmempool, true, false, false},
-        {"blockchain", "gettxout", &gettxout, true, false, false},
-        {"blockchain", "gettxoutsetinfo", &gettxoutsetinfo, true, false, false},
-        {"blockchain", "invalidateblock", &invalidateblock, true, true, false},
-        {"blockchain", "reconsiderblock", &reconsiderblock, true, true, false},
-        {"blockchain", "verifychain", &verifychain, true, false, false},
+        {"blockchain", "findserial", &findserial, true, false, false, true, NULL},
+        {"blockchain", "getaccumulatorvalues", &getaccumulatorvalues, true, false, false, true, NULL},
+        {"blockchain", "getblockchaininfo", &getblockchaininfo, true, false, false, true, NULL},
+        {"blockchain", "getbestblockhash", &getbestblockhash, true, false, false, true, NULL},
+        {"blockchain", "getblockcount", &getblockcount, true, false, false, true, NULL},
+        {"blockchain", "getblock", &getblock, true, false, false, true, &getblock_stream},
+        {"blockchain", "getblockhash", &getblockhash, true, false, false, true, NULL},
+        {"blockchain", "getblockhashes", &getblockhashes, true, false, false, true, NULL},
+        {"blockchain", "getblockheader", &getblockheader, false, false, false, true, NULL},
+        {"blockchain", "getblockrange", &getblockrange, true, false, false, true, &getblockrange_stream},
+        {"blockchain", "getchaintips", &getchaintips, true, false, false, true, NULL},
+        {"blockchain", "getdifficulty", &getdifficulty, true, false, false, true, NULL},
+        {"blockchain", "getfeeinfo", &getfeeinfo, true, false, false, true, NULL},
+        {"blockchain", "getmempoolinfo", &getmempoolinfo, true, true, false, true, NULL},
+        {"blockchain", "getrawmempool", &getrawmempool, true, false, false, true, &getrawmempool_stream},
+        {"blockchain", "gettxout", &gettxout, true, false, false, true, NULL},
+        {"blockchain", "gettxoutsetinfo", &gettxoutsetinfo, true, false, false, true, NULL},
+        {"blockchain", "invalidateblock", &invalidateblock, true, true, false, false, NULL},
+        {"blockchain", "reconsiderblock", &reconsiderblock, true, true, false, false, NULL},
+        {"blockchain", "verifychain", &verifychain, true, false, false, false, NULL},
 
         /* Mining */
-        {"mining", "getblocktemplate", &getblocktemplate, true, false, false},
-        {"mining", "getmininginfo", &getmininginfo, true, false, false},
-        {"mining", "getnetworkhashps", &getnetworkhashps, true, false, false},
-        {"mining", "prioritisetransaction", &prioritisetransaction, true, false, false},
-        {"mining", "submitblock", &submitblock, true, true, false},
-        {"mining", "reservebalance", &reservebalance, true, true, false},
+        {"mining", "getblocktemplate", &getblocktemplate, true, false, false, false, NULL},
+        {"mining", "getmininginfo", &getmininginfo, true, false, false, true, NULL},
+        {"mining", "getnetworkhashps", &getnetworkhashps, true, false, false, true, NULL},
+        {"mining", "prioritisetransaction", &prioritisetransaction, true, false, false, false, NULL},
+        {"mining", "submitblock", &submitblock, true, true, false, false, NULL},
+        {"mining", "reservebalance", &reservebalance, true, true, false, false, NULL},
 
 #ifdef ENABLE_WALLET
         /* Coin generation */
-        {"generating", "getgenerate", &getgenerate, true, false, false},
-        {"generating", "gethashespersec", &gethashespersec, true, false, false},
-        {"generating", "setgenerate", &setgenerate, true, true, false},
+        {"generating", "getgenerate", &getgenerate, true, false, false, false, NULL},
+        {"generating", "gethashespersec", &gethashespersec, true, false, false, false, NULL},
+        {"generating", "setgenerate", &setgenerate, true, true, false, false, NULL},
 #endif
 
+        /* Address index */
+        {"addressindex", "getaddressbalance", &getaddressbalance, true, false, false, true, NULL},
+        {"addressindex", "getaddressutxos", &getaddressutxos, true, false, false, true, NULL},
+        {"addressindex", "getaddresstxids", &getaddresstxids, true, false, false, true, NULL},
+        {"addressindex", "getspentinfo", &getspentinfo, true, false, false, true, NULL},
+
         /* Raw transactions */
-        {"rawtransactions", "createrawtransaction", &createrawtransaction, true, false, false},
-        {"rawtransactions", "decoderawtransaction", &decoderawtransaction, true, false, false},
-        {"rawtransactions", "decodescript", &decodescript, true, false, false},
-        {"rawtransactions", "getrawtransaction", &getrawtransaction, true, false, false},
-        {"rawtransactions", "sendrawtransaction", &sendrawtransaction, false, false, false},
-        {"rawtransactions", "signrawtransaction", &signrawtransaction, false, false, false}, /* uses wallet if enabled */
+        {"rawtransactions", "createrawtransaction", &createrawtransaction, true, false, false, true, NULL},
+        {"rawtransactions", "decoderawtransaction", &decoderawtransaction, true, false, false, true, NULL},
+        {"rawtransactions", "decodescript", &decodescript, true, false, false, true, NULL},
+        {"rawtransactions", "getrawtransaction", &getrawtransaction, true, false, false, true, NULL},
+        {"rawtransactions", "sendrawtransaction", &sendrawtransaction, false, false, false, false, NULL},
+        {"rawtransactions", "signrawtransaction", &signrawtransaction, false, false, false, false, NULL}, /* uses wallet if enabled */
 
         /* Utility functions */
-        {"util", "createmultisig", &createmultisig, true, true, false},
-        {"util", "validateaddress", &validateaddress, true, false, false}, /* uses wallet if enabled */
-        {"util", "verifymessage", &verifymessage, true, false, false},
-        {"util", "estimatefee", &estimatefee, true, true, false},
-        {"util", "estimatepriority", &estimatepriority, true, true, false},
+        {"util", "createmultisig", &createmultisig, true, true, false, false, NULL},
+        {"util", "validateaddress", &validateaddress, true, false, false, false, NULL}, /* uses wallet if enabled */
+        {"util", "verifymessage", &verifymessage, true, false, false, true, NULL},
+        {"util", "estimatefee", &estimatefee, true, true, false, true, NULL},
+        {"util", "estimatepriority", &estimatepriority, true, true, false, true, NULL},
 
         /* Not shown in help */
-        {"hidden", "invalidateblock", &invalidateblock, true, true, false},
-        {"hidden", "reconsiderblock", &reconsiderblock, true, true, false},
-        {"hidden", "setmocktime", &setmocktime, true, false, false},
+        {"hidden", "invalidateblock", &invalidateblock, true, true, false, false, NULL},
+        {"hidden", "reconsiderblock", &reconsiderblock, true, true, false, false, NULL},
+        {"hidden", "setmocktime", &setmocktime, true, false, false, false, NULL},
 
         /* UserX features */
-        {"userx", "masternode", &masternode, true, true, false},
-        {"userx", "listmasternodes", &listmasternodes, true, true, false},
-        {"userx", "getmasternodecount", &getmasternodecount, true, true, false},
-        {"userx", "masternodeconnect", &masternodeconnect, true, true, false},
-        {"userx", "createmasternodebroadcast", &createmasternodebroadcast, true, true, false},
-        {"userx", "decodemasternodebroadcast", &decodemasternodebroadcast, true, true, false},
-        {"userx", "relaymasternodebroadcast", &relaymasternodebroadcast, true, true, false},
-        {"userx", "masternodecurrent", &masternodecurrent, true, true, false},
-        {"userx", "masternodedebug", &masternodedebug, true, true, false},
-        {"userx", "startmasternode", &startmasternode, true, true, false},
-        {"userx", "createmasternodekey", &createmasternodekey, true, true, false},
-        {"userx", "getmasternodeoutputs", &getmasternodeoutputs, true, true, false},
-        {"userx", "listmasternodeconf", &listmasternodeconf, true, true, false},
-        {"userx", "getmasternodestatus", &getmasternodestatus, true, true, false},
-        {"userx", "getmasternodewinners", &getmasternodewinners, true, true, false},
-        {"userx", "getmasternodescores", &getmasternodescores, true, true, false},
-        {"userx", "mnbudget", &mnbudget, true, true, false},
-        {"userx", "preparebudget", &preparebudget, true, true, false},
-        {"userx", "submitbudget", &submitbudget, true, true, false},
-        {"userx", "mnbudgetvote", &mnbudgetvote, true, true, false},
-        {"userx", "getbudgetvotes", &getbudgetvotes, true, true, false},
-        {"userx", "getnextsuperblock", &getnextsuperblock, true, true, false},
-        {"userx", "getbudgetprojection", &getbudgetprojection, true, true, false},
-        {"userx", "getbudgetinfo", &getbudgetinfo, true, true, false},
-        {"userx", "mnbudgetrawvote", &mnbudgetrawvote, true, true, false},
-        {"userx", "mnfinalbudget", &mnfinalbudget, true, true, false},
-        {"userx", "checkbudgets", &checkbudgets, true, true, false},
-        {"userx", "mnsync", &mnsync, true, true, false},
-        {"userx", "spork", &spork, true, true, false},
-        {"userx", "getpoolinfo", &getpoolinfo, true, true, false},
+        {"userx", "masternode", &masternode, true, true, false, false, NULL},
+        {"userx", "listmasternodes", &listmasternodes, true, true, false, false, NULL},
+        {"userx", "getmasternodecount", &getmasternodecount, true, true, false, false, NULL},
+        {"userx", "masternodeconnect", &masternodeconnect, true, true, false, false, NULL},
+        {"userx", "createmasternodebroadcast", &createmasternodebroadcast, true, true, false, false, NULL},
+        {"userx", "decodemasternodebroadcast", &decodemasternodebroadcast, true, true, false, false, NULL},
+        {"userx", "relaymasternodebroadcast", &relaymasternodebroadcast, true, true, false, false, NULL},
+        {"userx", "masternodecurrent", &masternodecurrent, true, true, false, false, NULL},
+        {"userx", "masternodedebug", &masternodedebug, true, true, false, false, NULL},
+        {"userx", "startmasternode", &startmasternode, true, true, false, false, NULL},
+        {"userx", "createmasternodekey", &createmasternodekey, true, true, false, false, NULL},
+        {"userx", "getmasternodeoutputs", &getmasternodeoutputs, true, true, false, false, NULL},
+        {"userx", "listmasternodeconf", &listmasternodeconf, true, true, false, false, NULL},
+        {"userx", "getmasternodestatus", &getmasternodestatus, true, true, false, false, NULL},
+        {"userx", "getmasternodewinners", &getmasternodewinners, true, true, false, false, NULL},
+        {"userx", "getmasternodescores", &getmasternodescores, true, true, false, false, NULL},
+        {"userx", "mnbudget", &mnbudget, true, true, false, false, NULL},
+        {"userx", "preparebudget", &preparebudget, true, true, false, false, NULL},
+        {"userx", "submitbudget", &submitbudget, true, true, false, false, NULL},
+        {"userx", "mnbudgetvote", &mnbudgetvote, true, true, false, false, NULL},
+        {"userx", "getbudgetvotes", &getbudgetvotes, true, true, false, false, NULL},
+        {"userx", "getnextsuperblock", &getnextsuperblock, true, true, false, false, NULL},
+        {"userx", "getbudgetprojection", &getbudgetprojection, true, true, false, false, NULL},
+        {"userx", "getbudgetinfo", &getbudgetinfo, true, true, false, false, NULL},
+        {"userx", "mnbudgetrawvote", &mnbudgetrawvote, true, true, false, false, NULL},
+        {"userx", "mnfinalbudget", &mnfinalbudget, true, true, false, false, NULL},
+        {"userx", "checkbudgets", &checkbudgets, true, true, false, false, NULL},
+        {"userx", "mnsync", &mnsync, true, true, false, false, NULL},
+        {"userx", "spork", &spork, true, true, false, false, NULL},
+        {"userx", "getpoolinfo", &getpoolinfo, true, true, false, false, NULL},
 
 #ifdef ENABLE_WALLET
         /* Wallet */
-        {"wallet", "addmultisigaddress", &addmultisigaddress, true, false, true},
-        {"wallet", "autocombinerewards", &autocombinerewards, false, false, true},
-        {"wallet", "backupwallet", &backupwallet, true, false, true},
-        {"wallet", "dumpprivkey", &dumpprivkey, true, false, true},
-        {"wallet", "dumpwallet", &dumpwallet, true, false, true},
-        {"wallet", "bip38encrypt", &bip38encrypt, true, false, true},
-        {"wallet", "bip38decrypt", &bip38decrypt, true, false, true},
-        {"wallet", "encryptwallet", &encryptwallet, true, false, true},
-        {"wallet", "getaccountaddress", &getaccountaddress, true, false, true},
-        {"wallet", "getaccount", &getaccount, true, false, true},
-        {"wallet", "getaddressesbyaccount", &getaddressesbyaccount, true, false, true},
-        {"wallet", "getbalance", &getbalance, false, false, true},
-        {"wallet", "getnewaddress", &getnewaddress, true, false, true},
-        {"wallet", "getrawchangeaddress", &getrawchangeaddress, true, false, true},
-        {"wallet", "getreceivedbyaccount", &getreceivedbyaccount, false, false, true},
-        {"wallet", "getreceivedbyaddress", &getreceivedbyaddress, false, false, true},
-        {"wallet", "getstakingstatus", &getstakingstatus, false, false, true},
-        {"wallet", "getstakesplitthreshold", &getstakesplitthreshold, false, false, true},
-        {"wallet", "gettransaction", &gettransaction, false, false, true},
-        {"wallet", "getunconfirmedbalance", &getunconfirmedbalance, false, false, true},
-        {"wallet", "getwalletinfo", &getwalletinfo, false, false, true},
-        {"wallet", "importprivkey", &importprivkey, true, false, true},
-        {"wallet", "importwallet", &importwallet, true, false, true},
-        {"wallet", "importaddress", &importaddress, true, false, true},
-        {"wallet", "keypoolrefill", &keypoolrefill, true, false, true},
-        {"wallet", "listaccounts", &listaccounts, false, false, true},
-        {"wallet", "listaddressgroupings", &listaddressgroupings, false, false, true},
-        {"wallet", "listlockunspent", &listlockunspent, false, false, true},
-        {"wallet", "listreceivedbyaccount", &listreceivedbyaccount, false, false, true},
-        {"wallet", "listreceivedbyaddress", &listreceivedbyaddress, false, false, true},
-        {"wallet", "listsinceblock", &listsinceblock, false, false, true},
-        {"wallet", "listtransactions", &listtransactions, false, false, true},
-        {"wallet", "listunspent", &listunspent, false, false, true},
-        {"wallet", "lockunspent", &lockunspent, true, false, true},
-        {"wallet", "move", &movecmd, false, false, true},
-        {"wallet", "multisend", &multisend, false, false, true},
-        {"wallet", "sendfrom", &sendfrom, false, false, true},
-        {"wallet", "sendmany", &sendmany, false, false, true},
-        {"wallet", "sendtoaddress", &sendtoaddress, false, false, true},
-        {"wallet", "sendtoaddressix", &sendtoaddressix, false, false, true},
-        {"wallet", "setaccount", &setaccount, true, false, true},
-        {"wallet", "setstakesplitthreshold", &setstakesplitthreshold, false, false, true},
-        {"wallet", "settxfee", &settxfee, true, false, true},
-        {"wallet", "signmessage", &signmessage, true, false, true},
-        {"wallet", "walletlock", &walletlock, true, false, true},
-        {"wallet", "walletpassphrasechange", &walletpassphrasechange, true, false, true},
-        {"wallet", "walletpassphrase", &walletpassphrase, true, false, true},
-
-        // userx {"zerocoin", "getzerocoinbalance", &getzerocoinbalance, false, false, true},
-        {"zerocoin", "listmintedzerocoins", &listmintedzerocoins, false, false, true},
-        {"zerocoin", "listspentzerocoins", &listspentzerocoins, false, false, true},
-        {"zerocoin", "listzerocoinamounts", &listzerocoinamounts, false, false, true},
-        {"zerocoin", "mintzerocoin", &mintzerocoin, false, false, true},
-        {"zerocoin", "spendzerocoin", &spendzerocoin, false, false, true},
-        {"zerocoin", "resetmintzerocoin", &resetmintzerocoin, false, false, true},
-        {"zerocoin", "resetspentzerocoin", &resetspentzerocoin, false, false, true},
-        {"zerocoin", "getarchivedzerocoin", &getarchivedzerocoin, false, false, true},
-        {"zerocoin", "importzerocoins", &importzerocoins, false, false, true},
-        {"zerocoin", "exportzerocoins", &exportzerocoins, false, false, true},
-        {"zerocoin", "reconsiderzerocoins", &reconsiderzerocoins, false, false, true},
-        {"zerocoin", "getspentzerocoinamount", &getspentzerocoinamount, false, false, false},
-        {"zerocoin", "getzuserxseed", &getzuserxseed, false, false, true},
-        {"zerocoin", "setzuserxseed", &setzuserxseed, false, false, true},
-        {"zerocoin", "generatemintlist", &generatemintlist, false, false, true},
-        {"zerocoin", "searchdzuserx", &searchdzuserx, false, false, true},
-        {"zerocoin", "dzuserxstate", &dzuserxstate, false, false, true}
+        {"wallet", "addmultisigaddress", &addmultisigaddress, true, false, true, false, NULL},
+        {"wallet", "autocombinerewards", &autocombinerewards, false, false, true, false, NULL},
+        {"wallet", "backupwallet", &backupwallet, true, false, true, false, NULL},
+        {"wallet", "dumpprivkey", &dumpprivkey, true, false, true, false, NULL},
+        {"wallet", "dumpwallet", &dumpwallet, true, false, true, false, NULL},
+        {"wallet", "bip38encrypt", &bip38encrypt, true, false, true, false, NULL},
+        {"wallet", "bip38decrypt", &bip38decrypt, true, false, true, false, NULL},
+        {"wallet", "encryptwallet", &encryptwallet, true, false, true, false, NULL},
+        {"wallet", "getaccountaddress", &getaccountaddress, true, false, true, false, NULL},
+        {"wallet", "getaccount", &getaccount, true, false, true, false, NULL},
+        {"wallet", "getaddressesbyaccount", &getaddressesbyaccount, true, false, true, false, NULL},
+        {"wallet", "getbalance", &getbalance, false, false, true, false, NULL},
+        {"wallet", "getnewaddress", &getnewaddress, true, false, true, false, NULL},
+        {"wallet", "getrawchangeaddress", &getrawchangeaddress, true, false, true, false, NULL},
+        {"wallet", "getreceivedbyaccount", &getreceivedbyaccount, false, false, true, false, NULL},
+        {"wallet", "getreceivedbyaddress", &getreceivedbyaddress, false, false, true, false, NULL},
+        {"wallet", "getstakingstatus", &getstakingstatus, false, false, true, false, NULL},
+        {"wallet", "getstakesplitthreshold", &getstakesplitthreshold, false, false, true, false, NULL},
+        {"wallet", "gettransaction", &gettransaction, false, false, true, false, NULL},
+        {"wallet", "getunconfirmedbalance", &getunconfirmedbalance, false, false, true, false, NULL},
+        {"wallet", "getwalletinfo", &getwalletinfo, false, false, true, false, NULL},
+        {"wallet", "importprivkey", &importprivkey, true, false, true, false, NULL},
+        {"wallet", "importwallet", &importwallet, true, false, true, false, NULL},
+        {"wallet", "importaddress", &importaddress, true, false, true, false, NULL},
+        {"wallet", "keypoolrefill", &keypoolrefill, true, false, true, false, NULL},
+        {"wallet", "listaccounts", &listaccounts, false, false, true, false, NULL},
+        {"wallet", "listaddressgroupings", &listaddressgroupings, false, false, true, false, NULL},
+        {"wallet", "listlockunspent", &listlockunspent, false, false, true, false, NULL},
+        {"wallet", "listreceivedbyaccount", &listreceivedbyaccount, false, false, true, false, NULL},
+        {"wallet", "listreceivedbyaddress", &listreceivedbyaddress, false, false, true, false, NULL},
+        {"wallet", "listsinceblock", &listsinceblock, false, false, true, false, NULL},
+        {"wallet", "listtransactions", &listtransactions, false, false, true, false, NULL},
+        {"wallet", "listunspent", &listunspent, false, false, true, false, NULL},
+        {"wallet", "lockunspent", &lockunspent, true, false, true, false, NULL},
+        {"wallet", "move", &movecmd, false, false, true, false, NULL},
+        {"wallet", "multisend", &multisend, false, false, true, false, NULL},
+        {"wallet", "sendfrom", &sendfrom, false, false, true, false, NULL},
+        {"wallet", "sendmany", &sendmany, false, false, true, false, NULL},
+        {"wallet", "sendtoaddress", &sendtoaddress, false, false, true, false, NULL},
+        {"wallet", "sendtoaddressix", &sendtoaddressix, false, false, true, false, NULL},
+        {"wallet", "setaccount", &setaccount, true, false, true, false, NULL},
+        {"wallet", "setstakesplitthreshold", &setstakesplitthreshold, false, false, true, false, NULL},
+        {"wallet", "settxfee", &settxfee, true, false, true, false, NULL},
+        {"wallet", "signmessage", &signmessage, true, false, true, false, NULL},
+        {"wallet", "walletlock", &walletlock, true, false, true, false, NULL},
+        {"wallet", "walletpassphrasechange", &walletpassphrasechange, true, false, true, false, NULL},
+        {"wallet", "walletpassphrase", &walletpassphrase, true, false, true, false, NULL},
+
+        // userx {"zerocoin", "getzerocoinbalance", &getzerocoinbalance, false, false, true, false, NULL},
+        {"zerocoin", "listmintedzerocoins", &listmintedzerocoins, false, false, true, false, NULL},
+        {"zerocoin", "listspentzerocoins", &listspentzerocoins, false, false, true, false, NULL},
+        {"zerocoin", "listzerocoinamounts", &listzerocoinamounts, false, false, true, false, NULL},
+        {"zerocoin", "mintzerocoin", &mintzerocoin, false, false, true, false, NULL},
+        {"zerocoin", "spendzerocoin", &spendzerocoin, false, false, true, false, NULL},
+        {"zerocoin", "resetmintzerocoin", &resetmintzerocoin, false, false, true, false, NULL},
+        {"zerocoin", "resetspentzerocoin", &resetspentzerocoin, false, false, true, false, NULL},
+        {"zerocoin", "getarchivedzerocoin", &getarchivedzerocoin, false, false, true, false, NULL},
+        {"zerocoin", "importzerocoins", &importzerocoins, false, false, true, false, NULL},
+        {"zerocoin", "exportzerocoins", &exportzerocoins, false, false, true, false, NULL},
+        {"zerocoin", "reconsiderzerocoins", &reconsiderzerocoins, false, false, true, false, NULL},
+        {"zerocoin", "getspentzerocoinamount", &getspentzerocoinamount, false, false, false, false, NULL},
+        {"zerocoin", "getzuserxseed", &getzuserxseed, false, false, true, false, NULL},
+        {"zerocoin", "setzuserxseed", &setzuserxseed, false, false, true, false, NULL},
+        {"zerocoin", "generatemintlist", &generatemintlist, false, false, true, false, NULL},
+        {"zerocoin", "searchdzuserx", &searchdzuserx, false, false, true, false, NULL},
+        {"zerocoin", "dzuserxstate", &dzuserxstate, false, false, true, false, NULL}
 
 #endif // ENABLE_WALLET
 };
@@ -573,11 +584,93 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
-std::string JSONRPCExecBatch(const UniValue& vReq)
+/**
+ * A run of readOnly batch entries being worked through by several threads.
+ * Helpers can be started after the run is complete and its requests are
+ * gone, so they only look at the requests after claiming an index below nEnd.
+ */
+struct RPCBatchState {
+    const UniValue& vReq;
+    std::vector<UniValue>& vRet;
+    const size_t nEnd;
+    std::atomic<size_t> nNext;
+    boost::mutex cs;
+    boost::condition_variable cond;
+    size_t nDone;
+
+    RPCBatchState(const UniValue& vReqIn, std::vector<UniValue>& vRetIn, size_t nBegin, size_t nEndIn) : vReq(vReqIn), vRet(vRetIn), nEnd(nEndIn), nNext(nBegin), nDone(nBegin) {}
+};
+
+static void RunRPCBatch(boost::shared_ptr<RPCBatchState> batch)
+{
+    size_t nRun = 0;
+    for (size_t i = batch->nNext++; i < batch->nEnd; i = batch->nNext++) {
+        try {
+            batch->vRet[i] = JSONRPCExecOne(batch->vReq[i]);
+        } catch (...) {
+            // Every claimed entry has to be counted, or the caller waits forever
+            batch->vRet[i] = JSONRPCReplyObj(NullUniValue, JSONRPCError(RPC_MISC_ERROR, "unknown exception"), NullUniValue);
+        }
+        nRun++;
+    }
+    if (nRun) {
+        boost::lock_guard<boost::mutex> lock(batch->cs);
+        batch->nDone += nRun;
+        batch->cond.notify_all();
+    }
+}
+
+/** Whether a batch entry calls a readOnly command, which may run alongside its neighbours */
+static bool IsReadOnlyRequest(const UniValue& req)
+{
+    if (!req.isObject())
+        return false;
+    const UniValue& method = find_value(req.get_obj(), "method");
+    if (!method.isStr())
+        return false;
+    const CRPCCommand* pcmd = tableRPC[method.get_str()];
+    return pcmd && pcmd->readOnly;
+}
+
+std::string JSONRPCExecBatch(const UniValue& vReq, const RPCWorkDispatcher& dispatch, int nMaxHelpers)
 {
+    std::vector<UniValue> vRet(vReq.size());
+
+    size_t nBegin = 0;
+    while (nBegin < vReq.size()) {
+        // Anything that may change state runs here, in order, after all the
+        // entries before it have finished
+        if (!IsReadOnlyRequest(vReq[nBegin])) {
+            vRet[nBegin] = JSONRPCExecOne(vReq[nBegin]);
+            nBegin++;
+            continue;
+        }
+
+        size_t nEnd = nBegin + 1;
+        while (nEnd < vReq.size() && IsReadOnlyRequest(vReq[nEnd]))
+            nEnd++;
+
+        // The calling thread works through the run too, so it completes even
+        // when every other worker is busy and no helper gets to run
+        boost::shared_ptr<RPCBatchState> batch(new RPCBatchState(vReq, vRet, nBegin, nEnd));
+        if (dispatch) {
+            for (int i = 0; i < nMaxHelpers && nBegin + i + 1 < nEnd; i++) {
+                if (!dispatch(boost::bind(&RunRPCBatch, batch)))
+                    break;
+            }
+        }
+        RunRPCBatch(batch);
+        {
+            boost::unique_lock<boost::mutex> lock(batch->cs);
+            while (batch->nDone < nEnd)
+                batch->cond.wait(lock);
+        }
+        nBegin = nEnd;
+    }
+
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    for (size_t reqIdx = 0; reqIdx < vRet.size(); reqIdx++)
+        ret.push_back(vRet[reqIdx]);
 
     return ret.write() + "\n";
 }
@@ -591,6 +684,10 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
 
     g_rpcSignals.PreCommand(*pcmd);
 
+    // Wallet calls see the effect of everything validated before they started
+    if (pcmd->reqWallet)
+        SyncWithValidationInterfaceQueue();
+
     try {
         // Execute
         return pcmd->actor(params, false);
@@ -601,6 +698,24 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
     g_rpcSignals.PostCommand(*pcmd);
 }
 
+bool CRPCTable::executeStream(const std::string &strMethod, const UniValue &params, CJSONStreamWriter& writer) const
+{
+    const CRPCCommand* pcmd = tableRPC[strMethod];
+    if (!pcmd || !pcmd->streamActor)
+        return false;
+
+    g_rpcSignals.PreCommand(*pcmd);
+
+    try {
+        pcmd->streamActor(params, writer);
+    } catch (std::exception& e) {
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+
+    g_rpcSignals.PostCommand(*pcmd);
+    return true;
+}
+
 std::vector<std::string> CRPCTable::listCommands() const
 {
     std::vector<std::string> commandList;
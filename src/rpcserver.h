@@ -112,7 +112,11 @@ void RPCUnregisterTimerInterface(RPCTimerInterface *iface);
  */
 void RPCRunLater(const std::string& name, boost::function<void(void)> func, int64_t nSeconds);
 
+class CJSONStreamWriter;
+
 typedef UniValue(*rpcfn_type)(const UniValue& params, bool fHelp);
+/** Writes the result of a call to a stream as it is produced, for results too large to build first */
+typedef void(*rpcstreamfn_type)(const UniValue& params, CJSONStreamWriter& writer);
 
 class CRPCCommand
 {
@@ -123,6 +127,10 @@ public:
     bool okSafeMode;
     bool threadSafe;
     bool reqWallet;
+    //! Changes no node or wallet state, so batch entries may run alongside each other
+    bool readOnly;
+    //! Optional streaming form of actor, used by the HTTP server for single calls
+    rpcstreamfn_type streamActor;
 };
 
 /**
@@ -147,6 +155,13 @@ public:
      */
     UniValue execute(const std::string &method, const UniValue &params) const;
 
+    /**
+     * Execute a method that can stream its result, writing the result to writer.
+     * @returns false, without executing anything, if the method has no streaming form.
+     * @throws an exception (UniValue) when an error happens.
+     */
+    bool executeStream(const std::string &method, const UniValue &params, CJSONStreamWriter& writer) const;
+
     /**
     * Returns a list of registered commands
     * @returns List of registered commands.
@@ -281,9 +296,16 @@ extern UniValue getdifficulty(const UniValue& params, bool fHelp);
 extern UniValue settxfee(const UniValue& params, bool fHelp);
 extern UniValue getmempoolinfo(const UniValue& params, bool fHelp);
 extern UniValue getrawmempool(const UniValue& params, bool fHelp);
+extern void getrawmempool_stream(const UniValue& params, CJSONStreamWriter& writer);
 extern UniValue getblockhash(const UniValue& params, bool fHelp);
+extern UniValue getblockhashes(const UniValue& params, bool fHelp);
 extern UniValue getblock(const UniValue& params, bool fHelp);
+extern void getblock_stream(const UniValue& params, CJSONStreamWriter& writer);
 extern UniValue getblockheader(const UniValue& params, bool fHelp);
+/** Most blocks one getblockrange or /rest/blockrange request returns */
+static const int MAX_BLOCKRANGE_COUNT = 10000;
+extern UniValue getblockrange(const UniValue& params, bool fHelp);
+extern void getblockrange_stream(const UniValue& params, CJSONStreamWriter& writer);
 extern UniValue getfeeinfo(const UniValue& params, bool fHelp);
 extern UniValue gettxoutsetinfo(const UniValue& params, bool fHelp);
 extern UniValue gettxout(const UniValue& params, bool fHelp);
@@ -328,6 +350,10 @@ extern UniValue mnsync(const UniValue& params, bool fHelp);
 extern UniValue spork(const UniValue& params, bool fHelp);
 extern UniValue validateaddress(const UniValue& params, bool fHelp);
 extern UniValue createmultisig(const UniValue& params, bool fHelp);
+extern UniValue getaddressbalance(const UniValue& params, bool fHelp);
+extern UniValue getaddressutxos(const UniValue& params, bool fHelp);
+extern UniValue getaddresstxids(const UniValue& params, bool fHelp);
+extern UniValue getspentinfo(const UniValue& params, bool fHelp);
 extern UniValue verifymessage(const UniValue& params, bool fHelp);
 extern UniValue setmocktime(const UniValue& params, bool fHelp);
 extern UniValue getstakingstatus(const UniValue& params, bool fHelp);
@@ -335,6 +361,13 @@ extern UniValue getstakingstatus(const UniValue& params, bool fHelp);
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
-std::string JSONRPCExecBatch(const UniValue& vReq);
+/** Runs a function on another thread, returns false if it could not be handed off */
+typedef boost::function<bool(const boost::function<void(void)>&)> RPCWorkDispatcher;
+/**
+ * Execute a JSON-RPC batch. Runs of readOnly calls are spread over up to
+ * nMaxHelpers other threads through the dispatcher; every other call runs on
+ * the calling thread once the calls before it are done. Replies keep request order.
+ */
+std::string JSONRPCExecBatch(const UniValue& vReq, const RPCWorkDispatcher& dispatch = RPCWorkDispatcher(), int nMaxHelpers = 0);
 
 #endif // BITCOIN_RPCSERVER_H
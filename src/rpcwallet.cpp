@@ -1324,10 +1324,11 @@ void AcentryToJSON(const CAccountingEntry& acentry, const string& strAccount, Un
 
 UniValue listtransactions(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() > 4)
+    if (fHelp || params.size() > 5)
         throw runtime_error(
-            "listtransactions ( \"account\" count from includeWatchonly)\n"
+            "listtransactions ( \"account\" count from includeWatchonly after )\n"
             "\nReturns up to 'count' most recent transactions skipping the first 'from' transactions for account 'account'.\n"
+            "If 'after' is given, instead returns the transactions that follow position 'after' in the wallet, oldest first.\n"
 
             "\nArguments:\n"
             "1. \"account\"    (string, optional) The account name. If not included, it will list all transactions for all accounts.\n"
@@ -1335,6 +1336,9 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
             "2. count          (numeric, optional, default=10) The number of transactions to return\n"
             "3. from           (numeric, optional, default=0) The number of transactions to skip\n"
             "4. includeWatchonly (bool, optional, default=false) Include transactions to watchonly addresses (see 'importaddress')\n"
+            "5. after          (numeric, optional) Page forward from this wallet position, as returned in 'orderpos'.\n"
+            "                  Use -1 to start at the oldest transaction. 'from' is ignored. A transaction is never split\n"
+            "                  across pages, so a page can hold slightly more than 'count' entries.\n"
 
             "\nResult:\n"
             "[\n"
@@ -1369,6 +1373,7 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
             "    \"otheraccount\": \"accountname\",  (string) For the 'move' category of transactions, the account the funds came \n"
             "                                          from (for receiving funds, positive amounts), or went to (for sending funds,\n"
             "                                          negative amounts).\n"
+            "    \"orderpos\": n,          (numeric) Position in the wallet, only returned when 'after' is given.\n"
             "  }\n"
             "]\n"
 
@@ -1379,6 +1384,8 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
             HelpExampleCli("listtransactions", "\"tabby\"") +
             "\nList transactions 100 to 120 from the tabby account\n" +
             HelpExampleCli("listtransactions", "\"tabby\" 20 100") +
+            "\nList the 100 transactions that follow wallet position 5000\n" +
+            HelpExampleCli("listtransactions", "\"*\" 100 0 false 5000") +
             "\nAs a json rpc call\n" +
             HelpExampleRpc("listtransactions", "\"tabby\", 20, 100"));
 
@@ -1407,6 +1414,27 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
 
     const CWallet::TxItems & txOrdered = pwalletMain->wtxOrdered;
 
+    if (params.size() > 4) {
+        // Cursor paging: walk forward from the cursor and touch only the returned items
+        int64_t nAfter = params[4].get_int64();
+        for (CWallet::TxItems::const_iterator it = txOrdered.upper_bound(nAfter); it != txOrdered.end() && (int)ret.size() < nCount; ++it) {
+            UniValue entries(UniValue::VARR);
+            CWalletTx* const pwtx = (*it).second.first;
+            if (pwtx != 0)
+                ListTransactions(*pwtx, strAccount, 0, true, entries, filter);
+            CAccountingEntry* const pacentry = (*it).second.second;
+            if (pacentry != 0)
+                AcentryToJSON(*pacentry, strAccount, entries);
+
+            for (size_t i = 0; i < entries.size(); i++) {
+                UniValue entry = entries[i];
+                entry.push_back(Pair("orderpos", (*it).first));
+                ret.push_back(entry);
+            }
+        }
+        return ret;
+    }
+
     // iterate backwards until we have nCount items to return:
     for (CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it) {
         CWalletTx* const pwtx = (*it).second.first;
@@ -1591,11 +1619,16 @@ UniValue listsinceblock(const UniValue& params, bool fHelp)
 
     UniValue transactions(UniValue::VARR);
 
-    for (map<uint256, CWalletTx>::iterator it = pwalletMain->mapWallet.begin(); it != pwalletMain->mapWallet.end(); it++) {
-        CWalletTx tx = (*it).second;
-
-        if (depth == -1 || tx.GetDepthInMainChain(false) < depth)
-            ListTransactions(tx, "*", 0, true, transactions, filter);
+    // Transactions above pindex, or not in the active chain at all, are the ones shallower
+    // than 'depth'; the height index lists exactly those
+    const std::set<std::pair<int, uint256> >& setByHeight = pwalletMain->setWalletTxByHeight;
+    std::set<std::pair<int, uint256> >::const_iterator it = setByHeight.begin();
+    if (depth != -1)
+        it = setByHeight.lower_bound(make_pair(pindex->nHeight + 1, uint256(0)));
+    for (; it != setByHeight.end(); ++it) {
+        map<uint256, CWalletTx>::const_iterator mi = pwalletMain->mapWallet.find(it->second);
+        if (mi != pwalletMain->mapWallet.end())
+            ListTransactions(mi->second, "*", 0, true, transactions, filter);
     }
 
     CBlockIndex* pblockLast = chainActive[chainActive.Height() + 1 - target_confirms];
@@ -1691,6 +1724,8 @@ UniValue backupwallet(const UniValue& params, bool fHelp)
         throw runtime_error(
             "backupwallet \"destination\"\n"
             "\nSafely copies wallet.dat to destination, which can be a directory or a path with filename.\n"
+            "With -walletlog the copy is the wallet log: to restore it, put it in place of wallet.dat (or of wallet.dat.log)\n"
+            "and start with -walletlog.\n"
 
             "\nArguments:\n"
             "1. \"destination\"   (string) The destination directory or file\n"
@@ -0,0 +1,245 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "addressindex.h"
+
+#include "clientversion.h"
+#include "coins.h"
+#include "key.h"
+#include "main.h"
+#include "random.h"
+#include "script/standard.h"
+#include "streams.h"
+#include "txdb.h"
+
+#include <boost/test/unit_test.hpp>
+
+static uint160 GetRandHash160()
+{
+    uint256 hash = GetRandHash();
+    return uint160(std::vector<unsigned char>(hash.begin(), hash.begin() + 20));
+}
+
+BOOST_AUTO_TEST_SUITE(addressindex_tests)
+
+BOOST_AUTO_TEST_CASE(addressindex_key_order)
+{
+    // LevelDB compares keys bytewise, so heights must serialize in numeric order
+    uint160 hashBytes = GetRandHash160();
+    std::vector<std::string> vKeys;
+    const int heights[] = {1, 255, 256, 65535, 65536, 16777216};
+    for (int nHeight : heights) {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << CAddressIndexKey(ADDRESS_INDEX_PUBKEYHASH, hashBytes, nHeight, 0, 0, 0, false);
+        vKeys.push_back(ss.str());
+    }
+    for (unsigned int i = 1; i < vKeys.size(); i++)
+        BOOST_CHECK(vKeys[i - 1] < vKeys[i]);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    CAddressIndexKey key(ADDRESS_INDEX_SCRIPTHASH, hashBytes, 123456, 7, GetRandHash(), 3, true);
+    ss << key;
+    CAddressIndexKey keyRead;
+    ss >> keyRead;
+    BOOST_CHECK_EQUAL(keyRead.nAddressType, key.nAddressType);
+    BOOST_CHECK(keyRead.hashBytes == key.hashBytes);
+    BOOST_CHECK_EQUAL(keyRead.nHeight, key.nHeight);
+    BOOST_CHECK_EQUAL(keyRead.nTxIndex, key.nTxIndex);
+    BOOST_CHECK(keyRead.txhash == key.txhash);
+    BOOST_CHECK_EQUAL(keyRead.nIndex, key.nIndex);
+    BOOST_CHECK_EQUAL(keyRead.fSpending, key.fSpending);
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_script_types)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CPubKey pubkey = key.GetPubKey();
+    unsigned char nAddressType;
+    uint160 hashBytes;
+
+    BOOST_CHECK(GetIndexAddress(GetScriptForDestination(pubkey.GetID()), nAddressType, hashBytes));
+    BOOST_CHECK_EQUAL(nAddressType, ADDRESS_INDEX_PUBKEYHASH);
+    BOOST_CHECK(hashBytes == uint160(pubkey.GetID()));
+
+    // Pay-to-pubkey outputs, as used by coinstakes, are indexed under the key's address
+    BOOST_CHECK(GetIndexAddress(CScript() << ToByteVector(pubkey) << OP_CHECKSIG, nAddressType, hashBytes));
+    BOOST_CHECK_EQUAL(nAddressType, ADDRESS_INDEX_PUBKEYHASH);
+    BOOST_CHECK(hashBytes == uint160(pubkey.GetID()));
+
+    CScript redeem = CScript() << OP_TRUE;
+    BOOST_CHECK(GetIndexAddress(GetScriptForDestination(CScriptID(redeem)), nAddressType, hashBytes));
+    BOOST_CHECK_EQUAL(nAddressType, ADDRESS_INDEX_SCRIPTHASH);
+    BOOST_CHECK(hashBytes == uint160(CScriptID(redeem)));
+
+    BOOST_CHECK(!GetIndexAddress(CScript() << OP_RETURN << ToByteVector(GetRandHash()), nAddressType, hashBytes));
+    BOOST_CHECK(!GetIndexAddress(CScript() << OP_ZEROCOINMINT << ToByteVector(GetRandHash()), nAddressType, hashBytes));
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_db)
+{
+    CBlockTreeDB db(1 << 20, true);
+    uint160 hashA = GetRandHash160();
+    uint160 hashB = GetRandHash160();
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vWrite;
+    for (int nHeight = 1; nHeight <= 300; nHeight++) {
+        vWrite.push_back(std::make_pair(CAddressIndexKey(ADDRESS_INDEX_PUBKEYHASH, hashA, nHeight, 1, GetRandHash(), 0, false), nHeight));
+        vWrite.push_back(std::make_pair(CAddressIndexKey(ADDRESS_INDEX_PUBKEYHASH, hashB, nHeight, 1, GetRandHash(), 0, false), 1));
+    }
+    BOOST_CHECK(db.WriteAddressIndex(vWrite));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vRead;
+    BOOST_CHECK(db.ReadAddressIndex(ADDRESS_INDEX_PUBKEYHASH, hashA, vRead));
+    BOOST_CHECK_EQUAL(vRead.size(), 300U);
+    for (unsigned int i = 0; i < vRead.size(); i++) {
+        BOOST_CHECK(vRead[i].first.hashBytes == hashA);
+        BOOST_CHECK_EQUAL(vRead[i].first.nHeight, (int)i + 1);
+    }
+
+    vRead.clear();
+    BOOST_CHECK(db.ReadAddressIndex(ADDRESS_INDEX_PUBKEYHASH, hashA, vRead, 250, 260));
+    BOOST_CHECK_EQUAL(vRead.size(), 11U);
+    BOOST_CHECK_EQUAL(vRead.front().first.nHeight, 250);
+    BOOST_CHECK_EQUAL(vRead.back().first.nHeight, 260);
+
+    // Nothing is stored under the other address type
+    vRead.clear();
+    BOOST_CHECK(db.ReadAddressIndex(ADDRESS_INDEX_SCRIPTHASH, hashA, vRead));
+    BOOST_CHECK(vRead.empty());
+
+    // A null unspent value erases, and later updates in a batch win
+    uint256 txid = GetRandHash();
+    CAddressUnspentKey unspentKey(ADDRESS_INDEX_PUBKEYHASH, hashA, txid, 0);
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vUpdate;
+    vUpdate.push_back(std::make_pair(unspentKey, CAddressUnspentValue(5, CScript() << OP_TRUE, 10)));
+    vUpdate.push_back(std::make_pair(CAddressUnspentKey(ADDRESS_INDEX_PUBKEYHASH, hashA, txid, 1), CAddressUnspentValue(6, CScript() << OP_TRUE, 10)));
+    BOOST_CHECK(db.UpdateAddressUnspentIndex(vUpdate));
+    vUpdate.clear();
+    vUpdate.push_back(std::make_pair(unspentKey, CAddressUnspentValue()));
+    BOOST_CHECK(db.UpdateAddressUnspentIndex(vUpdate));
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspent;
+    BOOST_CHECK(db.ReadAddressUnspentIndex(ADDRESS_INDEX_PUBKEYHASH, hashA, vUnspent));
+    BOOST_CHECK_EQUAL(vUnspent.size(), 1U);
+    BOOST_CHECK_EQUAL(vUnspent[0].first.nIndex, 1U);
+    BOOST_CHECK_EQUAL(vUnspent[0].second.nSatoshis, 6);
+
+    // Timestamps come back in time order and the high bound is exclusive
+    const unsigned int times[] = {1000, 300, 70000, 2000};
+    for (unsigned int nTime : times)
+        BOOST_CHECK(db.WriteTimestampIndex(CTimestampIndexKey(nTime, uint256(nTime))));
+    std::vector<uint256> vHashes;
+    BOOST_CHECK(db.ReadTimestampIndex(70000, 300, vHashes));
+    BOOST_CHECK_EQUAL(vHashes.size(), 3U);
+    BOOST_CHECK(vHashes[0] == uint256(300));
+    BOOST_CHECK(vHashes[1] == uint256(1000));
+    BOOST_CHECK(vHashes[2] == uint256(2000));
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_connect_disconnect)
+{
+    bool fAddressIndexOld = fAddressIndex, fSpentIndexOld = fSpentIndex, fTimestampIndexOld = fTimestampIndex;
+    fAddressIndex = fSpentIndex = fTimestampIndex = true;
+
+    CKey keyA, keyB;
+    keyA.MakeNewKey(true);
+    keyB.MakeNewKey(true);
+    uint160 hashA(keyA.GetPubKey().GetID());
+    uint160 hashB(keyB.GetPubKey().GetID());
+    CTxOut txoutPrev(5 * COIN, GetScriptForDestination(keyA.GetPubKey().GetID()));
+
+    // An output to A from height 1, as an earlier block left it in the unspent index
+    uint256 hashPrev = GetRandHash();
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vSeed;
+    vSeed.push_back(std::make_pair(CAddressUnspentKey(ADDRESS_INDEX_PUBKEYHASH, hashA, hashPrev, 0), CAddressUnspentValue(txoutPrev.nValue, txoutPrev.scriptPubKey, 1)));
+    BOOST_CHECK(pblocktree->UpdateAddressUnspentIndex(vSeed));
+
+    // A block at height 2 whose second transaction spends it to B
+    CMutableTransaction txCoinbase;
+    txCoinbase.vin.resize(1);
+    txCoinbase.vin[0].prevout.SetNull();
+    txCoinbase.vout.push_back(CTxOut(0, CScript()));
+    CMutableTransaction txSpend;
+    txSpend.vin.push_back(CTxIn(COutPoint(hashPrev, 0)));
+    txSpend.vout.push_back(CTxOut(4 * COIN, GetScriptForDestination(keyB.GetPubKey().GetID())));
+    CBlock block;
+    block.nTime = 1500000000;
+    block.vtx.push_back(CTransaction(txCoinbase));
+    block.vtx.push_back(CTransaction(txSpend));
+    CBlockUndo blockundo;
+    blockundo.vtxundo.resize(1);
+    blockundo.vtxundo[0].vprevout.push_back(CTxInUndo(txoutPrev, false, false, 1, 1));
+
+    uint256 hashBlock = block.GetHash();
+    CBlockIndex index(block);
+    index.phashBlock = &hashBlock;
+    index.nHeight = 2;
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+    const uint256 hashSpend = block.vtx[1].GetHash();
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vIndexA, vIndexB;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspentA, vUnspentB;
+    CSpentIndexValue spent;
+    std::vector<uint256> vHashes;
+
+    // Connecting writes the spend under A, the payment and new unspent output under B,
+    // the spent record and the block's time
+    BOOST_CHECK(UpdateBlockExplorerIndexes(block, blockundo, &index, view, true));
+    BOOST_CHECK(GetAddressIndex(ADDRESS_INDEX_PUBKEYHASH, hashA, vIndexA));
+    BOOST_CHECK_EQUAL(vIndexA.size(), 1U);
+    if (vIndexA.size() == 1) {
+        BOOST_CHECK(vIndexA[0].first.fSpending);
+        BOOST_CHECK(vIndexA[0].first.txhash == hashSpend);
+        BOOST_CHECK_EQUAL(vIndexA[0].first.nHeight, 2);
+        BOOST_CHECK_EQUAL(vIndexA[0].second, -5 * COIN);
+    }
+    BOOST_CHECK(GetAddressIndex(ADDRESS_INDEX_PUBKEYHASH, hashB, vIndexB));
+    BOOST_CHECK_EQUAL(vIndexB.size(), 1U);
+    if (vIndexB.size() == 1) {
+        BOOST_CHECK(!vIndexB[0].first.fSpending);
+        BOOST_CHECK_EQUAL(vIndexB[0].second, 4 * COIN);
+    }
+    BOOST_CHECK(GetAddressUnspent(ADDRESS_INDEX_PUBKEYHASH, hashA, vUnspentA));
+    BOOST_CHECK(vUnspentA.empty());
+    BOOST_CHECK(GetAddressUnspent(ADDRESS_INDEX_PUBKEYHASH, hashB, vUnspentB));
+    BOOST_CHECK_EQUAL(vUnspentB.size(), 1U);
+    BOOST_CHECK(GetSpentIndex(CSpentIndexKey(hashPrev, 0), spent));
+    BOOST_CHECK(spent.txid == hashSpend);
+    BOOST_CHECK_EQUAL(spent.nHeight, 2);
+    BOOST_CHECK(spent.addressHash == hashA);
+    BOOST_CHECK(GetTimestampIndex(block.nTime + 1, block.nTime, vHashes));
+    BOOST_CHECK(vHashes.size() == 1 && vHashes[0] == hashBlock);
+
+    // Disconnecting takes them all back out and gives A its unspent output again
+    BOOST_CHECK(UpdateBlockExplorerIndexes(block, blockundo, &index, view, false));
+    vIndexA.clear();
+    vIndexB.clear();
+    vUnspentA.clear();
+    vUnspentB.clear();
+    vHashes.clear();
+    BOOST_CHECK(GetAddressIndex(ADDRESS_INDEX_PUBKEYHASH, hashA, vIndexA));
+    BOOST_CHECK(vIndexA.empty());
+    BOOST_CHECK(GetAddressIndex(ADDRESS_INDEX_PUBKEYHASH, hashB, vIndexB));
+    BOOST_CHECK(vIndexB.empty());
+    BOOST_CHECK(GetAddressUnspent(ADDRESS_INDEX_PUBKEYHASH, hashA, vUnspentA));
+    BOOST_CHECK_EQUAL(vUnspentA.size(), 1U);
+    if (vUnspentA.size() == 1) {
+        BOOST_CHECK(vUnspentA[0].first.txhash == hashPrev);
+        BOOST_CHECK_EQUAL(vUnspentA[0].second.nSatoshis, 5 * COIN);
+        BOOST_CHECK_EQUAL(vUnspentA[0].second.nHeight, 1);
+    }
+    BOOST_CHECK(GetAddressUnspent(ADDRESS_INDEX_PUBKEYHASH, hashB, vUnspentB));
+    BOOST_CHECK(vUnspentB.empty());
+    BOOST_CHECK(!GetSpentIndex(CSpentIndexKey(hashPrev, 0), spent));
+    BOOST_CHECK(GetTimestampIndex(block.nTime + 1, block.nTime, vHashes));
+    BOOST_CHECK(vHashes.empty());
+
+    fAddressIndex = fAddressIndexOld;
+    fSpentIndex = fSpentIndexOld;
+    fTimestampIndex = fTimestampIndexOld;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
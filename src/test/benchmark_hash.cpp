@@ -0,0 +1,91 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/sha256.h"
+#include "hash.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+// Hashes per timed run; small enough to keep the suite fast
+static const size_t BENCH_HASHES = 20000;
+
+// Timings go to the debug log under -debug=bench, so make check stays quiet
+static void ReportRate(const string& strName, int64_t nMicros, size_t nHashes)
+{
+    LogPrint("bench", "  %s: %d ns per hash\n", strName, nMicros * 1000 / (int64_t)nHashes);
+}
+
+BOOST_AUTO_TEST_SUITE(benchmark_hash)
+
+BOOST_AUTO_TEST_CASE(benchmark_sha256d)
+{
+    LogPrint("bench", "SHA256 implementation %s\n", SHA256AutoDetect());
+
+    vector<uint256> vIn(2 * BENCH_HASHES), vOut(BENCH_HASHES), vOutMany(BENCH_HASHES);
+    for (size_t i = 0; i < vIn.size(); i++)
+        vIn[i] = GetRandHash();
+
+    // One pass over a large buffer, as for block data
+    vector<unsigned char> vData(1000000);
+    for (size_t i = 0; i < vData.size(); i++)
+        vData[i] = insecure_rand();
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    int64_t nStart = GetTimeMicros();
+    CSHA256().Write(&vData[0], vData.size()).Finalize(hash);
+    LogPrint("bench", "  SHA256 1MB: %d us\n", GetTimeMicros() - nStart);
+
+    // 64-byte inputs, as hashed by the merkle tree
+    nStart = GetTimeMicros();
+    for (size_t i = 0; i < BENCH_HASHES; i++)
+        vOut[i] = Hash(vIn[2 * i].begin(), vIn[2 * i].end(), vIn[2 * i + 1].begin(), vIn[2 * i + 1].end());
+    ReportRate("Hash 64 bytes", GetTimeMicros() - nStart, BENCH_HASHES);
+
+    nStart = GetTimeMicros();
+    SHA256D64(vOutMany[0].begin(), vIn[0].begin(), BENCH_HASHES);
+    ReportRate("SHA256D64", GetTimeMicros() - nStart, BENCH_HASHES);
+    BOOST_CHECK(vOut == vOutMany);
+
+    // Kernel-sized inputs, as hashed by the stake search
+    const size_t nLen = 8 + 4 + 36 + 4;
+    vector<unsigned char> vKernels(nLen * BENCH_HASHES);
+    for (size_t i = 0; i < vKernels.size(); i++)
+        vKernels[i] = insecure_rand();
+
+    nStart = GetTimeMicros();
+    for (size_t i = 0; i < BENCH_HASHES; i++)
+        vOut[i] = Hash(vKernels.begin() + i * nLen, vKernels.begin() + (i + 1) * nLen);
+    ReportRate("Hash kernel", GetTimeMicros() - nStart, BENCH_HASHES);
+
+    nStart = GetTimeMicros();
+    SHA256DMany(vOutMany[0].begin(), &vKernels[0], nLen, BENCH_HASHES);
+    ReportRate("SHA256DMany kernel", GetTimeMicros() - nStart, BENCH_HASHES);
+    BOOST_CHECK(vOut == vOutMany);
+}
+
+BOOST_AUTO_TEST_CASE(benchmark_merkle)
+{
+    CBlock block;
+    for (int i = 0; i < 2000; i++) {
+        CMutableTransaction tx;
+        tx.nLockTime = i;
+        block.vtx.push_back(tx);
+    }
+
+    int64_t nStart = GetTimeMicros();
+    for (int i = 0; i < 10; i++)
+        block.BuildMerkleTree();
+    LogPrint("bench", "  BuildMerkleTree 2000 txs: %d us\n", (GetTimeMicros() - nStart) / 10);
+
+    BOOST_CHECK(block.vMerkleTree.size() > block.vtx.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
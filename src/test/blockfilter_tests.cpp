@@ -0,0 +1,169 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "clientversion.h"
+#include "main.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "script/script.h"
+#include "streams.h"
+#include "txdb.h"
+#include "undo.h"
+#ifdef ENABLE_WALLET
+#include "init.h"
+#include "wallet.h"
+#include "zuserxtracker.h"
+#endif
+
+#include <algorithm>
+#include <limits>
+
+#include <boost/test/unit_test.hpp>
+
+static uint64_t HashScript(const CScript& script)
+{
+    return CBlockFilter::HashElement(script.data(), script.data() + script.size());
+}
+
+BOOST_AUTO_TEST_SUITE(blockfilter_tests)
+
+BOOST_AUTO_TEST_CASE(blockfilter_match)
+{
+    std::vector<CScript> vIncluded;
+    std::vector<CScript> vExcluded;
+    for (int i = 0; i < 100; i++) {
+        vIncluded.push_back(CScript() << ToByteVector(GetRandHash()) << OP_CHECKSIG);
+        vExcluded.push_back(CScript() << ToByteVector(GetRandHash()) << OP_CHECKSIG);
+    }
+
+    CBlock block;
+    CMutableTransaction tx;
+    for (int i = 0; i < 50; i++)
+        tx.vout.push_back(CTxOut(1, vIncluded[i]));
+    tx.vout.push_back(CTxOut(0, CScript() << OP_RETURN << ToByteVector(GetRandHash())));
+    block.vtx.push_back(tx);
+
+    // The second half are scripts spent by the block
+    CBlockUndo blockundo;
+    blockundo.vtxundo.push_back(CTxUndo());
+    for (int i = 50; i < 100; i++)
+        blockundo.vtxundo.back().vprevout.push_back(CTxInUndo(CTxOut(1, vIncluded[i])));
+
+    CBlockFilter filter(block, blockundo);
+    BOOST_CHECK_EQUAL(filter.GetElementCount(), 100U);
+
+    // Serialization round trip
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << filter;
+    CBlockFilter filter2;
+    ss >> filter2;
+
+    BOOST_FOREACH (const CScript& script, vIncluded) {
+        std::vector<uint64_t> vHashes(1, HashScript(script));
+        BOOST_CHECK(filter.MatchAny(vHashes));
+        BOOST_CHECK(filter2.MatchAny(vHashes));
+    }
+
+    // At a false positive rate of 1/784931 none of these should match
+    std::vector<uint64_t> vHashes;
+    BOOST_FOREACH (const CScript& script, vExcluded)
+        vHashes.push_back(HashScript(script));
+    std::sort(vHashes.begin(), vHashes.end());
+    BOOST_CHECK(!filter.MatchAny(vHashes));
+
+    // One included element among many excluded ones
+    vHashes.push_back(HashScript(vIncluded[75]));
+    std::sort(vHashes.begin(), vHashes.end());
+    BOOST_CHECK(filter.MatchAny(vHashes));
+
+    // OP_RETURN outputs are not indexed
+    std::vector<uint64_t> vReturn(1, HashScript(block.vtx[0].vout.back().scriptPubKey));
+    BOOST_CHECK(!filter.MatchAny(vReturn));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_empty)
+{
+    CBlock block;
+    CBlockUndo blockundo;
+    CBlockFilter filter(block, blockundo);
+    BOOST_CHECK_EQUAL(filter.GetElementCount(), 0U);
+
+    std::vector<uint64_t> vHashes(1, GetRand(std::numeric_limits<uint64_t>::max()));
+    BOOST_CHECK(!filter.MatchAny(vHashes));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_zerocoin_spend)
+{
+    std::vector<uint64_t> vSpend(1, CBlockFilter::GetZerocoinSpendElement());
+
+    CBlock block;
+    CMutableTransaction tx;
+    tx.vout.push_back(CTxOut(1, CScript() << ToByteVector(GetRandHash()) << OP_CHECKSIG));
+    block.vtx.push_back(tx);
+    BOOST_CHECK(!CBlockFilter(block, CBlockUndo()).MatchAny(vSpend));
+
+    // A spend paying elsewhere still matches through the spend marker
+    CMutableTransaction txSpend;
+    txSpend.vin.resize(1);
+    txSpend.vin[0].scriptSig = CScript() << OP_ZEROCOINSPEND << 0;
+    txSpend.vout.push_back(CTxOut(1, CScript() << ToByteVector(GetRandHash()) << OP_CHECKSIG));
+    BOOST_CHECK(CTransaction(txSpend).IsZerocoinSpend());
+    block.vtx.push_back(txSpend);
+    BOOST_CHECK(CBlockFilter(block, CBlockUndo()).MatchAny(vSpend));
+}
+
+
+BOOST_AUTO_TEST_CASE(blockfilter_db_best_block)
+{
+    CBlockFilterDB db(1 << 20, true);
+    BOOST_CHECK(db.ReadBestBlock() == 0);
+
+    CBlock block;
+    CBlockFilter filter(block, CBlockUndo());
+    uint256 hash1 = GetRandHash(), hash2 = GetRandHash();
+
+    // A filter written ahead of the index leaves the best block alone
+    BOOST_CHECK(db.WriteFilter(hash2, filter));
+    BOOST_CHECK(db.HaveFilter(hash2));
+    BOOST_CHECK(db.ReadBestBlock() == 0);
+
+    BOOST_CHECK(db.WriteFilter(hash1, filter, true));
+    BOOST_CHECK(db.ReadBestBlock() == hash1);
+    BOOST_CHECK(db.WriteBestBlock(hash2));
+    BOOST_CHECK(db.ReadBestBlock() == hash2);
+}
+
+#ifdef ENABLE_WALLET
+BOOST_AUTO_TEST_CASE(blockfilter_wallet_external_spend)
+{
+    // A wallet holding a mint must rescan blocks whose spend pays to a script it does not own
+    CBigNum bnPubcoin = CBigNum::randBignum(CBigNum(1) << 256);
+    CZerocoinMint mint(libzerocoin::CoinDenomination::ZQ_ONE, bnPubcoin, CBigNum(0), CBigNum(1), false, 1);
+    pwalletMain->zuserxTracker->Init();
+    pwalletMain->zuserxTracker->Add(mint);
+
+    std::vector<uint64_t> vHashes;
+    pwalletMain->GetBlockFilterElements(vHashes);
+    BOOST_CHECK(std::binary_search(vHashes.begin(), vHashes.end(), CBlockFilter::GetZerocoinSpendElement()));
+
+    CBlock block;
+    CMutableTransaction tx;
+    tx.vout.push_back(CTxOut(1, CScript() << ToByteVector(GetRandHash()) << OP_CHECKSIG));
+    block.vtx.push_back(tx);
+    BOOST_CHECK(!CBlockFilter(block, CBlockUndo()).MatchAny(vHashes));
+
+    CMutableTransaction txSpend;
+    txSpend.vin.resize(1);
+    txSpend.vin[0].scriptSig = CScript() << OP_ZEROCOINSPEND << 0;
+    txSpend.vout.push_back(CTxOut(1, CScript() << ToByteVector(GetRandHash()) << OP_CHECKSIG));
+    block.vtx.push_back(txSpend);
+    BOOST_CHECK(CBlockFilter(block, CBlockUndo()).MatchAny(vHashes));
+
+    pwalletMain->zuserxTracker->Clear();
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,7 +9,11 @@
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/muhash.h"
+#include "hash.h"
+#include "primitives/block.h"
 #include "random.h"
+#include "streams.h"
 #include "utilstrencodings.h"
 
 #include <vector>
@@ -131,6 +135,54 @@ BOOST_AUTO_TEST_CASE(sha256_testvectors) {
     TestSHA256(test1, "a316d55510b49662420f49d145d42fb83f31ef8dc016aa4e32df049991a91e26");
 }
 
+BOOST_AUTO_TEST_CASE(sha256d_many) {
+    // Lengths around the one and two chunk padding boundaries, and batch
+    // sizes that leave a remainder for every lane count
+    static const size_t lens[] = {0, 32, 55, 56, 64, 80, 119, 120, 200};
+    for (unsigned int l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+        const size_t len = lens[l];
+        for (size_t n = 1; n <= 17; n += 4) {
+            std::vector<unsigned char> in(len * n + 1);
+            for (size_t i = 0; i < in.size(); i++)
+                in[i] = insecure_rand();
+            std::vector<uint256> out(n);
+            SHA256DMany(out[0].begin(), &in[0], len, n);
+            for (size_t i = 0; i < n; i++)
+                BOOST_CHECK(out[i] == Hash(in.begin() + i * len, in.begin() + (i + 1) * len));
+        }
+    }
+
+    std::vector<uint256> in(20), out(10);
+    for (size_t i = 0; i < in.size(); i++)
+        in[i] = GetRandHash();
+    SHA256D64(out[0].begin(), in[0].begin(), out.size());
+    for (size_t i = 0; i < out.size(); i++)
+        BOOST_CHECK(out[i] == Hash(in[2 * i].begin(), in[2 * i].end(), in[2 * i + 1].begin(), in[2 * i + 1].end()));
+}
+
+BOOST_AUTO_TEST_CASE(merkle_root_batched) {
+    // Odd and even level sizes, with the last hash of a level paired with itself
+    CBlock block;
+    for (int nTx = 1; nTx <= 33; nTx++) {
+        CMutableTransaction tx;
+        tx.nLockTime = nTx;
+        block.vtx.push_back(tx);
+
+        std::vector<uint256> vLevel;
+        for (size_t i = 0; i < block.vtx.size(); i++)
+            vLevel.push_back(block.vtx[i].GetHash());
+        while (vLevel.size() > 1) {
+            std::vector<uint256> vNext;
+            for (size_t i = 0; i < vLevel.size(); i += 2) {
+                const uint256& right = vLevel[std::min(i + 1, vLevel.size() - 1)];
+                vNext.push_back(Hash(vLevel[i].begin(), vLevel[i].end(), right.begin(), right.end()));
+            }
+            vLevel.swap(vNext);
+        }
+        BOOST_CHECK(block.BuildMerkleTree() == vLevel[0]);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(sha512_testvectors) {
     TestSHA512("",
                "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
@@ -282,4 +334,70 @@ BOOST_AUTO_TEST_CASE(rfc6979_hmac_sha256)
             ("7597887cbd76321f32e30440679a22cf7f8d9d2eac390e581fea091ce202ba94"));
 }
 
+static std::string MuHashHex(MuHash3072 muhash)
+{
+    unsigned char hash[MuHash3072::OUTPUT_SIZE];
+    muhash.Finalize(hash);
+    return HexStr(hash, hash + sizeof(hash));
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    const unsigned char* abc = (const unsigned char*)"abc";
+
+    // The empty set, {"abc"} and {"abc"}^-1
+    BOOST_CHECK_EQUAL(MuHashHex(MuHash3072()), "c85525462fdcf30a2c18d6f4b92923000974355c2477f59594d2c205a1d25add");
+    BOOST_CHECK_EQUAL(MuHashHex(MuHash3072().Insert(abc, 3)), "fa28c8b17b698e6b5b9bcf74892b5ede6e7be2c6e2ce61abb3009ac132812b04");
+    BOOST_CHECK_EQUAL(MuHashHex(MuHash3072().Remove(abc, 3)), "d816d48cd69bbc53c47a49b6f4898c83bfe6c6bfca053c983b10ae685dd63ae5");
+
+    std::vector<uint256> vElements;
+    for (int i = 0; i < 8; i++)
+        vElements.push_back(GetRandHash());
+
+    // Only the final set matters, not the order of insertions and removals
+    MuHash3072 forwards, backwards, half1, half2;
+    for (unsigned int i = 0; i < vElements.size(); i++) {
+        forwards.Insert(vElements[i].begin(), 32);
+        backwards.Insert(vElements[vElements.size() - 1 - i].begin(), 32);
+        (i % 2 ? half1 : half2).Insert(vElements[i].begin(), 32);
+    }
+    BOOST_CHECK_EQUAL(MuHashHex(forwards), MuHashHex(backwards));
+    half1 *= half2;
+    BOOST_CHECK_EQUAL(MuHashHex(half1), MuHashHex(forwards));
+
+    MuHash3072 removed = forwards;
+    removed.Remove(vElements[3].begin(), 32);
+    BOOST_CHECK(MuHashHex(removed) != MuHashHex(forwards));
+    MuHash3072 without;
+    for (unsigned int i = 0; i < vElements.size(); i++) {
+        if (i != 3)
+            without.Insert(vElements[i].begin(), 32);
+    }
+    BOOST_CHECK_EQUAL(MuHashHex(removed), MuHashHex(without));
+    removed /= half2;
+    removed *= half2;
+    BOOST_CHECK_EQUAL(MuHashHex(removed), MuHashHex(without));
+
+    // The running state survives a round trip through serialization
+    CDataStream ss(SER_DISK, 0);
+    ss << removed;
+    MuHash3072 read;
+    ss >> read;
+    BOOST_CHECK_EQUAL(MuHashHex(read), MuHashHex(without));
+
+    // Inverses of numbers next to the prime
+    Num3072 x;
+    for (int i = 0; i < Num3072::LIMBS; i++)
+        x.limbs[i] = ~(uint64_t)0;
+    x.limbs[0] -= 1103717;
+    Num3072 inv = x.GetInverse();
+    inv.Multiply(x);
+    BOOST_CHECK(inv.limbs[0] == 1 && inv.limbs[Num3072::LIMBS - 1] == 0);
+    x.SetToOne();
+    x.limbs[0] = 2;
+    inv = x.GetInverse();
+    inv.Multiply(x);
+    BOOST_CHECK(inv.limbs[0] == 1 && inv.limbs[Num3072::LIMBS - 1] == 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -46,4 +46,16 @@ BOOST_AUTO_TEST_CASE(murmurhash3)
 #undef T
 }
 
+BOOST_AUTO_TEST_CASE(quark_testvectors)
+{
+    // Covers the SSE2 JH and AES-NI Groestl stages where the CPU has them
+    vector<unsigned char> vch(80, 0);
+    BOOST_CHECK_EQUAL(HashQuark(vch.begin(), vch.end()).GetHex(),
+                      "02067fe51503a2f5ebb46b8a06f185fb8763a5d3d758eee11a3a0ea055823d63");
+    for (int i = 0; i < 80; i++)
+        vch[i] = i;
+    BOOST_CHECK_EQUAL(HashQuark(vch.begin(), vch.end()).GetHex(),
+                      "ce5ec7b3af68ac039b417096a3aaf87aab5ec285f9843291a2fff881907569ae");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
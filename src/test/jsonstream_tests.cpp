@@ -0,0 +1,72 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "jsonstream.h"
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+
+static void AppendChunk(std::string& strOut, unsigned int& nChunks, const std::string& chunk)
+{
+    strOut += chunk;
+    nChunks++;
+}
+
+BOOST_AUTO_TEST_SUITE(jsonstream_tests)
+
+BOOST_AUTO_TEST_CASE(jsonstream_matches_univalue)
+{
+    UniValue tx(UniValue::VOBJ);
+    tx.push_back(Pair("txid", "ab\"c\\d\n"));
+    tx.push_back(Pair("vout", 3));
+    tx.push_back(Pair("empty", UniValue(UniValue::VARR)));
+
+    UniValue before(UniValue::VOBJ);
+    before.push_back(Pair("hash", "00ff"));
+    before.push_back(Pair("height", 12));
+    UniValue after(UniValue::VOBJ);
+    after.push_back(Pair("time", 1234567890));
+    after.push_back(Pair("next", NullUniValue));
+
+    UniValue expected(UniValue::VOBJ);
+    expected.pushKVs(before);
+    UniValue txs(UniValue::VARR);
+    for (int i = 0; i < 100; i++)
+        txs.push_back(tx);
+    expected.push_back(Pair("tx", txs));
+    expected.pushKVs(after);
+    expected.push_back(Pair("nested", UniValue(UniValue::VOBJ)));
+
+    // A tiny flush size makes the writer hand over many chunks
+    std::string strOut;
+    unsigned int nChunks = 0;
+    CJSONStreamWriter writer(boost::bind(&AppendChunk, boost::ref(strOut), boost::ref(nChunks), _1), 100);
+    writer.BeginObject().Fields(before).Key("tx").BeginArray();
+    for (int i = 0; i < 100; i++)
+        writer.Value(tx);
+    writer.EndArray().Fields(after).Key("nested").BeginObject().EndObject().EndObject();
+    writer.Finish();
+
+    BOOST_CHECK_EQUAL(strOut, expected.write() + "\n");
+    BOOST_CHECK(nChunks > 10);
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_top_level_values)
+{
+    std::string strOut;
+    unsigned int nChunks = 0;
+    CJSONStreamWriter writer(boost::bind(&AppendChunk, boost::ref(strOut), boost::ref(nChunks), _1));
+    writer.BeginArray().EndArray();
+    writer.Finish();
+    BOOST_CHECK_EQUAL(strOut, "[]\n");
+    BOOST_CHECK_EQUAL(nChunks, 1U);
+
+    strOut.clear();
+    CJSONStreamWriter writerHex(boost::bind(&AppendChunk, boost::ref(strOut), boost::ref(nChunks), _1));
+    writerHex.Value("0102");
+    writerHex.Finish();
+    BOOST_CHECK_EQUAL(strOut, "\"0102\"\n");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,348 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "logdb.h"
+#include "random.h"
+#include "util.h"
+
+#include <atomic>
+#include <fstream>
+#include <iterator>
+
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+namespace
+{
+struct LogDBSetup {
+    boost::filesystem::path pathDir;
+
+    LogDBSetup()
+    {
+        pathDir = GetTempPath() / strprintf("test_logdb_%lu_%i", (unsigned long)GetTime(), (int)GetRand(100000));
+        boost::filesystem::create_directories(pathDir);
+    }
+    ~LogDBSetup()
+    {
+        boost::filesystem::remove_all(pathDir);
+    }
+};
+
+CSerializeData Value(const std::string& str)
+{
+    return CSerializeData(str.begin(), str.end());
+}
+
+std::string ReadValue(CLogDB& logdb, const std::string& key)
+{
+    CSerializeData value;
+    if (!logdb.Read(key, value))
+        return "<missing>";
+    return std::string(value.begin(), value.end());
+}
+
+std::string ReadFile(const boost::filesystem::path& path)
+{
+    std::ifstream file(path.string().c_str(), std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+} // anon namespace
+
+BOOST_FIXTURE_TEST_SUITE(logdb_tests, LogDBSetup)
+
+BOOST_AUTO_TEST_CASE(logdb_readwrite)
+{
+    boost::filesystem::path path = pathDir / "wallet.dat.log";
+    {
+        CLogDB logdb;
+        BOOST_CHECK(!logdb.Open(path, false));
+        BOOST_CHECK(logdb.Open(path, true));
+        BOOST_CHECK(logdb.Write("a", Value("1")));
+        BOOST_CHECK(logdb.Write("b", Value("2")));
+        BOOST_CHECK(logdb.Write("a", Value("3")));
+        BOOST_CHECK(logdb.Write("empty", Value("")));
+        BOOST_CHECK(logdb.Erase("b"));
+        BOOST_CHECK(logdb.Erase("missing"));
+
+        BOOST_CHECK_EQUAL(ReadValue(logdb, "a"), "3");
+        BOOST_CHECK_EQUAL(ReadValue(logdb, "b"), "<missing>");
+        BOOST_CHECK_EQUAL(ReadValue(logdb, "empty"), "");
+        BOOST_CHECK(!logdb.Exists("b"));
+        BOOST_CHECK_EQUAL(logdb.GetCount(), 2U);
+
+        // A transaction reaches the log as a whole
+        CLogDBTxn txn;
+        txn.Write("c", Value("4"));
+        txn.Erase("a");
+        txn.Write("d", Value("5"));
+        BOOST_CHECK_EQUAL(ReadValue(logdb, "c"), "<missing>");
+        BOOST_CHECK(logdb.Commit(txn));
+        BOOST_CHECK_EQUAL(ReadValue(logdb, "c"), "4");
+        BOOST_CHECK(!logdb.Exists("a"));
+    }
+
+    // Read back with the saved index, then by replaying the whole log
+    for (int i = 0; i < 2; i++) {
+        if (i == 1)
+            boost::filesystem::remove(path.string() + ".idx");
+        CLogDB logdb;
+        BOOST_CHECK(logdb.Open(path, false));
+        BOOST_CHECK_EQUAL(logdb.GetCount(), 3U);
+        BOOST_CHECK_EQUAL(ReadValue(logdb, "c"), "4");
+        BOOST_CHECK_EQUAL(ReadValue(logdb, "d"), "5");
+        BOOST_CHECK_EQUAL(ReadValue(logdb, "empty"), "");
+
+        // Key order
+        std::string key;
+        CSerializeData value;
+        std::vector<std::string> vKeys;
+        for (bool fFirst = true; logdb.Next(key, value, fFirst); fFirst = false)
+            vKeys.push_back(key);
+        BOOST_CHECK_EQUAL(vKeys.size(), 3U);
+        BOOST_CHECK(vKeys[0] == "c" && vKeys[1] == "d" && vKeys[2] == "empty");
+        key = "d";
+        BOOST_CHECK(logdb.Next(key, value, true) && key == "d");
+        BOOST_CHECK(logdb.Next(key, value, false) && key == "empty");
+        BOOST_CHECK(!logdb.Next(key, value, false));
+
+        // Log order
+        logdb.GetKeysInLogOrder(vKeys);
+        BOOST_CHECK_EQUAL(vKeys.size(), 3U);
+        BOOST_CHECK(vKeys[0] == "empty" && vKeys[1] == "c" && vKeys[2] == "d");
+    }
+}
+
+BOOST_AUTO_TEST_CASE(logdb_torn_tail)
+{
+    boost::filesystem::path path = pathDir / "wallet.dat.log";
+    uint64_t nSize;
+    {
+        CLogDB logdb;
+        BOOST_CHECK(logdb.Open(path, true));
+        BOOST_CHECK(logdb.Write("a", Value("1")));
+        nSize = logdb.GetFileSize();
+    }
+
+    // A frame cut short by a crash, after the saved index
+    {
+        CLogDB logdb;
+        BOOST_CHECK(logdb.Open(path, false));
+        BOOST_CHECK(logdb.Write("b", Value("2")));
+        BOOST_CHECK(logdb.Write("c", Value("3")));
+    }
+    boost::filesystem::remove(path.string() + ".idx");
+    std::string strLog = ReadFile(path);
+    {
+        std::ofstream file(path.string().c_str(), std::ios::binary | std::ios::trunc);
+        file.write(strLog.data(), strLog.size() - 1);
+    }
+    {
+        CLogDB logdb;
+        BOOST_CHECK(logdb.Open(path, false));
+        BOOST_CHECK_EQUAL(ReadValue(logdb, "a"), "1");
+        BOOST_CHECK_EQUAL(ReadValue(logdb, "b"), "2");
+        BOOST_CHECK(!logdb.Exists("c"));
+        BOOST_CHECK_EQUAL(boost::filesystem::file_size(path), logdb.GetFileSize());
+
+        // Appending goes on from the last whole frame
+        BOOST_CHECK(logdb.Write("d", Value("4")));
+    }
+
+    // The last frame's bytes don't match its checksum
+    strLog = ReadFile(path);
+    strLog[strLog.size() - 1] ^= 1;
+    {
+        std::ofstream file(path.string().c_str(), std::ios::binary | std::ios::trunc);
+        file.write(strLog.data(), strLog.size());
+    }
+    boost::filesystem::remove(path.string() + ".idx");
+    {
+        CLogDB logdb;
+        BOOST_CHECK(logdb.Open(path, false));
+        BOOST_CHECK_EQUAL(ReadValue(logdb, "a"), "1");
+        BOOST_CHECK_EQUAL(ReadValue(logdb, "b"), "2");
+        BOOST_CHECK(!logdb.Exists("d"));
+        BOOST_CHECK(logdb.GetFileSize() > nSize);
+        BOOST_CHECK(logdb.GetFileSize() < strLog.size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(logdb_mid_log_corruption)
+{
+    boost::filesystem::path path = pathDir / "wallet.dat.log";
+    uint64_t nSize;
+    {
+        CLogDB logdb;
+        BOOST_CHECK(logdb.Open(path, true));
+        BOOST_CHECK(logdb.Write("a", Value("1")));
+        nSize = logdb.GetFileSize();
+        BOOST_CHECK(logdb.Write("b", Value("2")));
+        BOOST_CHECK(logdb.Write("c", Value("3")));
+    }
+    boost::filesystem::remove(path.string() + ".idx");
+
+    // A damaged frame with whole frames after it is not a torn tail
+    std::string strLog = ReadFile(path);
+    strLog[nSize + 10] ^= 1;
+    {
+        std::ofstream file(path.string().c_str(), std::ios::binary | std::ios::trunc);
+        file.write(strLog.data(), strLog.size());
+    }
+    {
+        CLogDB logdb;
+        BOOST_CHECK(!logdb.Open(path, false));
+    }
+    BOOST_CHECK(ReadFile(path) == strLog);
+
+    // Nor is a frame header whose size runs past the frames after it
+    strLog[nSize + 10] ^= 1;
+    strLog[nSize + 3] = (char)0x7f;
+    {
+        std::ofstream file(path.string().c_str(), std::ios::binary | std::ios::trunc);
+        file.write(strLog.data(), strLog.size());
+    }
+    {
+        CLogDB logdb;
+        BOOST_CHECK(!logdb.Open(path, false));
+    }
+    BOOST_CHECK(ReadFile(path) == strLog);
+}
+
+BOOST_AUTO_TEST_CASE(logdb_salvage)
+{
+    boost::filesystem::path path = pathDir / "wallet.dat.log";
+    uint64_t nSize;
+    {
+        CLogDB logdb;
+        BOOST_CHECK(logdb.Open(path, true));
+        BOOST_CHECK(logdb.Write("a", Value("1")));
+        nSize = logdb.GetFileSize();
+        BOOST_CHECK(logdb.Write("b", Value("2")));
+        BOOST_CHECK(logdb.Write("c", Value("3")));
+        BOOST_CHECK(logdb.Erase("a"));
+        BOOST_CHECK(logdb.Write("d", Value("4")));
+    }
+
+    // The damaged frame that wrote b is lost, the frames around it are kept
+    std::string strLog = ReadFile(path);
+    strLog[nSize + 10] ^= 1;
+    strLog += "torn";
+    {
+        std::ofstream file(path.string().c_str(), std::ios::binary | std::ios::trunc);
+        file.write(strLog.data(), strLog.size());
+    }
+    std::vector<std::pair<std::string, CSerializeData> > vResult;
+    BOOST_CHECK(CLogDB::Salvage(path, vResult));
+    BOOST_CHECK_EQUAL(vResult.size(), 2U);
+    if (vResult.size() == 2) {
+        BOOST_CHECK_EQUAL(vResult[0].first, "c");
+        BOOST_CHECK(vResult[0].second == Value("3"));
+        BOOST_CHECK_EQUAL(vResult[1].first, "d");
+        BOOST_CHECK(vResult[1].second == Value("4"));
+    }
+
+    {
+        std::ofstream file((pathDir / "other").string().c_str(), std::ios::binary);
+        file << "not a log";
+    }
+    BOOST_CHECK(!CLogDB::Salvage(pathDir / "other", vResult));
+}
+
+BOOST_AUTO_TEST_CASE(logdb_compact)
+{
+    boost::filesystem::path path = pathDir / "wallet.dat.log";
+    std::string strBig(1000, 'x');
+    CLogDB logdb;
+    BOOST_CHECK(logdb.Open(path, true));
+    for (int i = 0; i < 2000; i++)
+        BOOST_CHECK(logdb.Write(strprintf("key%d", i % 10), Value(strprintf("%d", i) + strBig)));
+    BOOST_CHECK(logdb.Write("pool1", Value("p")));
+    uint64_t nSize = logdb.GetFileSize();
+    BOOST_CHECK(nSize > LOGDB_MIN_COMPACT_SIZE);
+
+    // Flush compacts once most of the log is dead
+    BOOST_CHECK(logdb.Flush());
+    BOOST_CHECK(logdb.GetFileSize() < nSize / 100);
+    BOOST_CHECK_EQUAL(logdb.GetCount(), 11U);
+    BOOST_CHECK_EQUAL(ReadValue(logdb, "key3"), "1993" + strBig);
+
+    BOOST_CHECK(logdb.Compact("pool"));
+    BOOST_CHECK(!logdb.Exists("pool1"));
+    BOOST_CHECK(logdb.Write("key0", Value("new")));
+    logdb.Close();
+
+    BOOST_CHECK(logdb.Open(path, false));
+    BOOST_CHECK_EQUAL(logdb.GetCount(), 10U);
+    BOOST_CHECK_EQUAL(ReadValue(logdb, "key0"), "new");
+    BOOST_CHECK_EQUAL(ReadValue(logdb, "key9"), "1999" + strBig);
+}
+
+void WriteKeys(CLogDB* plogdb, const std::atomic<bool>* pfStop, int* pnWritten)
+{
+    for (int i = 0; !*pfStop; i++) {
+        if (!plogdb->Write(strprintf("new%d", i), Value(strprintf("%d", i))))
+            break;
+        *pnWritten = i + 1;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(logdb_compact_concurrent)
+{
+    boost::filesystem::path path = pathDir / "wallet.dat.log";
+    std::string strBig(1000, 'x');
+    CLogDB logdb;
+    BOOST_CHECK(logdb.Open(path, true));
+    for (int i = 0; i < 6000; i++)
+        BOOST_CHECK(logdb.Write(strprintf("key%d", i % 2000), Value(strprintf("%d", i) + strBig)));
+
+    // Writes go on while the log compacts, and none of them is lost
+    std::atomic<bool> fStop(false);
+    int nWritten = 0;
+    boost::thread thread(boost::bind(&WriteKeys, &logdb, &fStop, &nWritten));
+    while (logdb.GetCount() == 2000)
+        MilliSleep(1);
+    BOOST_CHECK(logdb.Flush());
+    fStop = true;
+    thread.join();
+    BOOST_CHECK(logdb.GetFileSize() < 6000 * strBig.size() / 2);
+    BOOST_CHECK_EQUAL(logdb.GetCount(), 2000U + nWritten);
+    BOOST_CHECK_EQUAL(ReadValue(logdb, "key7"), "4007" + strBig);
+    BOOST_CHECK_EQUAL(ReadValue(logdb, strprintf("new%d", nWritten - 1)), strprintf("%d", nWritten - 1));
+    logdb.Close();
+
+    BOOST_CHECK(logdb.Open(path, false));
+    BOOST_CHECK_EQUAL(logdb.GetCount(), 2000U + nWritten);
+    BOOST_CHECK_EQUAL(ReadValue(logdb, "new0"), "0");
+    BOOST_CHECK_EQUAL(ReadValue(logdb, strprintf("new%d", nWritten - 1)), strprintf("%d", nWritten - 1));
+}
+
+BOOST_AUTO_TEST_CASE(logdb_backup)
+{
+    boost::filesystem::path path = pathDir / "wallet.dat.log";
+    boost::filesystem::path pathBackup = pathDir / "backup.log";
+    CLogDB logdb;
+    BOOST_CHECK(logdb.Open(path, true));
+    BOOST_CHECK(logdb.Write("a", Value("1")));
+    BOOST_CHECK(logdb.Backup(pathBackup));
+    BOOST_CHECK(ReadFile(pathBackup) == ReadFile(path));
+
+    // Brought up to date by appending
+    BOOST_CHECK(logdb.Write("b", Value("2")));
+    BOOST_CHECK(logdb.Backup(pathBackup));
+    BOOST_CHECK(ReadFile(pathBackup) == ReadFile(path));
+
+    // Copied in full once the log is no longer an extension of it
+    BOOST_CHECK(logdb.Compact());
+    BOOST_CHECK(logdb.Backup(pathBackup));
+    BOOST_CHECK(ReadFile(pathBackup) == ReadFile(path));
+
+    CLogDB logdbBackup;
+    BOOST_CHECK(logdbBackup.Open(pathBackup, false));
+    BOOST_CHECK_EQUAL(ReadValue(logdbBackup, "a"), "1");
+    BOOST_CHECK_EQUAL(ReadValue(logdbBackup, "b"), "2");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
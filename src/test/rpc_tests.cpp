@@ -7,10 +7,14 @@
 #include "rpcclient.h"
 
 #include "base58.h"
+#include "main.h"
 #include "netbase.h"
+#include "script/script.h"
 #include "util.h"
+#include "utilstrencodings.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/thread.hpp>
 #include <boost/test/unit_test.hpp>
 
 #include <univalue.h>
@@ -264,4 +268,246 @@ BOOST_AUTO_TEST_CASE(rpc_ban)
     BOOST_CHECK_EQUAL(adr.get_str(), "2001:4d48:ac57:400:cacf:e9ff:fe1d:9c63/128");
 }
 
+static bool RunOnNewThread(const boost::function<void(void)>& func)
+{
+    boost::thread(func).detach();
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(rpc_batch)
+{
+    UniValue vReq(UniValue::VARR);
+    for (int i = 0; i < 50; i++) {
+        UniValue req(UniValue::VOBJ);
+        req.push_back(Pair("id", i));
+        if (i == 7) {
+            req.push_back(Pair("method", "nosuchmethod"));
+        } else {
+            req.push_back(Pair("method", "decodescript"));
+            UniValue params(UniValue::VARR);
+            params.push_back(HexStr(CScript() << i));
+            req.push_back(Pair("params", params));
+        }
+        vReq.push_back(req);
+    }
+
+    // Helpers or not, replies come back complete and in request order
+    UniValue serial, parallel;
+    BOOST_CHECK(serial.read(JSONRPCExecBatch(vReq)));
+    BOOST_CHECK(parallel.read(JSONRPCExecBatch(vReq, &RunOnNewThread, 3)));
+    BOOST_CHECK_EQUAL(serial.size(), vReq.size());
+    BOOST_CHECK_EQUAL(serial.write(), parallel.write());
+    for (unsigned int i = 0; i < parallel.size(); i++) {
+        BOOST_CHECK_EQUAL(find_value(parallel[i].get_obj(), "id").get_int(), (int)i);
+        BOOST_CHECK_EQUAL(find_value(parallel[i].get_obj(), "error").isNull(), i != 7);
+    }
+}
+
+static bool fRecordCommands = false;
+static boost::mutex csRecordedCommands;
+static std::vector<std::pair<std::string, boost::thread::id> > vRecordedCommands;
+
+static void RecordCommand(const CRPCCommand& cmd)
+{
+    if (!fRecordCommands)
+        return;
+    boost::lock_guard<boost::mutex> lock(csRecordedCommands);
+    vRecordedCommands.push_back(std::make_pair(cmd.name, boost::this_thread::get_id()));
+}
+
+BOOST_AUTO_TEST_CASE(rpc_batch_order)
+{
+    // readOnly runs either side of a call that changes state
+    UniValue vReq(UniValue::VARR);
+    for (int i = 0; i < 21; i++) {
+        UniValue req(UniValue::VOBJ);
+        req.push_back(Pair("id", i));
+        if (i == 10) {
+            req.push_back(Pair("method", "clearbanned"));
+        } else {
+            req.push_back(Pair("method", "decodescript"));
+            UniValue params(UniValue::VARR);
+            params.push_back(HexStr(CScript() << i));
+            req.push_back(Pair("params", params));
+        }
+        vReq.push_back(req);
+    }
+
+    RPCServer::OnPreCommand(&RecordCommand);
+    fRecordCommands = true;
+    UniValue ret;
+    BOOST_CHECK(ret.read(JSONRPCExecBatch(vReq, &RunOnNewThread, 3)));
+    fRecordCommands = false;
+    BOOST_CHECK_EQUAL(ret.size(), vReq.size());
+
+    // The state change runs on the calling thread, after every entry before
+    // it and before every entry after it
+    BOOST_CHECK_EQUAL(vRecordedCommands.size(), vReq.size());
+    BOOST_CHECK_EQUAL(vRecordedCommands[10].first, "clearbanned");
+    BOOST_CHECK(vRecordedCommands[10].second == boost::this_thread::get_id());
+}
+
+extern std::vector<const CBlockIndex*> GetBlockRange(int nStart, int nCount);
+extern bool ReadBlockAndUndo(const CBlockIndex* pindex, CBlock& block, CBlockUndo& blockundo);
+extern bool WriteBlockRangeEntry(const CBlockIndex* pindex, CDataStream& ss);
+
+/** Write a block and its undo data to block file nFile and make it the active tip */
+static CBlockIndex* AppendTestBlock(CBlock& block, CBlockUndo& blockundo, int nFile)
+{
+    LOCK(cs_main);
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    block.hashPrevBlock = pindexPrev->GetBlockHash();
+    block.nBits = pindexPrev->nBits;
+    block.nTime = pindexPrev->nTime + 60;
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    CDiskBlockPos pos(nFile, 0), posUndo(nFile, 0);
+    BOOST_CHECK(WriteBlockToDisk(block, pos));
+    BOOST_CHECK(blockundo.WriteToDisk(posUndo, pindexPrev->GetBlockHash()));
+
+    CBlockIndex* pindex = new CBlockIndex(block);
+    pindex->phashBlock = &mapBlockIndex.insert(std::make_pair(block.GetHash(), pindex)).first->first;
+    pindex->pprev = pindexPrev;
+    pindex->nHeight = pindexPrev->nHeight + 1;
+    pindex->nFile = nFile;
+    pindex->nDataPos = pos.nPos;
+    pindex->nUndoPos = posUndo.nPos;
+    pindex->nStatus |= BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO;
+    pindex->BuildSkip();
+    chainActive.SetTip(pindex);
+    return pindex;
+}
+
+BOOST_AUTO_TEST_CASE(rpc_blockrange)
+{
+    int nHeight;
+    CBlockIndex* pgenesis;
+    CBlockIndex* pindexTip;
+    {
+        LOCK(cs_main);
+        nHeight = chainActive.Height();
+        pgenesis = chainActive.Genesis();
+        pindexTip = chainActive.Tip();
+    }
+
+    // Counts are bounded, and the start must be in the active chain
+    BOOST_CHECK_THROW(GetBlockRange(0, 0), UniValue);
+    BOOST_CHECK_THROW(GetBlockRange(0, MAX_BLOCKRANGE_COUNT + 1), UniValue);
+    BOOST_CHECK_THROW(GetBlockRange(-1, 1), UniValue);
+    BOOST_CHECK_THROW(GetBlockRange(nHeight + 1, 1), UniValue);
+    BOOST_CHECK_THROW(CallRPC(strprintf("getblockrange 0 %d", MAX_BLOCKRANGE_COUNT + 1)), runtime_error);
+    BOOST_CHECK_THROW(CallRPC(strprintf("getblockrange %d 1", nHeight + 1)), runtime_error);
+
+    // A range past the tip stops at it
+    std::vector<const CBlockIndex*> vIndex = GetBlockRange(0, MAX_BLOCKRANGE_COUNT);
+    BOOST_CHECK_EQUAL(vIndex.size(), (size_t)nHeight + 1);
+    BOOST_CHECK(vIndex.front() == pgenesis);
+
+    // The genesis block has no undo data
+    CBlock block;
+    CBlockUndo blockundo;
+    blockundo.vtxundo.resize(1);
+    BOOST_CHECK(ReadBlockAndUndo(pgenesis, block, blockundo));
+    BOOST_CHECK(block.GetHash() == pgenesis->GetBlockHash());
+    BOOST_CHECK(blockundo.vtxundo.empty());
+
+    // JSON entries
+    UniValue r = CallRPC("getblockrange 0 1");
+    BOOST_CHECK_EQUAL(r.size(), 1U);
+    const UniValue& entry = r[0];
+    BOOST_CHECK_EQUAL(find_value(entry, "hash").get_str(), pgenesis->GetBlockHash().GetHex());
+    BOOST_CHECK_EQUAL(find_value(entry, "height").get_int(), 0);
+    BOOST_CHECK(find_value(entry, "previousblockhash").isNull());
+    BOOST_CHECK_EQUAL(find_value(entry, "time").get_int64(), block.GetBlockTime());
+    BOOST_CHECK_EQUAL(find_value(entry, "size").get_int(), (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+    const UniValue& txs = find_value(entry, "tx");
+    BOOST_CHECK_EQUAL(txs.size(), block.vtx.size());
+    const CTransaction& txCoinbase = block.vtx[0];
+    BOOST_CHECK_EQUAL(find_value(txs[0], "txid").get_str(), txCoinbase.GetHash().GetHex());
+    const UniValue& vin = find_value(txs[0], "vin");
+    BOOST_CHECK_EQUAL(vin.size(), txCoinbase.vin.size());
+    BOOST_CHECK_EQUAL(find_value(vin[0], "coinbase").get_str(), HexStr(txCoinbase.vin[0].scriptSig.begin(), txCoinbase.vin[0].scriptSig.end()));
+    BOOST_CHECK(find_value(vin[0], "txid").isNull());
+    const UniValue& vout = find_value(txs[0], "vout");
+    BOOST_CHECK_EQUAL(vout.size(), txCoinbase.vout.size());
+    BOOST_CHECK_EQUAL(AmountFromValue(find_value(vout[0], "value")), txCoinbase.vout[0].nValue);
+    BOOST_CHECK_EQUAL(find_value(vout[0], "scriptPubKey").get_str(), HexStr(txCoinbase.vout[0].scriptPubKey.begin(), txCoinbase.vout[0].scriptPubKey.end()));
+
+    // Block 1 pays its coinbase to a key; block 2 spends it and holds a zerocoin spend
+    CKey key;
+    key.MakeNewKey(true);
+    CMutableTransaction txCoinbase1;
+    txCoinbase1.vin.resize(1);
+    txCoinbase1.vin[0].scriptSig = CScript() << 1 << OP_0;
+    txCoinbase1.vout.push_back(CTxOut(50 * COIN, GetScriptForDestination(key.GetPubKey().GetID())));
+    CBlock block1;
+    block1.vtx.push_back(txCoinbase1);
+    CBlockUndo blockundo1;
+    CBlockIndex* pindex1 = AppendTestBlock(block1, blockundo1, 97);
+
+    CMutableTransaction txCoinbase2;
+    txCoinbase2.vin.resize(1);
+    txCoinbase2.vin[0].scriptSig = CScript() << 2 << OP_0;
+    txCoinbase2.vout.push_back(CTxOut(0, CScript() << OP_TRUE));
+    CMutableTransaction txSpend;
+    txSpend.vin.push_back(CTxIn(COutPoint(block1.vtx[0].GetHash(), 0)));
+    txSpend.vout.push_back(CTxOut(49 * COIN, CScript() << OP_TRUE));
+    CMutableTransaction txZerocoinSpend;
+    txZerocoinSpend.vin.resize(1);
+    txZerocoinSpend.vin[0].scriptSig = CScript() << OP_ZEROCOINSPEND << std::vector<unsigned char>(16, 0);
+    txZerocoinSpend.vout.push_back(CTxOut(1 * COIN, CScript() << OP_TRUE));
+    CBlock block2;
+    block2.vtx.push_back(txCoinbase2);
+    block2.vtx.push_back(txSpend);
+    block2.vtx.push_back(txZerocoinSpend);
+    CBlockUndo blockundo2;
+    blockundo2.vtxundo.resize(2);
+    blockundo2.vtxundo[0].vprevout.push_back(CTxInUndo(block1.vtx[0].vout[0], true, false, 1, 1));
+    CBlockIndex* pindex2 = AppendTestBlock(block2, blockundo2, 96);
+
+    // Binary and hex entries are each block followed by its undo data
+    vIndex = GetBlockRange(nHeight + 1, 2);
+    BOOST_CHECK(vIndex.size() == 2 && vIndex[0] == pindex1 && vIndex[1] == pindex2);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_FOREACH (const CBlockIndex* pindex, vIndex)
+        BOOST_CHECK(WriteBlockRangeEntry(pindex, ss));
+    CBlock blockRead;
+    CBlockUndo blockundoRead;
+    ss >> blockRead >> blockundoRead;
+    BOOST_CHECK(blockRead.GetHash() == pindex1->GetBlockHash());
+    BOOST_CHECK(blockundoRead.vtxundo.empty());
+    ss >> blockRead >> blockundoRead;
+    BOOST_CHECK(blockRead.GetHash() == pindex2->GetBlockHash());
+    BOOST_CHECK_EQUAL(blockundoRead.vtxundo.size(), 2U);
+    BOOST_CHECK(ss.empty());
+
+    // A spending input carries the value and script of the output it spends
+    r = CallRPC(strprintf("getblockrange %d 1", nHeight + 2));
+    BOOST_CHECK_EQUAL(r.size(), 1U);
+    BOOST_CHECK_EQUAL(find_value(r[0], "previousblockhash").get_str(), pindex1->GetBlockHash().GetHex());
+    const UniValue& txs2 = find_value(r[0], "tx");
+    BOOST_CHECK_EQUAL(txs2.size(), 3U);
+    const UniValue& vinSpend = find_value(txs2[1], "vin");
+    BOOST_CHECK_EQUAL(vinSpend.size(), 1U);
+    const CTxOut& prevout = block1.vtx[0].vout[0];
+    BOOST_CHECK_EQUAL(find_value(vinSpend[0], "txid").get_str(), block1.vtx[0].GetHash().GetHex());
+    BOOST_CHECK_EQUAL(find_value(vinSpend[0], "vout").get_int(), 0);
+    BOOST_CHECK_EQUAL(AmountFromValue(find_value(vinSpend[0], "value")), prevout.nValue);
+    BOOST_CHECK_EQUAL(find_value(vinSpend[0], "scriptPubKey").get_str(), HexStr(prevout.scriptPubKey.begin(), prevout.scriptPubKey.end()));
+
+    // A zerocoin spend has no undo entry to read a value from
+    const UniValue& vinZerocoin = find_value(txs2[2], "vin");
+    BOOST_CHECK_EQUAL(vinZerocoin.size(), 1U);
+    BOOST_CHECK(find_value(vinZerocoin[0], "zerocoinspend").isObject());
+    BOOST_CHECK(find_value(vinZerocoin[0], "value").isNull());
+
+    {
+        LOCK(cs_main);
+        chainActive.SetTip(pindexTip);
+        mapBlockIndex.erase(pindex2->GetBlockHash());
+        mapBlockIndex.erase(pindex1->GetBlockHash());
+        delete pindex2;
+        delete pindex1;
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,8 +7,11 @@
 #include "rpcclient.h"
 
 #include "base58.h"
+#include "main.h"
 #include "wallet.h"
 
+#include <set>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/test/unit_test.hpp>
 
@@ -105,6 +108,20 @@ BOOST_AUTO_TEST_CASE(rpc_wallet)
     BOOST_CHECK_THROW(CallRPC("listunspent 0 1 [] extra"), runtime_error);
     BOOST_CHECK_NO_THROW(r = CallRPC("listunspent 0 1 []"));
     BOOST_CHECK(r.get_array().empty());
+    BOOST_CHECK_NO_THROW(r = CallRPC("listunspent 0 1 [] 1 10"));
+    BOOST_CHECK(r.get_array().empty());
+    BOOST_CHECK_THROW(CallRPC("listunspent 0 1 [] 1 -1"), runtime_error);
+    BOOST_CHECK_THROW(CallRPC("listunspent 0 1 [] 1 10 not_object"), runtime_error);
+    BOOST_CHECK_NO_THROW(CallRPC("listunspent 0 1 [] 1 10 {\"txid\":\"0000000000000000000000000000000000000000000000000000000000000000\",\"vout\":0}"));
+
+    /*********************************
+     * 		listtransactions
+     *********************************/
+    BOOST_CHECK_NO_THROW(CallRPC("listtransactions"));
+    BOOST_CHECK_NO_THROW(r = CallRPC("listtransactions * 10 0 false -1"));
+    BOOST_CHECK(r.get_array().empty());
+    BOOST_CHECK_THROW(CallRPC("listtransactions * 10 0 false not_int"), runtime_error);
+    BOOST_CHECK_THROW(CallRPC("listtransactions * 10 0 false -1 extra"), runtime_error);
 
     /*********************************
      * 		listreceivedbyaddress
@@ -181,4 +198,85 @@ BOOST_AUTO_TEST_CASE(rpc_wallet)
     BOOST_CHECK(CBitcoinAddress(arr[0].get_str()).Get() == demoAddress.Get());
 }
 
+
+static uint256 AddPagingTx(CWallet& wallet, const CScript& scriptPubKey, int nNonce, bool fConfirmed)
+{
+    CMutableTransaction tx;
+    tx.vin.push_back(CTxIn(COutPoint(uint256(nNonce), 0)));
+    tx.vout.push_back(CTxOut(1 * COIN, scriptPubKey));
+    CWalletTx wtx(&wallet, tx);
+    if (fConfirmed) {
+        wtx.hashBlock = chainActive.Genesis()->GetBlockHash();
+        wtx.nIndex = 0;
+    }
+    BOOST_CHECK(wallet.AddToWallet(wtx));
+    return tx.GetHash();
+}
+
+BOOST_AUTO_TEST_CASE(rpc_wallet_paging)
+{
+    // Run the paging RPCs against a wallet of our own, restored before returning
+    CWallet* pwalletSaved = pwalletMain;
+    CWallet wallet("wallet_paging_test.dat");
+    pwalletMain = &wallet;
+    LOCK2(cs_main, wallet.cs_wallet);
+
+    CKey key;
+    key.MakeNewKey(true);
+    BOOST_CHECK(wallet.AddKeyPubKey(key, key.GetPubKey()));
+    CScript scriptMine = GetScriptForDestination(key.GetPubKey().GetID());
+
+    std::set<uint256> setAdded;
+    int nNonce = 1;
+    for (int i = 0; i < 5; i++)
+        setAdded.insert(AddPagingTx(wallet, scriptMine, nNonce++, false));
+
+    // listtransactions cursor: transactions added between pages land after the cursor,
+    // so every one of them is returned exactly once
+    std::set<uint256> setSeen;
+    int64_t nAfter = -1;
+    UniValue r;
+    for (int nPage = 0; nPage < 20; nPage++) {
+        BOOST_CHECK_NO_THROW(r = CallRPC(strprintf("listtransactions * 2 0 false %d", nAfter)));
+        const UniValue& page = r.get_array();
+        if (page.empty())
+            break;
+        for (unsigned int i = 0; i < page.size(); i++) {
+            int64_t nPos = find_value(page[i].get_obj(), "orderpos").get_int64();
+            BOOST_CHECK(nPos > nAfter);
+            nAfter = nPos;
+            BOOST_CHECK(setSeen.insert(uint256(find_value(page[i].get_obj(), "txid").get_str())).second);
+        }
+        if (nPage < 3)
+            setAdded.insert(AddPagingTx(wallet, scriptMine, nNonce++, false));
+    }
+    BOOST_CHECK(setSeen == setAdded);
+
+    // listsinceblock over the height index: a transaction confirmed between calls leaves
+    // the unconfirmed tail, one added between calls joins it, none is repeated
+    const std::string strGenesis = chainActive.Genesis()->GetBlockHash().GetHex();
+    BOOST_CHECK_NO_THROW(r = CallRPC("listsinceblock " + strGenesis));
+    BOOST_CHECK_EQUAL(find_value(r.get_obj(), "transactions").get_array().size(), setAdded.size());
+
+    uint256 hashConfirmed = *setAdded.begin();
+    CWalletTx wtxConfirmed = wallet.mapWallet[hashConfirmed];
+    wtxConfirmed.hashBlock = chainActive.Genesis()->GetBlockHash();
+    wtxConfirmed.nIndex = 0;
+    BOOST_CHECK(wallet.AddToWallet(wtxConfirmed));
+    setAdded.erase(hashConfirmed);
+    setAdded.insert(AddPagingTx(wallet, scriptMine, nNonce++, false));
+    AddPagingTx(wallet, scriptMine, nNonce++, true);
+
+    BOOST_CHECK_NO_THROW(r = CallRPC("listsinceblock " + strGenesis));
+    const UniValue& txs = find_value(r.get_obj(), "transactions").get_array();
+    setSeen.clear();
+    for (unsigned int i = 0; i < txs.size(); i++)
+        BOOST_CHECK(setSeen.insert(uint256(find_value(txs[i].get_obj(), "txid").get_str())).second);
+    BOOST_CHECK(setSeen == setAdded);
+    BOOST_CHECK_EQUAL(wallet.setWalletTxByHeight.size(), wallet.mapWallet.size());
+    BOOST_CHECK_EQUAL(wallet.mapWalletTxHeight[hashConfirmed], 0);
+
+    pwalletMain = pwalletSaved;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,129 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "validationinterface.h"
+
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "utiltime.h"
+
+#include <boost/make_shared.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/weak_ptr.hpp>
+
+namespace
+{
+class CRecordingListener : public CValidationInterface
+{
+public:
+    std::vector<uint256> vSynced;
+    std::vector<const CBlock*> vBlocks;
+    std::vector<boost::thread::id> vThreads;
+
+protected:
+    void SyncTransaction(const CTransaction& tx, const CBlock* pblock)
+    {
+        // Slow enough that the notifier would notice if it waited for this
+        MilliSleep(1);
+        vSynced.push_back(tx.GetHash());
+        vBlocks.push_back(pblock);
+        vThreads.push_back(boost::this_thread::get_id());
+    }
+};
+
+CTransaction MakeTransaction(int n)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.n = n;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = n;
+    return tx;
+}
+} // anon namespace
+
+BOOST_AUTO_TEST_SUITE(validationinterface_tests)
+
+BOOST_AUTO_TEST_CASE(validation_queue_order_and_sync)
+{
+    CRecordingListener listener;
+    RegisterValidationInterface(&listener);
+    StartValidationInterfaceQueue();
+
+    std::vector<uint256> vExpected;
+    const CBlock* pblockSent;
+    boost::weak_ptr<const CBlock> wpblock;
+    {
+        boost::shared_ptr<CBlock> pblock = boost::make_shared<CBlock>();
+        for (int i = 0; i < 5; i++) {
+            pblock->vtx.push_back(MakeTransaction(i));
+            vExpected.push_back(pblock->vtx.back().GetHash());
+        }
+        pblockSent = pblock.get();
+        wpblock = pblock;
+        GetMainSignals().SyncBlock(pblock);
+        // The queue shares the block, so the caller may drop it right after the call
+    }
+    for (int i = 5; i < 20; i++) {
+        CTransaction tx = MakeTransaction(i);
+        vExpected.push_back(tx.GetHash());
+        SyncWithWallets(tx, boost::shared_ptr<const CBlock>());
+    }
+
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(listener.vSynced == vExpected);
+    for (unsigned int i = 0; i < listener.vBlocks.size(); i++) {
+        BOOST_CHECK_EQUAL(listener.vBlocks[i] != NULL, i < 5);
+        BOOST_CHECK(listener.vThreads[i] != boost::this_thread::get_id());
+    }
+    BOOST_CHECK(listener.vBlocks[0] == pblockSent && listener.vBlocks[4] == pblockSent);
+    BOOST_CHECK(wpblock.expired());
+
+    // What is still queued runs before the queue stops, later calls run right away
+    SyncWithWallets(MakeTransaction(20), boost::shared_ptr<const CBlock>());
+    StopValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(listener.vSynced.size(), 21U);
+    SyncWithWallets(MakeTransaction(21), boost::shared_ptr<const CBlock>());
+    BOOST_CHECK_EQUAL(listener.vSynced.size(), 22U);
+    BOOST_CHECK(listener.vThreads.back() == boost::this_thread::get_id());
+
+    UnregisterValidationInterface(&listener);
+}
+
+BOOST_AUTO_TEST_CASE(validation_queue_shared_blocks_and_functions)
+{
+    CRecordingListener listener;
+    RegisterValidationInterface(&listener);
+    StartValidationInterfaceQueue();
+
+    boost::shared_ptr<CBlock> pblock = boost::make_shared<CBlock>();
+    for (int i = 0; i < 3; i++)
+        pblock->vtx.push_back(MakeTransaction(i));
+
+    // A transaction of a block is passed on as part of the block itself
+    GetMainSignals().SyncTransaction(pblock->vtx[1], pblock);
+    GetMainSignals().SyncDisconnectedBlock(pblock);
+
+    // Functions run in order with the notifications made before them
+    size_t nSyncedBefore = 0;
+    CallFunctionInValidationInterfaceQueue([&listener, &nSyncedBefore]() {
+        nSyncedBefore = listener.vSynced.size();
+    });
+
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(nSyncedBefore, 4U);
+    BOOST_CHECK_EQUAL(listener.vSynced.size(), 4U);
+    BOOST_CHECK(listener.vSynced[0] == pblock->vtx[1].GetHash());
+    BOOST_CHECK(listener.vBlocks[0] == pblock.get());
+    for (unsigned int i = 1; i < listener.vSynced.size(); i++) {
+        BOOST_CHECK(listener.vSynced[i] == pblock->vtx[i - 1].GetHash());
+        BOOST_CHECK(listener.vBlocks[i] == NULL);
+    }
+
+    StopValidationInterfaceQueue();
+    UnregisterValidationInterface(&listener);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,11 @@
 
 #include "wallet.h"
 
+#include "main.h"
+#include "random.h"
+#include "txmempool.h"
+
+#include <limits>
 #include <set>
 #include <stdint.h>
 #include <utility>
@@ -305,4 +310,179 @@ BOOST_AUTO_TEST_CASE(coin_selection_tests)
     empty_wallet();
 }
 
+BOOST_AUTO_TEST_CASE(mn_collateral_tier_tests)
+{
+    // The collateral bucket holds every amount ONLY_10000 may match
+    for (int nHeight = 0; nHeight <= 250000; nHeight += 100) {
+        BOOST_CHECK(CWallet::IsMNCollateralTier(GetMNCollateral(nHeight) * COIN));
+        BOOST_CHECK(CWallet::IsMNCollateralTier(GetMNCollateralOld(nHeight) * COIN));
+    }
+    BOOST_CHECK(CWallet::IsMNCollateralTier(GetMNCollateral(std::numeric_limits<int>::max()) * COIN));
+
+    // GetMNCollateral() steps at the tier heights
+    BOOST_CHECK_EQUAL(GetMNCollateral(-1), 2000);
+    BOOST_CHECK_EQUAL(GetMNCollateral(59999), 2000);
+    BOOST_CHECK_EQUAL(GetMNCollateral(60000), 4000);
+    BOOST_CHECK_EQUAL(GetMNCollateral(149999), 6000);
+    BOOST_CHECK_EQUAL(GetMNCollateral(150000), 10000);
+    BOOST_CHECK_EQUAL(GetMNCollateral(200000), 25000);
+
+    BOOST_CHECK(CWallet::IsMNCollateralTier(2000 * COIN));
+    BOOST_CHECK(CWallet::IsMNCollateralTier(25000 * COIN));
+    BOOST_CHECK(!CWallet::IsMNCollateralTier(0));
+    BOOST_CHECK(!CWallet::IsMNCollateralTier(2000));
+    BOOST_CHECK(!CWallet::IsMNCollateralTier(5000 * COIN));
+    BOOST_CHECK(!CWallet::IsMNCollateralTier(10000 * COIN + 1));
+    BOOST_CHECK(!CWallet::IsMNCollateralTier(10000 * COIN - 1));
+}
+
+static void CheckBalanceTotals(const CWallet& wallet)
+{
+    // The same balances summed afresh over every wallet transaction
+    CAmount nAvailable = 0, nUnconfirmed = 0, nImmature = 0, nLocked = 0, nUnlocked = 0;
+    CAmount nDenominated = 0, nDenominatedUnconf = 0, nWatchAvailable = 0, nWatchUnconfirmed = 0;
+    for (const auto& item : wallet.mapWallet) {
+        const CWalletTx& wtx = item.second;
+        const bool fTrusted = wtx.IsTrusted();
+        const int nDepth = wtx.GetDepthInMainChain();
+        if (fTrusted) {
+            nAvailable += wtx.GetAvailableCredit(false);
+            nWatchAvailable += wtx.GetAvailableWatchOnlyCredit(false);
+        }
+        if (fTrusted && nDepth > 0) {
+            nLocked += wtx.GetLockedCredit();
+            nUnlocked += wtx.GetUnlockedCredit();
+        }
+        if (!IsFinalTx(wtx) || (!fTrusted && nDepth == 0)) {
+            nUnconfirmed += wtx.GetAvailableCredit(false);
+            nWatchUnconfirmed += wtx.GetAvailableWatchOnlyCredit(false);
+        }
+        nImmature += wtx.GetImmatureCredit(false);
+        nDenominated += wtx.GetDenominatedCredit(false, false);
+        nDenominatedUnconf += wtx.GetDenominatedCredit(true, false);
+    }
+
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), nAvailable);
+    BOOST_CHECK_EQUAL(wallet.GetUnconfirmedBalance(), nUnconfirmed);
+    BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), nImmature);
+    BOOST_CHECK_EQUAL(wallet.GetLockedCoins(), nLocked);
+    BOOST_CHECK_EQUAL(wallet.GetUnlockedCoins(), nUnlocked);
+    BOOST_CHECK_EQUAL(wallet.GetDenominatedBalance(false), nDenominated);
+    BOOST_CHECK_EQUAL(wallet.GetDenominatedBalance(true), nDenominatedUnconf);
+    BOOST_CHECK_EQUAL(wallet.GetWatchOnlyBalance(), nWatchAvailable);
+    BOOST_CHECK_EQUAL(wallet.GetUnconfirmedWatchOnlyBalance(), nWatchUnconfirmed);
+}
+
+static uint256 AddWalletTx(CWallet& wallet, const CMutableTransaction& tx, bool fConfirmed)
+{
+    // Confirmed transactions claim the genesis block
+    CWalletTx wtx(&wallet, tx);
+    if (fConfirmed) {
+        wtx.hashBlock = chainActive.Genesis()->GetBlockHash();
+        wtx.nIndex = 0;
+    }
+    BOOST_CHECK(wallet.AddToWallet(wtx));
+    wallet.mapWallet[tx.GetHash()].fMerkleVerified = fConfirmed;
+    return tx.GetHash();
+}
+
+BOOST_AUTO_TEST_CASE(balance_totals_tests)
+{
+    CWallet wallet("wallet_balance_test.dat");
+    LOCK2(cs_main, wallet.cs_wallet);
+
+    CKey key;
+    key.MakeNewKey(true);
+    BOOST_CHECK(wallet.AddKeyPubKey(key, key.GetPubKey()));
+    CScript scriptMine = GetScriptForDestination(key.GetPubKey().GetID());
+    CKey keyOther;
+    keyOther.MakeNewKey(true);
+    CScript scriptOther = GetScriptForDestination(keyOther.GetPubKey().GetID());
+
+    CMutableTransaction tx1;
+    tx1.vin.resize(1);
+    tx1.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    tx1.vout.push_back(CTxOut(10 * COIN, scriptMine));
+    tx1.vout.push_back(CTxOut(3 * COIN, scriptMine));
+    tx1.vout.push_back(CTxOut(5 * COIN, scriptOther));
+    uint256 hash1 = AddWalletTx(wallet, tx1, true);
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 13 * COIN);
+    CheckBalanceTotals(wallet);
+
+    // Coin locks move coins between the locked and unlocked totals
+    COutPoint outLocked(hash1, 0);
+    wallet.LockCoin(outLocked);
+    BOOST_CHECK_EQUAL(wallet.GetLockedCoins(), 10 * COIN);
+    BOOST_CHECK_EQUAL(wallet.GetUnlockedCoins(), 3 * COIN);
+    CheckBalanceTotals(wallet);
+
+    // An unconfirmed spend in the mempool, with change back to us
+    CMutableTransaction tx2;
+    tx2.vin.push_back(CTxIn(COutPoint(hash1, 1)));
+    tx2.vout.push_back(CTxOut(1 * COIN, scriptOther));
+    tx2.vout.push_back(CTxOut(2 * COIN, scriptMine));
+    mempool.addUnchecked(tx2.GetHash(), CTxMemPoolEntry(tx2, 0, GetTime(), 0, chainActive.Height()));
+    uint256 hash2 = AddWalletTx(wallet, tx2, false);
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 12 * COIN);
+    CheckBalanceTotals(wallet);
+
+    // Dropped from the mempool, the spend no longer counts
+    std::list<CTransaction> removed;
+    mempool.remove(tx2, removed);
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 13 * COIN);
+    CheckBalanceTotals(wallet);
+
+    // Confirmed, the spent output leaves the unspent index
+    AddWalletTx(wallet, tx2, true);
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 12 * COIN);
+    CheckBalanceTotals(wallet);
+
+    wallet.UnlockCoin(outLocked);
+    BOOST_CHECK_EQUAL(wallet.GetLockedCoins(), 0);
+    BOOST_CHECK_EQUAL(wallet.GetUnlockedCoins(), 12 * COIN);
+    CheckBalanceTotals(wallet);
+
+    // A full recompute agrees with the running totals
+    wallet.MarkDirty();
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 12 * COIN);
+    CheckBalanceTotals(wallet);
+    BOOST_CHECK(wallet.mapWallet.count(hash2));
+}
+
+BOOST_AUTO_TEST_CASE(balance_totals_no_change_spend)
+{
+    CWallet wallet("wallet_balance_nochange_test.dat");
+    LOCK2(cs_main, wallet.cs_wallet);
+
+    CKey key;
+    key.MakeNewKey(true);
+    BOOST_CHECK(wallet.AddKeyPubKey(key, key.GetPubKey()));
+    CScript scriptMine = GetScriptForDestination(key.GetPubKey().GetID());
+    CKey keyOther;
+    keyOther.MakeNewKey(true);
+    CScript scriptOther = GetScriptForDestination(keyOther.GetPubKey().GetID());
+
+    CMutableTransaction tx1;
+    tx1.vin.resize(1);
+    tx1.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    tx1.vout.push_back(CTxOut(10 * COIN, scriptMine));
+    uint256 hash1 = AddWalletTx(wallet, tx1, true);
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 10 * COIN);
+
+    // A sweep: nothing comes back to us, so the spend owns no indexed output
+    CMutableTransaction tx2;
+    tx2.vin.push_back(CTxIn(COutPoint(hash1, 0)));
+    tx2.vout.push_back(CTxOut(10 * COIN, scriptOther));
+    mempool.addUnchecked(tx2.GetHash(), CTxMemPoolEntry(tx2, 0, GetTime(), 0, chainActive.Height()));
+    AddWalletTx(wallet, tx2, false);
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 0);
+    CheckBalanceTotals(wallet);
+
+    // Dropped from the mempool, its input is ours to spend again
+    std::list<CTransaction> removed;
+    mempool.remove(tx2, removed);
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 10 * COIN);
+    CheckBalanceTotals(wallet);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,290 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "db.h"
+#include "key.h"
+#include "logdb.h"
+#include "util.h"
+#include "wallet.h"
+#include "walletdb.h"
+
+#include <fstream>
+#include <iterator>
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+extern CWallet* pwalletMain;
+
+namespace
+{
+/** Keeps the wallet files opened meanwhile as logs (-walletlog) in a directory of their own */
+struct WalletLogSetup {
+    boost::filesystem::path pathDir;
+
+    WalletLogSetup()
+    {
+        pathDir = GetDataDir() / "walletlog";
+        boost::filesystem::create_directories(pathDir);
+        bitdb.MakeMockLog(pathDir.string());
+    }
+    ~WalletLogSetup()
+    {
+        bitdb.MakeMockLog("");
+        boost::filesystem::remove_all(pathDir);
+    }
+
+    /** Close the logs, so that their files can be looked at */
+    void CloseLogs()
+    {
+        bitdb.MakeMockLog(pathDir.string());
+    }
+};
+
+std::string ReadFile(const boost::filesystem::path& path)
+{
+    std::ifstream file(path.string().c_str(), std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const boost::filesystem::path& path, const std::string& str)
+{
+    std::ofstream file(path.string().c_str(), std::ios::binary | std::ios::trunc);
+    file.write(str.data(), str.size());
+}
+
+std::string AccountKey(const std::string& strAccount)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << std::make_pair(std::string("acc"), strAccount);
+    return std::string(ssKey.begin(), ssKey.end());
+}
+} // anon namespace
+
+BOOST_AUTO_TEST_SUITE(walletdb_tests)
+
+static CAccount MakeAccount()
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CAccount account;
+    account.vchPubKey = key.GetPubKey();
+    return account;
+}
+
+BOOST_AUTO_TEST_CASE(walletdb_batch)
+{
+    const std::string& strFile = pwalletMain->strWalletFile;
+    CAccount accountA = MakeAccount();
+    CAccount accountB = MakeAccount();
+    CAccount accountRead;
+
+    // Opened before the batch, and used inside it
+    CWalletDB walletdb(strFile);
+    {
+        CDBBatch batch(strFile);
+        BOOST_CHECK(CWalletDB(strFile).WriteAccount("batch_a", accountA));
+        BOOST_CHECK(walletdb.ReadAccount("batch_a", accountRead));
+        BOOST_CHECK(accountRead.vchPubKey == accountA.vchPubKey);
+
+        // A nested batch joins the outer one
+        {
+            CDBBatch batchNested(strFile);
+            BOOST_CHECK(walletdb.WriteAccount("batch_b", accountB));
+        }
+        BOOST_CHECK(CWalletDB(strFile).ReadAccount("batch_b", accountRead));
+
+        // An explicit transaction nests in the batch and aborts on its own
+        {
+            CWalletDB walletdbTxn(strFile);
+            BOOST_CHECK(walletdbTxn.TxnBegin());
+            BOOST_CHECK(walletdbTxn.WriteAccount("batch_c", accountB));
+            BOOST_CHECK(walletdb.ReadAccount("batch_c", accountRead));
+            BOOST_CHECK(walletdbTxn.TxnAbort());
+        }
+        BOOST_CHECK(!walletdb.ReadAccount("batch_c", accountRead));
+        BOOST_CHECK(walletdb.ReadAccount("batch_a", accountRead));
+    }
+
+    // Committed when the batch ended
+    BOOST_CHECK(CWalletDB(strFile).ReadAccount("batch_a", accountRead));
+    BOOST_CHECK(accountRead.vchPubKey == accountA.vchPubKey);
+    BOOST_CHECK(walletdb.ReadAccount("batch_b", accountRead));
+    BOOST_CHECK(accountRead.vchPubKey == accountB.vchPubKey);
+}
+
+BOOST_FIXTURE_TEST_CASE(walletdb_log_batch, WalletLogSetup)
+{
+    const std::string strFile = "walletlog_batch.dat";
+    CAccount accountA = MakeAccount();
+    CAccount accountB = MakeAccount();
+    CAccount accountRead;
+
+    uint64_t nSizeBefore;
+    {
+        CWalletDB walletdb(strFile, "cr+");
+        {
+            LOCK(bitdb.cs_db);
+            nSizeBefore = bitdb.mapLogDb[strFile]->GetFileSize();
+        }
+        {
+            CDBBatch batch(strFile);
+            BOOST_CHECK(walletdb.WriteAccount("log_a", accountA));
+
+            // A transaction that commits merges into the batch, one that aborts leaves no trace
+            {
+                CWalletDB walletdbTxn(strFile);
+                BOOST_CHECK(walletdbTxn.TxnBegin());
+                BOOST_CHECK(walletdbTxn.WriteAccount("log_b", accountB));
+                BOOST_CHECK(walletdbTxn.TxnCommit());
+                BOOST_CHECK(walletdbTxn.TxnBegin());
+                BOOST_CHECK(walletdbTxn.WriteAccount("log_c", accountB));
+                BOOST_CHECK(walletdbTxn.ReadAccount("log_c", accountRead));
+                BOOST_CHECK(walletdbTxn.TxnAbort());
+            }
+            BOOST_CHECK(walletdb.ReadAccount("log_b", accountRead));
+            BOOST_CHECK(!walletdb.ReadAccount("log_c", accountRead));
+
+            // Nothing reaches the log before the batch ends
+            LOCK(bitdb.cs_db);
+            BOOST_CHECK_EQUAL(bitdb.mapLogDb[strFile]->GetFileSize(), nSizeBefore);
+        }
+        BOOST_CHECK(walletdb.ReadAccount("log_a", accountRead));
+        BOOST_CHECK(accountRead.vchPubKey == accountA.vchPubKey);
+        BOOST_CHECK(walletdb.ReadAccount("log_b", accountRead));
+        BOOST_CHECK(accountRead.vchPubKey == accountB.vchPubKey);
+    }
+    CloseLogs();
+
+    // The batch wrote one frame: damaging it loses both of its records
+    boost::filesystem::path pathLog = pathDir / (strFile + ".log");
+    std::vector<std::pair<std::string, CSerializeData> > vRecords;
+    BOOST_CHECK(CLogDB::Salvage(pathLog, vRecords));
+    size_t nRecords = vRecords.size();
+    std::string strLog = ReadFile(pathLog);
+    BOOST_CHECK(strLog.size() > nSizeBefore + 10);
+    strLog[nSizeBefore + 10] ^= 1;
+    WriteFile(pathLog, strLog);
+    vRecords.clear();
+    BOOST_CHECK(CLogDB::Salvage(pathLog, vRecords));
+    BOOST_CHECK_EQUAL(vRecords.size(), nRecords - 2);
+    for (unsigned int i = 0; i < vRecords.size(); i++) {
+        BOOST_CHECK(vRecords[i].first != AccountKey("log_a"));
+        BOOST_CHECK(vRecords[i].first != AccountKey("log_b"));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(walletdb_log_import, WalletLogSetup)
+{
+    const std::string strFile = "walletlog_import.dat";
+    CAccount account = MakeAccount();
+    CAccount accountRead;
+
+    // A BerkeleyDB wallet from before -walletlog
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << std::make_pair(std::string("acc"), std::string("imported"));
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        ssValue << account;
+        Db db(&bitdb.dbenv, 0);
+        BOOST_CHECK(db.open(NULL, (pathDir / strFile).string().c_str(), "main", DB_BTREE, DB_CREATE, 0) == 0);
+        Dbt datKey(&ssKey[0], ssKey.size());
+        Dbt datValue(&ssValue[0], ssValue.size());
+        BOOST_CHECK(db.put(NULL, &datKey, &datValue, 0) == 0);
+        BOOST_CHECK(db.close(0) == 0);
+    }
+
+    // Opening it imports it into its log, and moves it out of the way
+    int64_t nTimeBefore = GetTime();
+    BOOST_CHECK(CWalletDB(strFile).ReadAccount("imported", accountRead));
+    BOOST_CHECK(accountRead.vchPubKey == account.vchPubKey);
+    BOOST_CHECK(boost::filesystem::exists(pathDir / (strFile + ".log")));
+    BOOST_CHECK(!boost::filesystem::exists(pathDir / strFile));
+    unsigned int nImported = 0;
+    for (boost::filesystem::directory_iterator it(pathDir); it != boost::filesystem::directory_iterator(); ++it) {
+        std::string strName = it->path().filename().string();
+        std::string strPrefix = strFile + ".imported-";
+        if (strName.compare(0, strPrefix.size(), strPrefix) != 0)
+            continue;
+        int64_t nTime = atoi64(strName.substr(strPrefix.size()));
+        BOOST_CHECK(nTime >= nTimeBefore && nTime <= GetTime());
+        nImported++;
+    }
+    BOOST_CHECK_EQUAL(nImported, 1U);
+
+    // The log is the wallet from now on, and isn't imported again
+    BOOST_CHECK(CWalletDB(strFile).WriteAccount("after", account));
+    CloseLogs();
+    BOOST_CHECK(CWalletDB(strFile).ReadAccount("after", accountRead));
+    BOOST_CHECK(CWalletDB(strFile).ReadAccount("imported", accountRead));
+}
+
+BOOST_FIXTURE_TEST_CASE(walletdb_log_restore, WalletLogSetup)
+{
+    const std::string strFile = "walletlog_restore.dat";
+    CAccount account = MakeAccount();
+    CAccount accountRead;
+
+    // A backup of the log, as backupwallet makes it with -walletlog
+    boost::filesystem::path pathBackup = pathDir / (strFile + ".bak");
+    BOOST_CHECK(CWalletDB(strFile, "cr+").WriteAccount("backed", account));
+    {
+        LOCK(bitdb.cs_db);
+        BOOST_CHECK(bitdb.GetLog(strFile, false)->Backup(pathBackup));
+    }
+    BOOST_CHECK(CLogDB::IsLog(pathBackup));
+    CloseLogs();
+
+    // Restored in place of the wallet file, it becomes the log as it is
+    boost::filesystem::remove(pathDir / (strFile + ".log"));
+    boost::filesystem::remove(pathDir / (strFile + ".log.idx"));
+    boost::filesystem::copy_file(pathBackup, pathDir / strFile);
+    BOOST_CHECK(CWalletDB(strFile).ReadAccount("backed", accountRead));
+    BOOST_CHECK(accountRead.vchPubKey == account.vchPubKey);
+    BOOST_CHECK(!boost::filesystem::exists(pathDir / strFile));
+    BOOST_CHECK(ReadFile(pathDir / (strFile + ".log")) == ReadFile(pathBackup));
+    for (boost::filesystem::directory_iterator it(pathDir); it != boost::filesystem::directory_iterator(); ++it)
+        BOOST_CHECK(it->path().filename().string().find(".imported-") == std::string::npos);
+}
+
+BOOST_FIXTURE_TEST_CASE(walletdb_log_salvage, WalletLogSetup)
+{
+    const std::string strFile = "walletlog_salvage.dat";
+    CAccount account = MakeAccount();
+    CAccount accountRead;
+
+    uint64_t nSize;
+    {
+        CWalletDB walletdb(strFile, "cr+");
+        BOOST_CHECK(walletdb.WriteAccount("kept", account));
+        LOCK(bitdb.cs_db);
+        nSize = bitdb.mapLogDb[strFile]->GetFileSize();
+    }
+    BOOST_CHECK(CWalletDB(strFile).WriteAccount("lost", account));
+    CloseLogs();
+
+    boost::filesystem::path pathLog = pathDir / (strFile + ".log");
+    std::string strLog = ReadFile(pathLog);
+    strLog[nSize + 10] ^= 1;
+    WriteFile(pathLog, strLog);
+
+    // The damaged frame is dropped, the backup keeps the log as it was
+    std::vector<CDBEnv::KeyValPair> vResult;
+    BOOST_CHECK(bitdb.SalvageLog(strFile, strFile + ".bak", vResult));
+    BOOST_CHECK(ReadFile(pathDir / (strFile + ".bak")) == strLog);
+    bool fKept = false;
+    for (unsigned int i = 0; i < vResult.size(); i++) {
+        std::string strKey(vResult[i].first.begin(), vResult[i].first.end());
+        BOOST_CHECK(strKey != AccountKey("lost"));
+        if (strKey == AccountKey("kept"))
+            fKept = true;
+    }
+    BOOST_CHECK(fKept);
+
+    // An empty log is left in its place
+    BOOST_CHECK(boost::filesystem::exists(pathLog));
+    BOOST_CHECK(!CWalletDB(strFile).ReadAccount("kept", accountRead));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
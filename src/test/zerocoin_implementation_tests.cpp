@@ -17,10 +17,13 @@
 #include "wallet.h"
 #include "zuserxwallet.h"
 #include "zuserxchain.h"
+#include "zuserxspendcache.h"
+#include "zuserxtracker.h"
 
 using namespace libzerocoin;
 
 extern bool DecodeHexTx(CTransaction& tx, const std::string& strHexTx);
+extern CWallet* pwalletMain;
 
 BOOST_AUTO_TEST_SUITE(zerocoin_implementation_tests)
 
@@ -516,4 +519,510 @@ BOOST_AUTO_TEST_CASE(deterministic_tests)
 }
 
 
+/**
+ * A spend of the rawTxpub1 coin from an accumulator of the vecRawMints coins, paying
+ * one coin to an empty script, made with the accumulator params the chain uses now
+ */
+static CTransaction MakeTestZerocoinSpend(uint32_t& nChecksum, CBigNum& bnAccumulatorValue)
+{
+    ZerocoinParams* paramsCoin = Params().Zerocoin_Params(true);
+    ZerocoinParams* paramsAccumulator = Params().Zerocoin_Params(chainActive.Height() < Params().Zerocoin_Block_V2_Start());
+
+    CBigNum bnpubcoin;
+    bnpubcoin.SetHexBool(rawTxpub1);
+    PublicCoin pubCoin(paramsCoin, bnpubcoin, CoinDenomination::ZQ_ONE);
+    Accumulator accumulator(paramsAccumulator, CoinDenomination::ZQ_ONE);
+    AccumulatorWitness witness(paramsAccumulator, accumulator, pubCoin);
+    CValidationState state;
+    for (pair<string, string> raw : vecRawMints) {
+        CTransaction tx;
+        DecodeHexTx(tx, raw.first);
+        for (const CTxOut out : tx.vout) {
+            if (!out.scriptPubKey.empty() && out.scriptPubKey.IsZerocoinMint()) {
+                PublicCoin publicCoin(paramsCoin);
+                TxOutToPublicCoin(out, publicCoin, state);
+                accumulator += publicCoin;
+                witness += publicCoin;
+            }
+        }
+    }
+
+    PrivateCoin privateCoin(paramsCoin, pubCoin.getDenomination());
+    privateCoin.setPublicCoin(pubCoin);
+    CBigNum bn = 0;
+    bn.SetHex(rawTxRand1);
+    privateCoin.setRandomness(bn);
+    CBigNum bn2 = 0;
+    bn2.SetHex(rawTxSerial1);
+    privateCoin.setSerialNumber(bn2);
+    privateCoin.setVersion(1);
+
+    // The spend signs the outputs of the transaction it is in
+    CMutableTransaction txSpend;
+    txSpend.vout.push_back(CTxOut(1 * COIN, CScript()));
+    CMutableTransaction txTemp;
+    txTemp.vout = txSpend.vout;
+    uint256 hashTxOut = txTemp.GetHash();
+
+    nChecksum = GetChecksum(accumulator.getValue());
+    bnAccumulatorValue = accumulator.getValue();
+    CoinSpend coinSpend(paramsCoin, paramsAccumulator, privateCoin, accumulator, nChecksum, witness, hashTxOut, SpendType::SPEND);
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << coinSpend;
+    std::vector<unsigned char> data(ss.begin(), ss.end());
+    CTxIn txin;
+    txin.nSequence = CoinDenomination::ZQ_ONE;
+    txin.scriptSig = CScript() << OP_ZEROCOINSPEND << data.size();
+    txin.scriptSig.insert(txin.scriptSig.end(), data.begin(), data.end());
+    txin.prevout.SetNull();
+    txSpend.vin.push_back(txin);
+    return txSpend;
+}
+
+BOOST_AUTO_TEST_CASE(zerocoin_spend_verify_cache_test)
+{
+    uint32_t nChecksum;
+    CBigNum bnAccumulatorValue;
+    CTransaction tx = MakeTestZerocoinSpend(nChecksum, bnAccumulatorValue);
+    CMutableTransaction txTemp;
+    txTemp.vout = tx.vout;
+    uint256 hashTxOut = txTemp.GetHash();
+    bool fUseV1Params = chainActive.Height() < Params().Zerocoin_Block_V2_Start();
+
+    CZerocoinDB* zerocoinDBOld = zerocoinDB;
+    zerocoinDB = new CZerocoinDB(0, true);
+    CValidationState state;
+
+    // Not cached yet, so the spend is checked against its accumulator
+    BOOST_CHECK(!IsZerocoinSpendVerified(tx.vin[0], nChecksum, hashTxOut, fUseV1Params, false));
+    BOOST_CHECK(!CheckZerocoinSpend(tx, true, state, true));
+
+    // A spend that fails to verify is not cached
+    Accumulator accumulatorEmpty(Params().Zerocoin_Params(fUseV1Params), CoinDenomination::ZQ_ONE);
+    BOOST_CHECK(zerocoinDB->WriteAccumulatorValue(nChecksum, accumulatorEmpty.getValue()));
+    BOOST_CHECK(!CheckZerocoinSpend(tx, true, state, true));
+    BOOST_CHECK(!IsZerocoinSpendVerified(tx.vin[0], nChecksum, hashTxOut, fUseV1Params, false));
+
+    // Verified when accepted to the mempool, then found by the block check without reading the accumulator
+    BOOST_CHECK(zerocoinDB->WriteAccumulatorValue(nChecksum, bnAccumulatorValue));
+    BOOST_CHECK(CheckZerocoinSpend(tx, true, state, true));
+    BOOST_CHECK(IsZerocoinSpendVerified(tx.vin[0], nChecksum, hashTxOut, fUseV1Params, false));
+    BOOST_CHECK(zerocoinDB->EraseAccumulatorValue(nChecksum));
+    BOOST_CHECK(CheckZerocoinSpend(tx, true, state, false));
+
+    // Entries only match the same spend, accumulator, outputs and params
+    CTxIn txinOther = tx.vin[0];
+    txinOther.scriptSig[txinOther.scriptSig.size() - 1] ^= 1;
+    BOOST_CHECK(!IsZerocoinSpendVerified(txinOther, nChecksum, hashTxOut, fUseV1Params, false));
+    BOOST_CHECK(!IsZerocoinSpendVerified(tx.vin[0], nChecksum + 1, hashTxOut, fUseV1Params, false));
+    BOOST_CHECK(!IsZerocoinSpendVerified(tx.vin[0], nChecksum, uint256(1), fUseV1Params, false));
+    BOOST_CHECK(!IsZerocoinSpendVerified(tx.vin[0], nChecksum, hashTxOut, !fUseV1Params, false));
+    SetZerocoinSpendVerified(txinOther, nChecksum, hashTxOut, fUseV1Params);
+    BOOST_CHECK(IsZerocoinSpendVerified(txinOther, nChecksum, hashTxOut, fUseV1Params, false));
+
+    delete zerocoinDB;
+    zerocoinDB = zerocoinDBOld;
+}
+
+BOOST_AUTO_TEST_CASE(zerocoin_spend_parse_cache_test)
+{
+    uint32_t nChecksum;
+    CBigNum bnAccumulatorValue;
+    CTransaction tx = MakeTestZerocoinSpend(nChecksum, bnAccumulatorValue);
+
+    // Parsed once, then shared
+    CoinSpendRef spend = TxInToZerocoinSpendRef(tx, 0);
+    BOOST_CHECK(TxInToZerocoinSpendRef(tx, 0).get() == spend.get());
+    BOOST_CHECK(spend->getCoinSerialNumber() == TxInToZerocoinSpend(tx.vin[0]).getCoinSerialNumber());
+    BOOST_CHECK(spend->getAccumulatorChecksum() == nChecksum);
+
+    // Other transactions with the same input are parsed on their own, and push the oldest entries out
+    for (unsigned int i = 0; i < MAX_ZEROCOIN_SPEND_PARSE_CACHE; i++) {
+        CMutableTransaction txOther(tx);
+        txOther.nLockTime = i + 1;
+        CoinSpendRef spendOther = TxInToZerocoinSpendRef(txOther, 0);
+        BOOST_CHECK(spendOther.get() != spend.get());
+        if (i == 0)
+            BOOST_CHECK(TxInToZerocoinSpendRef(tx, 0).get() == spend.get());
+    }
+    CoinSpendRef spendReparsed = TxInToZerocoinSpendRef(tx, 0);
+    BOOST_CHECK(spendReparsed.get() != spend.get());
+    BOOST_CHECK(spendReparsed->getCoinSerialNumber() == spend->getCoinSerialNumber());
+
+    // A spend pushed out stays valid for those still holding it
+    BOOST_CHECK(spend->getDenomination() == CoinDenomination::ZQ_ONE);
+}
+
+BOOST_AUTO_TEST_CASE(zerocoin_serial_index_test)
+{
+    uint32_t nChecksum;
+    CBigNum bnAccumulatorValue;
+    CTransaction tx = MakeTestZerocoinSpend(nChecksum, bnAccumulatorValue);
+    CoinSpend spend = TxInToZerocoinSpend(tx.vin[0]);
+    CBigNum bnSerial = spend.getCoinSerialNumber();
+    uint256 hashSerial = GetSerialHash(bnSerial);
+    std::vector<std::pair<CoinSpend, uint256> > vSpends(1, std::make_pair(spend, tx.GetHash()));
+
+    CZerocoinDB* zerocoinDBOld = zerocoinDB;
+    zerocoinDB = new CZerocoinDB(0, true);
+    LOCK(cs_main);
+    int nHeight = -1;
+    uint256 txid;
+    BOOST_CHECK(!IsSerialKnown(bnSerial));
+    BOOST_CHECK(!IsSerialInBlockchain(bnSerial, nHeight));
+
+    // Recorded by a block of the active chain
+    CBlockIndex* pindexTip = chainActive.Tip();
+    BOOST_CHECK(zerocoinDB->WriteCoinSpendBatch(vSpends, pindexTip));
+    BOOST_CHECK(IsSerialKnown(bnSerial));
+    BOOST_CHECK(IsSerialInBlockchain(hashSerial, nHeight, txid));
+    BOOST_CHECK_EQUAL(nHeight, pindexTip->nHeight);
+    BOOST_CHECK(txid == tx.GetHash());
+
+    // Recorded by a block that was reorged away, at the same height and above the new tip
+    uint256 hashStale(1);
+    CBlockIndex indexStale;
+    indexStale.phashBlock = &hashStale;
+    indexStale.nHeight = pindexTip->nHeight;
+    BOOST_CHECK(zerocoinDB->WriteCoinSpendBatch(vSpends, &indexStale));
+    BOOST_CHECK(IsSerialKnown(bnSerial));
+    BOOST_CHECK(!IsSerialInBlockchain(hashSerial, nHeight, txid));
+    indexStale.nHeight = pindexTip->nHeight + 1;
+    BOOST_CHECK(zerocoinDB->WriteCoinSpendBatch(vSpends, &indexStale));
+    BOOST_CHECK(!IsSerialInBlockchain(bnSerial, nHeight));
+
+    // Disconnecting the block erases it
+    BOOST_CHECK(zerocoinDB->WriteCoinSpendBatch(vSpends, pindexTip));
+    BOOST_CHECK(zerocoinDB->EraseCoinSpend(bnSerial));
+    BOOST_CHECK(!IsSerialKnown(bnSerial));
+    BOOST_CHECK(!IsSerialInBlockchain(bnSerial, nHeight));
+
+    // Loaded from disk with no block, so looked up in the chain, which doesn't have it
+    BOOST_CHECK(zerocoinDB->WriteCoinSpendBatch(vSpends));
+    BOOST_CHECK(zerocoinDB->LoadSerials());
+    BOOST_CHECK(IsSerialKnown(bnSerial));
+    BOOST_CHECK(!IsSerialInBlockchain(bnSerial, nHeight));
+
+    delete zerocoinDB;
+    zerocoinDB = zerocoinDBOld;
+}
+
+
+BOOST_AUTO_TEST_CASE(rescan_zerocoin_test)
+{
+    // A -zapwallettxes rescan puts our mint and its spend to someone else back in the wallet
+    SelectParams(CBaseChainParams::UNITTEST);
+    ModifiableParams()->setZerocoinStartHeight(1);
+    ModifiableParams()->setSkipProofOfWorkCheck(true);
+
+    uint32_t nChecksum;
+    CBigNum bnAccumulatorValue;
+    CTransaction txSpend = MakeTestZerocoinSpend(nChecksum, bnAccumulatorValue);
+    CoinSpend spend = TxInToZerocoinSpend(txSpend.vin[0]);
+    CTransaction txMint;
+    BOOST_CHECK(DecodeHexTx(txMint, rawTx1));
+    CBigNum bnPubcoin;
+    BOOST_CHECK(bnPubcoin.SetHexBool(rawTxpub1));
+
+    CZerocoinDB* zerocoinDBOld = zerocoinDB;
+    zerocoinDB = new CZerocoinDB(0, true);
+
+    // Block 1 of the active chain holds the mint and the spend
+    CMutableTransaction txCoinbase;
+    txCoinbase.vin.resize(1);
+    txCoinbase.vin[0].scriptSig = CScript() << 1 << OP_0;
+    txCoinbase.vout.push_back(CTxOut(0, CScript() << OP_TRUE));
+    CBlock block;
+    block.nTime = GetTime();
+    block.vtx.push_back(txCoinbase);
+    block.vtx.push_back(txMint);
+    block.vtx.push_back(txSpend);
+    block.hashMerkleRoot = block.BuildMerkleTree();
+
+    CBlockIndex* pindexGenesis;
+    CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        pindexGenesis = chainActive.Genesis();
+        block.hashPrevBlock = pindexGenesis->GetBlockHash();
+        block.nBits = pindexGenesis->nBits;
+        CDiskBlockPos pos(99, 0);
+        BOOST_CHECK(WriteBlockToDisk(block, pos));
+
+        pindex = new CBlockIndex(block);
+        pindex->phashBlock = &mapBlockIndex.insert(std::make_pair(block.GetHash(), pindex)).first->first;
+        pindex->pprev = pindexGenesis;
+        pindex->nHeight = 1;
+        pindex->nFile = pos.nFile;
+        pindex->nDataPos = pos.nPos;
+        pindex->nStatus |= BLOCK_HAVE_DATA;
+        pindex->BuildSkip();
+        chainActive.SetTip(pindex);
+
+        BOOST_CHECK(pblocktree->WriteFlag("txlocations", false));
+        BOOST_CHECK(LoadTxLocations());
+        std::vector<std::pair<CoinSpend, uint256> > vSpends(1, std::make_pair(spend, txSpend.GetHash()));
+        BOOST_CHECK(zerocoinDB->WriteCoinSpendBatch(vSpends, pindex));
+    }
+
+    // The tracker knows the mint, the wallet has neither transaction
+    CZerocoinMint mint(CoinDenomination::ZQ_ONE, bnPubcoin, CBigNum(0), spend.getCoinSerialNumber(), false, 1);
+    pwalletMain->zuserxTracker->Init();
+    pwalletMain->zuserxTracker->Add(mint, true);
+    BOOST_CHECK(!pwalletMain->mapWallet.count(txMint.GetHash()));
+    BOOST_CHECK(!pwalletMain->mapWallet.count(txSpend.GetHash()));
+
+    mapArgs["-zapwallettxes"] = "1";
+    pwalletMain->ScanForWalletTransactions(pindexGenesis, true);
+    mapArgs.erase("-zapwallettxes");
+
+    {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+        BOOST_CHECK(pwalletMain->mapWallet.count(txMint.GetHash()));
+        BOOST_CHECK(pwalletMain->mapWallet.count(txSpend.GetHash()));
+        if (pwalletMain->mapWallet.count(txSpend.GetHash()))
+            BOOST_CHECK_EQUAL(pwalletMain->mapWallet[txSpend.GetHash()].GetDepthInMainChain(false), 1);
+        CMintMeta meta = pwalletMain->zuserxTracker->GetMetaFromPubcoin(GetPubCoinHash(bnPubcoin));
+        BOOST_CHECK_EQUAL(meta.nHeight, 1);
+        BOOST_CHECK(meta.txid == txMint.GetHash());
+
+        pwalletMain->EraseFromWallet(txMint.GetHash());
+        pwalletMain->EraseFromWallet(txSpend.GetHash());
+        pwalletMain->zuserxTracker->Clear();
+
+        chainActive.SetTip(pindexGenesis);
+        mapBlockIndex.erase(block.GetHash());
+        delete pindex;
+    }
+
+    delete zerocoinDB;
+    zerocoinDB = zerocoinDBOld;
+    ModifiableParams()->setSkipProofOfWorkCheck(false);
+    ModifiableParams()->setZerocoinStartHeight(999999999);
+    SelectParams(CBaseChainParams::MAIN);
+}
+
+
+/** A tracker whose indexes can be checked against its mints */
+class CzUSERXTrackerTest : public CzUSERXTracker
+{
+public:
+    CzUSERXTrackerTest() : CzUSERXTracker("tracker_test.dat") {}
+
+    bool IsStatusDirty(const uint256& hashSerial) const { return setStatusDirty.count(hashSerial) > 0; }
+    void ClearStatusDirty() { setStatusDirty.clear(); }
+    bool HasPendingSpend(const uint256& hashSerial) const { return mapPendingSpends.count(hashSerial) > 0; }
+
+    //! Rebuild every secondary index from mapSerialHashes and compare
+    bool CheckIndexes() const
+    {
+        HashIndex mapPubcoin, mapStake;
+        std::set<std::pair<uint256, uint256> > setTxids, setTxidsIndexed;
+        std::set<uint256> setUnusedScan, setPendingScan;
+        std::set<std::pair<int, uint256> > setConfirmedScan;
+        for (auto& it : mapSerialHashes) {
+            const CMintMeta& meta = it.second;
+            mapPubcoin[meta.hashPubcoin] = meta.hashSerial;
+            mapStake[meta.hashStake] = meta.hashSerial;
+            if (meta.txid != 0)
+                setTxids.insert(std::make_pair(meta.txid, meta.hashSerial));
+            if (meta.isArchived)
+                continue;
+            if (!meta.isUsed) {
+                setUnusedScan.insert(meta.hashSerial);
+                if (meta.nHeight)
+                    setConfirmedScan.insert(std::make_pair(meta.nHeight, meta.hashSerial));
+            }
+            if (!meta.nHeight || meta.txid == 0)
+                setPendingScan.insert(meta.hashSerial);
+        }
+        setTxidsIndexed.insert(mapMintTxids.begin(), mapMintTxids.end());
+        return mapPubcoin == mapHashPubcoin && mapStake == mapHashStake && setTxids == setTxidsIndexed &&
+               setUnusedScan == setUnused && setConfirmedScan == setUnusedConfirmed && setPendingScan == setPendingMints;
+    }
+
+    //! The pubcoin hashes ListMints(fUnusedOnly, fMatureOnly, false) returned when it scanned every mint
+    std::set<uint256> ListMintsFullScan(bool fUnusedOnly, bool fMatureOnly) const
+    {
+        std::set<uint256> setMints;
+        int nConfirmedHeight = chainActive.Height() - Params().Zerocoin_MintRequiredConfirmations();
+        std::map<libzerocoin::CoinDenomination, int> mapMaturity;
+        if (fMatureOnly)
+            mapMaturity = GetMintMaturityHeight();
+        for (auto& it : mapSerialHashes) {
+            const CMintMeta& mint = it.second;
+            if (mint.isArchived || (fUnusedOnly && mint.isUsed))
+                continue;
+            if (fMatureOnly && (!mint.nHeight || mint.nHeight > nConfirmedHeight || mint.nHeight >= mapMaturity.at(mint.denom)))
+                continue;
+            setMints.insert(mint.hashPubcoin);
+        }
+        return setMints;
+    }
+};
+
+static std::set<uint256> PubcoinHashes(const std::set<CMintMeta>& setMints)
+{
+    std::set<uint256> setHashes;
+    for (const CMintMeta& mint : setMints)
+        setHashes.insert(mint.hashPubcoin);
+    return setHashes;
+}
+
+static CZerocoinMint MakeTrackerTestMint(int nHeight, const uint256& txid, bool fUsed)
+{
+    CZerocoinMint mint(CoinDenomination::ZQ_ONE, CBigNum::randBignum(CBigNum(1) << 256), CBigNum(0), CBigNum::randBignum(CBigNum(1) << 240), fUsed, 1);
+    mint.SetHeight(nHeight);
+    mint.SetTxHash(txid);
+    return mint;
+}
+
+BOOST_AUTO_TEST_CASE(zuserxtracker_index_test)
+{
+    CzUSERXTrackerTest tracker;
+    uint256 txidShared = GetRandHash();
+    CZerocoinMint mintPending = MakeTrackerTestMint(0, 0, false);
+    CZerocoinMint mintUnused = MakeTrackerTestMint(5, txidShared, false);
+    CZerocoinMint mintUsed = MakeTrackerTestMint(3, txidShared, true);
+    CZerocoinMint mintArchived = MakeTrackerTestMint(2, GetRandHash(), false);
+    tracker.Add(mintPending);
+    tracker.Add(mintUnused);
+    tracker.Add(mintUsed);
+    tracker.Add(mintArchived, false, true);
+    BOOST_CHECK(tracker.CheckIndexes());
+
+    // Every index finds the mints it should
+    uint256 hashSerialUnused = GetSerialHash(mintUnused.GetSerialNumber());
+    BOOST_CHECK(tracker.HasMintTx(txidShared));
+    BOOST_CHECK(tracker.HasPubcoin(mintUsed.GetValue()));
+    BOOST_CHECK(tracker.GetMetaFromPubcoin(GetPubCoinHash(mintUnused.GetValue())).hashSerial == hashSerialUnused);
+    CMintMeta meta = tracker.Get(hashSerialUnused);
+    CMintMeta metaStake;
+    BOOST_CHECK(tracker.GetMetaFromStakeHash(meta.hashStake, metaStake));
+    BOOST_CHECK(metaStake.hashSerial == hashSerialUnused);
+    BOOST_CHECK_EQUAL(tracker.GetMints(false).size(), 2U);
+
+    // Updates move a mint between the buckets
+    mintPending.SetHeight(7);
+    mintPending.SetUsed(true);
+    BOOST_CHECK(tracker.UpdateZerocoinMint(mintPending));
+    BOOST_CHECK(tracker.CheckIndexes());
+    BOOST_CHECK_EQUAL(tracker.GetMints(false).size(), 1U);
+
+    // Adding a mint again replaces its entries, including the old mint txid
+    uint256 txidNew = GetRandHash();
+    mintUsed.SetTxHash(txidNew);
+    mintUsed.SetUsed(false);
+    tracker.Add(mintUsed);
+    BOOST_CHECK(tracker.CheckIndexes());
+    BOOST_CHECK(tracker.HasMintTx(txidShared));
+    BOOST_CHECK(tracker.HasMintTx(txidNew));
+    mintUnused.SetTxHash(txidNew);
+    tracker.Add(mintUnused);
+    BOOST_CHECK(tracker.CheckIndexes());
+    BOOST_CHECK(!tracker.HasMintTx(txidShared));
+
+    // Archiving takes a mint out of the unused buckets but keeps it findable
+    meta = tracker.Get(hashSerialUnused);
+    tracker.Archive(meta);
+    BOOST_CHECK(tracker.CheckIndexes());
+    BOOST_CHECK(tracker.Get(hashSerialUnused).isArchived);
+    BOOST_CHECK(tracker.HasPubcoin(mintUnused.GetValue()));
+
+    // The bucketed listings match a scan of every mint
+    for (int i = 0; i < 4; i++) {
+        bool fUnusedOnly = i & 1, fMatureOnly = i & 2;
+        BOOST_CHECK(PubcoinHashes(tracker.ListMints(fUnusedOnly, fMatureOnly, false)) == tracker.ListMintsFullScan(fUnusedOnly, fMatureOnly));
+    }
+
+    tracker.Clear();
+    BOOST_CHECK(tracker.IsEmpty());
+    BOOST_CHECK(tracker.CheckIndexes());
+}
+
+BOOST_AUTO_TEST_CASE(zuserxtracker_notify_test)
+{
+    uint32_t nChecksum;
+    CBigNum bnAccumulatorValue;
+    CTransaction txSpend = MakeTestZerocoinSpend(nChecksum, bnAccumulatorValue);
+    CoinSpend spend = TxInToZerocoinSpend(txSpend.vin[0]);
+
+    CMutableTransaction txMint;
+    txMint.vout.push_back(CTxOut(1 * COIN, CScript() << OP_TRUE));
+    CMutableTransaction txOther;
+    txOther.vout.push_back(CTxOut(2 * COIN, CScript() << OP_TRUE));
+
+    // One mint from txMint, one whose serial txSpend spends, one untouched
+    CzUSERXTrackerTest tracker;
+    CZerocoinMint mintFromTx = MakeTrackerTestMint(3, CTransaction(txMint).GetHash(), false);
+    CZerocoinMint mintSpent(CoinDenomination::ZQ_ONE, CBigNum::randBignum(CBigNum(1) << 256), CBigNum(0), spend.getCoinSerialNumber(), false, 1);
+    mintSpent.SetHeight(2);
+    mintSpent.SetTxHash(GetRandHash());
+    CZerocoinMint mintOther = MakeTrackerTestMint(4, GetRandHash(), false);
+    tracker.Add(mintFromTx);
+    tracker.Add(mintSpent);
+    tracker.Add(mintOther);
+    uint256 hashSerialFromTx = GetSerialHash(mintFromTx.GetSerialNumber());
+    uint256 hashSerialSpent = GetSerialHash(mintSpent.GetSerialNumber());
+    uint256 hashSerialOther = GetSerialHash(mintOther.GetSerialNumber());
+    BOOST_CHECK(tracker.IsStatusDirty(hashSerialFromTx) && tracker.IsStatusDirty(hashSerialSpent) && tracker.IsStatusDirty(hashSerialOther));
+
+    // Connecting and disconnecting a transaction both notify it; each marks only its own mints
+    tracker.ClearStatusDirty();
+    tracker.NotifyTransaction(txOther);
+    BOOST_CHECK(!tracker.IsStatusDirty(hashSerialFromTx) && !tracker.IsStatusDirty(hashSerialSpent) && !tracker.IsStatusDirty(hashSerialOther));
+
+    tracker.NotifyTransaction(txMint);
+    BOOST_CHECK(tracker.IsStatusDirty(hashSerialFromTx));
+    BOOST_CHECK(!tracker.IsStatusDirty(hashSerialSpent) && !tracker.IsStatusDirty(hashSerialOther));
+
+    tracker.ClearStatusDirty();
+    tracker.NotifyTransaction(txSpend);
+    BOOST_CHECK(tracker.IsStatusDirty(hashSerialSpent));
+    BOOST_CHECK(!tracker.IsStatusDirty(hashSerialFromTx) && !tracker.IsStatusDirty(hashSerialOther));
+}
+
+BOOST_AUTO_TEST_CASE(zuserxtracker_update_status_test)
+{
+    CZerocoinDB* zerocoinDBOld = zerocoinDB;
+    zerocoinDB = new CZerocoinDB(0, true);
+
+    // Mints the zerocoin DB has in a block and no spend of are up to date
+    CzUSERXTrackerTest tracker;
+    std::vector<CZerocoinMint> vMints;
+    std::vector<std::pair<PublicCoin, uint256> > vMintInfo;
+    for (int i = 0; i < 3; i++) {
+        vMints.push_back(MakeTrackerTestMint(i + 1, GetRandHash(), false));
+        vMintInfo.push_back(std::make_pair(PublicCoin(Params().Zerocoin_Params(false), vMints.back().GetValue(), CoinDenomination::ZQ_ONE), vMints.back().GetTxHash()));
+    }
+    BOOST_CHECK(zerocoinDB->WriteCoinMintBatch(vMintInfo));
+    for (unsigned int i = 0; i < vMints.size(); i++)
+        tracker.Add(vMints[i], i == 0);
+
+    // A spend of the first one that never reached the mempool is looked at without being notified
+    uint256 hashPubcoinPending = GetPubCoinHash(vMints[0].GetValue());
+    uint256 hashSerialPending = GetSerialHash(vMints[0].GetSerialNumber());
+    tracker.SetPubcoinUsed(hashPubcoinPending, GetRandHash());
+    BOOST_CHECK(tracker.Get(hashSerialPending).isUsed);
+    BOOST_CHECK(tracker.HasPendingSpend(hashSerialPending));
+    tracker.ClearStatusDirty();
+
+    std::set<CMintMeta> setMints = tracker.ListMints(true, false, true);
+    BOOST_CHECK(!tracker.HasPendingSpend(hashSerialPending));
+    BOOST_CHECK(!tracker.Get(hashSerialPending).isUsed);
+    BOOST_CHECK(tracker.CheckIndexes());
+    BOOST_CHECK_EQUAL(setMints.size(), vMints.size());
+    BOOST_CHECK(PubcoinHashes(setMints) == tracker.ListMintsFullScan(true, false));
+    for (const CZerocoinMint& mint : vMints) {
+        CMintMeta meta = tracker.Get(GetSerialHash(mint.GetSerialNumber()));
+        BOOST_CHECK(!meta.isArchived);
+        BOOST_CHECK_EQUAL(meta.nHeight, mint.GetHeight());
+        BOOST_CHECK(meta.txid == mint.GetTxHash());
+    }
+
+    delete zerocoinDB;
+    zerocoinDB = zerocoinDBOld;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -119,16 +119,18 @@ bool CBlockTreeDB::ReadLastBlockFile(int& nFile)
 
 bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
 {
-    /* It seems that there are no "const iterators" for LevelDB.  Since we
-       only need read operations on it, use a const-cast to get around
-       that restriction.  */
-    boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CLevelDBWrapper*>(&db)->NewIterator());
+    // Scan a snapshot so that the totals belong to exactly one best block
+    // while blocks keep being connected, without holding cs_main
+    CLevelDBSnapshot snapshot(db);
+    boost::scoped_ptr<leveldb::Iterator> pcursor(snapshot.NewIterator());
     pcursor->SeekToFirst();
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = GetBestBlock();
+    if (!snapshot.Read('B', stats.hashBlock))
+        stats.hashBlock = uint256(0);
     ss << stats.hashBlock;
     CAmount nTotalAmount = 0;
+    MuHash3072 muhash;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         try {
@@ -155,6 +157,8 @@ bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
                         ss << VARINT(i + 1);
                         ss << out;
                         nTotalAmount += out.nValue;
+                        std::vector<unsigned char> vElement = UTXOSetHashElement(COutPoint(txhash, i), out);
+                        muhash.Insert(&vElement[0], vElement.size());
                     }
                 }
                 stats.nSerializedSize += 32 + slValue.size();
@@ -165,9 +169,15 @@ bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
             return error("%s : Deserialize or I/O error - %s", __func__, e.what());
         }
     }
-    stats.nHeight = mapBlockIndex.find(GetBestBlock())->second->nHeight;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator mi = mapBlockIndex.find(stats.hashBlock);
+        if (mi != mapBlockIndex.end())
+            stats.nHeight = mi->second->nHeight;
+    }
     stats.hashSerialized = ss.GetHash();
     stats.nTotalAmount = nTotalAmount;
+    muhash.Finalize(stats.hashMuHash.begin());
     return true;
 }
 
@@ -184,6 +194,57 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::WriteTxLocations(const std::vector<std::pair<uint256, CTxLocation> >& vect)
+{
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<uint256, CTxLocation> >::const_iterator it = vect.begin(); it != vect.end(); it++)
+        batch.Write(make_pair('z', it->first), it->second);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseTxLocations(const std::vector<uint256>& vect)
+{
+    CLevelDBBatch batch;
+    for (std::vector<uint256>::const_iterator it = vect.begin(); it != vect.end(); it++)
+        batch.Erase(make_pair('z', *it));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::LoadTxLocations(std::vector<std::pair<uint256, CTxLocation> >& vect)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair('z', uint256(0));
+    pcursor->Seek(ssKeySet.str());
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType == 'z') {
+                uint256 txid;
+                ssKey >> txid;
+                leveldb::Slice slValue = pcursor->value();
+                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+                CTxLocation location;
+                ssValue >> location;
+                vect.push_back(make_pair(txid, location));
+                pcursor->Next();
+            } else {
+                break; // finished loading transaction locations
+            }
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+
+    return true;
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string& name, bool fValue)
 {
     return Write(std::make_pair('F', name), fValue ? '1' : '0');
@@ -290,6 +351,165 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
     return true;
 }
 
+bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect)
+{
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = vect.begin(); it != vect.end(); it++)
+        batch.Write(make_pair('a', it->first), it->second);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect)
+{
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = vect.begin(); it != vect.end(); it++)
+        batch.Erase(make_pair('a', it->first));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadAddressIndex(unsigned char nAddressType, const uint160& hashBytes, std::vector<std::pair<CAddressIndexKey, CAmount> >& vect, int nStart, int nEnd)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair('a', CAddressIndexIteratorKey(nAddressType, hashBytes, nStart));
+    pcursor->Seek(ssKeySet.str());
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != 'a')
+                break;
+            CAddressIndexKey key;
+            ssKey >> key;
+            if (key.nAddressType != nAddressType || key.hashBytes != hashBytes || (nEnd > 0 && key.nHeight > nEnd))
+                break;
+
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CAmount nValue;
+            ssValue >> nValue;
+            vect.push_back(make_pair(key, nValue));
+            pcursor->Next();
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+
+    return true;
+}
+
+bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vect)
+{
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it = vect.begin(); it != vect.end(); it++) {
+        if (it->second.IsNull())
+            batch.Erase(make_pair('u', it->first));
+        else
+            batch.Write(make_pair('u', it->first), it->second);
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadAddressUnspentIndex(unsigned char nAddressType, const uint160& hashBytes, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vect)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair('u', CAddressUnspentIteratorKey(nAddressType, hashBytes));
+    pcursor->Seek(ssKeySet.str());
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != 'u')
+                break;
+            CAddressUnspentKey key;
+            ssKey >> key;
+            if (key.nAddressType != nAddressType || key.hashBytes != hashBytes)
+                break;
+
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CAddressUnspentValue value;
+            ssValue >> value;
+            vect.push_back(make_pair(key, value));
+            pcursor->Next();
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+
+    return true;
+}
+
+bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& vect)
+{
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >::const_iterator it = vect.begin(); it != vect.end(); it++) {
+        if (it->second.IsNull())
+            batch.Erase(make_pair('p', it->first));
+        else
+            batch.Write(make_pair('p', it->first), it->second);
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value)
+{
+    return Read(make_pair('p', key), value);
+}
+
+bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey& key)
+{
+    return Write(make_pair('s', key), '1');
+}
+
+bool CBlockTreeDB::EraseTimestampIndex(const CTimestampIndexKey& key)
+{
+    return Erase(make_pair('s', key));
+}
+
+bool CBlockTreeDB::ReadTimestampIndex(unsigned int nHigh, unsigned int nLow, std::vector<uint256>& vHashes)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair('s', CTimestampIndexKey(nLow, uint256(0)));
+    pcursor->Seek(ssKeySet.str());
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != 's')
+                break;
+            CTimestampIndexKey key;
+            ssKey >> key;
+            if (key.nTimestamp >= nHigh)
+                break;
+
+            vHashes.push_back(key.blockHash);
+            pcursor->Next();
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+
+    return true;
+}
+
 CZerocoinDB::CZerocoinDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "zerocoin", nCacheSize, fMemory, fWipe)
 {
 }
@@ -325,21 +545,30 @@ bool CZerocoinDB::EraseCoinMint(const CBigNum& bnPubcoin)
     return Erase(make_pair('m', hash));
 }
 
-bool CZerocoinDB::WriteCoinSpendBatch(const std::vector<std::pair<libzerocoin::CoinSpend, uint256> >& spendInfo)
+bool CZerocoinDB::WriteCoinSpendBatch(const std::vector<std::pair<libzerocoin::CoinSpend, uint256> >& spendInfo, const CBlockIndex* pindex)
 {
     CLevelDBBatch batch;
     size_t count = 0;
+    std::vector<uint256> vHashes;
     for (std::vector<std::pair<libzerocoin::CoinSpend, uint256> >::const_iterator it=spendInfo.begin(); it != spendInfo.end(); it++) {
         CBigNum bnSerial = it->first.getCoinSerialNumber();
         CDataStream ss(SER_GETHASH, 0);
         ss << bnSerial;
         uint256 hash = Hash(ss.begin(), ss.end());
         batch.Write(make_pair('s', hash), it->second);
+        vHashes.emplace_back(hash);
         ++count;
     }
 
     LogPrint("zero", "Writing %u coin spends to db.\n", (unsigned int)count);
-    return WriteBatch(batch, true);
+    if (!WriteBatch(batch, true))
+        return false;
+
+    LOCK(cs_serials);
+    for (unsigned int i = 0; i < vHashes.size(); i++)
+        mapSerials[vHashes[i]] = CSerialSpend(spendInfo[i].second, pindex);
+
+    return true;
 }
 
 bool CZerocoinDB::ReadCoinSpend(const CBigNum& bnSerial, uint256& txHash)
@@ -362,6 +591,11 @@ bool CZerocoinDB::EraseCoinSpend(const CBigNum& bnSerial)
     ss << bnSerial;
     uint256 hash = Hash(ss.begin(), ss.end());
 
+    {
+        LOCK(cs_serials);
+        mapSerials.erase(hash);
+    }
+
     return Erase(make_pair('s', hash));
 }
 
@@ -405,6 +639,11 @@ bool CZerocoinDB::WipeCoins(std::string strType)
             LogPrintf("%s: error failed to delete %s\n", __func__, hash.GetHex());
     }
 
+    if (type == 's') {
+        LOCK(cs_serials);
+        mapSerials.clear();
+    }
+
     return true;
 }
 
@@ -424,3 +663,148 @@ bool CZerocoinDB::EraseAccumulatorValue(const uint32_t& nChecksum)
     LogPrint("zero", "%s : checksum:%d\n", __func__, nChecksum);
     return Erase(make_pair('2', nChecksum));
 }
+
+bool CZerocoinDB::LoadSerials()
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair('s', uint256(0));
+    pcursor->Seek(ssKeySet.str());
+
+    LOCK(cs_serials);
+    mapSerials.clear();
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType == 's') {
+                uint256 hashSerial;
+                ssKey >> hashSerial;
+                leveldb::Slice slValue = pcursor->value();
+                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+                uint256 txHash;
+                ssValue >> txHash;
+                mapSerials[hashSerial] = CSerialSpend(txHash, NULL);
+                pcursor->Next();
+            } else {
+                break; // finished loading serials
+            }
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+
+    LogPrintf("%s: loaded %u zerocoin serials\n", __func__, mapSerials.size());
+    return true;
+}
+
+bool CZerocoinDB::GetSerialSpend(const uint256& hashSerial, uint256& txHash, int& nHeight, uint256& hashBlock)
+{
+    LOCK(cs_serials);
+    boost::unordered_map<uint256, CSerialSpend, BlockHasher>::const_iterator it = mapSerials.find(hashSerial);
+    if (it == mapSerials.end())
+        return false;
+
+    txHash = it->second.txHash;
+    nHeight = it->second.nHeight;
+    hashBlock = it->second.hashBlock;
+    return true;
+}
+
+void CZerocoinDB::SetSerialSpendBlock(const uint256& hashSerial, const CBlockIndex* pindex)
+{
+    LOCK(cs_serials);
+    boost::unordered_map<uint256, CSerialSpend, BlockHasher>::iterator it = mapSerials.find(hashSerial);
+    if (it != mapSerials.end())
+        it->second = CSerialSpend(it->second.txHash, pindex);
+}
+
+CBlockFilterDB::CBlockFilterDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "blockfilters", nCacheSize, fMemory, fWipe)
+{
+    // Filters over another element set could hide blocks from a rescan, so
+    // drop them and let ThreadBlockFilterIndex build them again
+    int nVersion = 0;
+    if (Read('V', nVersion) && nVersion == BLOCK_FILTER_VERSION)
+        return;
+
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair('f', uint256(0));
+    pcursor->Seek(ssKeySet.str());
+    CLevelDBBatch batch;
+    unsigned int nErased = 0;
+    while (pcursor->Valid()) {
+        leveldb::Slice slKey = pcursor->key();
+        CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+        std::pair<char, uint256> key;
+        ssKey >> key;
+        if (key.first != 'f')
+            break;
+        batch.Erase(key);
+        nErased++;
+        pcursor->Next();
+    }
+    batch.Erase('B');
+    batch.Write('V', BLOCK_FILTER_VERSION);
+    if (!WriteBatch(batch, true))
+        LogPrintf("%s : failed to reset the block filter index\n", __func__);
+    else if (nErased)
+        LogPrintf("%s : dropped %u filters of version %d\n", __func__, nErased, nVersion);
+}
+
+bool CBlockFilterDB::WriteFilter(const uint256& hashBlock, const CBlockFilter& filter, bool fBestBlock)
+{
+    CLevelDBBatch batch;
+    batch.Write(make_pair('f', hashBlock), filter);
+    if (fBestBlock)
+        batch.Write('B', hashBlock);
+    return WriteBatch(batch);
+}
+
+bool CBlockFilterDB::ReadFilter(const uint256& hashBlock, CBlockFilter& filter)
+{
+    return Read(make_pair('f', hashBlock), filter);
+}
+
+bool CBlockFilterDB::HaveFilter(const uint256& hashBlock)
+{
+    return Exists(make_pair('f', hashBlock));
+}
+
+bool CBlockFilterDB::WriteBestBlock(const uint256& hashBlock)
+{
+    return Write('B', hashBlock);
+}
+
+uint256 CBlockFilterDB::ReadBestBlock()
+{
+    uint256 hashBlock = 0;
+    Read('B', hashBlock);
+    return hashBlock;
+}
+
+CUTXOStatsDB::CUTXOStatsDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "utxostats", nCacheSize, fMemory, fWipe)
+{
+}
+
+bool CUTXOStatsDB::WriteState(const CUTXOStatsState& state)
+{
+    CLevelDBBatch batch;
+    batch.Write(make_pair('s', state.hashBlock), state.stats);
+    batch.Write('T', state);
+    return WriteBatch(batch);
+}
+
+bool CUTXOStatsDB::ReadState(CUTXOStatsState& state)
+{
+    return Read('T', state);
+}
+
+bool CUTXOStatsDB::ReadStats(const uint256& hashBlock, CUTXOSetStats& stats)
+{
+    return Read(make_pair('s', hashBlock), stats);
+}
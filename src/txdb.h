@@ -7,6 +7,9 @@
 #ifndef BITCOIN_TXDB_H
 #define BITCOIN_TXDB_H
 
+#include "addressindex.h"
+#include "blockfilter.h"
+#include "crypto/muhash.h"
 #include "leveldbwrapper.h"
 #include "main.h"
 #include "primitives/zerocoin.h"
@@ -62,11 +65,30 @@ public:
     bool ReadReindexing(bool& fReindex);
     bool ReadTxIndex(const uint256& txid, CDiskTxPos& pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& list);
+    bool WriteTxLocations(const std::vector<std::pair<uint256, CTxLocation> >& list);
+    bool EraseTxLocations(const std::vector<uint256>& list);
+    bool LoadTxLocations(std::vector<std::pair<uint256, CTxLocation> >& list);
     bool WriteFlag(const std::string& name, bool fValue);
     bool ReadFlag(const std::string& name, bool& fValue);
     bool WriteInt(const std::string& name, int nValue);
     bool ReadInt(const std::string& name, int& nValue);
     bool LoadBlockIndexGuts();
+
+    // Explorer indexes, see addressindex.h
+    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect);
+    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect);
+    /** Records of an address from nStart to nEnd inclusive, the whole chain if nEnd is 0 */
+    bool ReadAddressIndex(unsigned char nAddressType, const uint160& hashBytes, std::vector<std::pair<CAddressIndexKey, CAmount> >& vect, int nStart = 0, int nEnd = 0);
+    /** Apply in order, erasing the records whose value is null */
+    bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vect);
+    bool ReadAddressUnspentIndex(unsigned char nAddressType, const uint160& hashBytes, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vect);
+    /** Apply in order, erasing the records whose value is null */
+    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& vect);
+    bool ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value);
+    bool WriteTimestampIndex(const CTimestampIndexKey& key);
+    bool EraseTimestampIndex(const CTimestampIndexKey& key);
+    /** Hashes of the blocks with nLow <= time < nHigh, in time order */
+    bool ReadTimestampIndex(unsigned int nHigh, unsigned int nLow, std::vector<uint256>& vHashes);
 };
 
 /** Zerocoin database (zerocoin/) */
@@ -84,8 +106,8 @@ public:
     bool WriteCoinMintBatch(const std::vector<std::pair<libzerocoin::PublicCoin, uint256> >& mintInfo);
     bool ReadCoinMint(const CBigNum& bnPubcoin, uint256& txHash);
     bool ReadCoinMint(const uint256& hashPubcoin, uint256& hashTx);
-    /** Write zUSERX spends to the zerocoinDB in a batch */
-    bool WriteCoinSpendBatch(const std::vector<std::pair<libzerocoin::CoinSpend, uint256> >& spendInfo);
+    /** Write zUSERX spends to the zerocoinDB in a batch, pindex is the block containing them if known */
+    bool WriteCoinSpendBatch(const std::vector<std::pair<libzerocoin::CoinSpend, uint256> >& spendInfo, const CBlockIndex* pindex = NULL);
     bool ReadCoinSpend(const CBigNum& bnSerial, uint256& txHash);
     bool ReadCoinSpend(const uint256& hashSerial, uint256 &txHash);
     bool EraseCoinMint(const CBigNum& bnPubcoin);
@@ -94,6 +116,105 @@ public:
     bool WriteAccumulatorValue(const uint32_t& nChecksum, const CBigNum& bnValue);
     bool ReadAccumulatorValue(const uint32_t& nChecksum, CBigNum& bnValue);
     bool EraseAccumulatorValue(const uint32_t& nChecksum);
+
+    /** Load the serial hashes of all recorded zUSERX spends into memory */
+    bool LoadSerials();
+    /**
+     * Look up a recorded spend without touching disk. nHeight is -1 if the spend was loaded
+     * from disk and its block is not known yet, else hashBlock is the block it was recorded in
+     */
+    bool GetSerialSpend(const uint256& hashSerial, uint256& txHash, int& nHeight, uint256& hashBlock);
+    void SetSerialSpendBlock(const uint256& hashSerial, const CBlockIndex* pindex);
+
+private:
+    struct CSerialSpend {
+        uint256 txHash;
+        int nHeight;
+        uint256 hashBlock;
+        CSerialSpend() : txHash(0), nHeight(-1), hashBlock(0) {}
+        CSerialSpend(const uint256& txHashIn, const CBlockIndex* pindex) : txHash(txHashIn), nHeight(pindex ? pindex->nHeight : -1), hashBlock(pindex ? pindex->GetBlockHash() : 0) {}
+    };
+
+    //! In-memory mirror of the 's' records, hash of serial -> spending tx and block
+    boost::unordered_map<uint256, CSerialSpend, BlockHasher> mapSerials;
+    CCriticalSection cs_serials;
+};
+
+/** Compact block filter index (blockfilters/), see CBlockFilter */
+class CBlockFilterDB : public CLevelDBWrapper
+{
+public:
+    CBlockFilterDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+private:
+    CBlockFilterDB(const CBlockFilterDB&);
+    void operator=(const CBlockFilterDB&);
+
+public:
+    /** Write a block's filter, and with fBestBlock mark the index as complete up to that block */
+    bool WriteFilter(const uint256& hashBlock, const CBlockFilter& filter, bool fBestBlock = false);
+    bool ReadFilter(const uint256& hashBlock, CBlockFilter& filter);
+    bool HaveFilter(const uint256& hashBlock);
+    /** The block up to which every block of its chain has a filter, 0 if none */
+    bool WriteBestBlock(const uint256& hashBlock);
+    uint256 ReadBestBlock();
+};
+
+/** UTXO set totals after a block, as kept by -utxostatsindex */
+struct CUTXOSetStats {
+    int nHeight;
+    uint64_t nTransactionOutputs;
+    CAmount nTotalAmount;
+    uint256 hashMuHash;
+
+    CUTXOSetStats() : nHeight(0), nTransactionOutputs(0), nTotalAmount(0), hashMuHash(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nHeight);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nTotalAmount);
+        READWRITE(hashMuHash);
+    }
+};
+
+/** The block the UTXO stats index has reached, with the running set hash to continue from */
+struct CUTXOStatsState {
+    uint256 hashBlock;
+    CUTXOSetStats stats;
+    MuHash3072 muhash;
+
+    CUTXOStatsState() : hashBlock(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(hashBlock);
+        READWRITE(stats);
+        READWRITE(muhash);
+    }
+};
+
+/** Access to the UTXO set totals and MuHash after each block (-utxostatsindex) */
+class CUTXOStatsDB : public CLevelDBWrapper
+{
+public:
+    CUTXOStatsDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+private:
+    CUTXOStatsDB(const CUTXOStatsDB&);
+    void operator=(const CUTXOStatsDB&);
+
+public:
+    /** Move the index to state.hashBlock and record the stats of that block */
+    bool WriteState(const CUTXOStatsState& state);
+    bool ReadState(CUTXOStatsState& state);
+    bool ReadStats(const uint256& hashBlock, CUTXOSetStats& stats);
 };
 
 #endif // BITCOIN_TXDB_H
@@ -6,6 +6,18 @@
 
 #include "validationinterface.h"
 
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "script/script.h"
+#include "uint256.h"
+#include "util.h"
+
+#include <deque>
+
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread.hpp>
+
 static CMainSignals g_signals;
 
 CMainSignals& GetMainSignals()
@@ -13,48 +25,255 @@ CMainSignals& GetMainSignals()
     return g_signals;
 }
 
+namespace
+{
+/**
+ * Runs queued callbacks one at a time, in order, on a single thread. Callbacks
+ * that listeners make while another one runs simply queue behind it.
+ */
+class CValidationInterfaceQueue
+{
+private:
+    boost::mutex cs;
+    boost::condition_variable condWork;
+    boost::condition_variable condDone;
+    std::deque<boost::function<void()> > queue;
+    //! Whether callbacks are queued rather than run right away
+    bool fQueueing;
+    bool fStopping;
+    bool fBusy;
+    boost::thread thread;
+
+    void Thread()
+    {
+        RenameThread("userx-valinterface");
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (true) {
+            while (queue.empty() && !fStopping)
+                condWork.wait(lock);
+            if (queue.empty()) {
+                // Anything added from now on runs synchronously
+                fQueueing = false;
+                condDone.notify_all();
+                return;
+            }
+            boost::function<void()> func;
+            func.swap(queue.front());
+            queue.pop_front();
+            fBusy = true;
+            lock.unlock();
+            try {
+                func();
+            } catch (const std::exception& e) {
+                LogPrintf("%s: validation callback failed: %s\n", __func__, e.what());
+            }
+            lock.lock();
+            fBusy = false;
+            condDone.notify_all();
+        }
+    }
+
+public:
+    CValidationInterfaceQueue() : fQueueing(false), fStopping(false), fBusy(false) {}
+
+    void Start()
+    {
+        boost::lock_guard<boost::mutex> lock(cs);
+        assert(!fQueueing);
+        fQueueing = true;
+        fStopping = false;
+        thread = boost::thread(boost::bind(&CValidationInterfaceQueue::Thread, this));
+    }
+
+    void Stop()
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(cs);
+            fStopping = true;
+        }
+        condWork.notify_one();
+        if (thread.joinable())
+            thread.join();
+    }
+
+    void Add(const boost::function<void()>& func)
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(cs);
+            if (fQueueing) {
+                queue.push_back(func);
+                condWork.notify_one();
+                return;
+            }
+        }
+        func();
+    }
+
+    /** Wait until at most nMax callbacks are queued or running */
+    void WaitForSize(size_t nMax)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        // A callback waiting for the queue it runs on would never return
+        if (boost::this_thread::get_id() == thread.get_id())
+            return;
+        while (fQueueing && queue.size() + (fBusy ? 1 : 0) > nMax)
+            condDone.wait(lock);
+    }
+};
+
+CValidationInterfaceQueue validationQueue;
+} // anon namespace
+
+void StartValidationInterfaceQueue()
+{
+    validationQueue.Start();
+}
+
+void StopValidationInterfaceQueue()
+{
+    validationQueue.Stop();
+}
+
+void SyncWithValidationInterfaceQueue()
+{
+    validationQueue.WaitForSize(0);
+}
+
+void LimitValidationInterfaceQueue()
+{
+    validationQueue.WaitForSize(MAX_VALIDATION_QUEUE_CALLBACKS);
+}
+
+void CallFunctionInValidationInterfaceQueue(const boost::function<void()>& func)
+{
+    validationQueue.Add(func);
+}
+
+void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew)
+{
+    // Block index entries are never deleted, so the pointer stays valid
+    validationQueue.Add(boost::bind(boost::ref(callbacks.UpdatedBlockTip), pindexNew));
+}
+
+void CMainSignals::SyncTransaction(const CTransaction &tx, const boost::shared_ptr<const CBlock> &pblock)
+{
+    if (pblock) {
+        // The transaction is one of the block's, which the queue entry keeps alive
+        const CTransaction* ptx = &tx;
+        assert(ptx >= pblock->vtx.data() && ptx < pblock->vtx.data() + pblock->vtx.size());
+        validationQueue.Add([this, ptx, pblock]() {
+            callbacks.SyncTransaction(*ptx, pblock.get());
+        });
+        return;
+    }
+    boost::shared_ptr<const CTransaction> ptx = boost::make_shared<CTransaction>(tx);
+    validationQueue.Add([this, ptx]() {
+        callbacks.SyncTransaction(*ptx, NULL);
+    });
+}
+
+void CMainSignals::SyncBlock(const boost::shared_ptr<const CBlock> &pblock)
+{
+    // Listeners share the connected block itself; the queue entry keeps it alive
+    validationQueue.Add([this, pblock]() {
+        BOOST_FOREACH (const CTransaction& tx, pblock->vtx)
+            callbacks.SyncTransaction(tx, pblock.get());
+    });
+}
+
+void CMainSignals::SyncDisconnectedBlock(const boost::shared_ptr<const CBlock> &pblock)
+{
+    validationQueue.Add([this, pblock]() {
+        BOOST_FOREACH (const CTransaction& tx, pblock->vtx)
+            callbacks.SyncTransaction(tx, NULL);
+    });
+}
+
+void CMainSignals::NotifyTransactionLock(const CTransaction &tx)
+{
+    validationQueue.Add(boost::bind(boost::ref(callbacks.NotifyTransactionLock), tx));
+}
+
+void CMainSignals::UpdatedMasternodeWinner(int nBlockHeight, const CScript &payee)
+{
+    validationQueue.Add(boost::bind(boost::ref(callbacks.UpdatedMasternodeWinner), nBlockHeight, payee));
+}
+
+void CMainSignals::UpdatedTransaction(const uint256 &hash)
+{
+    validationQueue.Add(boost::bind(boost::ref(callbacks.UpdatedTransaction), hash));
+}
+
+void CMainSignals::SetBestChain(const CBlockLocator &locator)
+{
+    validationQueue.Add(boost::bind(boost::ref(callbacks.SetBestChain), locator));
+}
+
+void CMainSignals::Inventory(const uint256 &hash)
+{
+    validationQueue.Add(boost::bind(boost::ref(callbacks.Inventory), hash));
+}
+
+void CMainSignals::Broadcast()
+{
+    validationQueue.Add(boost::ref(callbacks.Broadcast));
+}
+
+void CMainSignals::BlockChecked(const CBlock &block, const CValidationState &state)
+{
+    callbacks.BlockChecked(block, state);
+}
+
+void CMainSignals::BlockFound(const uint256 &hash)
+{
+    validationQueue.Add(boost::bind(boost::ref(callbacks.BlockFound), hash));
+}
+
 void RegisterValidationInterface(CValidationInterface* pwalletIn) {
-// XX42 g_signals.EraseTransaction.connect(boost::bind(&CValidationInterface::EraseFromWallet, pwalletIn, _1));
-    g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1));
-    g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2));
-    g_signals.NotifyTransactionLock.connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
-    g_signals.UpdatedTransaction.connect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
-    g_signals.SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
-    g_signals.Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
-    g_signals.Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn));
-    g_signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
-// XX42    g_signals.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
-    g_signals.BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
+// XX42 g_signals.callbacks.EraseTransaction.connect(boost::bind(&CValidationInterface::EraseFromWallet, pwalletIn, _1));
+    g_signals.callbacks.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1));
+    g_signals.callbacks.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2));
+    g_signals.callbacks.NotifyTransactionLock.connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
+    g_signals.callbacks.UpdatedMasternodeWinner.connect(boost::bind(&CValidationInterface::UpdatedMasternodeWinner, pwalletIn, _1, _2));
+    g_signals.callbacks.UpdatedTransaction.connect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
+    g_signals.callbacks.SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
+    g_signals.callbacks.Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
+    g_signals.callbacks.Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn));
+    g_signals.callbacks.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
+// XX42    g_signals.callbacks.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
+    g_signals.callbacks.BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
-// XX42    g_signals.ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
-    g_signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
-    g_signals.Broadcast.disconnect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn));
-    g_signals.Inventory.disconnect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
-    g_signals.SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
-    g_signals.UpdatedTransaction.disconnect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
-    g_signals.NotifyTransactionLock.disconnect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
-    g_signals.SyncTransaction.disconnect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2));
-    g_signals.UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1));
-// XX42    g_signals.EraseTransaction.disconnect(boost::bind(&CValidationInterface::EraseFromWallet, pwalletIn, _1));
+    g_signals.callbacks.BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
+// XX42    g_signals.callbacks.ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
+    g_signals.callbacks.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
+    g_signals.callbacks.Broadcast.disconnect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn));
+    g_signals.callbacks.Inventory.disconnect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
+    g_signals.callbacks.SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
+    g_signals.callbacks.UpdatedTransaction.disconnect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
+    g_signals.callbacks.UpdatedMasternodeWinner.disconnect(boost::bind(&CValidationInterface::UpdatedMasternodeWinner, pwalletIn, _1, _2));
+    g_signals.callbacks.NotifyTransactionLock.disconnect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1));
+    g_signals.callbacks.SyncTransaction.disconnect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2));
+    g_signals.callbacks.UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1));
+// XX42    g_signals.callbacks.EraseTransaction.disconnect(boost::bind(&CValidationInterface::EraseFromWallet, pwalletIn, _1));
 }
 
 void UnregisterAllValidationInterfaces() {
-    g_signals.BlockFound.disconnect_all_slots();
-// XX42    g_signals.ScriptForMining.disconnect_all_slots();
-    g_signals.BlockChecked.disconnect_all_slots();
-    g_signals.Broadcast.disconnect_all_slots();
-    g_signals.Inventory.disconnect_all_slots();
-    g_signals.SetBestChain.disconnect_all_slots();
-    g_signals.UpdatedTransaction.disconnect_all_slots();
-    g_signals.NotifyTransactionLock.disconnect_all_slots();
-    g_signals.SyncTransaction.disconnect_all_slots();
-    g_signals.UpdatedBlockTip.disconnect_all_slots();
-// XX42    g_signals.EraseTransaction.disconnect_all_slots();
-}
-
-void SyncWithWallets(const CTransaction &tx, const CBlock *pblock = NULL) {
+    g_signals.callbacks.BlockFound.disconnect_all_slots();
+// XX42    g_signals.callbacks.ScriptForMining.disconnect_all_slots();
+    g_signals.callbacks.BlockChecked.disconnect_all_slots();
+    g_signals.callbacks.Broadcast.disconnect_all_slots();
+    g_signals.callbacks.Inventory.disconnect_all_slots();
+    g_signals.callbacks.SetBestChain.disconnect_all_slots();
+    g_signals.callbacks.UpdatedTransaction.disconnect_all_slots();
+    g_signals.callbacks.UpdatedMasternodeWinner.disconnect_all_slots();
+    g_signals.callbacks.NotifyTransactionLock.disconnect_all_slots();
+    g_signals.callbacks.SyncTransaction.disconnect_all_slots();
+    g_signals.callbacks.UpdatedBlockTip.disconnect_all_slots();
+// XX42    g_signals.callbacks.EraseTransaction.disconnect_all_slots();
+}
+
+void SyncWithWallets(const CTransaction &tx, const boost::shared_ptr<const CBlock> &pblock) {
     g_signals.SyncTransaction(tx, pblock);
 }
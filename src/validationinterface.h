@@ -7,6 +7,7 @@
 #ifndef BITCOIN_VALIDATIONINTERFACE_H
 #define BITCOIN_VALIDATIONINTERFACE_H
 
+#include <boost/function.hpp>
 #include <boost/signals2/signal.hpp>
 #include <boost/shared_ptr.hpp>
 
@@ -14,6 +15,7 @@ class CBlock;
 struct CBlockLocator;
 class CBlockIndex;
 class CReserveScript;
+class CScript;
 class CTransaction;
 class CValidationInterface;
 class CValidationState;
@@ -28,7 +30,32 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
 void UnregisterAllValidationInterfaces();
 /** Push an updated transaction to all registered wallets */
-void SyncWithWallets(const CTransaction& tx, const CBlock* pblock);
+void SyncWithWallets(const CTransaction& tx, const boost::shared_ptr<const CBlock>& pblock);
+
+//! Callbacks that may wait in the queue before ProcessNewBlock waits for them to run
+static const unsigned int MAX_VALIDATION_QUEUE_CALLBACKS = 100;
+
+/**
+ * Start the thread that runs the callbacks of validation notifications, in
+ * the order they were made, outside of cs_main. Until it runs (and after it
+ * stops) callbacks run synchronously.
+ */
+void StartValidationInterfaceQueue();
+/** Run the callbacks still queued and stop the thread */
+void StopValidationInterfaceQueue();
+/**
+ * Wait until the callbacks of all notifications made so far have run, for
+ * callers that need listeners to be up to date. Must not be called with
+ * cs_main held, as the callbacks may take it.
+ */
+void SyncWithValidationInterfaceQueue();
+/** Wait until few enough callbacks are queued. Must not be called with cs_main held */
+void LimitValidationInterfaceQueue();
+/**
+ * Queue a function behind the callbacks of the notifications made so far, for
+ * listener updates that have to stay in order with them
+ */
+void CallFunctionInValidationInterfaceQueue(const boost::function<void()>& func);
 
 class CValidationInterface {
 protected:
@@ -36,6 +63,7 @@ protected:
     virtual void UpdatedBlockTip(const CBlockIndex *pindex) {}
     virtual void SyncTransaction(const CTransaction &tx, const CBlock *pblock) {}
     virtual void NotifyTransactionLock(const CTransaction &tx) {}
+    virtual void UpdatedMasternodeWinner(int nBlockHeight, const CScript &payee) {}
     virtual void SetBestChain(const CBlockLocator &locator) {}
     virtual bool UpdatedTransaction(const uint256 &hash) { return false;}
     virtual void Inventory(const uint256 &hash) {}
@@ -49,29 +77,60 @@ protected:
     friend void ::UnregisterAllValidationInterfaces();
 };
 
-struct CMainSignals {
-// XX42    boost::signals2::signal<void(const uint256&)> EraseTransaction;
+/**
+ * Notifications from validation to the registered listeners. All but
+ * BlockChecked, whose callers read the listeners' conclusions right away,
+ * queue their callbacks on the validation interface thread; their arguments
+ * are copied, so they need not outlive the call.
+ */
+class CMainSignals {
+private:
+    struct Callbacks {
+// XX42        boost::signals2::signal<void(const uint256&)> EraseTransaction;
+        boost::signals2::signal<void (const CBlockIndex *)> UpdatedBlockTip;
+        boost::signals2::signal<void (const CTransaction &, const CBlock *)> SyncTransaction;
+        boost::signals2::signal<void (const CTransaction &)> NotifyTransactionLock;
+        boost::signals2::signal<void (int, const CScript &)> UpdatedMasternodeWinner;
+        boost::signals2::signal<bool (const uint256 &)> UpdatedTransaction;
+        boost::signals2::signal<void (const CBlockLocator &)> SetBestChain;
+        boost::signals2::signal<void (const uint256 &)> Inventory;
+// XX42        boost::signals2::signal<void (int64_t nBestBlockTime)> Broadcast;
+        boost::signals2::signal<void ()> Broadcast;
+        boost::signals2::signal<void (const CBlock&, const CValidationState&)> BlockChecked;
+// XX42        boost::signals2::signal<void (boost::shared_ptr<CReserveScript>&)> ScriptForMining;
+        boost::signals2::signal<void (const uint256 &)> BlockFound;
+    };
+    Callbacks callbacks;
+
+    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend void ::UnregisterValidationInterface(CValidationInterface*);
+    friend void ::UnregisterAllValidationInterfaces();
+
+public:
     /** Notifies listeners of updated block chain tip */
-    boost::signals2::signal<void (const CBlockIndex *)> UpdatedBlockTip;
+    void UpdatedBlockTip(const CBlockIndex *pindexNew);
     /** Notifies listeners of updated transaction data (transaction, and optionally the block it is found in. */
-    boost::signals2::signal<void (const CTransaction &, const CBlock *)> SyncTransaction;
+    void SyncTransaction(const CTransaction &tx, const boost::shared_ptr<const CBlock> &pblock = boost::shared_ptr<const CBlock>());
+    /** SyncTransaction for every transaction of a connected block, in block order */
+    void SyncBlock(const boost::shared_ptr<const CBlock> &pblock);
+    /** SyncTransaction without a block for every transaction of a disconnected block */
+    void SyncDisconnectedBlock(const boost::shared_ptr<const CBlock> &pblock);
     /** Notifies listeners of an updated transaction lock without new data. */
-    boost::signals2::signal<void (const CTransaction &)> NotifyTransactionLock;
+    void NotifyTransactionLock(const CTransaction &tx);
+    /** Notifies listeners that the masternode with the most payment votes for a height changed. */
+    void UpdatedMasternodeWinner(int nBlockHeight, const CScript &payee);
     /** Notifies listeners of an updated transaction without new data (for now: a coinbase potentially becoming visible). */
-    boost::signals2::signal<bool (const uint256 &)> UpdatedTransaction;
+    void UpdatedTransaction(const uint256 &hash);
     /** Notifies listeners of a new active block chain. */
-    boost::signals2::signal<void (const CBlockLocator &)> SetBestChain;
+    void SetBestChain(const CBlockLocator &locator);
     /** Notifies listeners about an inventory item being seen on the network. */
-    boost::signals2::signal<void (const uint256 &)> Inventory;
+    void Inventory(const uint256 &hash);
     /** Tells listeners to broadcast their data. */
-// XX42    boost::signals2::signal<void (int64_t nBestBlockTime)> Broadcast;
-    boost::signals2::signal<void ()> Broadcast;
-    /** Notifies listeners of a block validation result */
-    boost::signals2::signal<void (const CBlock&, const CValidationState&)> BlockChecked;
-    /** Notifies listeners that a key for mining is required (coinbase) */
-// XX42    boost::signals2::signal<void (boost::shared_ptr<CReserveScript>&)> ScriptForMining;
+    void Broadcast();
+    /** Notifies listeners of a block validation result. Runs synchronously */
+    void BlockChecked(const CBlock &block, const CValidationState &state);
     /** Notifies listeners that a block has been successfully mined */
-    boost::signals2::signal<void (const uint256 &)> BlockFound;
+    void BlockFound(const uint256 &hash);
 };
 
 CMainSignals& GetMainSignals();
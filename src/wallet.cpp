@@ -9,6 +9,7 @@
 
 #include "accumulators.h"
 #include "base58.h"
+#include "blockfilter.h"
 #include "checkpoints.h"
 #include "coincontrol.h"
 #include "kernel.h"
@@ -31,6 +32,7 @@
 #include "zuserxwallet.h"
 #include "primitives/deterministicmint.h"
 #include <assert.h>
+#include <atomic>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
@@ -465,6 +467,272 @@ void CWallet::AddToSpends(const uint256& wtxid)
         AddToSpends(txin.prevout, wtxid);
 }
 
+/**
+ * An output leaves the unspent index once a wallet transaction spending it
+ * is in the active chain. Unconfirmed spends are left to IsSpent().
+ */
+bool CWallet::IsSpentInChain(const COutPoint& outpoint) const
+{
+    pair<TxSpends::const_iterator, TxSpends::const_iterator> range;
+    range = mapTxSpends.equal_range(outpoint);
+    for (TxSpends::const_iterator it = range.first; it != range.second; ++it) {
+        std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(it->second);
+        if (mit != mapWallet.end() && mit->second.GetDepthInMainChain(false) > 0)
+            return true;
+    }
+    return false;
+}
+
+bool CWallet::IsMNCollateralTier(CAmount nValue)
+{
+    // GetMNCollateralOld() steps through the same amounts at later heights
+    for (int i = 0; i < MN_COLLATERAL_TIER_COUNT; i++) {
+        if (nValue == MN_COLLATERAL_TIERS[i] * COIN)
+            return true;
+    }
+    return false;
+}
+
+void CWallet::UpdateUnspentIndex(const COutPoint& outpoint) const
+{
+    setUnspentCoins.erase(outpoint);
+    for (int i = 0; i < UNSPENT_BUCKET_COUNT; i++)
+        setUnspentBucket[i].erase(outpoint);
+
+    std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+    if (it == mapWallet.end() || outpoint.n >= it->second.vout.size())
+        return;
+    const CTxOut& txout = it->second.vout[outpoint.n];
+    if (IsMine(txout) == ISMINE_NO || IsSpentInChain(outpoint))
+        return;
+
+    setUnspentCoins.insert(outpoint);
+    if (!txout.IsZerocoinMint())
+        setUnspentBucket[UNSPENT_STAKABLE].insert(outpoint);
+    if (IsDenominatedAmount(txout.nValue))
+        setUnspentBucket[UNSPENT_DENOMINATED].insert(outpoint);
+    if (IsCollateralAmount(txout.nValue))
+        setUnspentBucket[UNSPENT_COLLATERAL].insert(outpoint);
+    if (IsMNCollateralTier(txout.nValue))
+        setUnspentBucket[UNSPENT_MNCOLLATERAL].insert(outpoint);
+}
+
+/**
+ * Fold queued wallet transactions into the unspent index: their own outputs
+ * and the wallet outputs they spend. Rebuilds from mapWallet when stale.
+ */
+void CWallet::SyncUnspentIndex() const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    if (fUnspentIndexStale) {
+        setUnspentCoins.clear();
+        for (int i = 0; i < UNSPENT_BUCKET_COUNT; i++)
+            setUnspentBucket[i].clear();
+        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
+            for (unsigned int i = 0; i < it->second.vout.size(); i++)
+                UpdateUnspentIndex(COutPoint(it->first, i));
+        }
+        setUnspentPending.clear();
+        fUnspentIndexStale = false;
+        fBalanceStale = true;
+        LogPrint("selectcoins", "%s : indexed %u unspent outputs\n", __func__, setUnspentCoins.size());
+        return;
+    }
+
+    BOOST_FOREACH (const uint256& hash, setUnspentPending) {
+        std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+        if (it == mapWallet.end())
+            continue;
+        const CWalletTx& wtx = it->second;
+        for (unsigned int i = 0; i < wtx.vout.size(); i++)
+            UpdateUnspentIndex(COutPoint(hash, i));
+        setBalanceDirty.insert(hash);
+        if (wtx.IsCoinBase() || wtx.IsZerocoinSpend())
+            continue;
+        BOOST_FOREACH (const CTxIn& txin, wtx.vin) {
+            if (mapWallet.count(txin.prevout.hash)) {
+                UpdateUnspentIndex(txin.prevout);
+                setBalanceDirty.insert(txin.prevout.hash);
+            }
+        }
+    }
+    setUnspentPending.clear();
+}
+
+const std::set<COutPoint>& CWallet::GetUnspentCoins(AvailableCoinsType nCoinType) const
+{
+    switch (nCoinType) {
+    case ONLY_DENOMINATED:
+        return setUnspentBucket[UNSPENT_DENOMINATED];
+    case ONLY_COLLATERAL:
+        return setUnspentBucket[UNSPENT_COLLATERAL];
+    case ONLY_10000:
+        return setUnspentBucket[UNSPENT_MNCOLLATERAL];
+    case STAKABLE_COINS:
+        return setUnspentBucket[UNSPENT_STAKABLE];
+    default:
+        return setUnspentCoins;
+    }
+}
+
+/**
+ * Every output that can still contribute to a balance (unspent, or immature
+ * and therefore unspendable in the chain) is in the unspent index, so the
+ * balance getters only need the transactions that own indexed outputs.
+ */
+std::vector<const CWalletTx*> CWallet::GetUnspentWalletTxes() const
+{
+    SyncUnspentIndex();
+
+    std::vector<const CWalletTx*> vWtx;
+    const uint256* phashLast = NULL;
+    BOOST_FOREACH (const COutPoint& outpoint, setUnspentCoins) {
+        if (phashLast && *phashLast == outpoint.hash)
+            continue;
+        phashLast = &outpoint.hash;
+        std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+        if (it != mapWallet.end())
+            vWtx.push_back(&it->second);
+    }
+    return vWtx;
+}
+
+/**
+ * A transaction's share of each balance total, summed the way a full pass
+ * over the unspent index would. Returns whether the share can change with
+ * the tip or mempool alone.
+ */
+bool CWallet::GetBalanceContribution(const CWalletTx& wtx, std::vector<CAmount>& vBalance) const
+{
+    vBalance.assign(BALANCE_TYPE_COUNT, 0);
+
+    const bool fFinal = IsFinalTx(wtx);
+    const bool fTrusted = wtx.IsTrusted();
+    const int nDepth = wtx.GetDepthInMainChain();
+    const bool fUnconfirmed = !fFinal || (!fTrusted && nDepth == 0);
+
+    if (fTrusted) {
+        vBalance[BALANCE_AVAILABLE] = wtx.GetAvailableCredit(false);
+        vBalance[BALANCE_ANONYMIZABLE] = wtx.GetAnonymizableCredit(false);
+        vBalance[BALANCE_ANONYMIZED] = wtx.GetAnonymizedCredit(false);
+        vBalance[BALANCE_WATCH_AVAILABLE] = wtx.GetAvailableWatchOnlyCredit(false);
+        if (nDepth > 0) {
+            vBalance[BALANCE_UNLOCKED] = wtx.GetUnlockedCredit();
+            vBalance[BALANCE_LOCKED] = wtx.GetLockedCredit();
+            vBalance[BALANCE_WATCH_LOCKED] = wtx.GetLockedWatchOnlyCredit();
+        }
+    }
+    if (fUnconfirmed) {
+        vBalance[BALANCE_UNCONFIRMED] = wtx.GetAvailableCredit(false);
+        vBalance[BALANCE_WATCH_UNCONFIRMED] = wtx.GetAvailableWatchOnlyCredit(false);
+    }
+    vBalance[BALANCE_IMMATURE] = wtx.GetImmatureCredit(false);
+    vBalance[BALANCE_WATCH_IMMATURE] = wtx.GetImmatureWatchOnlyCredit(false);
+    vBalance[BALANCE_DENOMINATED] = wtx.GetDenominatedCredit(false, false);
+    vBalance[BALANCE_DENOMINATED_UNCONFIRMED] = wtx.GetDenominatedCredit(true, false);
+
+    return !fFinal || wtx.GetDepthInMainChain(false) <= 0 || wtx.GetBlocksToMaturity() > 0;
+}
+
+/** Move the totals by the change in one transaction's contribution. */
+void CWallet::UpdateBalance(const uint256& hash) const
+{
+    std::vector<CAmount> vBalance(BALANCE_TYPE_COUNT, 0);
+    bool fUnsettled = false;
+
+    // Only transactions owning indexed outputs count towards a balance
+    std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+    if (it != mapWallet.end()) {
+        std::set<COutPoint>::const_iterator itCoin = setUnspentCoins.lower_bound(COutPoint(hash, 0));
+        if (itCoin != setUnspentCoins.end() && itCoin->hash == hash)
+            fUnsettled = GetBalanceContribution(it->second, vBalance);
+        // A spend outside the chain gives its inputs back if it is dropped or
+        // conflicted, even when none of its own outputs are ours
+        if (!fUnsettled && it->second.GetDepthInMainChain(false) <= 0 && IsFromMe(it->second))
+            fUnsettled = true;
+    }
+
+    std::map<uint256, std::vector<CAmount> >::iterator itContrib = mapBalanceContrib.find(hash);
+    for (int i = 0; i < BALANCE_TYPE_COUNT; i++) {
+        nBalanceTotal[i] += vBalance[i];
+        if (itContrib != mapBalanceContrib.end())
+            nBalanceTotal[i] -= itContrib->second[i];
+    }
+
+    if (std::count(vBalance.begin(), vBalance.end(), 0) == BALANCE_TYPE_COUNT) {
+        if (itContrib != mapBalanceContrib.end())
+            mapBalanceContrib.erase(itContrib);
+    } else {
+        mapBalanceContrib[hash].swap(vBalance);
+    }
+
+    if (fUnsettled)
+        setBalanceUnsettled.insert(hash);
+    else
+        setBalanceUnsettled.erase(hash);
+}
+
+void CWallet::SyncBalances() const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    SyncUnspentIndex();
+
+    // A reorg can take settled transactions out of the chain, and a new
+    // collateral tier changes which outputs a masternode counts as locked
+    if (pindexBalance && !chainActive.Contains(pindexBalance))
+        fBalanceStale = true;
+    std::pair<int64_t, int64_t> pairMNCollateral(GetMNCollateral(chainActive.Height()), GetMNCollateralOld(chainActive.Height()));
+    if (fMasterNode && pairMNCollateral != pairBalanceMNCollateral)
+        fBalanceStale = true;
+    pairBalanceMNCollateral = pairMNCollateral;
+
+    if (fBalanceStale) {
+        std::fill(nBalanceTotal, nBalanceTotal + BALANCE_TYPE_COUNT, 0);
+        mapBalanceContrib.clear();
+        setBalanceUnsettled.clear();
+        setBalanceDirty.clear();
+        BOOST_FOREACH (const CWalletTx* pcoin, GetUnspentWalletTxes())
+            UpdateBalance(pcoin->GetHash());
+        fBalanceStale = false;
+        pindexBalance = chainActive.Tip();
+        nBalanceMempoolUpdates = mempool.GetTransactionsUpdated();
+        LogPrint("selectcoins", "%s : recomputed balances over %u transactions\n", __func__, mapBalanceContrib.size());
+        return;
+    }
+
+    // An unsettled transaction moves with the tip and mempool, and so do the
+    // wallet outputs it spends, which are only spent while it isn't conflicted
+    if (pindexBalance != chainActive.Tip() || nBalanceMempoolUpdates != mempool.GetTransactionsUpdated()) {
+        BOOST_FOREACH (const uint256& hash, setBalanceUnsettled) {
+            setBalanceDirty.insert(hash);
+            std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+            if (it == mapWallet.end() || it->second.IsCoinBase() || it->second.IsZerocoinSpend())
+                continue;
+            BOOST_FOREACH (const CTxIn& txin, it->second.vin) {
+                if (mapWallet.count(txin.prevout.hash))
+                    setBalanceDirty.insert(txin.prevout.hash);
+            }
+        }
+        pindexBalance = chainActive.Tip();
+        nBalanceMempoolUpdates = mempool.GetTransactionsUpdated();
+    }
+
+    BOOST_FOREACH (const uint256& hash, setBalanceDirty)
+        UpdateBalance(hash);
+    setBalanceDirty.clear();
+}
+
+CAmount CWallet::GetBalanceTotal(BalanceType nType) const
+{
+    LOCK2(cs_main, cs_wallet);
+    SyncBalances();
+    return nBalanceTotal[nType];
+}
+
 bool CWallet::GetMasternodeVinAndKeys(CTxIn& txinRet, CPubKey& pubKeyRet, CKey& keyRet, std::string strTxHash, std::string strOutputIndex)
 {
     // wait for reindex and/or import to finish
@@ -636,7 +904,30 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         BOOST_FOREACH (PAIRTYPE(const uint256, CWalletTx) & item, mapWallet)
             item.second.MarkDirty();
+        fUnspentIndexStale = true;
+        InvalidateBalanceCache();
+    }
+}
+
+void CWallet::IndexWalletTxHeight(const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+    int nHeight = std::numeric_limits<int>::max();
+    BlockMap::iterator mi = mapBlockIndex.find(wtx.hashBlock);
+    if (mi != mapBlockIndex.end() && chainActive.Contains(mi->second))
+        nHeight = mi->second->nHeight;
+
+    const uint256 hash = wtx.GetHash();
+    std::map<uint256, int>::iterator it = mapWalletTxHeight.find(hash);
+    if (it != mapWalletTxHeight.end()) {
+        if (it->second == nHeight)
+            return;
+        setWalletTxByHeight.erase(make_pair(it->second, hash));
+        it->second = nHeight;
+    } else {
+        mapWalletTxHeight.insert(make_pair(hash, nHeight));
     }
+    setWalletTxByHeight.insert(make_pair(nHeight, hash));
 }
 
 bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
@@ -648,6 +939,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
         CWalletTx& wtx = mapWallet[hash];
         wtx.BindWallet(this);
         wtxOrdered.insert(make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
+        IndexWalletTxHeight(wtx);
         AddToSpends(hash);
     } else {
         LOCK(cs_wallet);
@@ -691,8 +983,12 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
             if (!wtx.WriteToDisk())
                 return false;
 
+        // A disconnected block's transactions come through here too, so re-key them
+        IndexWalletTxHeight(wtx);
+
         // Break debit/credit balance caches:
         wtx.MarkDirty();
+        setUnspentPending.insert(hash);
 
         // Notify UI of new or updated transaction
         NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -733,6 +1029,13 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pbl
 void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
 {
     LOCK2(cs_main, cs_wallet);
+    // The tracker's and the wallet's writes for the transaction go in one commit
+    CDBBatch batch(strWalletFile);
+
+    // Spends of our mints need not involve our keys, so tell the tracker about every zerocoin tx
+    if (zuserxTracker && tx.ContainsZerocoins())
+        zuserxTracker->NotifyTransaction(tx);
+
     if (!AddToWalletIfInvolvingMe(tx, pblock, true))
         return; // Not one of ours
 
@@ -751,8 +1054,16 @@ void CWallet::EraseFromWallet(const uint256& hash)
         return;
     {
         LOCK(cs_wallet);
-        if (mapWallet.erase(hash))
+        if (mapWallet.erase(hash)) {
             CWalletDB(strWalletFile).EraseTx(hash);
+            std::map<uint256, int>::iterator it = mapWalletTxHeight.find(hash);
+            if (it != mapWalletTxHeight.end()) {
+                setWalletTxByHeight.erase(make_pair(it->second, hash));
+                mapWalletTxHeight.erase(it);
+            }
+            fUnspentIndexStale = true;
+            InvalidateBalanceCache();
+        }
     }
     return;
 }
@@ -1424,10 +1735,113 @@ bool CWalletTx::WriteToDisk()
     return CWalletDB(pwallet->strWalletFile).WriteTx(GetHash(), *this);
 }
 
+namespace {
+/** A block read by a rescan worker, with the transactions that pay to us marked */
+struct CRescanBlock {
+    CBlockIndex* pindex;
+    CBlock block;
+    std::vector<bool> vOwnsOutput;
+    bool fRead;
+};
+
+/**
+ * Rescan worker: read blocks from disk and test their outputs against the
+ * keystore. IsMine() only takes the keystore lock, so neither cs_main nor
+ * cs_wallet is needed here.
+ */
+void ThreadRescanMatch(const CWallet* pwallet, std::vector<CRescanBlock>* pvBlocks, std::atomic<size_t>* pnNext, const std::vector<uint64_t>* pvFilterElements)
+{
+    while (true) {
+        size_t n = (*pnNext)++;
+        if (n >= pvBlocks->size())
+            return;
+        CRescanBlock& item = (*pvBlocks)[n];
+
+        // Blocks whose filter matches nothing of ours are left empty
+        if (pvFilterElements) {
+            CBlockFilter filter;
+            if (pblockfilterdb->ReadFilter(item.pindex->GetBlockHash(), filter) && !filter.MatchAny(*pvFilterElements)) {
+                item.fRead = true;
+                continue;
+            }
+        }
+
+        item.fRead = ReadBlockFromDisk(item.block, item.pindex);
+        if (!item.fRead)
+            continue;
+        item.vOwnsOutput.assign(item.block.vtx.size(), false);
+        for (unsigned int i = 0; i < item.block.vtx.size(); i++) {
+            BOOST_FOREACH (const CTxOut& txout, item.block.vtx[i].vout) {
+                if (pwallet->IsMine(txout) != ISMINE_NO) {
+                    item.vOwnsOutput[i] = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+}
+
+/**
+ * Hashes of everything a block filter can match for this wallet: the
+ * scripts our keys, redeem scripts and watch-only entries pay to, and the
+ * pubcoin hashes of our zUSERX mints and mint pool, and the zerocoin spend
+ * marker if we have any mints. Sorted, see CBlockFilter.
+ */
+void CWallet::GetBlockFilterElements(std::vector<uint64_t>& vHashes) const
+{
+    std::vector<CScript> vScripts;
+    std::set<CKeyID> setKeyIds;
+    GetKeys(setKeyIds);
+    BOOST_FOREACH (const CKeyID& keyid, setKeyIds) {
+        CPubKey pubkey;
+        if (GetPubKey(keyid, pubkey))
+            vScripts.push_back(CScript() << ToByteVector(pubkey) << OP_CHECKSIG);
+        vScripts.push_back(GetScriptForDestination(keyid));
+    }
+    {
+        LOCK(cs_KeyStore);
+        for (ScriptMap::const_iterator it = mapScripts.begin(); it != mapScripts.end(); ++it) {
+            vScripts.push_back(it->second);
+            vScripts.push_back(GetScriptForDestination(CScriptID(it->second)));
+        }
+        BOOST_FOREACH (const CScript& script, setWatchOnly)
+            vScripts.push_back(script);
+    }
+
+    vHashes.clear();
+    BOOST_FOREACH (const CScript& script, vScripts)
+        vHashes.push_back(CBlockFilter::HashElement(script.data(), script.data() + script.size()));
+
+    std::vector<uint256> vPubcoinHashes;
+    BOOST_FOREACH (const CMintMeta& meta, zuserxTracker->GetMints(false))
+        vPubcoinHashes.push_back(meta.hashPubcoin);
+    if (zwalletMain) {
+        for (const std::pair<uint256, uint32_t>& pMint : zwalletMain->ListMintPool())
+            vPubcoinHashes.push_back(pMint.first);
+    }
+    BOOST_FOREACH (const uint256& hashPubcoin, vPubcoinHashes)
+        vHashes.push_back(CBlockFilter::HashElement(hashPubcoin.begin(), hashPubcoin.end()));
+
+    // A spend of our mint can pay anywhere, so blocks with spends stay candidates
+    if (!vPubcoinHashes.empty())
+        vHashes.push_back(CBlockFilter::GetZerocoinSpendElement());
+
+    std::sort(vHashes.begin(), vHashes.end());
+    vHashes.erase(std::unique(vHashes.begin(), vHashes.end()), vHashes.end());
+}
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
+ *
+ * Blocks are read and matched against the keystore by a pool of workers,
+ * one batch at a time with cs_main released. Each batch is then applied in
+ * chain order under cs_main and cs_wallet, where spends of our outputs and
+ * zUSERX mints are picked up. With -blockfilterindex, blocks whose filter
+ * matches none of our scripts or pubcoins, nor any zerocoin spend while we
+ * hold mints, are not read at all.
  */
 int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
@@ -1437,26 +1851,81 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
     if (fCheckZUSERX)
         zuserxTracker->Init();
 
+    int nThreads = GetArg("-rescanthreads", DEFAULT_RESCAN_THREADS);
+    if (nThreads <= 0)
+        nThreads += boost::thread::hardware_concurrency();
+    nThreads = std::max(1, std::min(nThreads, MAX_RESCAN_THREADS));
+
+    std::vector<uint64_t> vFilterElements;
+    if (pblockfilterdb) {
+        LOCK(cs_wallet);
+        GetBlockFilterElements(vFilterElements);
+    }
+
     CBlockIndex* pindex = pindexStart;
+    double dProgressStart;
+    double dProgressTip;
     {
-        LOCK2(cs_main, cs_wallet);
+        LOCK(cs_main);
 
         // no need to read and scan block, if block was created before
         // our wallet birthday (as adjusted for block time variability)
         while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - 7200)) && pindex->nHeight <= Params().Zerocoin_StartHeight())
             pindex = chainActive.Next(pindex);
 
-        ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = Checkpoints::GuessVerificationProgress(pindex, false);
-        double dProgressTip = Checkpoints::GuessVerificationProgress(chainActive.Tip(), false);
-        set<uint256> setAddedToWallet;
-        while (pindex) {
+        dProgressStart = Checkpoints::GuessVerificationProgress(pindex, false);
+        dProgressTip = Checkpoints::GuessVerificationProgress(chainActive.Tip(), false);
+    }
+
+    ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
+    set<uint256> setAddedToWallet;
+    while (pindex) {
+        std::vector<CRescanBlock> vBlocks;
+        {
+            LOCK(cs_main);
+            if (!chainActive.Contains(pindex)) {
+                // Reorganized away between batches: continue from the fork point
+                const CBlockIndex* pindexFork = chainActive.FindFork(pindex);
+                pindex = pindexFork ? chainActive.Next(pindexFork) : chainActive.Genesis();
+            }
+            for (CBlockIndex* pindexBatch = pindex; pindexBatch && vBlocks.size() < RESCAN_BATCH_SIZE; pindexBatch = chainActive.Next(pindexBatch)) {
+                vBlocks.push_back(CRescanBlock());
+                vBlocks.back().pindex = pindexBatch;
+            }
+        }
+        if (vBlocks.empty())
+            break;
+
+        std::atomic<size_t> nNext(0);
+        boost::thread_group threadGroup;
+        for (int i = 1; i < nThreads; i++)
+            threadGroup.create_thread(boost::bind(&ThreadRescanMatch, this, &vBlocks, &nNext, pblockfilterdb ? &vFilterElements : NULL));
+        ThreadRescanMatch(this, &vBlocks, &nNext, pblockfilterdb ? &vFilterElements : NULL);
+        threadGroup.join_all();
+
+        // One commit for the wallet's writes from each group of blocks
+        LOCK2(cs_main, cs_wallet);
+        CDBBatch batch(strWalletFile);
+        BOOST_FOREACH (CRescanBlock& item, vBlocks) {
+            pindex = item.pindex;
+            if (!chainActive.Contains(pindex))
+                break;
+
             if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
                 ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
 
-            CBlock block;
-            ReadBlockFromDisk(block, pindex);
-            BOOST_FOREACH (CTransaction& tx, block.vtx) {
+            if (!item.fRead) {
+                LogPrintf("%s : failed to read block %s\n", __func__, pindex->GetBlockHash().ToString());
+                pindex = chainActive.Next(pindex);
+                continue;
+            }
+
+            CBlock& block = item.block;
+            for (unsigned int i = 0; i < block.vtx.size(); i++) {
+                // Transactions without our outputs can only involve us by spending our coins
+                const CTransaction& tx = block.vtx[i];
+                if (!item.vOwnsOutput[i] && !tx.IsZerocoinSpend() && !IsFromMe(tx) && !mapWallet.count(tx.GetHash()))
+                    continue;
                 if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
                     ret++;
             }
@@ -1469,7 +1938,7 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
                 for (auto& m : listMints) {
                     if (IsMyMint(m.GetValue())) {
                         LogPrint("zero", "%s: found mint\n", __func__);
-                        pwalletMain->UpdateMint(m.GetValue(), pindex->nHeight, m.GetTxHash(), m.GetDenomination());
+                        UpdateMint(m.GetValue(), pindex->nHeight, m.GetTxHash(), m.GetDenomination());
 
                         // Add the transaction to the wallet
                         for (auto& tx : block.vtx) {
@@ -1477,30 +1946,33 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
                             if (setAddedToWallet.count(txid) || mapWallet.count(txid))
                                 continue;
                             if (txid == m.GetTxHash()) {
-                                CWalletTx wtx(pwalletMain, tx);
+                                CWalletTx wtx(this, tx);
                                 wtx.nTimeReceived = block.GetBlockTime();
                                 wtx.SetMerkleBranch(block);
-                                pwalletMain->AddToWallet(wtx);
+                                AddToWallet(wtx);
                                 setAddedToWallet.insert(txid);
                             }
                         }
 
-                        //Check if the mint was ever spent
+                        //Check if the mint was ever spent. Mints read from a block carry no serial, the tracker has it
+                        uint256 hashPubcoin = GetPubCoinHash(m.GetValue());
+                        if (!zuserxTracker->HasPubcoinHash(hashPubcoin))
+                            continue;
                         int nHeightSpend = 0;
                         uint256 txidSpend;
                         CTransaction txSpend;
-                        if (IsSerialInBlockchain(GetSerialHash(m.GetSerialNumber()), nHeightSpend, txidSpend, txSpend)) {
+                        if (IsSerialInBlockchain(zuserxTracker->GetMetaFromPubcoin(hashPubcoin).hashSerial, nHeightSpend, txidSpend, txSpend)) {
                             if (setAddedToWallet.count(txidSpend) || mapWallet.count(txidSpend))
                                 continue;
 
-                            CWalletTx wtx(pwalletMain, txSpend);
+                            CWalletTx wtx(this, txSpend);
                             CBlockIndex* pindexSpend = chainActive[nHeightSpend];
                             CBlock blockSpend;
                             if (ReadBlockFromDisk(blockSpend, pindexSpend))
                                 wtx.SetMerkleBranch(blockSpend);
 
                             wtx.nTimeReceived = pindexSpend->nTime;
-                            pwalletMain->AddToWallet(wtx);
+                            AddToWallet(wtx);
                             setAddedToWallet.emplace(txidSpend);
                         }
                     }
@@ -1508,13 +1980,13 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
             }
 
             pindex = chainActive.Next(pindex);
-            if (GetTime() >= nNow + 60) {
+            if (pindex && GetTime() >= nNow + 60) {
                 nNow = GetTime();
                 LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(pindex));
             }
         }
-        ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     }
+    ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     return ret;
 }
 
@@ -1621,18 +2093,7 @@ void CWallet::ResendWalletTransactions()
 
 CAmount CWallet::GetBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalanceTotal(BALANCE_AVAILABLE);
 }
 
 std::map<libzerocoin::CoinDenomination, int> mapMintMaturity;
@@ -1671,36 +2132,14 @@ CAmount CWallet::GetUnlockedCoins() const
 {
     if (fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-
-            if (pcoin->IsTrusted() && pcoin->GetDepthInMainChain() > 0)
-                nTotal += pcoin->GetUnlockedCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalanceTotal(BALANCE_UNLOCKED);
 }
 
 CAmount CWallet::GetLockedCoins() const
 {
     if (fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-
-            if (pcoin->IsTrusted() && pcoin->GetDepthInMainChain() > 0)
-                nTotal += pcoin->GetLockedCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalanceTotal(BALANCE_LOCKED);
 }
 
 // Get a Map pairing the Denominations with the amount of Zerocoin for each Denomination
@@ -1723,36 +2162,14 @@ CAmount CWallet::GetAnonymizableBalance() const
 {
     if (fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAnonymizableCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalanceTotal(BALANCE_ANONYMIZABLE);
 }
 
 CAmount CWallet::GetAnonymizedBalance() const
 {
     if (fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAnonymizedCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalanceTotal(BALANCE_ANONYMIZED);
 }
 
 // Note: calculated including unconfirmed,
@@ -1766,10 +2183,8 @@ double CWallet::GetAverageAnonymizedRounds() const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-
-            uint256 hash = (*it).first;
+        BOOST_FOREACH (const CWalletTx* pcoin, GetUnspentWalletTxes()) {
+            uint256 hash = pcoin->GetHash();
 
             for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
                 CTxIn vin = CTxIn(hash, i);
@@ -1798,10 +2213,8 @@ CAmount CWallet::GetNormalizedAnonymizedBalance() const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-
-            uint256 hash = (*it).first;
+        BOOST_FOREACH (const CWalletTx* pcoin, GetUnspentWalletTxes()) {
+            uint256 hash = pcoin->GetHash();
 
             for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
                 CTxIn vin = CTxIn(hash, i);
@@ -1822,183 +2235,145 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
 {
     if (fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-
-            nTotal += pcoin->GetDenominatedCredit(unconfirmed);
-        }
-    }
-
-    return nTotal;
+    return GetBalanceTotal(unconfirmed ? BALANCE_DENOMINATED_UNCONFIRMED : BALANCE_DENOMINATED);
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    return GetBalanceTotal(BALANCE_UNCONFIRMED);
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetBalanceTotal(BALANCE_IMMATURE);
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalanceTotal(BALANCE_WATCH_AVAILABLE);
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalanceTotal(BALANCE_WATCH_UNCONFIRMED);
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalanceTotal(BALANCE_WATCH_IMMATURE);
 }
 
 CAmount CWallet::GetLockedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted() && pcoin->GetDepthInMainChain() > 0)
-                nTotal += pcoin->GetLockedWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalanceTotal(BALANCE_WATCH_LOCKED);
 }
 
 /**
  * populate vCoins with vector of available COutputs.
  */
-void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl* coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseIX, int nWatchonlyConfig) const
+void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl* coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseIX, int nWatchonlyConfig, const COutPoint* pOutpointAfter, unsigned int nMaxCoins) const
 {
     vCoins.clear();
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+        SyncUnspentIndex();
+
+        // Candidates are ordered by txid, so the per-transaction checks run
+        // once for each run of outputs from the same transaction.
+        map<uint256, CWalletTx>::const_iterator it = mapWallet.end();
+        bool fSkipTx = true;
+        int nDepth = 0;
+        const std::set<COutPoint>& setCoins = GetUnspentCoins(nCoinType);
+        std::set<COutPoint>::const_iterator itCoin = pOutpointAfter ? setCoins.upper_bound(*pOutpointAfter) : setCoins.begin();
+        for (; itCoin != setCoins.end(); ++itCoin) {
+            const COutPoint& outpoint = *itCoin;
+            if (it == mapWallet.end() || it->first != outpoint.hash) {
+                it = mapWallet.find(outpoint.hash);
+                if (it == mapWallet.end())
+                    continue;
+                const CWalletTx* pcoin = &(*it).second;
+                fSkipTx = true;
 
-            if (!CheckFinalTx(*pcoin))
-                continue;
+                if (!CheckFinalTx(*pcoin))
+                    continue;
 
-            if (fOnlyConfirmed && !pcoin->IsTrusted())
-                continue;
+                if (fOnlyConfirmed && !pcoin->IsTrusted())
+                    continue;
 
-            if ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0)
-                continue;
+                if ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0)
+                    continue;
 
-            int nDepth = pcoin->GetDepthInMainChain(false);
-            // do not use IX for inputs that have less then 6 blockchain confirmations
-            if (fUseIX && nDepth < 6)
-                continue;
+                nDepth = pcoin->GetDepthInMainChain(false);
+                // do not use IX for inputs that have less then 6 blockchain confirmations
+                if (fUseIX && nDepth < 6)
+                    continue;
 
-            // We should not consider coins which aren't at least in our mempool
-            // It's possible for these to be conflicted via ancestors which we may never be able to detect
-            if (nDepth == 0 && !pcoin->InMempool())
-                continue;
+                // We should not consider coins which aren't at least in our mempool
+                // It's possible for these to be conflicted via ancestors which we may never be able to detect
+                if (nDepth == 0 && !pcoin->InMempool())
+                    continue;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                bool found = false;
-                if (nCoinType == ONLY_DENOMINATED) {
-                    found = IsDenominatedAmount(pcoin->vout[i].nValue);
-                } else if (nCoinType == ONLY_NOT10000IFMN) {
-                    found = !(fMasterNode && (pcoin->vout[i].nValue == GetMNCollateral(chainActive.Height()) * COIN || pcoin->vout[i].nValue == GetMNCollateralOld(chainActive.Height()) * COIN));
-                } else if (nCoinType == ONLY_NONDENOMINATED_NOT10000IFMN) {
-                    if (IsCollateralAmount(pcoin->vout[i].nValue)) continue; // do not use collateral amounts
-                    found = !IsDenominatedAmount(pcoin->vout[i].nValue);
-                    if (found && fMasterNode) found = (pcoin->vout[i].nValue != GetMNCollateral(chainActive.Height()) * COIN || pcoin->vout[i].nValue != GetMNCollateralOld(chainActive.Height()) * COIN); // do not use Hot MN funds
-                } else if (nCoinType == ONLY_10000) {
-                    found = (pcoin->vout[i].nValue == GetMNCollateral(chainActive.Height()) * COIN || pcoin->vout[i].nValue == GetMNCollateralOld(chainActive.Height()) * COIN);
-                } else {
-                    found = true;
-                }
-                if (!found) continue;
+                fSkipTx = false;
+            }
+            if (fSkipTx)
+                continue;
 
-                if (nCoinType == STAKABLE_COINS) {
-                    if (pcoin->vout[i].IsZerocoinMint())
-                        continue;
-                }
+            const uint256& wtxid = it->first;
+            const CWalletTx* pcoin = &(*it).second;
+            unsigned int i = outpoint.n;
+
+            bool found = false;
+            if (nCoinType == ONLY_DENOMINATED) {
+                found = IsDenominatedAmount(pcoin->vout[i].nValue);
+            } else if (nCoinType == ONLY_NOT10000IFMN) {
+                found = !(fMasterNode && (pcoin->vout[i].nValue == GetMNCollateral(chainActive.Height()) * COIN || pcoin->vout[i].nValue == GetMNCollateralOld(chainActive.Height()) * COIN));
+            } else if (nCoinType == ONLY_NONDENOMINATED_NOT10000IFMN) {
+                if (IsCollateralAmount(pcoin->vout[i].nValue)) continue; // do not use collateral amounts
+                found = !IsDenominatedAmount(pcoin->vout[i].nValue);
+                if (found && fMasterNode) found = (pcoin->vout[i].nValue != GetMNCollateral(chainActive.Height()) * COIN || pcoin->vout[i].nValue != GetMNCollateralOld(chainActive.Height()) * COIN); // do not use Hot MN funds
+            } else if (nCoinType == ONLY_10000) {
+                found = (pcoin->vout[i].nValue == GetMNCollateral(chainActive.Height()) * COIN || pcoin->vout[i].nValue == GetMNCollateralOld(chainActive.Height()) * COIN);
+            } else if (nCoinType == ONLY_COLLATERAL) {
+                found = IsCollateralAmount(pcoin->vout[i].nValue);
+            } else {
+                found = true;
+            }
+            if (!found) continue;
 
-                isminetype mine = IsMine(pcoin->vout[i]);
-                if (IsSpent(wtxid, i))
-                    continue;
-                if (mine == ISMINE_NO)
+            if (nCoinType == STAKABLE_COINS) {
+                if (pcoin->vout[i].IsZerocoinMint())
                     continue;
+            }
 
-                if ((mine == ISMINE_MULTISIG || mine == ISMINE_SPENDABLE) && nWatchonlyConfig == 2)
-                    continue;
+            isminetype mine = IsMine(pcoin->vout[i]);
+            if (IsSpent(wtxid, i))
+                continue;
+            if (mine == ISMINE_NO)
+                continue;
 
-                if (mine == ISMINE_WATCH_ONLY && nWatchonlyConfig == 1)
-                    continue;
+            if ((mine == ISMINE_MULTISIG || mine == ISMINE_SPENDABLE) && nWatchonlyConfig == 2)
+                continue;
 
-                if (IsLockedCoin((*it).first, i) && nCoinType != ONLY_10000)
-                    continue;
-                if (pcoin->vout[i].nValue <= 0 && !fIncludeZeroValue)
-                    continue;
-                if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected((*it).first, i))
-                    continue;
+            if (mine == ISMINE_WATCH_ONLY && nWatchonlyConfig == 1)
+                continue;
+
+            if (IsLockedCoin(wtxid, i) && nCoinType != ONLY_10000)
+                continue;
+            if (pcoin->vout[i].nValue <= 0 && !fIncludeZeroValue)
+                continue;
+            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(wtxid, i))
+                continue;
 
-                bool fIsSpendable = false;
-                if ((mine & ISMINE_SPENDABLE) != ISMINE_NO)
-                    fIsSpendable = true;
-                if ((mine & ISMINE_MULTISIG) != ISMINE_NO)
-                    fIsSpendable = true;
+            bool fIsSpendable = false;
+            if ((mine & ISMINE_SPENDABLE) != ISMINE_NO)
+                fIsSpendable = true;
+            if ((mine & ISMINE_MULTISIG) != ISMINE_NO)
+                fIsSpendable = true;
 
-                vCoins.emplace_back(COutput(pcoin, i, nDepth, fIsSpendable));
-            }
+            vCoins.emplace_back(COutput(pcoin, i, nDepth, fIsSpendable));
+            if (nMaxCoins && vCoins.size() >= nMaxCoins)
+                break;
         }
     }
 }
@@ -2513,7 +2888,7 @@ bool CWallet::SelectCoinsCollateral(std::vector<CTxIn>& setCoinsRet, CAmount& nV
     vector<COutput> vCoins;
 
     //LogPrintf(" selecting coins for collateral\n");
-    AvailableCoins(vCoins);
+    AvailableCoins(vCoins, true, NULL, false, ONLY_COLLATERAL);
 
     //LogPrintf("found coins %d\n", (int)vCoins.size());
 
@@ -2565,7 +2940,7 @@ int CWallet::CountInputsWithAmount(CAmount nInputAmount)
 bool CWallet::HasCollateralInputs(bool fOnlyConfirmed) const
 {
     vector<COutput> vCoins;
-    AvailableCoins(vCoins, fOnlyConfirmed);
+    AvailableCoins(vCoins, fOnlyConfirmed, NULL, false, ONLY_COLLATERAL);
 
     int nFound = 0;
     BOOST_FOREACH (const COutput& out, vCoins)
@@ -3067,7 +3442,9 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
                 return error("CreateCoinStake : failed to sign coinstake");
         }
     } else {
-        //Update the mint database with tx hash and height
+        //Update the mint database with tx hash and height, in one commit
+        LOCK(cs_wallet);
+        CDBBatch batch(strWalletFile);
         for (const CTxOut& out : txNew.vout) {
             if (!out.IsZerocoinMint())
                 continue;
@@ -3087,6 +3464,8 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
             if (!zuserxTracker->UpdateState(meta))
                 return error("%s: failed to update metadata in tracker", __func__);
         }
+        if (!batch.Commit())
+            return error("%s: failed to write the mint metadata", __func__);
     }
 
     // Successfully generated coinstake
@@ -3102,10 +3481,8 @@ bool CWallet::CommitTransaction(CWalletTx& wtxNew, CReserveKey& reservekey, std:
         LOCK2(cs_main, cs_wallet);
         LogPrintf("CommitTransaction:\n%s", wtxNew.ToString());
         {
-            // This is only to keep the database open to defeat the auto-flush for the
-            // duration of this scope.  This is the only place where this optimization
-            // maybe makes sense; please don't do it anywhere else.
-            CWalletDB* pwalletdb = fFileBacked ? new CWalletDB(strWalletFile, "r") : NULL;
+            // The key pool and wallet writes of the transaction go in one commit
+            CDBBatch batch(strWalletFile);
 
             // Take key pair from key pool so it won't be used again
             reservekey.KeepKey();
@@ -3128,8 +3505,9 @@ bool CWallet::CommitTransaction(CWalletTx& wtxNew, CReserveKey& reservekey, std:
                 }
             }
 
-            if (fFileBacked)
-                delete pwalletdb;
+            // Don't broadcast a transaction the wallet failed to record
+            if (!batch.Commit())
+                return error("CommitTransaction() : Error: failed to write the transaction to the wallet");
         }
 
         // Track how many getdata requests our transaction gets
@@ -3757,6 +4135,7 @@ bool CWallet::UpdatedTransaction(const uint256& hashTx)
         // Only notify UI if this transaction is in this wallet
         map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
         if (mi != mapWallet.end()) {
+            setBalanceDirty.insert(hashTx);
             NotifyTransactionChanged(this, hashTx, CT_UPDATED);
             return true;
         }
@@ -3768,17 +4147,21 @@ void CWallet::LockCoin(COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.insert(output);
+    setBalanceDirty.insert(output.hash);
 }
 
 void CWallet::UnlockCoin(COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.erase(output);
+    setBalanceDirty.insert(output.hash);
 }
 
 void CWallet::UnlockAllCoins()
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
+    BOOST_FOREACH (const COutPoint& outpoint, setLockedCoins)
+        setBalanceDirty.insert(outpoint.hash);
     setLockedCoins.clear();
 }
 
@@ -5153,34 +5536,42 @@ string CWallet::MintZerocoin(CAmount nValue, CWalletTx& wtxNew, vector<CDetermin
         return strError;
     }
 
-    string strError;
-    CMutableTransaction txNew;
-    if (!CreateZerocoinMintTransaction(nValue, txNew, vDMints, &reservekey, nFeeRequired, strError, coinControl)) {
-        if (nValue + nFeeRequired > GetBalance())
-            return strprintf(_("Error: This transaction requires a transaction fee of at least %s because of its amount, complexity, or use of recently received funds!"), FormatMoney(nFeeRequired).c_str());
-        return strError;
-    }
+    {
+        // The mint counter, key pool, transaction and mint writes go in one
+        // commit. It ends before the backup, which needs the wallet file idle
+        LOCK2(cs_main, cs_wallet);
+        CDBBatch batch(strWalletFile);
 
-    wtxNew = CWalletTx(this, txNew);
-    wtxNew.fFromMe = true;
-    wtxNew.fTimeReceivedIsTxTime = true;
+        string strError;
+        CMutableTransaction txNew;
+        if (!CreateZerocoinMintTransaction(nValue, txNew, vDMints, &reservekey, nFeeRequired, strError, coinControl)) {
+            if (nValue + nFeeRequired > GetBalance())
+                return strprintf(_("Error: This transaction requires a transaction fee of at least %s because of its amount, complexity, or use of recently received funds!"), FormatMoney(nFeeRequired).c_str());
+            return strError;
+        }
 
-    // Limit size
-    unsigned int nBytes = ::GetSerializeSize(txNew, SER_NETWORK, PROTOCOL_VERSION);
-    if (nBytes >= MAX_ZEROCOIN_TX_SIZE) {
-        return _("Error: The transaction is larger than the maximum allowed transaction size!");
-    }
+        wtxNew = CWalletTx(this, txNew);
+        wtxNew.fFromMe = true;
+        wtxNew.fTimeReceivedIsTxTime = true;
 
-    //commit the transaction to the network
-    if (!CommitTransaction(wtxNew, reservekey)) {
-        return _("Error: The transaction was rejected! This might happen if some of the coins in your wallet were already spent, such as if you used a copy of wallet.dat and coins were spent in the copy but not marked as spent here.");
-    } else {
-        //update mints with full transaction hash and then database them
-        CWalletDB walletdb(pwalletMain->strWalletFile);
-        for (CDeterministicMint dMint : vDMints) {
-            dMint.SetTxHash(wtxNew.GetHash());
-            zuserxTracker->Add(dMint, true);
+        // Limit size
+        unsigned int nBytes = ::GetSerializeSize(txNew, SER_NETWORK, PROTOCOL_VERSION);
+        if (nBytes >= MAX_ZEROCOIN_TX_SIZE) {
+            return _("Error: The transaction is larger than the maximum allowed transaction size!");
+        }
+
+        //commit the transaction to the network
+        if (!CommitTransaction(wtxNew, reservekey)) {
+            return _("Error: The transaction was rejected! This might happen if some of the coins in your wallet were already spent, such as if you used a copy of wallet.dat and coins were spent in the copy but not marked as spent here.");
+        } else {
+            //update mints with full transaction hash and then database them
+            for (CDeterministicMint dMint : vDMints) {
+                dMint.SetTxHash(wtxNew.GetHash());
+                zuserxTracker->Add(dMint, true);
+            }
         }
+        if (!batch.Commit())
+            return _("Error: Failed to write the mints to the wallet");
     }
 
     //Create a backup of the wallet
@@ -5242,6 +5633,10 @@ bool CWallet::SpendZerocoin(CAmount nAmount, int nSecurityLevel, CWalletTx& wtxN
         return false;
     }
 
+    // The mint state writes go in one commit
+    LOCK2(cs_main, cs_wallet);
+    CDBBatch batch(strWalletFile);
+
     //Set spent mints as used
     uint256 txidSpend = wtxNew.GetHash();
     for (CZerocoinMint mint : vMintsSelected) {
@@ -5261,6 +5656,11 @@ bool CWallet::SpendZerocoin(CAmount nAmount, int nSecurityLevel, CWalletTx& wtxN
         zuserxTracker->Add(dMint, true);
     }
 
+    if (!batch.Commit()) {
+        receipt.SetStatus("Error: Failed to write the spent mints to the wallet", ZUSERX_COMMIT_FAILED);
+        return false;
+    }
+
     receipt.SetStatus("Spend Successful", ZUSERX_SPEND_OKAY);  // When we reach this point spending zUSERX was successful
 
     return true;
@@ -58,6 +58,12 @@ static const CAmount nHighTransactionMaxFeeWarning = 100 * nHighTransactionFeeWa
 static const unsigned int MAX_FREE_TRANSACTION_CREATE_SIZE = 1000;
 //! -custombackupthreshold default
 static const int DEFAULT_CUSTOMBACKUPTHRESHOLD = 1;
+//! -rescanthreads default (0 = one per core)
+static const int DEFAULT_RESCAN_THREADS = 0;
+//! Maximum number of rescan worker threads
+static const int MAX_RESCAN_THREADS = 16;
+//! Number of blocks read per rescan batch, between releases of cs_main
+static const unsigned int RESCAN_BATCH_SIZE = 500;
 
 // Zerocoin denomination which creates exactly one of each denominations:
 // 6666 = 1*5000 + 1*1000 + 1*500 + 1*100 + 1*50 + 1*10 + 1*5 + 1
@@ -86,7 +92,8 @@ enum AvailableCoinsType {
     ONLY_NOT10000IFMN = 3,
     ONLY_NONDENOMINATED_NOT10000IFMN = 4, // ONLY_NONDENOMINATED and not 10000 USERX at the same time
     ONLY_10000 = 5,                        // find masternode outputs including locked ones (use with caution)
-    STAKABLE_COINS = 6                          // UTXO's that are valid for staking
+    STAKABLE_COINS = 6,                         // UTXO's that are valid for staking
+    ONLY_COLLATERAL = 7                         // obfuscation collateral amounts
 };
 
 // Possible states for zUSERX send
@@ -191,6 +198,68 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    /**
+     * Owned outputs that are not spent by a transaction in the active chain,
+     * bucketed by the coin types AvailableCoins() filters on. Outputs spent
+     * only by unconfirmed transactions stay indexed and are filtered by
+     * IsSpent(). Transactions passed to AddToWallet() are queued and folded
+     * in before the next lookup, under cs_main.
+     */
+    enum UnspentBucket {
+        UNSPENT_STAKABLE = 0,
+        UNSPENT_DENOMINATED,
+        UNSPENT_COLLATERAL,
+        UNSPENT_MNCOLLATERAL,
+        UNSPENT_BUCKET_COUNT
+    };
+    mutable std::set<COutPoint> setUnspentCoins;
+    mutable std::set<COutPoint> setUnspentBucket[UNSPENT_BUCKET_COUNT];
+    mutable std::set<uint256> setUnspentPending;
+    mutable bool fUnspentIndexStale;
+    bool IsSpentInChain(const COutPoint& outpoint) const;
+    void UpdateUnspentIndex(const COutPoint& outpoint) const;
+    void SyncUnspentIndex() const;
+    const std::set<COutPoint>& GetUnspentCoins(AvailableCoinsType nCoinType) const;
+    std::vector<const CWalletTx*> GetUnspentWalletTxes() const;
+
+    /**
+     * Running balance totals over the transactions in the unspent index.
+     * Each transaction's contribution is kept, and a transaction queued as
+     * changed (added, spent from, coin lock) moves the totals by the change
+     * in its contribution. Unsettled transactions (unconfirmed, immature or
+     * not final) are also re-read when the tip or mempool moves; a reorg or
+     * an IsMine change recomputes every contribution.
+     */
+    enum BalanceType {
+        BALANCE_AVAILABLE = 0,
+        BALANCE_UNCONFIRMED,
+        BALANCE_IMMATURE,
+        BALANCE_LOCKED,
+        BALANCE_UNLOCKED,
+        BALANCE_ANONYMIZABLE,
+        BALANCE_ANONYMIZED,
+        BALANCE_DENOMINATED,
+        BALANCE_DENOMINATED_UNCONFIRMED,
+        BALANCE_WATCH_AVAILABLE,
+        BALANCE_WATCH_UNCONFIRMED,
+        BALANCE_WATCH_IMMATURE,
+        BALANCE_WATCH_LOCKED,
+        BALANCE_TYPE_COUNT
+    };
+    mutable CAmount nBalanceTotal[BALANCE_TYPE_COUNT];
+    mutable std::map<uint256, std::vector<CAmount> > mapBalanceContrib;
+    mutable std::set<uint256> setBalanceDirty;
+    mutable std::set<uint256> setBalanceUnsettled;
+    mutable bool fBalanceStale;
+    mutable const CBlockIndex* pindexBalance;
+    mutable unsigned int nBalanceMempoolUpdates;
+    mutable std::pair<int64_t, int64_t> pairBalanceMNCollateral;
+    bool GetBalanceContribution(const CWalletTx& wtx, std::vector<CAmount>& vBalance) const;
+    void UpdateBalance(const uint256& hash) const;
+    void SyncBalances() const;
+    CAmount GetBalanceTotal(BalanceType nType) const;
+    void InvalidateBalanceCache() const { fBalanceStale = true; }
+
 public:
     bool MintableCoins();
     bool SelectStakeCoins(std::list<std::unique_ptr<CStakeInput> >& listInputs, CAmount nTargetAmount);
@@ -199,6 +268,8 @@ public:
     bool SelectCoinsDarkDenominated(CAmount nTargetValue, std::vector<CTxIn>& setCoinsRet, CAmount& nValueRet) const;
     bool HasCollateralInputs(bool fOnlyConfirmed = true) const;
     bool IsCollateralAmount(CAmount nInputAmount) const;
+    //! Whether an amount is masternode collateral at any height
+    static bool IsMNCollateralTier(CAmount nValue);
     int CountInputsWithAmount(CAmount nInputAmount);
 
     bool SelectCoinsCollateral(std::vector<CTxIn>& setCoinsRet, CAmount& nValueRet) const;
@@ -302,6 +373,10 @@ public:
         nTimeFirstKey = 0;
         fWalletUnlockAnonymizeOnly = false;
         fBackupMints = false;
+        fUnspentIndexStale = true;
+        fBalanceStale = true;
+        pindexBalance = NULL;
+        nBalanceMempoolUpdates = 0;
 
         // Stake Settings
         nHashDrift = 45;
@@ -364,6 +439,11 @@ public:
     typedef std::multimap<int64_t, TxPair > TxItems;
     TxItems wtxOrdered;
 
+    //! Wallet txids by the height of their block in the active chain, INT_MAX while not in it.
+    //! Kept in memory only: AddToWallet rebuilds it from mapWallet as the wallet loads
+    std::set<std::pair<int, uint256> > setWalletTxByHeight;
+    std::map<uint256, int> mapWalletTxHeight;
+
     int64_t nOrderPosNext;
     std::map<uint256, int> mapRequestCount;
 
@@ -384,7 +464,8 @@ public:
         return nWalletMaxVersion >= wf;
     }
 
-    void AvailableCoins(std::vector<COutput>& vCoins, bool fOnlyConfirmed = true, const CCoinControl* coinControl = NULL, bool fIncludeZeroValue = false, AvailableCoinsType nCoinType = ALL_COINS, bool fUseIX = false, int nWatchonlyConfig = 1) const;
+    //! Outputs come in outpoint order; pOutpointAfter and nMaxCoins page through them
+    void AvailableCoins(std::vector<COutput>& vCoins, bool fOnlyConfirmed = true, const CCoinControl* coinControl = NULL, bool fIncludeZeroValue = false, AvailableCoinsType nCoinType = ALL_COINS, bool fUseIX = false, int nWatchonlyConfig = 1, const COutPoint* pOutpointAfter = NULL, unsigned int nMaxCoins = 0) const;
     std::map<CBitcoinAddress, std::vector<COutput> > AvailableCoinsByAddress(bool fConfirmed = true, CAmount maxCoinValue = 0);
     bool SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, std::vector<COutput> vCoins, std::set<std::pair<const CWalletTx*, unsigned int> >& setCoinsRet, CAmount& nValueRet) const;
 
@@ -461,6 +542,7 @@ public:
      * @return next transaction order id
      */
     int64_t IncOrderPosNext(CWalletDB* pwalletdb = NULL);
+    void IndexWalletTxHeight(const CWalletTx& wtx);
 
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet = false);
@@ -468,6 +550,7 @@ public:
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
     void EraseFromWallet(const uint256& hash);
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+    void GetBlockFilterElements(std::vector<uint64_t>& vHashes) const;
     void ReacceptWalletTransactions();
     void ResendWalletTransactions();
     CAmount GetBalance() const;
@@ -28,6 +28,9 @@ using namespace std;
 
 static uint64_t nAccountingEntryNumber = 0;
 
+//! Longest a busy wallet goes without a checkpoint, in seconds
+static const int64_t WALLET_CHECKPOINT_MAX_INTERVAL = 60;
+
 //
 // CWalletDB
 //
@@ -298,7 +301,7 @@ void CWalletDB::ListAccountCreditDebit(const string& strAccount, list<CAccountin
 {
     bool fAllAccounts = (strAccount == "*");
 
-    Dbc* pcursor = GetCursor();
+    CDBCursor* pcursor = GetCursor();
     if (!pcursor)
         throw runtime_error("CWalletDB::ListAccountCreditDebit() : cannot create DB cursor");
     unsigned int fFlags = DB_SET_RANGE;
@@ -313,7 +316,7 @@ void CWalletDB::ListAccountCreditDebit(const string& strAccount, list<CAccountin
         if (ret == DB_NOTFOUND)
             break;
         else if (ret != 0) {
-            pcursor->close();
+            delete pcursor;
             throw runtime_error("CWalletDB::ListAccountCreditDebit() : error scanning DB");
         }
 
@@ -332,7 +335,7 @@ void CWalletDB::ListAccountCreditDebit(const string& strAccount, list<CAccountin
         entries.push_back(acentry);
     }
 
-    pcursor->close();
+    delete pcursor;
 }
 
 DBErrors CWalletDB::ReorderTransactions(CWallet* pwallet)
@@ -688,8 +691,9 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             pwallet->LoadMinVersion(nMinVersion);
         }
 
-        // Get cursor
-        Dbc* pcursor = GetCursor();
+        // Get cursor. No record depends on the ones before it, so a log is
+        // read in the order it sits on disk
+        CDBCursor* pcursor = GetCursor(true);
         if (!pcursor) {
             LogPrintf("Error getting wallet database cursor\n");
             return DB_CORRUPT;
@@ -704,6 +708,7 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
                 break;
             else if (ret != 0) {
                 LogPrintf("Error reading next record from wallet database\n");
+                delete pcursor;
                 return DB_CORRUPT;
             }
 
@@ -725,7 +730,7 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             if (!strErr.empty())
                 LogPrintf("%s\n", strErr);
         }
-        pcursor->close();
+        delete pcursor;
     } catch (boost::thread_interrupted) {
         throw;
     } catch (...) {
@@ -787,7 +792,7 @@ DBErrors CWalletDB::FindWalletTx(CWallet* pwallet, vector<uint256>& vTxHash, vec
         }
 
         // Get cursor
-        Dbc* pcursor = GetCursor();
+        CDBCursor* pcursor = GetCursor();
         if (!pcursor) {
             LogPrintf("Error getting wallet database cursor\n");
             return DB_CORRUPT;
@@ -818,7 +823,7 @@ DBErrors CWalletDB::FindWalletTx(CWallet* pwallet, vector<uint256>& vTxHash, vec
                 vWtx.push_back(wtx);
             }
         }
-        pcursor->close();
+        delete pcursor;
     } catch (boost::thread_interrupted) {
         throw;
     } catch (...) {
@@ -848,7 +853,7 @@ DBErrors CWalletDB::ZapWalletTx(CWallet* pwallet, vector<CWalletTx>& vWtx)
     return DB_LOAD_OK;
 }
 
-void ThreadFlushWalletDB(const string& strFile)
+void ThreadFlushWalletDB()
 {
     // Make this thread recognisable as the wallet flushing thread
     RenameThread("userx-wallet");
@@ -862,7 +867,9 @@ void ThreadFlushWalletDB(const string& strFile)
 
     unsigned int nLastSeen = nWalletDBUpdated;
     unsigned int nLastFlushed = nWalletDBUpdated;
+    unsigned int nLastCheckpointed = nWalletDBUpdated;
     int64_t nLastWalletUpdate = GetTime();
+    int64_t nLastCheckpointTime = GetTime();
     while (true) {
         MilliSleep(500);
 
@@ -871,35 +878,65 @@ void ThreadFlushWalletDB(const string& strFile)
             nLastWalletUpdate = GetTime();
         }
 
-        if (nLastFlushed != nWalletDBUpdated && GetTime() - nLastWalletUpdate >= 2) {
+        // Wait for the wallet to go idle, but not so long that a wallet kept
+        // busy by staking or a rescan never writes its changes through
+        bool fOverdue = nLastCheckpointed != nLastSeen && GetTime() - nLastCheckpointTime >= WALLET_CHECKPOINT_MAX_INTERVAL;
+        if (nLastFlushed == nLastSeen || (GetTime() - nLastWalletUpdate < 2 && !fOverdue))
+            continue;
+
+        // Write the committed changes through to the wallet files first, without
+        // cs_db, so that wallets can still be opened while the disk is busy
+        if (nLastCheckpointed != nLastSeen) {
+            nLastCheckpointed = nLastSeen;
+            nLastCheckpointTime = GetTime();
+            int64_t nStart = GetTimeMillis();
+            bitdb.dbenv.txn_checkpoint(0, 0, 0);
+            LogPrint("db", "Checkpointed wallet databases %dms\n", GetTimeMillis() - nStart);
+        }
+
+        // Then detach each wallet file that nobody has open, so it's self contained
+        bool fInUse = false;
+        vector<CLogDB*> vLogs;
+        {
             TRY_LOCK(bitdb.cs_db, lockDb);
-            if (lockDb) {
-                // Don't do this if any databases are in use
-                int nRefCount = 0;
-                map<string, int>::iterator mi = bitdb.mapFileUseCount.begin();
-                while (mi != bitdb.mapFileUseCount.end()) {
-                    nRefCount += (*mi).second;
+            if (!lockDb)
+                continue;
+            boost::this_thread::interruption_point();
+            map<string, int>::iterator mi = bitdb.mapFileUseCount.begin();
+            while (mi != bitdb.mapFileUseCount.end()) {
+                // Logs are written through in place, open or not
+                map<string, CLogDB*>::iterator itLog = bitdb.mapLogDb.find((*mi).first);
+                if (itLog != bitdb.mapLogDb.end()) {
+                    vLogs.push_back(itLog->second);
                     mi++;
+                    continue;
                 }
+                if ((*mi).second != 0) {
+                    fInUse = true;
+                    mi++;
+                    continue;
+                }
+                string strFile = (*mi).first;
+                LogPrint("db", "Flushing %s\n", strFile);
+                int64_t nStart = GetTimeMillis();
 
-                if (nRefCount == 0) {
-                    boost::this_thread::interruption_point();
-                    map<string, int>::iterator mi = bitdb.mapFileUseCount.find(strFile);
-                    if (mi != bitdb.mapFileUseCount.end()) {
-                        LogPrint("db", "Flushing wallet.dat\n");
-                        nLastFlushed = nWalletDBUpdated;
-                        int64_t nStart = GetTimeMillis();
-
-                        // Flush wallet.dat so it's self contained
-                        bitdb.CloseDb(strFile);
-                        bitdb.CheckpointLSN(strFile);
+                bitdb.CloseDb(strFile);
+                bitdb.CheckpointLSN(strFile);
 
-                        bitdb.mapFileUseCount.erase(mi++);
-                        LogPrint("db", "Flushed wallet.dat %dms\n", GetTimeMillis() - nStart);
-                    }
-                }
+                bitdb.mapFileUseCount.erase(mi++);
+                LogPrint("db", "Flushed %s %dms\n", strFile, GetTimeMillis() - nStart);
             }
         }
+
+        // Logs stay open until shutdown, which stops this thread first
+        for (unsigned int i = 0; i < vLogs.size(); i++) {
+            int64_t nStart = GetTimeMillis();
+            if (!vLogs[i]->Flush())
+                fInUse = true;
+            LogPrint("db", "Flushed wallet log %dms\n", GetTimeMillis() - nStart);
+        }
+        if (!fInUse)
+            nLastFlushed = nLastSeen;
     }
 }
 
@@ -1018,6 +1055,24 @@ bool AttemptBackupWallet(const CWallet& wallet, const filesystem::path& pathSrc,
 {
     bool retStatus;
     string strMessage;
+
+    CLogDB* plogdb = NULL;
+    if (bitdb.UsesLog()) {
+        LOCK(bitdb.cs_db);
+        plogdb = bitdb.GetLog(wallet.strWalletFile, false);
+    }
+    if (plogdb) {
+        // An earlier backup of the same log only needs what was appended since
+        retStatus = plogdb->Backup(pathDest);
+        if (retStatus)
+            strMessage = strprintf("copied %s log to %s\n", wallet.strWalletFile, pathDest.string());
+        else
+            strMessage = strprintf("failed to copy %s log to %s\n", wallet.strWalletFile, pathDest.string());
+        LogPrint(nullptr, strMessage.data());
+        NotifyBacked(wallet, retStatus, strMessage);
+        return retStatus;
+    }
+
     try {
 #if BOOST_VERSION >= 105800 /* BOOST_LIB_VERSION 1_58 */
         filesystem::copy_file(pathSrc.c_str(), pathDest, filesystem::copy_option::overwrite_if_exists);
@@ -1053,20 +1108,26 @@ bool CWalletDB::Recover(CDBEnv& dbenv, std::string filename, bool fOnlyKeys)
     // Rewrite salvaged data to wallet.dat
     // Set -rescan so any missing transactions will be
     // found.
+    // With -walletlog, the same goes for the log of wallet.dat.
     int64_t now = GetTime();
     std::string newFilename = strprintf("wallet.%d.bak", now);
-
-    int result = dbenv.dbenv.dbrename(NULL, filename.c_str(), NULL,
-        newFilename.c_str(), DB_AUTO_COMMIT);
-    if (result == 0)
-        LogPrintf("Renamed %s to %s\n", filename, newFilename);
-    else {
-        LogPrintf("Failed to rename %s to %s\n", filename, newFilename);
-        return false;
-    }
+    bool fLog = dbenv.UsesLog() && boost::filesystem::exists(GetDataDir() / (filename + ".log"));
 
     std::vector<CDBEnv::KeyValPair> salvagedData;
-    bool allOK = dbenv.Salvage(newFilename, true, salvagedData);
+    bool allOK;
+    if (fLog) {
+        allOK = dbenv.SalvageLog(filename, newFilename, salvagedData);
+    } else {
+        int result = dbenv.dbenv.dbrename(NULL, filename.c_str(), NULL,
+            newFilename.c_str(), DB_AUTO_COMMIT);
+        if (result == 0)
+            LogPrintf("Renamed %s to %s\n", filename, newFilename);
+        else {
+            LogPrintf("Failed to rename %s to %s\n", filename, newFilename);
+            return false;
+        }
+        allOK = dbenv.Salvage(newFilename, true, salvagedData);
+    }
     if (salvagedData.empty()) {
         LogPrintf("Salvage(aggressive) found no records in %s.\n", newFilename);
         return false;
@@ -1074,21 +1135,33 @@ bool CWalletDB::Recover(CDBEnv& dbenv, std::string filename, bool fOnlyKeys)
     LogPrintf("Salvage(aggressive) found %u records\n", salvagedData.size());
 
     bool fSuccess = allOK;
-    boost::scoped_ptr<Db> pdbCopy(new Db(&dbenv.dbenv, 0));
-    int ret = pdbCopy->open(NULL, // Txn pointer
-        filename.c_str(),         // Filename
-        "main",                   // Logical db name
-        DB_BTREE,                 // Database type
-        DB_CREATE,                // Flags
-        0);
-    if (ret > 0) {
-        LogPrintf("Cannot create database file %s\n", filename);
-        return false;
+    boost::scoped_ptr<Db> pdbCopy;
+    CLogDB* plogdb = NULL;
+    if (fLog) {
+        LOCK(dbenv.cs_db);
+        plogdb = dbenv.GetLog(filename, false);
+        if (!plogdb) {
+            LogPrintf("Cannot open log of %s\n", filename);
+            return false;
+        }
+    } else {
+        pdbCopy.reset(new Db(&dbenv.dbenv, 0));
+        int ret = pdbCopy->open(NULL, // Txn pointer
+            filename.c_str(),         // Filename
+            "main",                   // Logical db name
+            DB_BTREE,                 // Database type
+            DB_CREATE,                // Flags
+            0);
+        if (ret > 0) {
+            LogPrintf("Cannot create database file %s\n", filename);
+            return false;
+        }
     }
     CWallet dummyWallet;
     CWalletScanState wss;
 
-    DbTxn* ptxn = dbenv.TxnBegin();
+    DbTxn* ptxn = fLog ? NULL : dbenv.TxnBegin();
+    CLogDBTxn logtxn;
     BOOST_FOREACH (CDBEnv::KeyValPair& row, salvagedData) {
         if (fOnlyKeys) {
             CDataStream ssKey(row.first, SER_DISK, CLIENT_VERSION);
@@ -1103,14 +1176,23 @@ bool CWalletDB::Recover(CDBEnv& dbenv, std::string filename, bool fOnlyKeys)
                 continue;
             }
         }
+        if (fLog) {
+            logtxn.Write(std::string(row.first.begin(), row.first.end()), CSerializeData(row.second.begin(), row.second.end()));
+            continue;
+        }
         Dbt datKey(&row.first[0], row.first.size());
         Dbt datValue(&row.second[0], row.second.size());
         int ret2 = pdbCopy->put(ptxn, &datKey, &datValue, DB_NOOVERWRITE);
         if (ret2 > 0)
             fSuccess = false;
     }
-    ptxn->commit(0);
-    pdbCopy->close(0);
+    if (fLog) {
+        if (!plogdb->Commit(logtxn))
+            fSuccess = false;
+    } else {
+        ptxn->commit(0);
+        pdbCopy->close(0);
+    }
 
     return fSuccess;
 }
@@ -1323,7 +1405,7 @@ bool CWalletDB::WriteMintPoolPair(const uint256& hashMasterSeed, const uint256&
 std::map<uint256, std::vector<pair<uint256, uint32_t> > > CWalletDB::MapMintPool()
 {
     std::map<uint256, std::vector<pair<uint256, uint32_t> > > mapPool;
-    Dbc* pcursor = GetCursor();
+    CDBCursor* pcursor = GetCursor();
     if (!pcursor)
         throw runtime_error(std::string(__func__)+" : cannot create DB cursor");
     unsigned int fFlags = DB_SET_RANGE;
@@ -1340,7 +1422,7 @@ std::map<uint256, std::vector<pair<uint256, uint32_t> > > CWalletDB::MapMintPool
             break;
         else if (ret != 0)
         {
-            pcursor->close();
+            delete pcursor;
             throw runtime_error(std::string(__func__)+" : error scanning DB");
         }
 
@@ -1371,7 +1453,7 @@ std::map<uint256, std::vector<pair<uint256, uint32_t> > > CWalletDB::MapMintPool
         }
     }
 
-    pcursor->close();
+    delete pcursor;
 
     return mapPool;
 }
@@ -1379,7 +1461,7 @@ std::map<uint256, std::vector<pair<uint256, uint32_t> > > CWalletDB::MapMintPool
 std::list<CDeterministicMint> CWalletDB::ListDeterministicMints()
 {
     std::list<CDeterministicMint> listMints;
-    Dbc* pcursor = GetCursor();
+    CDBCursor* pcursor = GetCursor();
     if (!pcursor)
         throw runtime_error(std::string(__func__)+" : cannot create DB cursor");
     unsigned int fFlags = DB_SET_RANGE;
@@ -1396,7 +1478,7 @@ std::list<CDeterministicMint> CWalletDB::ListDeterministicMints()
             break;
         else if (ret != 0)
         {
-            pcursor->close();
+            delete pcursor;
             throw runtime_error(std::string(__func__)+" : error scanning DB");
         }
 
@@ -1415,14 +1497,14 @@ std::list<CDeterministicMint> CWalletDB::ListDeterministicMints()
         listMints.emplace_back(mint);
     }
 
-    pcursor->close();
+    delete pcursor;
     return listMints;
 }
 
 std::list<CZerocoinMint> CWalletDB::ListMintedCoins()
 {
     std::list<CZerocoinMint> listPubCoin;
-    Dbc* pcursor = GetCursor();
+    CDBCursor* pcursor = GetCursor();
     if (!pcursor)
         throw runtime_error(std::string(__func__)+" : cannot create DB cursor");
     unsigned int fFlags = DB_SET_RANGE;
@@ -1441,7 +1523,7 @@ std::list<CZerocoinMint> CWalletDB::ListMintedCoins()
             break;
         else if (ret != 0)
         {
-            pcursor->close();
+            delete pcursor;
             throw runtime_error(std::string(__func__)+" : error scanning DB");
         }
 
@@ -1460,14 +1542,14 @@ std::list<CZerocoinMint> CWalletDB::ListMintedCoins()
         listPubCoin.emplace_back(mint);
     }
 
-    pcursor->close();
+    delete pcursor;
     return listPubCoin;
 }
 
 std::list<CZerocoinSpend> CWalletDB::ListSpentCoins()
 {
     std::list<CZerocoinSpend> listCoinSpend;
-    Dbc* pcursor = GetCursor();
+    CDBCursor* pcursor = GetCursor();
     if (!pcursor)
         throw runtime_error(std::string(__func__)+" : cannot create DB cursor");
     unsigned int fFlags = DB_SET_RANGE;
@@ -1484,7 +1566,7 @@ std::list<CZerocoinSpend> CWalletDB::ListSpentCoins()
             break;
         else if (ret != 0)
         {
-            pcursor->close();
+            delete pcursor;
             throw runtime_error(std::string(__func__)+" : error scanning DB");
         }
 
@@ -1503,7 +1585,7 @@ std::list<CZerocoinSpend> CWalletDB::ListSpentCoins()
         listCoinSpend.push_back(zerocoinSpendItem);
     }
 
-    pcursor->close();
+    delete pcursor;
     return listCoinSpend;
 }
 
@@ -1522,7 +1604,7 @@ std::list<CBigNum> CWalletDB::ListSpentCoinsSerial()
 std::list<CZerocoinMint> CWalletDB::ListArchivedZerocoins()
 {
     std::list<CZerocoinMint> listMints;
-    Dbc* pcursor = GetCursor();
+    CDBCursor* pcursor = GetCursor();
     if (!pcursor)
         throw runtime_error(std::string(__func__)+" : cannot create DB cursor");
     unsigned int fFlags = DB_SET_RANGE;
@@ -1539,7 +1621,7 @@ std::list<CZerocoinMint> CWalletDB::ListArchivedZerocoins()
             break;
         else if (ret != 0)
         {
-            pcursor->close();
+            delete pcursor;
             throw runtime_error(std::string(__func__)+" : error scanning DB");
         }
 
@@ -1558,14 +1640,14 @@ std::list<CZerocoinMint> CWalletDB::ListArchivedZerocoins()
         listMints.push_back(mint);
     }
 
-    pcursor->close();
+    delete pcursor;
     return listMints;
 }
 
 std::list<CDeterministicMint> CWalletDB::ListArchivedDeterministicMints()
 {
     std::list<CDeterministicMint> listMints;
-    Dbc* pcursor = GetCursor();
+    CDBCursor* pcursor = GetCursor();
     if (!pcursor)
         throw runtime_error(std::string(__func__)+" : cannot create DB cursor");
     unsigned int fFlags = DB_SET_RANGE;
@@ -1582,7 +1664,7 @@ std::list<CDeterministicMint> CWalletDB::ListArchivedDeterministicMints()
             break;
         else if (ret != 0)
         {
-            pcursor->close();
+            delete pcursor;
             throw runtime_error(std::string(__func__)+" : error scanning DB");
         }
 
@@ -1601,6 +1683,6 @@ std::list<CDeterministicMint> CWalletDB::ListArchivedDeterministicMints()
         listMints.emplace_back(dMint);
     }
 
-    pcursor->close();
+    delete pcursor;
     return listMints;
 }
@@ -10,8 +10,12 @@
 #include <map>
 
 class CBlockIndex;
+class CScript;
 class CZMQAbstractNotifier;
 
+//! Default for -zmqqueuesize, the most messages waiting for the publisher thread
+static const unsigned int DEFAULT_ZMQ_QUEUE_SIZE = 10000;
+
 class CZMQNotificationInterface : public CValidationInterface
 {
 public:
@@ -27,11 +31,13 @@ protected:
     void SyncTransaction(const CTransaction &tx, const CBlock *pblock);
     void UpdatedBlockTip(const CBlockIndex *pindex);
     void NotifyTransactionLock(const CTransaction &tx);
+    void UpdatedMasternodeWinner(int nBlockHeight, const CScript &payee);
 
 private:
     CZMQNotificationInterface();
 
     void *pcontext;
+    unsigned int nMaxQueue;
     std::list<CZMQAbstractNotifier*> notifiers;
 };
 
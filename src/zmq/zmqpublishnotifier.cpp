@@ -5,8 +5,14 @@
 #include "chainparams.h"
 #include "zmqpublishnotifier.h"
 #include "main.h"
+#include "primitives/zerocoin.h"
 #include "util.h"
 #include "crypto/common.h"
+#include "zuserxchain.h"
+
+#include <deque>
+
+#include <boost/thread.hpp>
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
@@ -15,7 +21,11 @@ static const char *MSG_HASHTX     = "hashtx";
 static const char *MSG_HASHTXLOCK = "hashtxlock";
 static const char *MSG_RAWBLOCK   = "rawblock";
 static const char *MSG_RAWTX      = "rawtx";
+static const char *MSG_RAWTXBATCH = "rawtxbatch";
 static const char *MSG_RAWTXLOCK = "rawtxlock";
+static const char *MSG_ZEROCOINMINT  = "zerocoinmint";
+static const char *MSG_ZEROCOINSPEND = "zerocoinspend";
+static const char *MSG_MNWINNER   = "mnwinner";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -57,6 +67,145 @@ static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
     return 0;
 }
 
+/**
+ * Messages of all publish notifiers, sent in order by one thread. Every
+ * message takes its sequence number when it is pushed, under the queue lock,
+ * whether it is queued or dropped because the queue is full.
+ */
+class CZMQPublishQueue
+{
+private:
+    struct Entry {
+        CZMQAbstractPublishNotifier *notifier;
+        std::string data;
+        uint32_t nSequence;
+    };
+
+    boost::mutex cs;
+    boost::condition_variable cond;
+    std::deque<Entry> queue;
+    unsigned int nMaxQueue;
+    bool fStop;
+    //! Held while sending, so a notifier is not shut down under a send
+    boost::mutex csSend;
+    boost::thread thread;
+
+    void Thread()
+    {
+        RenameThread("userx-zmqpub");
+        while (true) {
+            CZMQAbstractPublishNotifier *notifier;
+            std::string data;
+            uint32_t nSequence;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (queue.empty() && !fStop)
+                    cond.wait(lock);
+                if (queue.empty())
+                    return;
+                notifier = queue.front().notifier;
+                nSequence = queue.front().nSequence;
+                if (notifier->CanBatch()) {
+                    // Send all the notifier's queued transactions together, as long as their
+                    // sequence numbers run on: the batch carries the first one's number and
+                    // its transactions take the numbers that follow
+                    std::vector<std::string> vData;
+                    size_t nSize = 0;
+                    std::deque<Entry> queueRest;
+                    BOOST_FOREACH(Entry &entry, queue) {
+                        if (entry.notifier == notifier && entry.nSequence == (uint32_t)(nSequence + vData.size()) && vData.size() < MAX_ZMQ_TX_BATCH) {
+                            nSize += entry.data.size();
+                            vData.push_back(std::string());
+                            vData.back().swap(entry.data);
+                        } else {
+                            queueRest.push_back(Entry());
+                            queueRest.back().notifier = entry.notifier;
+                            queueRest.back().data.swap(entry.data);
+                            queueRest.back().nSequence = entry.nSequence;
+                        }
+                    }
+                    queue.swap(queueRest);
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    WriteCompactSize(ss, vData.size());
+                    data.reserve(ss.size() + nSize);
+                    data.assign(ss.begin(), ss.end());
+                    BOOST_FOREACH(const std::string &txData, vData)
+                        data += txData;
+                } else {
+                    data.swap(queue.front().data);
+                    queue.pop_front();
+                }
+            }
+            boost::lock_guard<boost::mutex> lockSend(csSend);
+            if (notifier->psocket)
+                notifier->SendMessage(notifier->GetCommand(), data.data(), data.size(), nSequence);
+        }
+    }
+
+public:
+    CZMQPublishQueue(unsigned int nMaxQueueIn) : nMaxQueue(nMaxQueueIn), fStop(false)
+    {
+        thread = boost::thread(boost::bind(&CZMQPublishQueue::Thread, this));
+    }
+
+    ~CZMQPublishQueue()
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(cs);
+            fStop = true;
+        }
+        cond.notify_one();
+        thread.join();
+    }
+
+    void Push(CZMQAbstractPublishNotifier *notifier, const std::string &data)
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(cs);
+            uint32_t nSequence = notifier->nSequence++;
+            if (queue.size() >= nMaxQueue) {
+                // Subscribers see the lost message as a gap in the sequence
+                LogPrint("zmq", "zmq: Queue full, dropping %s message %u\n", notifier->GetCommand(), nSequence);
+                return;
+            }
+            queue.push_back(Entry());
+            queue.back().notifier = notifier;
+            queue.back().data = data;
+            queue.back().nSequence = nSequence;
+        }
+        cond.notify_one();
+    }
+
+    /** Drop what the notifier still has queued and wait for a send in progress */
+    void Remove(CZMQAbstractPublishNotifier *notifier)
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(cs);
+            for (std::deque<Entry>::iterator it = queue.begin(); it != queue.end(); ) {
+                if (it->notifier == notifier)
+                    it = queue.erase(it);
+                else
+                    ++it;
+            }
+        }
+        boost::lock_guard<boost::mutex> lockSend(csSend);
+    }
+};
+
+static CZMQPublishQueue *ppublishQueue = NULL;
+
+void StartZMQPublisher(unsigned int nMaxQueue)
+{
+    assert(!ppublishQueue);
+    ppublishQueue = new CZMQPublishQueue(nMaxQueue);
+}
+
+void StopZMQPublisher()
+{
+    delete ppublishQueue;
+    ppublishQueue = NULL;
+}
+
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 {
     assert(!psocket);
@@ -100,6 +249,9 @@ void CZMQAbstractPublishNotifier::Shutdown()
 {
     assert(psocket);
 
+    if (ppublishQueue)
+        ppublishQueue->Remove(this);
+
     int count = mapPublishNotifiers.count(address);
 
     // remove this notifier from the list of publishers using this address
@@ -126,82 +278,116 @@ void CZMQAbstractPublishNotifier::Shutdown()
     psocket = 0;
 }
 
-bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size, uint32_t nMessageSequence)
 {
     assert(psocket);
 
     /* send three parts, command & data & a LE 4byte sequence number */
     unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
+    WriteLE32(&msgseq[0], nMessageSequence);
     int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), (void*)0);
     if (rc == -1)
         return false;
 
-    /* increment memory only sequence number after sending */
-    nSequence++;
-
     return true;
 }
 
+void CZMQAbstractPublishNotifier::QueueMessage(const std::string &data)
+{
+    assert(ppublishQueue);
+    ppublishQueue->Push(this, data);
+}
+
+/** A hash in the byte order it is displayed in */
+static std::string HashToMessage(const uint256 &hash)
+{
+    std::string data(32, 0);
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    return data;
+}
+
+const char *CZMQPublishHashBlockNotifier::GetCommand() const { return MSG_HASHBLOCK; }
+const char *CZMQPublishHashTransactionNotifier::GetCommand() const { return MSG_HASHTX; }
+const char *CZMQPublishHashTransactionLockNotifier::GetCommand() const { return MSG_HASHTXLOCK; }
+const char *CZMQPublishRawBlockNotifier::GetCommand() const { return MSG_RAWBLOCK; }
+const char *CZMQPublishRawTransactionNotifier::GetCommand() const { return MSG_RAWTX; }
+const char *CZMQPublishRawTransactionBatchNotifier::GetCommand() const { return MSG_RAWTXBATCH; }
+const char *CZMQPublishRawTransactionLockNotifier::GetCommand() const { return MSG_RAWTXLOCK; }
+const char *CZMQPublishZerocoinMintNotifier::GetCommand() const { return MSG_ZEROCOINMINT; }
+const char *CZMQPublishZerocoinSpendNotifier::GetCommand() const { return MSG_ZEROCOINSPEND; }
+const char *CZMQPublishMasternodeWinnerNotifier::GetCommand() const { return MSG_MNWINNER; }
+
 bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     uint256 hash = pindex->GetBlockHash();
     LogPrint("zmq", "zmq: Publish hashblock %s\n", hash.GetHex());
-    char data[32];
-    for (unsigned int i = 0; i < 32; i++)
-        data[31 - i] = hash.begin()[i];
-    return SendMessage(MSG_HASHBLOCK, data, 32);
+    QueueMessage(HashToMessage(hash));
+    return true;
 }
 
 bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish hashtx %s\n", hash.GetHex());
-    char data[32];
-    for (unsigned int i = 0; i < 32; i++)
-        data[31 - i] = hash.begin()[i];
-    return SendMessage(MSG_HASHTX, data, 32);
+    QueueMessage(HashToMessage(hash));
+    return true;
 }
 
 bool CZMQPublishHashTransactionLockNotifier::NotifyTransactionLock(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish hashtxlock %s\n", hash.GetHex());
-    char data[32];
-    for (unsigned int i = 0; i < 32; i++)
-        data[31 - i] = hash.begin()[i];
-    return SendMessage(MSG_HASHTXLOCK, data, 32);
+    QueueMessage(HashToMessage(hash));
+    return true;
+}
+
+bool CZMQPublishRawBlockNotifier::NotifyBlockConnected(const CBlock &block)
+{
+    // Only the tip is published, but it is cheaper to serialize every
+    // connected block here than to read the tip back from disk later
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    LOCK(cs_connected);
+    hashConnected = block.GetHash();
+    strConnected.assign(ss.begin(), ss.end());
+    return true;
 }
 
 bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-// XX42    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     {
-        LOCK(cs_main);
-        CBlock block;
-// XX42        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        if(!ReadBlockFromDisk(block, pindex))
-        {
-            zmqError("Can't read block from disk");
-            return false;
+        LOCK(cs_connected);
+        if (hashConnected == pindex->GetBlockHash()) {
+            QueueMessage(strConnected);
+            return true;
         }
+    }
 
-        ss << block;
+    // Block files are only appended to, so this needs no cs_main
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex))
+    {
+        zmqError("Can't read block from disk");
+        return false;
     }
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    QueueMessage(std::string(ss.begin(), ss.end()));
+    return true;
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
-    LogPrint("zmq", "zmq: Publish rawtx %s\n", hash.GetHex());
+    LogPrint("zmq", "zmq: Publish %s %s\n", GetCommand(), hash.GetHex());
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << transaction;
-    return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
+    QueueMessage(std::string(ss.begin(), ss.end()));
+    return true;
 }
 
 bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransaction &transaction)
@@ -210,5 +396,59 @@ bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransac
     LogPrint("zmq", "zmq: Publish rawtxlock %s\n", hash.GetHex());
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << transaction;
-    return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
+    QueueMessage(std::string(ss.begin(), ss.end()));
+    return true;
+}
+
+/** Body of the zerocoin topics: coin hash, transaction hash and denomination */
+static std::string ZerocoinMessage(const uint256 &hashCoin, const uint256 &txid, libzerocoin::CoinDenomination denom)
+{
+    unsigned char denomination[sizeof(uint32_t)];
+    WriteLE32(denomination, (uint32_t)libzerocoin::ZerocoinDenominationToInt(denom));
+    return HashToMessage(hashCoin) + HashToMessage(txid) + std::string((const char*)denomination, sizeof(denomination));
+}
+
+bool CZMQPublishZerocoinMintNotifier::NotifyBlockConnected(const CBlock &block)
+{
+    BOOST_FOREACH(const CTransaction &tx, block.vtx) {
+        if (!tx.IsZerocoinMint())
+            continue;
+        BOOST_FOREACH(const CTxOut &txout, tx.vout) {
+            if (!txout.IsZerocoinMint())
+                continue;
+            libzerocoin::PublicCoin pubCoin(Params().Zerocoin_Params(false));
+            CValidationState state;
+            if (!TxOutToPublicCoin(txout, pubCoin, state))
+                continue;
+            LogPrint("zmq", "zmq: Publish zerocoinmint %s\n", tx.GetHash().GetHex());
+            QueueMessage(ZerocoinMessage(GetPubCoinHash(pubCoin.getValue()), tx.GetHash(), pubCoin.getDenomination()));
+        }
+    }
+    return true;
+}
+
+bool CZMQPublishZerocoinSpendNotifier::NotifyBlockConnected(const CBlock &block)
+{
+    BOOST_FOREACH(const CTransaction &tx, block.vtx) {
+        if (!tx.IsZerocoinSpend())
+            continue;
+        for (unsigned int i = 0; i < tx.vin.size(); i++) {
+            if (!tx.vin[i].scriptSig.IsZerocoinSpend())
+                continue;
+            // Parsed and cached already when the block was connected
+            CoinSpendRef spend = TxInToZerocoinSpendRef(tx, i);
+            LogPrint("zmq", "zmq: Publish zerocoinspend %s\n", tx.GetHash().GetHex());
+            QueueMessage(ZerocoinMessage(GetSerialHash(spend->getCoinSerialNumber()), tx.GetHash(), spend->getDenomination()));
+        }
+    }
+    return true;
+}
+
+bool CZMQPublishMasternodeWinnerNotifier::NotifyMasternodeWinner(int nBlockHeight, const CScript &payee)
+{
+    LogPrint("zmq", "zmq: Publish mnwinner %d\n", nBlockHeight);
+    unsigned char height[sizeof(uint32_t)];
+    WriteLE32(height, (uint32_t)nBlockHeight);
+    QueueMessage(std::string((const char*)height, sizeof(height)) + std::string(payee.begin(), payee.end()));
+    return true;
 }
@@ -6,15 +6,43 @@
 #define BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
 
 #include "zmqabstractnotifier.h"
+#include "sync.h"
+#include "uint256.h"
 
 class CBlockIndex;
 
+//! Most transactions sent in one rawtxbatch message
+static const unsigned int MAX_ZMQ_TX_BATCH = 100;
+
+/**
+ * Start the thread that sends the messages of all publish notifiers, so that
+ * slow subscribers don't hold up validation. When more than nMaxQueue
+ * messages wait, new ones are dropped and leave a gap in their topic's
+ * sequence numbers.
+ */
+void StartZMQPublisher(unsigned int nMaxQueue);
+/** Send what is still queued and stop the thread. Call before shutting the notifiers down */
+void StopZMQPublisher();
+
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
 private:
-    uint32_t nSequence; // upcounting per message sequence number
+    uint32_t nSequence; // upcounting per message sequence number, guarded by the publisher queue
+
+    friend class CZMQPublishQueue;
+
+protected:
+    /** Hand a message to the publisher thread */
+    void QueueMessage(const std::string &data);
+
+    /** Whether the notifier's queued messages may go out as one */
+    virtual bool CanBatch() const { return false; }
 
 public:
+    CZMQAbstractPublishNotifier() : nSequence(0) { }
+
+    /** The topic of this notifier's messages */
+    virtual const char *GetCommand() const = 0;
 
     /* send zmq multipart message
        parts:
@@ -22,7 +50,7 @@ public:
           * data
           * message sequence number
     */
-    bool SendMessage(const char *command, const void* data, size_t size);
+    bool SendMessage(const char *command, const void* data, size_t size, uint32_t nMessageSequence);
 
     bool Initialize(void *pcontext);
     void Shutdown();
@@ -31,37 +59,81 @@ public:
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
+    const char *GetCommand() const;
     bool NotifyBlock(const CBlockIndex *pindex);
 };
 
 class CZMQPublishHashTransactionNotifier : public CZMQAbstractPublishNotifier
 {
 public:
+    const char *GetCommand() const;
     bool NotifyTransaction(const CTransaction &transaction);
 };
 
 class CZMQPublishHashTransactionLockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
+    const char *GetCommand() const;
     bool NotifyTransactionLock(const CTransaction &transaction);
 };
 
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
+private:
+    //! The last connected block, serialized while it was still in memory
+    CCriticalSection cs_connected;
+    uint256 hashConnected;
+    std::string strConnected;
+
 public:
+    const char *GetCommand() const;
+    bool NotifyBlockConnected(const CBlock &block);
     bool NotifyBlock(const CBlockIndex *pindex);
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier
 {
 public:
+    const char *GetCommand() const;
     bool NotifyTransaction(const CTransaction &transaction);
 };
 
+/** Like rawtx, but the transactions queued at the time go out in one message, count first */
+class CZMQPublishRawTransactionBatchNotifier : public CZMQPublishRawTransactionNotifier
+{
+protected:
+    bool CanBatch() const { return true; }
+
+public:
+    const char *GetCommand() const;
+};
+
 class CZMQPublishRawTransactionLockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
+    const char *GetCommand() const;
     bool NotifyTransactionLock(const CTransaction &transaction);
 };
 
+class CZMQPublishZerocoinMintNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    const char *GetCommand() const;
+    bool NotifyBlockConnected(const CBlock &block);
+};
+
+class CZMQPublishZerocoinSpendNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    const char *GetCommand() const;
+    bool NotifyBlockConnected(const CBlock &block);
+};
+
+class CZMQPublishMasternodeWinnerNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    const char *GetCommand() const;
+    bool NotifyMasternodeWinner(int nBlockHeight, const CScript &payee);
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
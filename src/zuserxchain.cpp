@@ -8,6 +8,8 @@
 #include "txdb.h"
 #include "ui_interface.h"
 
+#include <deque>
+
 // 6 comes from OPCODE (1) + vch.size() (1) + BIGNUM size (4)
 #define SCRIPT_OFFSET 6
 // For Script size (BIGNUM/Uint256 size)
@@ -224,33 +226,58 @@ bool IsPubcoinInBlockchain(const uint256& hashPubcoin, uint256& txid)
 bool IsSerialKnown(const CBigNum& bnSerial)
 {
     uint256 txHash = 0;
-    return zerocoinDB->ReadCoinSpend(bnSerial, txHash);
+    uint256 hashBlock = 0;
+    int nHeight = -1;
+    return zerocoinDB->GetSerialSpend(GetSerialHash(bnSerial), txHash, nHeight, hashBlock);
 }
 
 bool IsSerialInBlockchain(const CBigNum& bnSerial, int& nHeightTx)
 {
     uint256 txHash = 0;
-    // if not in zerocoinDB then its not in the blockchain
-    if (!zerocoinDB->ReadCoinSpend(bnSerial, txHash))
-        return false;
-
-    return IsTransactionInChain(txHash, nHeightTx);
+    return IsSerialInBlockchain(GetSerialHash(bnSerial), nHeightTx, txHash);
 }
 
 bool IsSerialInBlockchain(const uint256& hashSerial, int& nHeightTx, uint256& txidSpend)
 {
-    CTransaction tx;
-    return IsSerialInBlockchain(hashSerial, nHeightTx, txidSpend, tx);
+    txidSpend = 0;
+    // if not in zerocoinDB then its not in the blockchain
+    int nHeight = -1;
+    uint256 hashBlock = 0;
+    if (!zerocoinDB->GetSerialSpend(hashSerial, txidSpend, nHeight, hashBlock))
+        return false;
+
+    // spends recorded while connecting a block count while that block is in the active chain
+    if (nHeight >= 0) {
+        CBlockIndex* pindex = chainActive[nHeight];
+        if (pindex && pindex->GetBlockHash() == hashBlock) {
+            nHeightTx = nHeight;
+            return true;
+        }
+    }
+
+    // spends loaded from disk, or whose block was reorged away, are looked up and then
+    // remembered with the block they are in now
+    if (!IsZerocoinTxInChain(txidSpend, nHeightTx))
+        return false;
+    zerocoinDB->SetSerialSpendBlock(hashSerial, chainActive[nHeightTx]);
+    return true;
 }
 
 bool IsSerialInBlockchain(const uint256& hashSerial, int& nHeightTx, uint256& txidSpend, CTransaction& tx)
 {
     txidSpend = 0;
     // if not in zerocoinDB then its not in the blockchain
-    if (!zerocoinDB->ReadCoinSpend(hashSerial, txidSpend))
+    int nHeight = -1;
+    uint256 hashBlock = 0;
+    if (!zerocoinDB->GetSerialSpend(hashSerial, txidSpend, nHeight, hashBlock))
         return false;
 
-    return IsTransactionInChain(txidSpend, nHeightTx, tx);
+    if (!IsTransactionInChain(txidSpend, nHeightTx, tx))
+        return false;
+    CBlockIndex* pindex = chainActive[nHeightTx];
+    if (nHeight != nHeightTx || !pindex || pindex->GetBlockHash() != hashBlock)
+        zerocoinDB->SetSerialSpendBlock(hashSerial, pindex);
+    return true;
 }
 
 std::string ReindexZerocoinDB()
@@ -261,72 +288,81 @@ std::string ReindexZerocoinDB()
 
     uiInterface.ShowProgress(_("Reindexing zerocoin database..."), 0);
 
-    CBlockIndex* pindex = chainActive[Params().Zerocoin_StartHeight()];
+    // Blocks are read and their zerocoins parsed on a worker pool a window at a time; the
+    // results are written to the zerocoinDB in chain order
+    struct CBlockZerocoins {
+        bool fRead;
+        std::vector<std::pair<libzerocoin::CoinSpend, uint256> > vSpendInfo;
+        std::vector<std::pair<libzerocoin::PublicCoin, uint256> > vMintInfo;
+        CBlockZerocoins() : fRead(false) {}
+    };
+    const int nHeightStart = Params().Zerocoin_StartHeight();
+    const size_t nWindow = 1000;
+
+    CBlockIndex* pindex = chainActive[nHeightStart];
     std::vector<std::pair<libzerocoin::CoinSpend, uint256> > vSpendInfo;
     std::vector<std::pair<libzerocoin::PublicCoin, uint256> > vMintInfo;
     while (pindex) {
-        uiInterface.ShowProgress(_("Reindexing zerocoin database..."), std::max(1, std::min(99, (int)((double)(pindex->nHeight - Params().Zerocoin_StartHeight()) / (double)(chainActive.Height() - Params().Zerocoin_StartHeight()) * 100))));
+        uiInterface.ShowProgress(_("Reindexing zerocoin database..."), std::max(1, std::min(99, (int)((double)(pindex->nHeight - nHeightStart) / (double)(chainActive.Height() - nHeightStart) * 100))));
+        LogPrintf("Reindexing zerocoin : block %d...\n", pindex->nHeight);
 
-        if (pindex->nHeight % 1000 == 0)
-            LogPrintf("Reindexing zerocoin : block %d...\n", pindex->nHeight);
+        std::vector<CBlockIndex*> vWindow;
+        for (; pindex && vWindow.size() < nWindow; pindex = chainActive.Next(pindex))
+            vWindow.push_back(pindex);
 
-        CBlock block;
-        if (!ReadBlockFromDisk(block, pindex)) {
-            return _("Reindexing zerocoin failed");
-        }
+        std::vector<CBlockZerocoins> vZerocoins(vWindow.size());
+        ParallelForBlocks(vWindow.size(), [&](size_t j) {
+            CBlock block;
+            if (!ReadBlockFromDisk(block, vWindow[j]))
+                return;
 
-        for (const CTransaction& tx : block.vtx) {
-            for (unsigned int i = 0; i < tx.vin.size(); i++) {
-                if (tx.IsCoinBase())
-                    break;
+            for (const CTransaction& tx : block.vtx) {
+                if (tx.IsCoinBase() || !tx.ContainsZerocoins())
+                    continue;
+
+                uint256 txid = tx.GetHash();
+                //Record Serials
+                if (tx.IsZerocoinSpend()) {
+                    for (auto& in : tx.vin) {
+                        if (!in.scriptSig.IsZerocoinSpend())
+                            continue;
 
-                if (tx.ContainsZerocoins()) {
-                    uint256 txid = tx.GetHash();
-                    //Record Serials
-                    if (tx.IsZerocoinSpend()) {
-                        for (auto& in : tx.vin) {
-                            if (!in.scriptSig.IsZerocoinSpend())
-                                continue;
-
-                            libzerocoin::CoinSpend spend = TxInToZerocoinSpend(in);
-                            vSpendInfo.push_back(make_pair(spend, txid));
-                        }
+                        libzerocoin::CoinSpend spend = TxInToZerocoinSpend(in);
+                        vZerocoins[j].vSpendInfo.push_back(make_pair(spend, txid));
                     }
+                }
+
+                //Record mints
+                if (tx.IsZerocoinMint()) {
+                    for (auto& out : tx.vout) {
+                        if (!out.IsZerocoinMint())
+                            continue;
 
-                    //Record mints
-                    if (tx.IsZerocoinMint()) {
-                        for (auto& out : tx.vout) {
-                            if (!out.IsZerocoinMint())
-                                continue;
-
-                            CValidationState state;
-                            libzerocoin::PublicCoin coin(Params().Zerocoin_Params(pindex->nHeight < Params().Zerocoin_Block_V2_Start()));
-                            TxOutToPublicCoin(out, coin, state);
-                            vMintInfo.push_back(make_pair(coin, txid));
-                        }
+                        CValidationState state;
+                        libzerocoin::PublicCoin coin(Params().Zerocoin_Params(vWindow[j]->nHeight < Params().Zerocoin_Block_V2_Start()));
+                        TxOutToPublicCoin(out, coin, state);
+                        vZerocoins[j].vMintInfo.push_back(make_pair(coin, txid));
                     }
                 }
             }
+            vZerocoins[j].fRead = true;
+        });
+
+        for (const CBlockZerocoins& zerocoins : vZerocoins) {
+            if (!zerocoins.fRead)
+                return _("Reindexing zerocoin failed");
+            vSpendInfo.insert(vSpendInfo.end(), zerocoins.vSpendInfo.begin(), zerocoins.vSpendInfo.end());
+            vMintInfo.insert(vMintInfo.end(), zerocoins.vMintInfo.begin(), zerocoins.vMintInfo.end());
         }
 
-        // Flush the zerocoinDB to disk every 100 blocks
-        if (pindex->nHeight % 100 == 0) {
-            if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)))
-                return _("Error writing zerocoinDB to disk");
-            vSpendInfo.clear();
-            vMintInfo.clear();
-        }
-
-        pindex = chainActive.Next(pindex);
+        // Flush the zerocoinDB to disk once per window
+        if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)))
+            return _("Error writing zerocoinDB to disk");
+        vSpendInfo.clear();
+        vMintInfo.clear();
     }
     uiInterface.ShowProgress("", 100);
 
-    // Final flush to disk in case any remaining information exists
-    if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)))
-        return _("Error writing zerocoinDB to disk");
-
-    uiInterface.ShowProgress("", 100);
-
     return "";
 }
 
@@ -335,6 +371,61 @@ bool RemoveSerialFromDB(const CBigNum& bnSerial)
     return zerocoinDB->EraseCoinSpend(bnSerial);
 }
 
+namespace {
+
+/**
+ * Parsed zerocoin spends, keyed by the (txid, vin index) they were read from and the
+ * accumulator params they were parsed with. A spend is deserialized by several stages of
+ * validation (CheckTransaction, CheckBlock, ConnectBlock, AcceptToMemoryPool and
+ * CreateNewBlock), so each of them shares a single immutable parsed object instead.
+ */
+class CZerocoinSpendParseCache
+{
+private:
+    typedef std::pair<COutPoint, bool> key_type;
+    std::map<key_type, CoinSpendRef> mapSpends;
+    std::deque<key_type> queueSpends;
+    CCriticalSection cs_spends;
+
+public:
+    CoinSpendRef Get(const key_type& key)
+    {
+        LOCK(cs_spends);
+        std::map<key_type, CoinSpendRef>::const_iterator it = mapSpends.find(key);
+        if (it == mapSpends.end())
+            return CoinSpendRef();
+        return it->second;
+    }
+
+    void Set(const key_type& key, const CoinSpendRef& spend)
+    {
+        LOCK(cs_spends);
+        if (!mapSpends.insert(std::make_pair(key, spend)).second)
+            return;
+        queueSpends.push_back(key);
+        while (queueSpends.size() > MAX_ZEROCOIN_SPEND_PARSE_CACHE) {
+            mapSpends.erase(queueSpends.front());
+            queueSpends.pop_front();
+        }
+    }
+};
+
+CZerocoinSpendParseCache zerocoinSpendParseCache;
+
+}
+
+CoinSpendRef TxInToZerocoinSpendRef(const CTransaction& tx, unsigned int nIn)
+{
+    std::pair<COutPoint, bool> key(COutPoint(tx.GetHash(), nIn), chainActive.Height() < Params().Zerocoin_Block_V2_Start());
+    CoinSpendRef spend = zerocoinSpendParseCache.Get(key);
+    if (spend)
+        return spend;
+
+    spend.reset(new libzerocoin::CoinSpend(TxInToZerocoinSpend(tx.vin[nIn])));
+    zerocoinSpendParseCache.Set(key, spend);
+    return spend;
+}
+
 libzerocoin::CoinSpend TxInToZerocoinSpend(const CTxIn& txin)
 {
     // extract the CoinSpend from the txin
@@ -375,13 +466,14 @@ std::list<libzerocoin::CoinDenomination> ZerocoinSpendListFromBlock(const CBlock
         if (!tx.IsZerocoinSpend())
             continue;
 
-        for (const CTxIn txin : tx.vin) {
+        for (unsigned int i = 0; i < tx.vin.size(); i++) {
+            const CTxIn& txin = tx.vin[i];
             if (!txin.scriptSig.IsZerocoinSpend())
                 continue;
 
             if (fFilterInvalid) {
-                libzerocoin::CoinSpend spend = TxInToZerocoinSpend(txin);
-                if (invalid_out::ContainsSerial(spend.getCoinSerialNumber()))
+                CoinSpendRef spend = TxInToZerocoinSpendRef(tx, i);
+                if (invalid_out::ContainsSerial(spend->getCoinSerialNumber()))
                     continue;
             }
 
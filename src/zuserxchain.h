@@ -11,6 +11,11 @@
 #include <list>
 #include <string>
 
+#include <boost/shared_ptr.hpp>
+
+//! Number of parsed zerocoin spends kept by TxInToZerocoinSpendRef
+static const unsigned int MAX_ZEROCOIN_SPEND_PARSE_CACHE = 500;
+
 class CBlock;
 class CBigNum;
 struct CMintMeta;
@@ -21,6 +26,8 @@ class CValidationState;
 class CZerocoinMint;
 class uint256;
 
+typedef boost::shared_ptr<const libzerocoin::CoinSpend> CoinSpendRef;
+
 bool BlockToMintValueVector(const CBlock& block, const libzerocoin::CoinDenomination denom, std::vector<CBigNum>& vValues);
 bool BlockToPubcoinList(const CBlock& block, std::list<libzerocoin::PublicCoin>& listPubcoins, bool fFilterInvalid);
 bool BlockToZerocoinMintList(const CBlock& block, std::list<CZerocoinMint>& vMints, bool fFilterInvalid);
@@ -35,6 +42,7 @@ bool IsSerialInBlockchain(const uint256& hashSerial, int& nHeightTx, uint256& tx
 bool RemoveSerialFromDB(const CBigNum& bnSerial);
 std::string ReindexZerocoinDB();
 libzerocoin::CoinSpend TxInToZerocoinSpend(const CTxIn& txin);
+CoinSpendRef TxInToZerocoinSpendRef(const CTransaction& tx, unsigned int nIn);
 bool TxOutToPublicCoin(const CTxOut& txout, libzerocoin::PublicCoin& pubCoin, CValidationState& state);
 std::list<libzerocoin::CoinDenomination> ZerocoinSpendListFromBlock(const CBlock& block, bool fFilterInvalid);
 
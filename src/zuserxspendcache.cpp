@@ -0,0 +1,87 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zuserxspendcache.h"
+
+#include "crypto/sha256.h"
+#include "cuckoocache.h"
+#include "primitives/transaction.h"
+#include "random.h"
+#include "uint256.h"
+#include "util.h"
+
+#include <boost/thread.hpp>
+
+namespace {
+
+class CZerocoinSpendCache
+{
+private:
+    uint256 nonce;
+    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
+    map_type setVerified;
+    boost::shared_mutex cs_zcspendcache;
+
+public:
+    CZerocoinSpendCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    void ComputeEntry(uint256& entry, const CTxIn& txin, uint32_t nAccumulatorChecksum, const uint256& hashTxOut, bool fUseV1Params)
+    {
+        unsigned char fV1 = fUseV1Params ? 1 : 0;
+        CSHA256 hasher;
+        hasher.Write(nonce.begin(), 32);
+        if (!txin.scriptSig.empty())
+            hasher.Write(&txin.scriptSig[0], txin.scriptSig.size());
+        hasher.Write((const unsigned char*)&nAccumulatorChecksum, sizeof(nAccumulatorChecksum))
+              .Write(hashTxOut.begin(), 32)
+              .Write(&fV1, 1)
+              .Finalize(entry.begin());
+    }
+
+    bool Get(const uint256& entry, const bool erase)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_zcspendcache);
+        return setVerified.contains(entry, erase);
+    }
+
+    void Set(const uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_zcspendcache);
+        setVerified.insert(entry);
+    }
+
+    uint32_t setup_bytes(size_t n)
+    {
+        return setVerified.setup_bytes(n);
+    }
+};
+
+CZerocoinSpendCache zerocoinSpendCache;
+
+}
+
+void InitZerocoinSpendCache()
+{
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, GetArg("-maxzcverifycachesize", DEFAULT_MAX_ZEROCOIN_VERIFY_CACHE_SIZE)), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = zerocoinSpendCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for zerocoin spend verification cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
+
+bool IsZerocoinSpendVerified(const CTxIn& txin, uint32_t nAccumulatorChecksum, const uint256& hashTxOut, bool fUseV1Params, bool fErase)
+{
+    uint256 entry;
+    zerocoinSpendCache.ComputeEntry(entry, txin, nAccumulatorChecksum, hashTxOut, fUseV1Params);
+    return zerocoinSpendCache.Get(entry, fErase);
+}
+
+void SetZerocoinSpendVerified(const CTxIn& txin, uint32_t nAccumulatorChecksum, const uint256& hashTxOut, bool fUseV1Params)
+{
+    uint256 entry;
+    zerocoinSpendCache.ComputeEntry(entry, txin, nAccumulatorChecksum, hashTxOut, fUseV1Params);
+    zerocoinSpendCache.Set(entry);
+}
@@ -0,0 +1,31 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef USERX_ZUSERXSPENDCACHE_H
+#define USERX_ZUSERXSPENDCACHE_H
+
+#include "script/sigcache.h"
+
+#include <stdint.h>
+
+class CTxIn;
+class uint256;
+
+// Each entry is a 32 byte salted hash, so 8MB holds roughly 260,000 verified spends
+static const int64_t DEFAULT_MAX_ZEROCOIN_VERIFY_CACHE_SIZE = 8;
+
+/**
+ * Cache of zerocoin spends whose accumulator proof of knowledge and serial
+ * signature of knowledge already verified, so that a spend accepted to the
+ * memory pool is not proven again when the block containing it is checked.
+ *
+ * Entries are keyed by a salted hash of the serialized spend in the txin,
+ * the accumulator checksum, the txout hash committed to by the spend and the
+ * set of zerocoin params the accumulator was verified against.
+ */
+void InitZerocoinSpendCache();
+bool IsZerocoinSpendVerified(const CTxIn& txin, uint32_t nAccumulatorChecksum, const uint256& hashTxOut, bool fUseV1Params, bool fErase);
+void SetZerocoinSpendVerified(const CTxIn& txin, uint32_t nAccumulatorChecksum, const uint256& hashTxOut, bool fUseV1Params);
+
+#endif //USERX_ZUSERXSPENDCACHE_H
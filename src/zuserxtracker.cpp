@@ -10,23 +10,70 @@
 #include "txdb.h"
 #include "walletdb.h"
 #include "accumulators.h"
+#include "zuserxchain.h"
 
 using namespace std;
 
 CzUSERXTracker::CzUSERXTracker(std::string strWalletFile)
 {
     this->strWalletFile = strWalletFile;
-    mapSerialHashes.clear();
     mapPendingSpends.clear();
     fInitialized = false;
 }
 
 CzUSERXTracker::~CzUSERXTracker()
 {
-    mapSerialHashes.clear();
+    Clear();
     mapPendingSpends.clear();
 }
 
+void CzUSERXTracker::IndexMeta(const CMintMeta& meta)
+{
+    mapHashPubcoin[meta.hashPubcoin] = meta.hashSerial;
+    mapHashStake[meta.hashStake] = meta.hashSerial;
+    if (meta.txid != 0)
+        mapMintTxids.insert(make_pair(meta.txid, meta.hashSerial));
+
+    if (meta.isArchived)
+        return;
+    if (!meta.isUsed) {
+        setUnused.insert(meta.hashSerial);
+        if (meta.nHeight)
+            setUnusedConfirmed.insert(make_pair(meta.nHeight, meta.hashSerial));
+    }
+    if (!meta.nHeight || meta.txid == 0)
+        setPendingMints.insert(meta.hashSerial);
+}
+
+void CzUSERXTracker::UnindexMeta(const CMintMeta& meta)
+{
+    mapHashPubcoin.erase(meta.hashPubcoin);
+    mapHashStake.erase(meta.hashStake);
+    auto range = mapMintTxids.equal_range(meta.txid);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == meta.hashSerial) {
+            mapMintTxids.erase(it);
+            break;
+        }
+    }
+    setUnused.erase(meta.hashSerial);
+    setUnusedConfirmed.erase(make_pair(meta.nHeight, meta.hashSerial));
+    setPendingMints.erase(meta.hashSerial);
+}
+
+//! All writes to mapSerialHashes go through here to keep the indexes in step
+void CzUSERXTracker::SetMeta(const CMintMeta& meta)
+{
+    auto it = mapSerialHashes.find(meta.hashSerial);
+    if (it != mapSerialHashes.end()) {
+        UnindexMeta(it->second);
+        it->second = meta;
+    } else {
+        mapSerialHashes.insert(make_pair(meta.hashSerial, meta));
+    }
+    IndexMeta(meta);
+}
+
 void CzUSERXTracker::Init()
 {
     //Load all CZerocoinMints and CDeterministicMints from the database
@@ -38,8 +85,12 @@ void CzUSERXTracker::Init()
 
 bool CzUSERXTracker::Archive(CMintMeta& meta)
 {
-    if (mapSerialHashes.count(meta.hashSerial))
-        mapSerialHashes.at(meta.hashSerial).isArchived = true;
+    auto it = mapSerialHashes.find(meta.hashSerial);
+    if (it != mapSerialHashes.end()) {
+        CMintMeta metaArchived = it->second;
+        metaArchived.isArchived = true;
+        SetMeta(metaArchived);
+    }
 
     CWalletDB walletdb(strWalletFile);
     CZerocoinMint mint;
@@ -80,33 +131,30 @@ bool CzUSERXTracker::UnArchive(const uint256& hashPubcoin, bool isDeterministic)
 
 CMintMeta CzUSERXTracker::Get(const uint256 &hashSerial)
 {
-    if (!mapSerialHashes.count(hashSerial))
+    auto it = mapSerialHashes.find(hashSerial);
+    if (it == mapSerialHashes.end())
         return CMintMeta();
 
-    return mapSerialHashes.at(hashSerial);
+    return it->second;
 }
 
 CMintMeta CzUSERXTracker::GetMetaFromPubcoin(const uint256& hashPubcoin)
 {
-    for (auto it : mapSerialHashes) {
-        CMintMeta meta = it.second;
-        if (meta.hashPubcoin == hashPubcoin)
-            return meta;
-    }
+    auto it = mapHashPubcoin.find(hashPubcoin);
+    if (it == mapHashPubcoin.end())
+        return CMintMeta();
 
-    return CMintMeta();
+    return Get(it->second);
 }
 
 bool CzUSERXTracker::GetMetaFromStakeHash(const uint256& hashStake, CMintMeta& meta) const
 {
-    for (auto& it : mapSerialHashes) {
-        if (it.second.hashStake == hashStake) {
-            meta = it.second;
-            return true;
-        }
-    }
+    auto it = mapHashStake.find(hashStake);
+    if (it == mapHashStake.end())
+        return false;
 
-    return false;
+    meta = mapSerialHashes.at(it->second);
+    return true;
 }
 
 std::vector<uint256> CzUSERXTracker::GetSerialHashes()
@@ -135,10 +183,8 @@ CAmount CzUSERXTracker::GetBalance(bool fConfirmedOnly, bool fUnconfirmedOnly) c
     {
         //LOCK(cs_userxtracker);
         // Get Unused coins
-        for (auto& it : mapSerialHashes) {
-            CMintMeta meta = it.second;
-            if (meta.isUsed || meta.isArchived)
-                continue;
+        for (const uint256& hashSerial : setUnused) {
+            const CMintMeta& meta = mapSerialHashes.at(hashSerial);
             bool fConfirmed = ((meta.nHeight < chainActive.Height() - Params().Zerocoin_MintRequiredConfirmations()) && !(meta.nHeight == 0));
             if (fConfirmedOnly && !fConfirmed)
                 continue;
@@ -163,10 +209,8 @@ CAmount CzUSERXTracker::GetUnconfirmedBalance() const
 std::vector<CMintMeta> CzUSERXTracker::GetMints(bool fConfirmedOnly) const
 {
     vector<CMintMeta> vMints;
-    for (auto& it : mapSerialHashes) {
-        CMintMeta mint = it.second;
-        if (mint.isArchived || mint.isUsed)
-            continue;
+    for (const uint256& hashSerial : setUnused) {
+        const CMintMeta& mint = mapSerialHashes.at(hashSerial);
         bool fConfirmed = (mint.nHeight < chainActive.Height() - Params().Zerocoin_MintRequiredConfirmations());
         if (fConfirmedOnly && !fConfirmed)
             continue;
@@ -178,12 +222,7 @@ std::vector<CMintMeta> CzUSERXTracker::GetMints(bool fConfirmedOnly) const
 //Does a mint in the tracker have this txid
 bool CzUSERXTracker::HasMintTx(const uint256& txid)
 {
-    for (auto it : mapSerialHashes) {
-        if (it.second.txid == txid)
-            return true;
-    }
-
-    return false;
+    return mapMintTxids.count(txid) > 0;
 }
 
 bool CzUSERXTracker::HasPubcoin(const CBigNum &bnValue) const
@@ -195,12 +234,7 @@ bool CzUSERXTracker::HasPubcoin(const CBigNum &bnValue) const
 
 bool CzUSERXTracker::HasPubcoinHash(const uint256& hashPubcoin) const
 {
-    for (auto it : mapSerialHashes) {
-        CMintMeta meta = it.second;
-        if (meta.hashPubcoin == hashPubcoin)
-            return true;
-    }
-    return false;
+    return mapHashPubcoin.count(hashPubcoin) > 0;
 }
 
 bool CzUSERXTracker::HasSerial(const CBigNum& bnSerial) const
@@ -227,7 +261,7 @@ bool CzUSERXTracker::UpdateZerocoinMint(const CZerocoinMint& mint)
     meta.isUsed = mint.IsUsed();
     meta.denom = mint.GetDenomination();
     meta.nHeight = mint.GetHeight();
-    mapSerialHashes.at(hashSerial) = meta;
+    SetMeta(meta);
 
     //Write to db
     return CWalletDB(strWalletFile).WriteZerocoinMint(mint);
@@ -271,7 +305,7 @@ bool CzUSERXTracker::UpdateState(const CMintMeta& meta)
             return error("%s: failed to write mint to database", __func__);
     }
 
-    mapSerialHashes[meta.hashSerial] = meta;
+    SetMeta(meta);
 
     return true;
 }
@@ -289,7 +323,8 @@ void CzUSERXTracker::Add(const CDeterministicMint& dMint, bool isNew, bool isArc
     meta.denom = dMint.GetDenomination();
     meta.isArchived = isArchived;
     meta.isDeterministic = true;
-    mapSerialHashes[meta.hashSerial] = meta;
+    SetMeta(meta);
+    setStatusDirty.insert(meta.hashSerial);
 
     if (isNew)
         CWalletDB(strWalletFile).WriteDeterministicMint(dMint);
@@ -309,7 +344,8 @@ void CzUSERXTracker::Add(const CZerocoinMint& mint, bool isNew, bool isArchived)
     meta.denom = mint.GetDenomination();
     meta.isArchived = isArchived;
     meta.isDeterministic = false;
-    mapSerialHashes[meta.hashSerial] = meta;
+    SetMeta(meta);
+    setStatusDirty.insert(meta.hashSerial);
 
     if (isNew)
         CWalletDB(strWalletFile).WriteZerocoinMint(mint);
@@ -430,8 +466,9 @@ bool CzUSERXTracker::UpdateStatusInternal(const std::set<uint256>& setMempool, C
 
 std::set<CMintMeta> CzUSERXTracker::ListMints(bool fUnusedOnly, bool fMatureOnly, bool fUpdateStatus)
 {
-    CWalletDB walletdb(strWalletFile);
-    if (fUpdateStatus) {
+    if (fUpdateStatus && !fInitialized) {
+        // Every later change goes through the tracker, so the database only has to be read once
+        CWalletDB walletdb(strWalletFile);
         std::list<CZerocoinMint> listMintsDB = walletdb.ListMintedCoins();
         for (auto& mint : listMintsDB)
             Add(mint);
@@ -441,54 +478,119 @@ std::set<CMintMeta> CzUSERXTracker::ListMints(bool fUnusedOnly, bool fMatureOnly
         for (auto& dMint : listDeterministicDB)
             Add(dMint);
         LogPrint("zero", "%s: added %d dzuserx from DB\n", __func__, listDeterministicDB.size());
+        fInitialized = true;
     }
 
-    std::vector<CMintMeta> vOverWrite;
-    std::set<CMintMeta> setMints;
-    std::set<uint256> setMempool;
-    {
-        LOCK(mempool.cs);
-        mempool.getTransactions(setMempool);
-    }
-
-    std::map<libzerocoin::CoinDenomination, int> mapMaturity = GetMintMaturityHeight();
-    for (auto& it : mapSerialHashes) {
-        CMintMeta mint = it.second;
-
-        //This is only intended for unarchived coins
-        if (mint.isArchived)
-            continue;
+    if (fUpdateStatus) {
+        std::set<uint256> setMempool;
+        {
+            LOCK(mempool.cs);
+            mempool.getTransactions(setMempool);
+        }
 
-        // Update the metadata of the mints if requested
-        if (fUpdateStatus && UpdateStatusInternal(setMempool, mint)) {
-            if (mint.isArchived)
+        // Only mints touched by a block since their last check, unconfirmed mints and pending
+        // spends can have changed status; everything else is left alone
+        std::set<uint256> setCheck;
+        setCheck.swap(setStatusDirty);
+        setCheck.insert(setPendingMints.begin(), setPendingMints.end());
+        for (auto& it : mapPendingSpends)
+            setCheck.insert(it.first);
+
+        bool fIBD = IsInitialBlockDownload();
+        std::vector<CMintMeta> vOverWrite;
+        for (const uint256& hashSerial : setCheck) {
+            auto it = mapSerialHashes.find(hashSerial);
+            if (it == mapSerialHashes.end() || it->second.isArchived)
                 continue;
 
-            // Mint was updated, queue for overwrite
-            vOverWrite.emplace_back(mint);
+            // Transaction lookups are skipped during IBD, so look at the mint again afterwards
+            if (fIBD)
+                setStatusDirty.insert(hashSerial);
+
+            CMintMeta mint = it->second;
+            if (UpdateStatusInternal(setMempool, mint) && !mint.isArchived) {
+                // Mint was updated, queue for overwrite
+                vOverWrite.emplace_back(mint);
+            }
         }
 
-        if (fUnusedOnly && mint.isUsed)
-            continue;
+        //overwrite any updates
+        for (CMintMeta& meta : vOverWrite)
+            UpdateState(meta);
+    }
+
+    std::set<CMintMeta> setMints;
+    int nConfirmedHeight = chainActive.Height() - Params().Zerocoin_MintRequiredConfirmations();
+    std::map<libzerocoin::CoinDenomination, int> mapMaturity;
+    if (fMatureOnly)
+        mapMaturity = GetMintMaturityHeight();
 
+    auto fnAdd = [&](const CMintMeta& mint) {
+        //This is only intended for unarchived coins
+        if (mint.isArchived)
+            return;
+        if (fUnusedOnly && mint.isUsed)
+            return;
         if (fMatureOnly) {
             // Not confirmed
-            if (!mint.nHeight || mint.nHeight > chainActive.Height() - Params().Zerocoin_MintRequiredConfirmations())
-                continue;
+            if (!mint.nHeight || mint.nHeight > nConfirmedHeight)
+                return;
             if (mint.nHeight >= mapMaturity.at(mint.denom))
-                continue;
+                return;
         }
         setMints.insert(mint);
-    }
+    };
 
-    //overwrite any updates
-    for (CMintMeta& meta : vOverWrite)
-        UpdateState(meta);
+    if (fUnusedOnly && fMatureOnly) {
+        for (auto& it : setUnusedConfirmed) {
+            if (it.first > nConfirmedHeight)
+                break;
+            fnAdd(mapSerialHashes.at(it.second));
+        }
+    } else if (fUnusedOnly) {
+        for (const uint256& hashSerial : setUnused)
+            fnAdd(mapSerialHashes.at(hashSerial));
+    } else {
+        for (auto& it : mapSerialHashes)
+            fnAdd(it.second);
+    }
 
     return setMints;
 }
 
+//! Queue the mints a connected or disconnected transaction mints or spends for a status check
+void CzUSERXTracker::NotifyTransaction(const CTransaction& tx)
+{
+    auto range = mapMintTxids.equal_range(tx.GetHash());
+    for (auto it = range.first; it != range.second; ++it)
+        setStatusDirty.insert(it->second);
+
+    if (!tx.IsZerocoinSpend())
+        return;
+
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        if (!tx.vin[i].scriptSig.IsZerocoinSpend())
+            continue;
+        try {
+            CoinSpendRef spend = TxInToZerocoinSpendRef(tx, i);
+            uint256 hashSerial = GetSerialHash(spend->getCoinSerialNumber());
+            if (mapSerialHashes.count(hashSerial))
+                setStatusDirty.insert(hashSerial);
+        } catch (const std::exception& e) {
+            LogPrintf("%s : failed to parse spend in tx %s: %s\n", __func__, tx.GetHash().GetHex(), e.what());
+        }
+    }
+}
+
 void CzUSERXTracker::Clear()
 {
     mapSerialHashes.clear();
-}
\ No newline at end of file
+    mapHashPubcoin.clear();
+    mapHashStake.clear();
+    mapMintTxids.clear();
+    setUnused.clear();
+    setUnusedConfirmed.clear();
+    setPendingMints.clear();
+    setStatusDirty.clear();
+    fInitialized = false;
+}
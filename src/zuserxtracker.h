@@ -5,18 +5,43 @@
 #ifndef USERX_ZUSERXTRACKER_H
 #define USERX_ZUSERXTRACKER_H
 
+#include "main.h"
 #include "primitives/zerocoin.h"
 #include <list>
+#include <set>
+
+#include <boost/unordered_map.hpp>
 
 class CDeterministicMint;
 
 class CzUSERXTracker
 {
-private:
+protected:
+    typedef boost::unordered_map<uint256, uint256, BlockHasher> HashIndex;
+
     bool fInitialized;
     std::string strWalletFile;
-    std::map<uint256, CMintMeta> mapSerialHashes;
+    boost::unordered_map<uint256, CMintMeta, BlockHasher> mapSerialHashes;
     std::map<uint256, uint256> mapPendingSpends; //serialhash, txid of spend
+
+    //! Secondary indexes onto mapSerialHashes: pubcoin hash and stake hash to serial hash
+    HashIndex mapHashPubcoin;
+    HashIndex mapHashStake;
+    //! Txid of the mint transaction to the serial hashes it minted
+    std::multimap<uint256, uint256> mapMintTxids;
+
+    //! Unarchived mints that are not used
+    std::set<uint256> setUnused;
+    //! Unused mints that are in a block, by height, so maturity is a prefix of the set
+    std::set<std::pair<int, uint256> > setUnusedConfirmed;
+    //! Unarchived mints without a known height or mint txid; their status is checked on every update
+    std::set<uint256> setPendingMints;
+    //! Mints touched by a connected or disconnected transaction since their status was last checked
+    std::set<uint256> setStatusDirty;
+
+    void IndexMeta(const CMintMeta& meta);
+    void UnindexMeta(const CMintMeta& meta);
+    void SetMeta(const CMintMeta& meta);
     bool UpdateStatusInternal(const std::set<uint256>& setMempool, CMintMeta& mint);
 public:
     CzUSERXTracker(std::string strWalletFile);
@@ -45,6 +70,7 @@ public:
     bool UnArchive(const uint256& hashPubcoin, bool isDeterministic);
     bool UpdateZerocoinMint(const CZerocoinMint& mint);
     bool UpdateState(const CMintMeta& meta);
+    void NotifyTransaction(const CTransaction& tx);
     void Clear();
 };
 
@@ -11,6 +11,10 @@
 #include "primitives/deterministicmint.h"
 #include "zuserxchain.h"
 
+#include <atomic>
+
+#include <boost/thread.hpp>
+
 using namespace libzerocoin;
 
 CzUSERXWallet::CzUSERXWallet(std::string strWalletFile)
@@ -104,12 +108,12 @@ void CzUSERXWallet::AddToMintPool(const std::pair<uint256, uint32_t>& pMint, boo
 }
 
 //Add the next 20 mints to the mint pool
-void CzUSERXWallet::GenerateMintPool(uint32_t nCountStart, uint32_t nCountEnd)
+bool CzUSERXWallet::GenerateMintPool(uint32_t nCountStart, uint32_t nCountEnd)
 {
 
     //Is locked
     if (seedMaster == 0)
-        return;
+        return true;
 
     uint32_t n = nCountLastUsed + 1;
 
@@ -120,38 +124,61 @@ void CzUSERXWallet::GenerateMintPool(uint32_t nCountStart, uint32_t nCountEnd)
     if (nCountEnd > 0)
         nStop = std::max(n, n + nCountEnd);
 
-    bool fFound;
-
     uint256 hashSeed = Hash(seedMaster.begin(), seedMaster.end());
     LogPrintf("%s : n=%d nStop=%d\n", __func__, n, nStop - 1);
-    for (uint32_t i = n; i < nStop; ++i) {
-        if (ShutdownRequested())
-            return;
-
-        fFound = false;
 
-        // Prevent unnecessary repeated minted
-        for (auto& pair : mintPool) {
-            if(pair.second == i) {
-                fFound = true;
-                break;
-            }
+    // Prevent unnecessary repeated minted
+    std::vector<uint32_t> vCounts;
+    for (uint32_t i = n; i < nStop; ++i) {
+        if (!mintPool.HasCount(i))
+            vCounts.push_back(i);
+    }
+    if (vCounts.empty())
+        return true;
+
+    // Each count derives independently, so spread the derivations over a worker pool
+    // Zerocoin_Params() initializes its statics lazily, so touch it before any worker does
+    Params().Zerocoin_Params(false);
+    std::vector<CBigNum> vValues(vCounts.size());
+    std::atomic<size_t> nNext(0);
+    auto derive = [&]() {
+        while (!ShutdownRequested()) {
+            size_t j = nNext++;
+            if (j >= vCounts.size())
+                return;
+            CBigNum bnSerial;
+            CBigNum bnRandomness;
+            CKey key;
+            SeedToZUSERX(GetZerocoinSeed(vCounts[j]), vValues[j], bnSerial, bnRandomness, key);
         }
+    };
+    int nThreads = std::max(1, std::min((int)vCounts.size(), (int)boost::thread::hardware_concurrency()));
+    boost::thread_group threadGroup;
+    for (int i = 1; i < nThreads; i++)
+        threadGroup.create_thread(derive);
+    derive();
+    threadGroup.join_all();
+    if (ShutdownRequested())
+        return false;
 
-        if(fFound)
-            continue;
-
-        uint512 seedZerocoin = GetZerocoinSeed(i);
-        CBigNum bnValue;
-        CBigNum bnSerial;
-        CBigNum bnRandomness;
-        CKey key;
-        SeedToZUSERX(seedZerocoin, bnValue, bnSerial, bnRandomness, key);
+    // Write the whole batch in one wallet DB transaction, and only then pool it
+    CWalletDB walletdb(strWalletFile);
+    if (!walletdb.TxnBegin())
+        return error("%s : failed to begin writing %d mint pool entries", __func__, vCounts.size());
+    for (unsigned int j = 0; j < vCounts.size(); j++) {
+        if (!walletdb.WriteMintPoolPair(hashSeed, GetPubCoinHash(vValues[j]), vCounts[j])) {
+            walletdb.TxnAbort();
+            return error("%s : failed to write mint pool entry count=%d", __func__, vCounts[j]);
+        }
+    }
+    if (!walletdb.TxnCommit())
+        return error("%s : failed to commit %d mint pool entries", __func__, vCounts.size());
 
-        mintPool.Add(bnValue, i);
-        CWalletDB(strWalletFile).WriteMintPoolPair(hashSeed, GetPubCoinHash(bnValue), i);
-        LogPrintf("%s : %s count=%d\n", __func__, bnValue.GetHex().substr(0, 6), i);
+    for (unsigned int j = 0; j < vCounts.size(); j++) {
+        mintPool.Add(vValues[j], vCounts[j]);
+        LogPrintf("%s : %s count=%d\n", __func__, vValues[j].GetHex().substr(0, 6), vCounts[j]);
     }
+    return true;
 }
 
 // pubcoin hashes are stored to db so that a full accounting of mints belonging to the seed can be tracked without regenerating
@@ -188,8 +215,10 @@ void CzUSERXWallet::SyncWithChain(bool fGenerateMintPool)
     set<uint256> setAddedTx;
     while (found) {
         found = false;
-        if (fGenerateMintPool)
-            GenerateMintPool();
+        if (fGenerateMintPool && !GenerateMintPool()) {
+            LogPrintf("%s: failed to extend the mint pool\n", __func__);
+            return;
+        }
         LogPrintf("%s: Mintpool size=%d\n", __func__, mintPool.size());
 
         std::set<uint256> setChecked;